@@ -4,10 +4,47 @@
 
 /* Includes ------------------------------------------------------------------*/
 #include "productDef.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* DMA source of the regular conversions */
+#define ADC3_DR_ADDRESS 0x4001224CUL
+
+/* Sample time of a channel, in ADC clock cycles (SMPR) */
+typedef enum {
+    ADC_SAMPLE_3_CYCLES = 0,
+    ADC_SAMPLE_15_CYCLES = 1,
+    ADC_SAMPLE_28_CYCLES = 2,
+    ADC_SAMPLE_56_CYCLES = 3,
+    ADC_SAMPLE_84_CYCLES = 4,
+    ADC_SAMPLE_112_CYCLES = 5,
+    ADC_SAMPLE_144_CYCLES = 6,
+    ADC_SAMPLE_480_CYCLES = 7
+} adc_sample_time_t;
+
+/* Conversion resolution (CR1 RES), applies to every channel of the ADC */
+typedef enum {
+    ADC_RESOLUTION_12_BITS = 0,
+    ADC_RESOLUTION_10_BITS = 1,
+    ADC_RESOLUTION_8_BITS = 2,
+    ADC_RESOLUTION_6_BITS = 3
+} adc_resolution_t;
+
+typedef struct {
+    uint8_t channel;
+    adc_sample_time_t sample_time;
+} adc_channel_t;
 
 /*Function
  * definitions---------------------------------------------------------*/
-void initADC3_5(void);
+void initADC3(adc_resolution_t resolution, const adc_channel_t *channels,
+              uint8_t num_channels);
 void startADCConversion(void);
+void setADC3WatchdogWindow(uint16_t low, uint16_t high);
+void enableADC3Watchdog(uint8_t channel);
+bool checkADC3WatchdogFlag(void);
+void clearADC3WatchdogFlag(void);
+bool checkADC3Overrun(void);
+void recoverADC3Overrun(void);
 
 #endif /*__GPIO_H */
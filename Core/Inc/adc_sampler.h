@@ -0,0 +1,51 @@
+/*
+ * adc_sampler.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#ifndef ADC_SAMPLER_H_
+#define ADC_SAMPLER_H_
+
+#include "adc_bad.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* DMA ring, in conversions. Each half holds whole sequences */
+#define ADC_SAMPLE_BUFFER_SIZE 64
+
+/* Called from the DMA interrupt with the half of the ring that just filled,
+ * sequence after sequence. Valid until the other half fills. */
+typedef void (*adc_block_handler_t)(const volatile uint16_t *block,
+                                    uint16_t length);
+
+typedef struct {
+    /* Sequences per second, each one converts every channel once */
+    uint32_t rate_hz;
+    adc_resolution_t resolution;
+    const adc_channel_t *channels;
+    uint8_t num_channels;
+    adc_block_handler_t on_block;
+    /* Called from the ADC interrupt when the analog watchdog trips */
+    void (*on_watchdog)(void);
+} adc_sampler_config_t;
+
+typedef struct {
+    uint32_t rate_hz;
+    uint32_t samples;
+    uint32_t overruns;
+    uint32_t dma_errors;
+    uint32_t elapsed_ms;
+} adc_sampler_stats_t;
+
+void init_adc_sampler(const adc_sampler_config_t *config);
+void start_adc_sampler(void);
+void stop_adc_sampler(void);
+bool adc_sampler_running(void);
+uint16_t adc_sampler_latest(uint8_t index);
+void get_adc_sampler_stats(adc_sampler_stats_t *stats);
+void print_adc_sampler_stats(void);
+void clear_adc_sampler_stats(void);
+
+#endif /* ADC_SAMPLER_H_ */
@@ -0,0 +1,32 @@
+/*
+ * boot.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#ifndef BOOT_H_
+#define BOOT_H_
+
+#include <stdbool.h>
+
+typedef enum {
+    BOOT_START,
+    BOOT_HAL_READY,
+    BOOT_PLL_STARTED,
+    BOOT_GPIO_READY,
+    BOOT_SYSCLK_READY,
+    BOOT_PERIPHERALS_READY,
+    BOOT_FIRST_HEARTBEAT,
+    BOOT_DEFERRED_DONE,
+    NUM_BOOT_MARKS
+} boot_mark_t;
+
+typedef void (*boot_task_t)(void);
+
+void boot_mark(boot_mark_t mark);
+bool boot_defer(boot_task_t task);
+void boot_run_deferred(void);
+void print_boot_log(void);
+
+#endif /* BOOT_H_ */
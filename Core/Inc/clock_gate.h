@@ -0,0 +1,25 @@
+/*
+ * clock_gate.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#ifndef CLOCK_GATE_H_
+#define CLOCK_GATE_H_
+
+#include "stm_utils.h"
+#include <stdint.h>
+
+/* Same (register, mask) form as the *_EN macros in stm_rcc.h */
+#define GPIO_CLOCK_EN(bank) 0, (1UL << ((uint32_t)(bank) >> 8))
+
+void acquire_clock(uint32_t reg, uint32_t mask);
+void release_clock(uint32_t reg, uint32_t mask);
+void acquire_gpio_clock(gpio_bank_t bank);
+void release_gpio_clock(gpio_bank_t bank);
+uint32_t clock_refcount(uint32_t reg, uint32_t mask);
+void flush_clock_releases(void);
+void print_clock_report(void);
+
+#endif /* CLOCK_GATE_H_ */
@@ -98,11 +98,55 @@
 #define INT_NUM_FMPI2C1            95
 #define INT_NUM_FMPI2C1_ERR        96
 
+#define NUM_VECTORS                (16 + INT_NUM_FMPI2C1_ERR + 1)
+
+// Set to false to link hot code into flash (for comparing ISR cycle counts)
+#define FASTCODE_IN_RAM true
+
+// Collect entry-to-exit cycle counts for the hot ISRs
+#define PROFILE_ISRS true
+
+#if FASTCODE_IN_RAM
+#define FASTCODE __attribute__((section(".fastcode"), noinline))
+#else
+#define FASTCODE
+#endif
+
+/* Placed outside .bss so the startup code does not zero it */
+#define NOINIT __attribute__((section(".noinit")))
+
+// DWT cycle counter, free running at the core clock once enabled
+#define CYCLE_COUNTER (*((volatile uint32_t *)0xE0001004))
+
+#if PROFILE_ISRS
+#define ISR_PROFILE_ENTER() uint32_t isr_profile_start = CYCLE_COUNTER
+#define ISR_PROFILE_EXIT(id)                                                   \
+    update_isr_profile(id, CYCLE_COUNTER - isr_profile_start)
+#else
+#define ISR_PROFILE_ENTER()
+#define ISR_PROFILE_EXIT(id)
+#endif
+
 typedef struct {
     uint8_t interrupt_id;
     uint8_t priority; // Larger number = lower priority
 } irq_info_t;
 
+typedef enum {
+    PROFILE_TICK,
+    PROFILE_EXTI9_5,
+    PROFILE_EXTI15_10,
+    PROFILE_TIM4,
+    PROFILE_DMA2_STREAM0,
+    NUM_ISR_PROFILES
+} isr_profile_id_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t total;
+    uint32_t max;
+} isr_profile_t;
+
 void disable_global_irq(void);
 void enable_global_irq(void);
 void configure_interrupt(irq_info_t config);
@@ -115,4 +159,10 @@ bool check_irq_active(irq_info_t irq);
 void send_software_irq(irq_info_t irq);
 void reset_system(void);
 
+void relocate_vector_table(void);
+void enable_cycle_counter(void);
+void update_isr_profile(isr_profile_id_t id, uint32_t cycles);
+void get_isr_profile(isr_profile_id_t id, isr_profile_t *profile);
+void clear_isr_profiles(void);
+
 #endif /* CORE_M4_H_ */
@@ -0,0 +1,52 @@
+/*
+ * dlog.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Deferred logging. DLOG() only copies a format id and up to DLOG_MAX_ARGS
+ * 32 bit arguments into a ring, so it is safe in any ISR. dlog_service()
+ * formats the entries later from the main loop. Arguments are stored as
+ * uint32_t, so use integer conversions only (no %s or floats).
+ *
+ * In raw mode the entries are streamed over USB CDC unformatted, as
+ * dlog_entry_t in little endian. The id is the offset of the format string in
+ * the .dlog_fmt section of the ELF, which tools/dlog_decode.py extracts with
+ * objcopy -O binary -j .dlog_fmt to print the stream.
+ */
+
+#ifndef DLOG_H_
+#define DLOG_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Must be a power of 2 */
+#define DLOG_RING_SIZE 64
+#define DLOG_MAX_ARGS  4
+
+typedef struct {
+    uint32_t header; /* DLOG_MAGIC | nargs << 16 | id */
+    uint32_t timestamp;
+    uint32_t args[DLOG_MAX_ARGS];
+} dlog_entry_t;
+
+#define DLOG_MAGIC 0xA5000000UL
+
+#define DLOG_NARGS_(_0, _1, _2, _3, _4, n, ...) n
+#define DLOG_NARGS(...) DLOG_NARGS_(0, ##__VA_ARGS__, 4, 3, 2, 1, 0)
+
+#define DLOG(fmt, ...)                                                         \
+    do {                                                                       \
+        static const char dlog_fmt_[]                                          \
+            __attribute__((section(".dlog_fmt"), used)) = fmt;                 \
+        dlog_write(dlog_fmt_, DLOG_NARGS(__VA_ARGS__),                         \
+                   (const uint32_t[DLOG_MAX_ARGS]){__VA_ARGS__});              \
+    } while (0)
+
+void dlog_write(const char *fmt, uint32_t nargs, const uint32_t *args);
+void dlog_service(void);
+void dlog_set_raw(bool raw);
+uint32_t dlog_dropped(void);
+
+#endif /* DLOG_H_ */
@@ -0,0 +1,125 @@
+/*
+ * dma.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#ifndef DMA_H_
+#define DMA_H_
+
+#include "stm_utils.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DMA_STREAMS_PER_CONTROLLER 8
+#define DMA_STREAMS                16
+
+/* Stream events, same bit positions as the stream 0 ISR/IFCR flags */
+#define DMA_EVENT_FIFO_ERROR       BIT0
+#define DMA_EVENT_DIRECT_ERROR     BIT2
+#define DMA_EVENT_TRANSFER_ERROR   BIT3
+#define DMA_EVENT_HALF_TRANSFER    BIT4
+#define DMA_EVENT_TRANSFER_DONE    BIT5
+#define DMA_EVENT_ALL                                                          \
+    (DMA_EVENT_FIFO_ERROR | DMA_EVENT_DIRECT_ERROR |                           \
+     DMA_EVENT_TRANSFER_ERROR | DMA_EVENT_HALF_TRANSFER |                      \
+     DMA_EVENT_TRANSFER_DONE)
+
+typedef enum {
+    DMA1_STREAM0,
+    DMA1_STREAM1,
+    DMA1_STREAM2,
+    DMA1_STREAM3,
+    DMA1_STREAM4,
+    DMA1_STREAM5,
+    DMA1_STREAM6,
+    DMA1_STREAM7,
+    DMA2_STREAM0,
+    DMA2_STREAM1,
+    DMA2_STREAM2,
+    DMA2_STREAM3,
+    DMA2_STREAM4,
+    DMA2_STREAM5,
+    DMA2_STREAM6,
+    DMA2_STREAM7
+} dma_stream_t;
+
+typedef enum {
+    DMA_PERIPH_TO_MEM = 0x0,
+    DMA_MEM_TO_PERIPH = 0x1,
+    /* DMA2 only, the peripheral address is the source */
+    DMA_MEM_TO_MEM = 0x2
+} dma_direction_t;
+
+typedef enum {
+    DMA_SIZE_BYTE = 0x0,
+    DMA_SIZE_HALF_WORD = 0x1,
+    DMA_SIZE_WORD = 0x2
+} dma_size_t;
+
+typedef enum {
+    DMA_PRIO_LOW = 0x0,
+    DMA_PRIO_MEDIUM = 0x1,
+    DMA_PRIO_HIGH = 0x2,
+    DMA_PRIO_VERY_HIGH = 0x3
+} dma_priority_t;
+
+/* Bursts need the FIFO */
+typedef enum {
+    DMA_BURST_SINGLE = 0x0,
+    DMA_BURST_INCR4 = 0x1,
+    DMA_BURST_INCR8 = 0x2,
+    DMA_BURST_INCR16 = 0x3
+} dma_burst_t;
+
+typedef enum {
+    DMA_FIFO_QUARTER = 0x0,
+    DMA_FIFO_HALF = 0x1,
+    DMA_FIFO_THREE_QUARTERS = 0x2,
+    DMA_FIFO_FULL = 0x3
+} dma_fifo_threshold_t;
+
+/* Runs in the stream interrupt with the events that were pending */
+typedef void (*dma_callback_t)(dma_stream_t stream, uint32_t events);
+
+typedef struct {
+    /* Request mapping, see the DMA request tables of the reference manual */
+    uint8_t channel;
+    dma_direction_t direction;
+    uint32_t peripheral;
+    dma_size_t peripheral_size;
+    bool peripheral_increment;
+    dma_size_t memory_size;
+    bool memory_increment;
+    dma_priority_t priority;
+    bool circular;
+    /* Swaps between the two memory addresses of dma_start() */
+    bool double_buffer;
+    /* Direct mode when false */
+    bool fifo;
+    dma_fifo_threshold_t fifo_threshold;
+    dma_burst_t peripheral_burst;
+    dma_burst_t memory_burst;
+    /* DMA_EVENT_* that interrupt and reach the callback */
+    uint32_t events;
+    dma_callback_t callback;
+    uint8_t irq_priority;
+} dma_config_t;
+
+bool dma_claim(dma_stream_t stream, const char *owner);
+void dma_release(dma_stream_t stream);
+void dma_configure(dma_stream_t stream, const dma_config_t *config);
+void dma_set_peripheral(dma_stream_t stream, uint32_t address);
+void dma_start(dma_stream_t stream, uint32_t memory0, uint32_t memory1,
+               uint16_t count);
+void dma_stop(dma_stream_t stream);
+bool dma_busy(dma_stream_t stream);
+uint16_t dma_remaining(dma_stream_t stream);
+uint8_t dma_current_target(dma_stream_t stream);
+void dma_set_memory(dma_stream_t stream, uint8_t target, uint32_t address);
+uint32_t dma_read_events(dma_stream_t stream);
+void dma_clear_events(dma_stream_t stream, uint32_t events);
+void print_dma_streams(void);
+
+#endif /* DMA_H_ */
@@ -0,0 +1,36 @@
+/*
+ * dma_copy.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#ifndef DMA_COPY_H_
+#define DMA_COPY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Below this many bytes the CPU is faster than setting up a transfer. An
+ * estimate from the setup cost and a copy loop of about a byte per cycle, not
+ * a measurement; check it against print_dma_copy_benchmark() on the board */
+#define DMA_COPY_THRESHOLD 128
+
+/* Requests waiting behind the running one. A full queue falls back to the
+ * CPU */
+#define DMA_COPY_QUEUE     4
+
+/* Runs once the destination holds the data, from the DMA interrupt or, when
+ * the CPU did the work, before the call returns */
+typedef void (*dma_copy_callback_t)(void *context);
+
+void init_dma_copy(void);
+void dma_memcpy(void *dst, const void *src, uint32_t length,
+                dma_copy_callback_t callback, void *context);
+void dma_memset(void *dst, uint8_t value, uint32_t length,
+                dma_copy_callback_t callback, void *context);
+bool dma_copy_busy(void);
+void dma_copy_wait(void);
+void print_dma_copy_benchmark(void);
+
+#endif /* DMA_COPY_H_ */
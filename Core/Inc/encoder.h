@@ -0,0 +1,23 @@
+/*
+ * encoder.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#ifndef ENCODER_H_
+#define ENCODER_H_
+
+#include <stdint.h>
+
+/* Snapshots taken by encoder_sample(), called at the control rate */
+#define ENCODER_SAMPLE_HZ     10000
+#define ENCODER_VELOCITY_SPAN 10
+
+void init_encoder(void);
+void encoder_sample(void);
+int32_t encoder_position(void);
+int32_t encoder_velocity(void);
+void encoder_set_position(int32_t counts);
+
+#endif /* ENCODER_H_ */
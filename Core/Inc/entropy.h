@@ -0,0 +1,28 @@
+/*
+ * entropy.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#ifndef ENTROPY_H_
+#define ENTROPY_H_
+
+#include <stdint.h>
+
+/* Conservative credit per sample, in bits */
+#define ENTROPY_HEARTBEAT_BITS 1
+#define ENTROPY_EVENT_BITS     4
+
+/* The generator is reseeded once the pool has collected this much */
+#define ENTROPY_RESEED_BITS    128
+
+void init_entropy(void);
+void entropy_add(uint32_t sample, uint32_t bits);
+void harvest_entropy(void);
+void entropy_service(void);
+uint32_t random_u32(void);
+uint32_t random_below(uint32_t bound);
+uint32_t random_range(uint32_t min, uint32_t max);
+
+#endif /* ENTROPY_H_ */
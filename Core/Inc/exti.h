@@ -32,10 +32,12 @@ void get_exti_configs(uint8_t channel, exti_config_t *config);
 void generate_exti_software_event(uint8_t channel);
 bool exti_software_event_generated(uint8_t channel);
 bool check_exti_channel_pending(uint8_t channel);
+uint32_t read_pending_exti_events(uint32_t mask);
 void acknowledge_exti_event(uint8_t channel);
 void acknowledge_multiple_exti_events(uint8_t channel0, uint8_t channel1,
                                       uint8_t channel2, uint8_t channel3,
                                       uint8_t channel4, uint8_t channel5);
+void acknowledge_exti_events(uint32_t mask);
 void clear_pending_exti_events(void);
 
 #endif /* EXTI_H_ */
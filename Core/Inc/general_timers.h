@@ -40,10 +40,22 @@
 #define TIM_MM_0C3REF_COMPARE 0x6
 #define TIM_MM_0C4REF_COMPARE 0x7
 
+// Slave mode selection (SMS)
+#define SMS_DISABLED       0x0
+#define SMS_ENCODER_MODE_1 0x1 // count on TI2 edges
+#define SMS_ENCODER_MODE_2 0x2 // count on TI1 edges
+#define SMS_ENCODER_MODE_3 0x3 // count on both, 4x resolution
+
 // captureDMA
 #define CCx_EVENT    false
 #define UPDATE_EVENT true
 
+// DMA base address (DCR DBA), in registers from CR1
+#define TIM_DMA_BASE_CCR1 0x0D
+#define TIM_DMA_BASE_CCR2 0x0E
+#define TIM_DMA_BASE_CCR3 0x0F
+#define TIM_DMA_BASE_CCR4 0x10
+
 // Interrupt enable
 #define TDE   BITE
 #define CC4DE BITC
@@ -103,6 +115,8 @@ typedef enum {
     TIMER3 = 0x100,
     TIMER4 = 0x200,
     TIMER5 = 0x300,
+    /* Advanced timer, only its general purpose features are used */
+    TIMER8 = 0x4100,
 } general_timers_32bit_t;
 
 typedef enum {
@@ -209,6 +223,11 @@ void disableCaptureCompareChannel(general_timers_32bit_t timer,
 uint16_t getCounterValue(general_timers_32bit_t timer);
 void setCounterValue(general_timers_32bit_t timer, uint16_t value);
 
+/* TIM2 and TIM5 only */
+uint32_t getCounterValue32(general_timers_32bit_t timer);
+void setCounterValue32(general_timers_32bit_t timer, uint32_t value);
+void setAutoReload32(general_timers_32bit_t timer, uint32_t value);
+
 uint32_t readCaptureValue(general_timers_32bit_t timer, uint8_t channel);
 
 void clearTimerStatusRegister(general_timers_32bit_t timer);
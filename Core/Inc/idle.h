@@ -0,0 +1,39 @@
+/*
+ * idle.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#ifndef IDLE_H_
+#define IDLE_H_
+
+#include "stm_utils.h"
+#include <stdint.h>
+
+/* STOP mode stops every clock but LSI, so TIM4, PWM, the ADC sampler, USB and
+ * the UART pause and the first console character after it can be lost. Off by
+ * default. */
+#define IDLE_ALLOW_STOP false
+
+typedef enum {
+    POWER_RUN,
+    POWER_SLEEP,
+    POWER_STOP,
+    NUM_POWER_STATES
+} power_state_t;
+
+/* Users of clocks that must keep running, STOP is skipped while any is set */
+#define IDLE_BLOCK_MOTOR BIT0
+#define IDLE_BLOCK_PWM   BIT1
+#define IDLE_BLOCK_USB   BIT2
+#define IDLE_BLOCK_ADC   BIT3
+
+void init_idle(void);
+void idle_block_stop(uint32_t source);
+void idle_allow_stop(uint32_t source);
+void idle_sleep(void);
+void print_power_stats(void);
+void clear_power_stats(void);
+
+#endif /* IDLE_H_ */
@@ -0,0 +1,42 @@
+/*
+ * motion_profile.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#ifndef MOTION_PROFILE_H_
+#define MOTION_PROFILE_H_
+
+#include "pid.h"
+#include <stdint.h>
+
+/* One table entry every 2^MOTION_TABLE_SHIFT control ticks */
+#define MOTION_TABLE_SHIFT 4
+#define MOTION_TABLE_SIZE  128
+#define MOTION_MAX_TICKS   ((MOTION_TABLE_SIZE - 1) << MOTION_TABLE_SHIFT)
+
+typedef enum { MOTION_TRAPEZOID, MOTION_S_CURVE } motion_shape_t;
+
+/* In full travel (Q15 1.0) per second, per second^2 and per second^3 */
+typedef struct {
+    motion_shape_t shape;
+    float max_velocity;
+    float max_acceleration;
+    float max_jerk;
+} motion_limits_t;
+
+/* Position is the fraction of the move done and velocity that fraction per
+ * tick, both Q31 */
+typedef struct {
+    uint32_t ticks;
+    q31_t position[MOTION_TABLE_SIZE];
+    q31_t velocity[MOTION_TABLE_SIZE];
+} motion_profile_t;
+
+void build_motion_profile(motion_profile_t *profile, motion_limits_t limits,
+                          q15_t distance, uint32_t tick_hz);
+void sample_motion_profile(const motion_profile_t *profile, uint32_t tick,
+                           q31_t *position, q31_t *velocity);
+
+#endif /* MOTION_PROFILE_H_ */
@@ -13,6 +13,7 @@
 void init_motor_pins(void);
 void start_slap(void);
 void reset_slap(void);
+void release_slap(void);
 bool done_with_actuation(void);
 void block_actuation_events(void);
 
@@ -0,0 +1,34 @@
+/*
+ * motor_control.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#ifndef MOTOR_CONTROL_H_
+#define MOTOR_CONTROL_H_
+
+#include "motion_profile.h"
+#include "pid.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* TIM4 runs at 84 MHz: PSC 0, ARR 8399 */
+#define MOTOR_CONTROL_HZ 10000
+#define MS_TO_TICKS(ms)  ((ms) * (MOTOR_CONTROL_HZ / 1000))
+
+#define SLAP_POSITION    Q15(0.9f)
+#define RESET_POSITION   0
+
+typedef enum { MOVE_SLAP, MOVE_RESET, NUM_MOTOR_MOVES } motor_move_t;
+
+void init_motor_control(void);
+void configure_motor_move(motor_move_t move, motion_limits_t limits);
+void motor_move(motor_move_t move);
+void motor_stop(void);
+bool motor_at_target(void);
+q15_t motor_position(void);
+int32_t motor_velocity(void);
+void motor_setpoint(q15_t *position, q31_t *velocity);
+
+#endif /* MOTOR_CONTROL_H_ */
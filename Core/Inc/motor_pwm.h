@@ -0,0 +1,27 @@
+/*
+ * motor_pwm.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#ifndef MOTOR_PWM_H_
+#define MOTOR_PWM_H_
+
+#include "pid.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* TIM3 CH3 on PB0, 84 MHz timer clock */
+#define PWM_FREQUENCY_HZ 20000
+#define PWM_PERIOD       (84000000 / PWM_FREQUENCY_HZ)
+
+typedef enum { PROFILE_SLAP, PROFILE_RESET, NUM_PWM_PROFILES } pwm_profile_t;
+
+void init_motor_pwm(void);
+void set_motor_duty(q15_t duty);
+void start_pwm_profile(pwm_profile_t profile);
+void stop_pwm_profile(void);
+bool pwm_profile_done(void);
+
+#endif /* MOTOR_PWM_H_ */
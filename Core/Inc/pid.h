@@ -0,0 +1,36 @@
+/*
+ * pid.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#ifndef PID_H_
+#define PID_H_
+
+#include <stdint.h>
+
+typedef int16_t q15_t;
+typedef int32_t q31_t;
+
+#define Q15_MAX  ((q15_t)0x7FFF)
+#define Q15_MIN  ((q15_t)0x8000)
+#define Q15(x)   ((q15_t)((x) * 32768.0f))
+
+typedef struct {
+    /* Gains are Q15 fractions scaled by 2^gain_shift */
+    q15_t kp;
+    q15_t ki;
+    q15_t kd;
+    uint8_t gain_shift;
+    q15_t out_min;
+    q15_t out_max;
+    /* State, cleared by pid_reset() */
+    int64_t integral;
+    q15_t prev_measurement;
+} pid_controller_t;
+
+void pid_reset(pid_controller_t *pid, q15_t measurement);
+q15_t pid_update(pid_controller_t *pid, q15_t setpoint, q15_t measurement);
+
+#endif /* PID_H_ */
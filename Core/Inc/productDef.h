@@ -43,13 +43,24 @@ void Error_Handler(void);
 #define HEARTBEAT_PRIORITY 10
 #define REACTION_PRIORITY  9
 #define MOTOR_PRIORITY     11
+#define ADC_PRIORITY       10
+
+/* Interrupt only priorities */
+#define MOTOR_CONTROL_PRIORITY 8
+#define USB_PRIORITY           12
+#define UART_PRIORITY          13
+#define DMA_COPY_PRIORITY      13
+#define IDLE_PRIORITY          14
 
 #define E_NO_EVENT         0x00000000
 #define E_HEARTBEAT        0x00000001
 #define E_REACTION         0x00000002
 #define E_ACTUATION_DONE   0x00000004
+#define E_COMMAND          0x00000008
+#define E_HAND             0x00000010
 
-#define E_VALID_MASK       (E_HEARTBEAT | E_REACTION | E_ACTUATION_DONE)
+#define E_VALID_MASK                                                           \
+    (E_HEARTBEAT | E_REACTION | E_ACTUATION_DONE | E_COMMAND | E_HAND)
 
 extern volatile uint32_t gEvents;
 
@@ -8,11 +8,28 @@
 #ifndef REACTION_H_
 #define REACTION_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 
+/* EXTI lines 5 to 9, one per IR sensor */
+#define REACTION_FIRST_LINE 5
+#define REACTION_LINES      5
+
+typedef struct {
+    /* Since the start of the round, only valid for lifted lines */
+    uint32_t lift_us[REACTION_LINES];
+    uint32_t first_us;
+    uint32_t last_us;
+    uint32_t spread_us;
+    /* Bit n is set once line REACTION_FIRST_LINE + n lifted */
+    uint8_t lifted;
+} reaction_round_t;
+
 void config_reaction(void);
 void start_reaction(void);
 void stop_reaction(void);
 uint32_t read_reaction(void);
+bool read_reaction_round(reaction_round_t *round);
+void print_reaction_round(void);
 
 #endif /* REACTION_H_ */
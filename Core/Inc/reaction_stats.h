@@ -0,0 +1,37 @@
+/*
+ * reaction_stats.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#ifndef REACTION_STATS_H_
+#define REACTION_STATS_H_
+
+#include <stdint.h>
+
+/* Must be a power of 2 */
+#define REACTION_HISTORY_SIZE 64
+
+typedef struct {
+    uint32_t timestamp;
+    uint32_t reaction_ms;
+} reaction_sample_t;
+
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    float mean;
+    float stddev;
+    float p50;
+    float p90;
+} reaction_summary_t;
+
+void record_reaction(uint32_t reaction_ms, uint32_t timestamp);
+uint32_t get_reaction_history(reaction_sample_t *samples, uint32_t max);
+void get_reaction_summary(reaction_summary_t *summary);
+void clear_reaction_stats(void);
+void print_reaction_stats(void);
+
+#endif /* REACTION_STATS_H_ */
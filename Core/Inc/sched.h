@@ -0,0 +1,36 @@
+/*
+ * sched.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#ifndef SCHED_H_
+#define SCHED_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* 0 is the highest priority, one task per level */
+#define SCHED_NUM_PRIORITIES 32
+#define SCHED_MAX_BACKGROUND 8
+
+typedef void (*task_handler_t)(uint32_t events);
+typedef void (*background_task_t)(void);
+
+typedef struct {
+    uint32_t runs;
+    uint64_t total_cycles;
+    uint32_t max_cycles;
+    uint32_t max_latency; /* cycles from post to dispatch */
+} task_stats_t;
+
+bool sched_add_task(const char *name, uint8_t priority, uint32_t events,
+                    task_handler_t handler);
+bool sched_add_background(background_task_t task);
+void sched_post(uint32_t events);
+void sched_run(void);
+void sched_print_stats(void);
+void sched_clear_stats(void);
+
+#endif /* SCHED_H_ */
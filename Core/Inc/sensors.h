@@ -9,14 +9,27 @@
 #define IR_SENSORS_H_
 
 #include <stdbool.h>
+#include <stdint.h>
+
+/* Let the ADC compare every conversion instead of polling the result */
+#define FSR_ANALOG_WATCHDOG true
 
 typedef enum { IR_0 = 0, IR_1 = 1, IR_2 = 2, IR_3 = 3, IR_4 = 4 } ir_sensor_t;
 
 void initialize_ir_sensors(void);
 void initialize_fsr(void);
+void start_fsr(void);
+void stop_fsr(void);
+void fsr_stream(bool on);
+uint32_t fsr_stream_dropped(void);
+void fsr_stream_service(void);
 void refresh_ir_sensors(void);
 bool all_ir_sensors_covered(void);
 bool read_ir_sensor(ir_sensor_t sensor);
 bool fsr_asserted(void);
+uint32_t fsr_change_ts(void);
+void load_fsr_calibration(void);
+uint32_t get_fsr_threshold(void);
+void set_fsr_threshold(uint32_t threshold);
 
 #endif /* IR_SENSORS_H_ */
@@ -8,8 +8,22 @@
 #ifndef INC_SERIAL_H_
 #define INC_SERIAL_H_
 
-void MX_USART3_UART_Init(void);
+#include <stdbool.h>
+
+/* Must be powers of 2 */
+#define UART_RX_BUFFER_SIZE 128
+#define UART_TX_BUFFER_SIZE 256
+
+void init_uart(void);
 void MX_USB_OTG_FS_PCD_Init(void);
 void USB_GPIO_Init(void);
+void init_usb(void);
+void init_uart_rx(void);
+bool uart_read_char(char *c);
+bool uart_rx_pending(void);
+bool uart_tx_idle(void);
+void uart_flush(void);
+void print_uart_stats(void);
+void clear_uart_stats(void);
 
 #endif /* INC_SERIAL_H_ */
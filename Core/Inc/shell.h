@@ -0,0 +1,17 @@
+/*
+ * shell.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#ifndef SHELL_H_
+#define SHELL_H_
+
+#define SHELL_LINE_SIZE 64
+#define SHELL_MAX_ARGS  4
+
+void init_shell(void);
+void shell_process(void);
+
+#endif /* SHELL_H_ */
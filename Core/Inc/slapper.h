@@ -9,9 +9,11 @@
 #define SLAPPER_H_
 
 #include <stdbool.h>
+#include <stdint.h>
 
 typedef enum {
     NO_ACTION,
+    START_ROUND,
     SENSORS_USER_QUERY,
     PRINT_PAUSED,
     PRINT_RED,
@@ -23,6 +25,11 @@ typedef enum {
     QUERY_PLAY_AGAIN
 } slapper_action_t;
 
+void init_slapper(void);
+uint32_t get_difficulty(void);
+void set_difficulty(uint32_t difficulty);
 slapper_action_t run_slapper(bool start, bool pause, bool actuator_done);
+slapper_action_t slapper_hand_changed(bool on);
+bool slapper_idle(void);
 
 #endif /* SLAPPER_H_ */
@@ -87,6 +87,22 @@
 #define TIM8_EN                    4, BIT1
 #define TIM1_EN                    4, BIT0
 
+/* Peripheral reset macros */
+/* Bus clocks a reset is held for, at the current prescalers */
+#define RESET_HOLD_BUS_CYCLES 2
+
+/* Same register order as the *_EN macros */
+#define RESET_AHB1            0
+#define RESET_AHB2            1
+#define RESET_AHB3            2
+#define RESET_APB1            3
+#define RESET_APB2            4
+#define RESET_REGISTERS       5
+
+#define RESET_ID(reg, bit)    (((reg) << 5) | (bit))
+#define RESET_REGISTER(id)    ((uint32_t)(id) >> 5)
+#define RESET_BIT(id)         ((uint32_t)(id) & 0x1F)
+
 /* Backup domain control macros */
 #define LOW_POWER  false
 #define HIGH_DRIVE true
@@ -149,6 +165,65 @@ typedef enum {
     CLK_AHB_APB1_BRIDGE = 0
 } clocks_t;
 
+typedef enum {
+    RESET_GPIOA = RESET_ID(RESET_AHB1, 0),
+    RESET_GPIOB = RESET_ID(RESET_AHB1, 1),
+    RESET_GPIOC = RESET_ID(RESET_AHB1, 2),
+    RESET_GPIOD = RESET_ID(RESET_AHB1, 3),
+    RESET_GPIOE = RESET_ID(RESET_AHB1, 4),
+    RESET_GPIOF = RESET_ID(RESET_AHB1, 5),
+    RESET_GPIOG = RESET_ID(RESET_AHB1, 6),
+    RESET_GPIOH = RESET_ID(RESET_AHB1, 7),
+    RESET_CRC = RESET_ID(RESET_AHB1, 12),
+    RESET_DMA1 = RESET_ID(RESET_AHB1, 21),
+    RESET_DMA2 = RESET_ID(RESET_AHB1, 22),
+    RESET_USB_OTG_HS = RESET_ID(RESET_AHB1, 29),
+    RESET_CAMERA_INTERFACE = RESET_ID(RESET_AHB2, 0),
+    RESET_USB_OTG_FS = RESET_ID(RESET_AHB2, 7),
+    RESET_FLEXIBLE_MEM_CONTROLLER = RESET_ID(RESET_AHB3, 0),
+    RESET_QUADSPI = RESET_ID(RESET_AHB3, 1),
+    RESET_TIM2 = RESET_ID(RESET_APB1, 0),
+    RESET_TIM3 = RESET_ID(RESET_APB1, 1),
+    RESET_TIM4 = RESET_ID(RESET_APB1, 2),
+    RESET_TIM5 = RESET_ID(RESET_APB1, 3),
+    RESET_TIM6 = RESET_ID(RESET_APB1, 4),
+    RESET_TIM7 = RESET_ID(RESET_APB1, 5),
+    RESET_TIM12 = RESET_ID(RESET_APB1, 6),
+    RESET_TIM13 = RESET_ID(RESET_APB1, 7),
+    RESET_TIM14 = RESET_ID(RESET_APB1, 8),
+    RESET_WWDG = RESET_ID(RESET_APB1, 11),
+    RESET_SPI2 = RESET_ID(RESET_APB1, 14),
+    RESET_SPI3 = RESET_ID(RESET_APB1, 15),
+    RESET_SPDIFRX = RESET_ID(RESET_APB1, 16),
+    RESET_UART2 = RESET_ID(RESET_APB1, 17),
+    RESET_UART3 = RESET_ID(RESET_APB1, 18),
+    RESET_UART4 = RESET_ID(RESET_APB1, 19),
+    RESET_UART5 = RESET_ID(RESET_APB1, 20),
+    RESET_I2C1 = RESET_ID(RESET_APB1, 21),
+    RESET_I2C2 = RESET_ID(RESET_APB1, 22),
+    RESET_I2C3 = RESET_ID(RESET_APB1, 23),
+    RESET_FMPI2C1 = RESET_ID(RESET_APB1, 24),
+    RESET_CAN1 = RESET_ID(RESET_APB1, 25),
+    RESET_CAN2 = RESET_ID(RESET_APB1, 26),
+    RESET_CEC = RESET_ID(RESET_APB1, 27),
+    RESET_PWR = RESET_ID(RESET_APB1, 28),
+    RESET_DAC = RESET_ID(RESET_APB1, 29),
+    RESET_TIM1 = RESET_ID(RESET_APB2, 0),
+    RESET_TIM8 = RESET_ID(RESET_APB2, 1),
+    RESET_UART1 = RESET_ID(RESET_APB2, 4),
+    RESET_UART6 = RESET_ID(RESET_APB2, 5),
+    RESET_ADC = RESET_ID(RESET_APB2, 8),
+    RESET_SDIO = RESET_ID(RESET_APB2, 11),
+    RESET_SPI1 = RESET_ID(RESET_APB2, 12),
+    RESET_SPI4 = RESET_ID(RESET_APB2, 13),
+    RESET_SYSCONFIG = RESET_ID(RESET_APB2, 14),
+    RESET_TIM9 = RESET_ID(RESET_APB2, 16),
+    RESET_TIM10 = RESET_ID(RESET_APB2, 17),
+    RESET_TIM11 = RESET_ID(RESET_APB2, 18),
+    RESET_SAI1 = RESET_ID(RESET_APB2, 22),
+    RESET_SAI2 = RESET_ID(RESET_APB2, 23)
+} peripheral_reset_t;
+
 /* Clock control */
 void enable_PLL(uint32_t pll);
 void disable_PLL(uint32_t pll);
@@ -181,6 +256,8 @@ void update_PPRE1(uint8_t bitfield);
 void update_HPRE(uint8_t bitfield);
 void update_SW(uint8_t bitfield);
 uint32_t read_clk_configs(uint32_t bitfield);
+uint32_t read_sysclk_frequency(void);
+uint32_t read_bus_frequency(uint32_t reg);
 
 /* Clock interrupts */
 void clear_clock_interrupt(uint32_t mask);
@@ -188,59 +265,12 @@ void enable_clock_interrupt(uint32_t mask);
 uint32_t check_clock_interrupt(uint32_t mask);
 
 /* Peripheral reset */
-void reset_gpio_clock(gpio_bank_t bank, bool hold_reset);
-void reset_usb_otg_hs(bool hold_reset);
-void reset_dma1(bool hold_reset);
-void reset_dma2(bool hold_reset);
-void reset_crc(bool hold_reset);
-
-void reset_usb_otg_fs(bool hold_reset);
-void reset_camera_interface(bool hold_reset);
-
-void reset_quad_spi(bool hold_reset);
-void reset_flexible_memory_controller(bool hold_reset);
-
-void reset_dac(bool hold_reset);
-void reset_pwr(bool hold_reset);
-void reset_cec(bool hold_reset);
-void reset_can2(bool hold_reset);
-void reset_can1(bool hold_reset);
-void reset_fmpi2c(bool hold_reset);
-void reset_i2c3(bool hold_reset);
-void reset_i2c2(bool hold_reset);
-void reset_i2c1(bool hold_reset);
-void reset_uart5(bool hold_reset);
-void reset_uart4(bool hold_reset);
-void reset_usart3(bool hold_reset);
-void reset_usart2(bool hold_reset);
-void reset_spdif_rx(bool hold_reset);
-void reset_spi3(bool hold_reset);
-void reset_spi2(bool hold_reset);
-void reset_window_watchdog(bool hold_reset);
-void reset_timer14(bool hold_reset);
-void reset_timer13(bool hold_reset);
-void reset_timer12(bool hold_reset);
-void reset_timer7(bool hold_reset);
-void reset_timer6(bool hold_reset);
-void reset_timer5(bool hold_reset);
-void reset_timer4(bool hold_reset);
-void reset_timer3(bool hold_reset);
-void reset_timer2(bool hold_reset);
-
-void reset_sai2(bool hold_reset);
-void reset_sai1(bool hold_reset);
-void reset_timer11(bool hold_reset);
-void reset_timer10(bool hold_reset);
-void reset_timer9(bool hold_reset);
-void reset_sys_config(bool hold_reset);
-void reset_spi4(bool hold_reset);
-void reset_spi1(bool hold_reset);
-void reset_sdio(bool hold_reset);
-void reset_adc(bool hold_reset);
-void reset_usart6(bool hold_reset);
-void reset_usart1(bool hold_reset);
-void reset_timer8(bool hold_reset);
-void reset_timer1(bool hold_reset);
+void reset_peripheral(peripheral_reset_t peripheral, bool hold_reset);
+void release_peripheral_reset(peripheral_reset_t peripheral);
+void reset_peripherals(const peripheral_reset_t peripherals[], uint8_t n,
+                       bool hold_reset);
+void release_peripheral_resets(const peripheral_reset_t peripherals[],
+                               uint8_t n);
 
 /* Peripheral clock enable */
 void enable_gpio_clock(gpio_bank_t bank);
@@ -250,6 +280,7 @@ bool check_gpio_clock(gpio_bank_t bank);
 void enable_peripheral_clock(uint32_t reg, uint32_t peripheral);
 void disable_peripheral_clock(uint32_t reg, uint32_t peripheral);
 bool check_peripheral_clock(uint32_t reg, uint32_t peripheral);
+uint32_t read_peripheral_clocks(uint32_t reg);
 
 void enable_peripheral_low_power_clock(uint32_t reg, uint32_t peripheral);
 void disable_peripheral_low_power_clock(uint32_t reg, uint32_t peripheral);
@@ -0,0 +1,32 @@
+/*
+ * storage.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#ifndef STORAGE_H_
+#define STORAGE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Stored in flash, only append new keys */
+typedef enum {
+    KEY_USER_SCORE,
+    KEY_CPU_SCORE,
+    KEY_FSR_THRESHOLD,
+    KEY_DIFFICULTY,
+    KEY_RANDOM_SEED,
+    NUM_STORAGE_KEYS
+} storage_key_t;
+
+void init_storage(void);
+bool storage_get(storage_key_t key, uint32_t *value);
+uint32_t storage_get_or(storage_key_t key, uint32_t fallback);
+void storage_set(storage_key_t key, uint32_t value);
+void storage_allow_erase(bool allow);
+void storage_service(void);
+void storage_flush(void);
+
+#endif /* STORAGE_H_ */
@@ -0,0 +1,18 @@
+/*
+ * sysclock.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#ifndef SYSCLOCK_H_
+#define SYSCLOCK_H_
+
+#include <stdbool.h>
+
+void start_system_clock(void);
+bool system_clock_locked(void);
+void finish_system_clock(void);
+void restore_system_clock(void);
+
+#endif /* SYSCLOCK_H_ */
@@ -18,6 +18,7 @@ typedef struct {
 
 // TODO: Add more sysconfig stuff
 void start_sysconfig(void);
+void stop_sysconfig(void);
 void configure_exti_line(exti_select_t config);
 void get_exti_line_config(uint8_t channel, exti_select_t *gpio_config);
 
@@ -8,12 +8,32 @@
 #ifndef TIMERS_H_
 #define TIMERS_H_
 
+#include <stdbool.h>
 #include <stdint.h>
 
-void init_heartbeat(void);
+/* One interrupt drives the HAL tick, the heartbeat, the watchdog and the time
+ * base, from either source */
+#define TICK_SOURCE_TIM2    0
+#define TICK_SOURCE_SYSTICK 1
+#define SYSTEM_TICK_SOURCE  TICK_SOURCE_TIM2
+/* The HAL tick assumes 1 kHz */
+#define SYSTEM_TICK_HZ      1000
+
+/* Lets idle merge up to TICKLESS_MAX_TICKS ticks into one interrupt while
+ * the game waits for the start button */
+#define SYSTEM_TICKLESS     false
+#define TICKLESS_MAX_TICKS  10
+
+void init_system_tick(void);
 void kick_the_watchdog(void);
 void disable_watchdog(void);
 void enable_watchdog(void);
+void watchdog_service(void);
+void set_tickless_limit(uint32_t ticks);
+uint32_t suppress_ticks(void);
+void resume_ticks(void);
+void advance_ticks(uint32_t cycles);
+uint32_t read_tick_cycles(void);
 uint32_t read_heartbeat(void);
 void start_measurement(void);
 void stop_measurement(void);
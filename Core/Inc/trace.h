@@ -0,0 +1,50 @@
+/*
+ * trace.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#ifndef TRACE_H_
+#define TRACE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Costs the 8 KB buffer and an IRQ mask in every traced ISR, so it is off
+ * unless the build passes -DTRACE_ENABLE=1 */
+#ifndef TRACE_ENABLE
+#define TRACE_ENABLE      false
+#endif
+
+/* Records, must be a power of 2 */
+#define TRACE_BUFFER_SIZE 1024
+
+typedef enum {
+    TRACE_TICK,           /* payload: ticks accounted */
+    TRACE_EXTI9_5,
+    TRACE_EXTI15_10,
+    TRACE_DISPATCH_BEGIN, /* payload: event bits */
+    TRACE_DISPATCH_END,   /* payload: event bits */
+    TRACE_STATE,          /* payload: new slapper state */
+    NUM_TRACE_IDS
+} trace_id_t;
+
+typedef struct {
+    uint32_t delta; /* CPU cycles since the previous record */
+    uint16_t id;
+    uint16_t payload;
+} trace_record_t;
+
+#if TRACE_ENABLE
+#define TRACE(id, payload) trace_record(id, payload)
+#else
+#define TRACE(id, payload)
+#endif
+
+void trace_record(trace_id_t id, uint16_t payload);
+void trace_clear(void);
+void trace_dump(bool usb);
+void trace_service(void);
+
+#endif /* TRACE_H_ */
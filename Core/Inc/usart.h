@@ -0,0 +1,89 @@
+/*
+ * usart.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#ifndef USART_H_
+#define USART_H_
+
+#include "stm_utils.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Status flags (SR). TXE, TC, RXNE and IDLE are also the interrupt enables
+ * in CR1 */
+#define USART_PE   BIT0
+#define USART_FE   BIT1
+#define USART_NF   BIT2
+#define USART_ORE  BIT3
+#define USART_IDLE BIT4
+#define USART_RXNE BIT5
+#define USART_TC   BIT6
+#define USART_TXE  BIT7
+
+#define USART_INTERRUPTS (USART_TXE | USART_TC | USART_RXNE | USART_IDLE)
+#define USART_ERRORS     (USART_PE | USART_FE | USART_NF | USART_ORE)
+
+/* Register block, in words from 0x40000000 */
+typedef enum {
+    usart_2 = 0x1100,
+    usart_3 = 0x1200,
+    uart_4 = 0x1300,
+    uart_5 = 0x1400,
+    usart_1 = 0x4400,
+    usart_6 = 0x4500
+} usart_port_t;
+
+/* CR1 PCE and PS. With parity the frame is 9 bits so there are still 8 data
+ * bits */
+typedef enum {
+    no_parity = 0x0,
+    even_parity = 0x2,
+    odd_parity = 0x3
+} usart_parity_t;
+
+/* CR2 STOP */
+typedef enum {
+    one_stop_bit = 0x0,
+    half_stop_bit = 0x1,
+    two_stop_bits = 0x2,
+    one_and_half_stop_bits = 0x3
+} usart_stop_bits_t;
+
+typedef struct {
+    usart_port_t port;
+    uint32_t baud_rate;
+    usart_parity_t parity;
+    usart_stop_bits_t stop_bits;
+} usart_config_t;
+
+typedef struct {
+    uint32_t parity;
+    uint32_t framing;
+    uint32_t noise;
+    uint32_t overrun;
+} usart_errors_t;
+
+/* Initialization functions */
+void init_usart(usart_config_t config);
+void update_baud_rate(usart_port_t port, uint32_t baud_rate);
+
+/* Interrupt functions */
+void enable_usart_interrupts(usart_port_t port, uint32_t mask);
+void disable_usart_interrupts(usart_port_t port, uint32_t mask);
+bool usart_interrupt_enabled(usart_port_t port, uint32_t mask);
+
+/* Transmit functions */
+uint32_t read_usart_status(usart_port_t port);
+void usart_write_byte(usart_port_t port, uint8_t byte);
+void usart_write(usart_port_t port, const uint8_t *data, uint32_t length);
+void usart_flush(usart_port_t port);
+
+/* Receive functions */
+bool usart_read_byte(usart_port_t port, uint8_t *byte);
+void read_usart_errors(usart_port_t port, usart_errors_t *errors);
+void clear_usart_errors(usart_port_t port);
+
+#endif /* USART_H_ */
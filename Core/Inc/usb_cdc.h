@@ -0,0 +1,29 @@
+/*
+ * usb_cdc.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#ifndef USB_CDC_H_
+#define USB_CDC_H_
+
+#include "productDef.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Each of the two bulk IN buffers */
+#define USB_CDC_TX_BUFFER_SIZE 2048
+/* Must be a power of two */
+#define USB_CDC_RX_BUFFER_SIZE 256
+/* Longest usb_cdc_printf() line */
+#define USB_CDC_LINE_SIZE      96
+
+void init_usb_cdc(PCD_HandleTypeDef *hpcd);
+bool usb_cdc_connected(void);
+uint32_t usb_cdc_write(const void *data, uint32_t len);
+uint32_t usb_cdc_tx_free(void);
+bool usb_cdc_printf(const char *fmt, ...);
+uint32_t usb_cdc_read(void *data, uint32_t max);
+
+#endif /* USB_CDC_H_ */
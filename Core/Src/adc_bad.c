@@ -8,9 +8,12 @@
  ******************************************************************************
  */
 
-#include "dma_bad.h"
+#include "adc_bad.h"
+#include "clock_gate.h"
 #include "gpio.h"
 #include "stm_rcc.h"
+#include <assert.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /* MACRO definitions----------------------------------------------------------*/
@@ -39,88 +42,170 @@
 
 // ADC_SR_EOC
 #define ADC_EOC ((uint32_t)0b10)
+#define ADC_AWD ((uint32_t)0b1)
+#define ADC_OVR ((uint32_t)0x20)
 
 // ADC_CR1
-#define ADC_SCAN  ((uint32_t)0x100)
-#define ADC_EOCIE ((uint32_t)0x20)
+#define ADC_SCAN      ((uint32_t)0x100)
+#define ADC_EOCIE     ((uint32_t)0x20)
+#define ADC_AWDEN     ((uint32_t)0x800000)
+#define ADC_AWDSGL    ((uint32_t)0x200)
+#define ADC_AWDIE     ((uint32_t)0x40)
+#define ADC_AWDCH     ((uint32_t)0x1F)
+#define ADC_OVRIE     ((uint32_t)0x4000000)
+#define ADC_RES_SHIFT 24
 
 // ADC_CR2
-#define ADC_EOCS    ((uint32_t)0x400)
-#define ADC_CONT    ((uint32_t)0x2)
-#define ADC_DDS     ((uint32_t)0x200)
-#define ADC_DMA     ((uint32_t)0x100)
-#define ADC_SWSTART ((uint32_t)0x40000000)
-
-// conversions
-#define ADC_1_CONVERSIONS ((uint32_t)0b0000)
-#define ADC_3_CONVERSIONS (((uint32_t)0b0010) << 20)
-
-// SMPR2 Cycle
-#define ADC_SMP_5_MX ((uint32_t)0x38000)
-#define ADC_SMP_6_MX (((uint32_t)0b111) << 18)
-#define ADC_SMP_7_MX (((uint32_t)0b111) << 21)
-
-// SQR3 conversion
-#define ADC_CHANNEL_5_MORT2 ((uint32_t)0b101)
-#define ADC_CHANNEL_6_MORT2 ((uint32_t)0b110)
-#define ADC_CHANNEL_7_MORT2 ((uint32_t)0b111)
+#define ADC_EOCS             ((uint32_t)0x400)
+#define ADC_CONT             ((uint32_t)0x2)
+#define ADC_DDS              ((uint32_t)0x200)
+#define ADC_DMA              ((uint32_t)0x100)
+#define ADC_SWSTART          ((uint32_t)0x40000000)
+#define ADC_EXTEN_RISING     ((uint32_t)0x10000000)
+#define ADC_EXTSEL_TIM8_TRGO (((uint32_t)0xE) << 24)
+
+// SQR1 sequence length, stored as conversions - 1
+#define ADC_L_SHIFT 20
+
+// SMPR: 3 bits per channel, channels 10-18 in SMPR1 and 0-9 in SMPR2
+#define ADC_SMP_BITS       3
+#define ADC_SMPR2_CHANNELS 10
+
+// SQR: 5 bits per rank, ranks 1-6 in SQR3, 7-12 in SQR2 and 13-16 in SQR1
+#define ADC_SQ_BITS         5
+#define ADC_SQR_RANKS       6
+#define ADC_MAX_CHANNEL     18
+#define ADC_MAX_CONVERSIONS 16
 
 // CR2
 #define ADC_ADON ((uint32_t)0b1)
 
-uint16_t adcvalue[3];
-uint8_t adcnewvalue;
-uint8_t adcindex;
+/* Pins of the ADC3 external channels 0-15 */
+static const struct {
+    gpio_bank_t bank;
+    uint8_t pin;
+} adc3_pins[ADC_MAX_CONVERSIONS] = {
+    {bank_a, 0}, {bank_a, 1}, {bank_a, 2}, {bank_a, 3},
+    {bank_f, 6}, {bank_f, 7}, {bank_f, 8}, {bank_f, 9},
+    {bank_f, 10}, {bank_f, 3}, {bank_c, 0}, {bank_c, 1},
+    {bank_c, 2}, {bank_c, 3}, {bank_f, 4}, {bank_f, 5}};
 
 /* function
  * definitions----------------------------------------------------------*/
 
-static void initGpioF7AsAnalog(void) {
-    gpio_config_t gpio_pin = {.gpio_bank = bank_f,
-                              .pin_number = 7,
+static void initGpioAsAnalog(uint8_t channel) {
+    gpio_config_t gpio_pin = {.gpio_bank = adc3_pins[channel].bank,
+                              .pin_number = adc3_pins[channel].pin,
                               .output_type = push_pull,
                               .resistor = no_pull,
                               .mode = analog};
     init_gpio(gpio_pin);
 }
 
-void initADC3_5(void) {
-    uint32_t *reg_pointer;
-    /* Initialize adcvalues */
-    adcvalue[0] = 0;
+/**
+ * @brief Sets up ADC3 to convert the channels in order on every rising edge
+ * of TIM8 TRGO and hand each result to DMA. The timer rate is the sample
+ * rate, nothing converts until it runs.
+ */
+void initADC3(adc_resolution_t resolution, const adc_channel_t *channels,
+              uint8_t num_channels) {
+    volatile uint32_t *reg_pointer;
+    uint32_t smpr[2] = {0, 0};
+    uint32_t sqr[3] = {0, 0, 0};
+
+    assert(num_channels && num_channels <= ADC_MAX_CONVERSIONS);
+
     /* Turn on ADC3 bus clock */
-    enable_peripheral_clock(ADC3_EN);
-    // RCC_APB2PeriphClockCmd(RCC_APB2Periph_ADC3, ENABLE);
-    /* Initialize GPIO F7 as analog */
-    initGpioF7AsAnalog();
-    initDMAForADC3_1channel();
-    enableDMAForAdc3_3channels();
+    acquire_clock(ADC3_EN);
+
+    for (uint8_t rank = 0; rank < num_channels; rank++) {
+        uint8_t channel = channels[rank].channel;
+        uint32_t smp = (uint32_t)channels[rank].sample_time & 0x7;
+
+        assert(channel <= ADC_MAX_CHANNEL);
+        if (channel < ADC_MAX_CONVERSIONS) {
+            initGpioAsAnalog(channel);
+        }
+        if (channel < ADC_SMPR2_CHANNELS) {
+            smpr[1] |= smp << (channel * ADC_SMP_BITS);
+        } else {
+            smpr[0] |= smp << ((channel - ADC_SMPR2_CHANNELS) * ADC_SMP_BITS);
+        }
+        sqr[2 - rank / ADC_SQR_RANKS] |=
+            (uint32_t)channel << ((rank % ADC_SQR_RANKS) * ADC_SQ_BITS);
+    }
+    sqr[0] |= (uint32_t)(num_channels - 1) << ADC_L_SHIFT;
+
     /*Setup the clock Prescalers*/
-    reg_pointer = (uint32_t *)ADC_COMMON_CCR_REGISTER;
+    reg_pointer = (volatile uint32_t *)ADC_COMMON_CCR_REGISTER;
     *reg_pointer = ADC_PRESCALER_4;
-    /* configure ADC 12bit resolution, End of conversion interrupt Enabled,
-    SCAN Mode enable to be able to scan a group of channels */
-    reg_pointer = (uint32_t *)ADC3_CR1_REGISTER;
-    *reg_pointer = ADC_SCAN;
-    /* configure ADC External trigger disabled, right data alignment, DMA,
-    EOC is set at the end of each regular conversion, conitnuous conversion
-    enabled */
-    reg_pointer = (uint32_t *)ADC3_CR2_REGISTER;
-    *reg_pointer = ADC_EOCS + ADC_CONT + ADC_DDS + ADC_DMA;
-    /* There will be 1 channels in the sequence of conversions */
-    reg_pointer = (uint32_t *)ADC3_SQR1_REGISTER;
-    *reg_pointer = ADC_1_CONVERSIONS;
-    /* There Channels 5 to max sampling times (480 cycles) */
-    reg_pointer = (uint32_t *)ADC3_SMPR2_REGISTER;
-    *reg_pointer = ADC_SMP_5_MX;
-    /* Configure the sequence of conversion for the ADC 5,6,7 */
-    reg_pointer = (uint32_t *)ADC3_SQR3_REGISTER;
-    *reg_pointer = ADC_CHANNEL_5_MORT2;
+    /* Resolution, SCAN Mode to convert the whole group on every trigger and
+    an interrupt when DMA falls behind */
+    reg_pointer = (volatile uint32_t *)ADC3_CR1_REGISTER;
+    *reg_pointer = ((uint32_t)resolution << ADC_RES_SHIFT) | ADC_SCAN |
+                   ADC_OVRIE;
+    /* Triggered by TIM8 TRGO, right data alignment, one DMA request per
+    conversion for as long as DMA runs */
+    reg_pointer = (volatile uint32_t *)ADC3_CR2_REGISTER;
+    *reg_pointer = ADC_EXTEN_RISING + ADC_EXTSEL_TIM8_TRGO + ADC_DDS + ADC_DMA;
+    reg_pointer = (volatile uint32_t *)ADC3_SMPR1_REGISTER;
+    *reg_pointer = smpr[0];
+    reg_pointer = (volatile uint32_t *)ADC3_SMPR2_REGISTER;
+    *reg_pointer = smpr[1];
+    reg_pointer = (volatile uint32_t *)ADC3_SQR1_REGISTER;
+    *reg_pointer = sqr[0];
+    reg_pointer = (volatile uint32_t *)ADC3_SQR2_REGISTER;
+    *reg_pointer = sqr[1];
+    reg_pointer = (volatile uint32_t *)ADC3_SQR3_REGISTER;
+    *reg_pointer = sqr[2];
     /* Enable the ADC3 */
-    reg_pointer = (uint32_t *)ADC3_CR2_REGISTER;
+    reg_pointer = (volatile uint32_t *)ADC3_CR2_REGISTER;
     *reg_pointer = *reg_pointer | ADC_ADON;
 }
 
+/* The watchdog flags every conversion of the channel outside [low, high] */
+void setADC3WatchdogWindow(uint16_t low, uint16_t high) {
+    volatile uint32_t *reg_pointer;
+    reg_pointer = (volatile uint32_t *)ADC3_HTR_REGISTER;
+    *reg_pointer = high;
+    reg_pointer = (volatile uint32_t *)ADC3_LTR_REGISTER;
+    *reg_pointer = low;
+}
+
+void enableADC3Watchdog(uint8_t channel) {
+    volatile uint32_t *reg_pointer;
+    /* Guard the one channel and interrupt when it leaves the window */
+    reg_pointer = (volatile uint32_t *)ADC3_CR1_REGISTER;
+    *reg_pointer = (*reg_pointer & ~ADC_AWDCH) | ADC_AWDEN | ADC_AWDSGL |
+                   ADC_AWDIE | (channel & ADC_AWDCH);
+}
+
+bool checkADC3WatchdogFlag(void) {
+    return (*(volatile uint32_t *)ADC3_SR_REGISTER & ADC_AWD) != 0;
+}
+
+void clearADC3WatchdogFlag(void) {
+    /* The status bits are cleared by writing 0, writing 1 has no effect */
+    *(volatile uint32_t *)ADC3_SR_REGISTER = ~ADC_AWD;
+}
+
+bool checkADC3Overrun(void) {
+    return (*(volatile uint32_t *)ADC3_SR_REGISTER & ADC_OVR) != 0;
+}
+
+/**
+ * @brief After an overrun the ADC stops issuing DMA requests. Clearing OVR
+ * and toggling DMA restarts the sequence at the next trigger.
+ */
+void recoverADC3Overrun(void) {
+    volatile uint32_t *reg_pointer;
+    reg_pointer = (volatile uint32_t *)ADC3_SR_REGISTER;
+    *reg_pointer = ~ADC_OVR;
+    reg_pointer = (volatile uint32_t *)ADC3_CR2_REGISTER;
+    *reg_pointer = *reg_pointer & ~ADC_DMA;
+    *reg_pointer = *reg_pointer | ADC_DMA;
+}
+
 void startADCConversion(void) {
     uint32_t *reg_pointer_32;
     /* Clear any pending flags in the status register */
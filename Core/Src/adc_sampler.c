@@ -0,0 +1,258 @@
+/*
+ * adc_sampler.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Fixed rate sampling on ADC3. TIM8 only counts, its update event (TRGO)
+ * starts one conversion sequence, so the sample rate is exactly the timer
+ * rate instead of whatever the conversion time adds up to. DMA streams the
+ * results into a ring and interrupts every half, the filled half is handed to
+ * the block handler while the other one fills.
+ *
+ * Samples are counted per half ring, and overruns (a conversion finished
+ * before DMA took the previous one) and DMA errors are counted too; both
+ * rewind the ring so channels stay in their slots.
+ */
+
+#include "adc_sampler.h"
+#include "adc_bad.h"
+#include "core_m4.h"
+#include "dma.h"
+#include "general_timers.h"
+#include "idle.h"
+#include "productDef.h"
+#include "stdio.h"
+#include "timers.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define RING_STREAM       DMA2_STREAM0
+#define RING_CHANNEL      2
+
+#define TRIGGER_TIMER     TIMER8
+/* APB2 timers run at 168 MHz, count in us */
+#define TRIGGER_PRESCALER (168 - 1)
+#define TRIGGER_TICK_HZ   1000000UL
+#define TRIGGER_MAX_TICKS 0x10000UL
+
+/* PCLK2 84 MHz / 4 */
+#define ADC_CLOCK_HZ      21000000UL
+
+static const uint16_t sample_cycles[] = {3, 15, 28, 56, 84, 112, 144, 480};
+
+static general_timer_attr_t trigger = {.autoReload = false,
+                                       .direction = UP_COUNTER,
+                                       .masterMode = TIM_MM_UPDATE,
+                                       .prescaler = TRIGGER_PRESCALER,
+                                       .enableAfterConfig = true};
+
+static void ring_filled(dma_stream_t stream, uint32_t events);
+
+static const dma_config_t ring_dma = {
+    .channel = RING_CHANNEL,
+    .direction = DMA_PERIPH_TO_MEM,
+    .peripheral = ADC3_DR_ADDRESS,
+    .peripheral_size = DMA_SIZE_HALF_WORD,
+    .memory_size = DMA_SIZE_HALF_WORD,
+    .memory_increment = true,
+    .priority = DMA_PRIO_HIGH,
+    .circular = true,
+    .events = DMA_EVENT_HALF_TRANSFER | DMA_EVENT_TRANSFER_DONE |
+              DMA_EVENT_TRANSFER_ERROR,
+    .callback = ring_filled,
+    .irq_priority = ADC_PRIORITY};
+
+static const irq_info_t adc_irq = {INT_NUM_ADC, ADC_PRIORITY};
+
+static volatile uint16_t ring[ADC_SAMPLE_BUFFER_SIZE];
+static uint16_t ring_length = 0;
+static uint8_t num_channels = 0;
+static adc_block_handler_t on_block = NULL;
+static void (*on_watchdog)(void) = NULL;
+static volatile bool running = false;
+
+static uint32_t rate_hz = 0;
+static volatile uint32_t samples = 0;
+static volatile uint32_t overruns = 0;
+static volatile uint32_t dma_errors = 0;
+static uint32_t stats_start_ms = 0;
+
+static void rewind_ring(void) {
+    dma_start(RING_STREAM, (uint32_t)ring, 0, ring_length);
+    recoverADC3Overrun();
+}
+
+FASTCODE static void ring_filled(dma_stream_t stream, uint32_t events) {
+    ISR_PROFILE_ENTER();
+    uint16_t half = ring_length / 2;
+
+    (void)stream;
+    if (events & DMA_EVENT_TRANSFER_ERROR) {
+        /* The stream turned itself off */
+        dma_errors++;
+        rewind_ring();
+        ISR_PROFILE_EXIT(PROFILE_DMA2_STREAM0);
+        return;
+    }
+    if (events & DMA_EVENT_HALF_TRANSFER) {
+        samples += half / num_channels;
+        if (on_block) {
+            on_block(ring, half);
+        }
+    }
+    if (events & DMA_EVENT_TRANSFER_DONE) {
+        samples += half / num_channels;
+        if (on_block) {
+            on_block(ring + half, half);
+        }
+    }
+    ISR_PROFILE_EXIT(PROFILE_DMA2_STREAM0);
+}
+
+FASTCODE void ADC_IRQHandler(void) {
+    if (checkADC3Overrun()) {
+        if (running) {
+            overruns++;
+            rewind_ring();
+        } else {
+            /* The last conversion after stop_adc_sampler(), drop it */
+            recoverADC3Overrun();
+        }
+    }
+    if (checkADC3WatchdogFlag()) {
+        if (on_watchdog) {
+            on_watchdog();
+        }
+        clearADC3WatchdogFlag();
+    }
+}
+
+/**
+ * @brief Sets up ADC3 and its DMA ring. Nothing converts until
+ * start_adc_sampler() runs the trigger timer.
+ */
+void init_adc_sampler(const adc_sampler_config_t *config) {
+    uint32_t cycles = 0;
+    uint32_t ticks;
+
+    assert(config->num_channels &&
+           config->num_channels <= ADC_SAMPLE_BUFFER_SIZE / 2);
+    assert(config->rate_hz && config->rate_hz <= TRIGGER_TICK_HZ);
+
+    /* A sequence has to finish before the next trigger */
+    for (uint8_t i = 0; i < config->num_channels; i++) {
+        cycles += sample_cycles[config->channels[i].sample_time & 0x7] + 12 -
+                  2 * (uint32_t)config->resolution;
+    }
+    assert(cycles * config->rate_hz <= ADC_CLOCK_HZ);
+
+    ticks = TRIGGER_TICK_HZ / config->rate_hz;
+    assert(ticks <= TRIGGER_MAX_TICKS);
+    trigger.auto_reload_value = (uint16_t)(ticks - 1);
+    rate_hz = TRIGGER_TICK_HZ / ticks;
+
+    num_channels = config->num_channels;
+    ring_length = (ADC_SAMPLE_BUFFER_SIZE / (2 * num_channels)) * 2 *
+                  num_channels;
+    on_block = config->on_block;
+    on_watchdog = config->on_watchdog;
+
+    if (!dma_claim(RING_STREAM, "adc_sampler")) {
+        assert(false);
+    }
+    dma_configure(RING_STREAM, &ring_dma);
+    initADC3(config->resolution, config->channels, num_channels);
+
+    configure_interrupt(adc_irq);
+}
+
+/**
+ * @brief Starts the DMA ring and the trigger timer. Its prescaler assumes the
+ * final clocks, so this runs after finish_system_clock().
+ */
+void start_adc_sampler(void) {
+    assert(ring_length);
+
+    if (running) {
+        return;
+    }
+    /* TIM8 and ADC3 stop in STOP mode */
+    idle_block_stop(IDLE_BLOCK_ADC);
+    clear_adc_sampler_stats();
+    rewind_ring();
+    running = true;
+    configureGeneralTimer(TRIGGER_TIMER, trigger);
+}
+
+/**
+ * @brief Stops the trigger timer and the DMA ring and lets the part take STOP
+ * mode again. start_adc_sampler() starts over from the top of the ring.
+ */
+void stop_adc_sampler(void) {
+    if (!running) {
+        return;
+    }
+    disableTimer(TRIGGER_TIMER);
+    running = false;
+    dma_stop(RING_STREAM);
+    idle_allow_stop(IDLE_BLOCK_ADC);
+}
+
+bool adc_sampler_running(void) {
+    return running;
+}
+
+/**
+ * @brief Last complete conversion of the channel at position index of the
+ * sequence.
+ */
+uint16_t adc_sampler_latest(uint8_t index) {
+    uint16_t next = ring_length - dma_remaining(RING_STREAM);
+    uint16_t start = (uint16_t)((next / num_channels) * num_channels);
+
+    assert(index < num_channels);
+
+    start = (start ? start : ring_length) - num_channels;
+    return ring[start + index];
+}
+
+void get_adc_sampler_stats(adc_sampler_stats_t *stats) {
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    stats->rate_hz = rate_hz;
+    stats->samples = samples;
+    stats->overruns = overruns;
+    stats->dma_errors = dma_errors;
+    stats->elapsed_ms = current_ts() - stats_start_ms;
+    __set_PRIMASK(primask);
+}
+
+void print_adc_sampler_stats(void) {
+    adc_sampler_stats_t stats;
+    uint32_t measured = 0;
+
+    get_adc_sampler_stats(&stats);
+    if (stats.elapsed_ms) {
+        measured =
+            (uint32_t)((uint64_t)stats.samples * 1000 / stats.elapsed_ms);
+    }
+    printf("ADC %lu Hz%s: %lu samples in %lu ms (%lu Hz)\r\n", stats.rate_hz,
+           running ? "" : " (stopped)", stats.samples, stats.elapsed_ms,
+           measured);
+    printf("%lu overruns, %lu DMA errors\r\n", stats.overruns,
+           stats.dma_errors);
+}
+
+void clear_adc_sampler_stats(void) {
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    samples = 0;
+    overruns = 0;
+    dma_errors = 0;
+    stats_start_ms = current_ts();
+    __set_PRIMASK(primask);
+}
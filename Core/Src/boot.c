@@ -0,0 +1,118 @@
+/*
+ * boot.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#include "boot.h"
+#include "core_m4.h"
+#include "productDef.h"
+#include "stdio.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MAX_DEFERRED_TASKS 8
+#define HSI_MHZ            16
+#define NOT_RECORDED       UINT32_MAX
+#define PRINT_BOOT_LOG     true
+
+/* Must match startup_stm32f446zetx.s */
+#define STARTUP_FLAG_FAST 0x1
+#define STARTUP_FLAG_DMA  0x2
+
+static const char *const mark_names[NUM_BOOT_MARKS] = {
+    "cycle counter", "HAL",         "PLL started",     "GPIO",
+    "SYSCLK on PLL", "peripherals", "first heartbeat", "deferred done"};
+
+static uint32_t mark_us[NUM_BOOT_MARKS] = {
+    NOT_RECORDED, NOT_RECORDED, NOT_RECORDED, NOT_RECORDED,
+    NOT_RECORDED, NOT_RECORDED, NOT_RECORDED, NOT_RECORDED};
+
+/* Written by Reset_Handler before .bss is zeroed, in cycles since reset */
+NOINIT uint32_t startup_copy_cycles;
+NOINIT uint32_t startup_init_cycles;
+NOINIT uint32_t startup_init_flags;
+
+static uint32_t elapsed_us = 0;
+static uint32_t last_cycles = 0;
+static uint32_t cycles_per_us = HSI_MHZ;
+
+static boot_task_t deferred[MAX_DEFERRED_TASKS];
+static uint8_t deferred_head = 0;
+static uint8_t deferred_count = 0;
+
+/**
+ * @brief Records the time of a boot milestone. The cycle counter keeps
+ * counting across the switch from HSI to the PLL, so each interval is scaled
+ * by the clock that was running while it elapsed. Only the first call per
+ * mark is kept.
+ */
+void boot_mark(boot_mark_t mark) {
+    uint32_t now = CYCLE_COUNTER;
+
+    assert(mark < NUM_BOOT_MARKS);
+    if (mark_us[mark] != NOT_RECORDED) {
+        return;
+    }
+
+    elapsed_us += (now - last_cycles) / cycles_per_us;
+    last_cycles = now;
+    cycles_per_us = SystemCoreClock / 1000000;
+    mark_us[mark] = elapsed_us;
+}
+
+/**
+ * @brief Queues non-critical bring-up work to run from the main loop once the
+ * game is up.
+ */
+bool boot_defer(boot_task_t task) {
+    if (deferred_count >= MAX_DEFERRED_TASKS) {
+        return false;
+    }
+
+    deferred[(deferred_head + deferred_count) % MAX_DEFERRED_TASKS] = task;
+    deferred_count++;
+    return true;
+}
+
+/**
+ * @brief Runs at most one deferred task. Nothing runs until the first
+ * heartbeat has been serviced so deferred work never delays it. The boot log
+ * is printed once the queue drains.
+ */
+void boot_run_deferred(void) {
+    boot_task_t task;
+
+    if (!deferred_count || mark_us[BOOT_FIRST_HEARTBEAT] == NOT_RECORDED) {
+        return;
+    }
+
+    task = deferred[deferred_head];
+    deferred_head = (deferred_head + 1) % MAX_DEFERRED_TASKS;
+    deferred_count--;
+    task();
+
+    if (!deferred_count) {
+        boot_mark(BOOT_DEFERRED_DONE);
+#if PRINT_BOOT_LOG
+        print_boot_log();
+#endif
+    }
+}
+
+void print_boot_log(void) {
+    printf("RAM init (%s%s): copy %lu cycles, total %lu cycles\r\n",
+           (startup_init_flags & STARTUP_FLAG_FAST) ? "LDM/STM" : "legacy",
+           (startup_init_flags & STARTUP_FLAG_DMA) ? " + DMA2 zero" : "",
+           startup_copy_cycles, startup_init_cycles);
+    printf("Boot timeline (us since reset):\r\n");
+    for (uint32_t i = 0; i < NUM_BOOT_MARKS; i++) {
+        if (mark_us[i] == NOT_RECORDED) {
+            printf("  %-16s -\r\n", mark_names[i]);
+        } else {
+            printf("  %-16s %lu\r\n", mark_names[i], mark_us[i]);
+        }
+    }
+}
@@ -0,0 +1,124 @@
+/*
+ * clock_gate.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Reference counts for the peripheral clock enable bits. Every driver
+ * acquires the clocks it uses and releases them when done, and a clock is
+ * only gated once its last user lets go.
+ *
+ * An acquire turns the clock on right away (the register is read back so the
+ * peripheral can be written on the next line). A release of the last
+ * reference only queues the disable, flush_clock_releases() then applies all
+ * queued disables with one write per register. A clock that is acquired again
+ * before the flush never gets switched off at all.
+ */
+
+#include "clock_gate.h"
+#include "productDef.h"
+#include "stdio.h"
+#include "stm_rcc.h"
+#include "stm_utils.h"
+#include <assert.h>
+#include <stdint.h>
+
+#define CLOCK_REGISTERS 5
+#define CLOCK_REF_MAX   UINT8_MAX
+
+static const char *const register_names[CLOCK_REGISTERS] = {
+    "AHB1", "AHB2", "AHB3", "APB1", "APB2"};
+
+static uint8_t refs[CLOCK_REGISTERS][32];
+static uint32_t pending_off[CLOCK_REGISTERS];
+
+void acquire_clock(uint32_t reg, uint32_t mask) {
+    uint32_t primask = __get_PRIMASK();
+    uint32_t off;
+
+    assert(reg < CLOCK_REGISTERS && mask);
+
+    __disable_irq();
+    for (uint32_t bits = mask; bits; bits &= bits - 1) {
+        uint32_t bit = __builtin_ctz(bits);
+        assert(refs[reg][bit] < CLOCK_REF_MAX);
+        refs[reg][bit]++;
+    }
+    pending_off[reg] &= ~mask;
+    off = mask & ~read_peripheral_clocks(reg);
+    if (off) {
+        enable_peripheral_clock(reg, off);
+        (void)check_peripheral_clock(reg, off);
+    }
+    __set_PRIMASK(primask);
+}
+
+void release_clock(uint32_t reg, uint32_t mask) {
+    uint32_t primask = __get_PRIMASK();
+
+    assert(reg < CLOCK_REGISTERS && mask);
+
+    __disable_irq();
+    for (uint32_t bits = mask; bits; bits &= bits - 1) {
+        uint32_t bit = __builtin_ctz(bits);
+        /* More releases than acquires */
+        assert(refs[reg][bit]);
+        if (!--refs[reg][bit]) {
+            pending_off[reg] |= 1UL << bit;
+        }
+    }
+    __set_PRIMASK(primask);
+}
+
+void acquire_gpio_clock(gpio_bank_t bank) {
+    acquire_clock(GPIO_CLOCK_EN(bank));
+}
+
+void release_gpio_clock(gpio_bank_t bank) {
+    release_clock(GPIO_CLOCK_EN(bank));
+}
+
+/**
+ * @brief Returns the number of users of a single clock.
+ */
+uint32_t clock_refcount(uint32_t reg, uint32_t mask) {
+    assert(reg < CLOCK_REGISTERS && mask && !(mask & (mask - 1)));
+    return refs[reg][__builtin_ctz(mask)];
+}
+
+/**
+ * @brief Gates every clock whose last user released it. Meant for the
+ * background slot of the main loop.
+ */
+void flush_clock_releases(void) {
+    for (uint32_t reg = 0; reg < CLOCK_REGISTERS; reg++) {
+        uint32_t primask;
+
+        if (!pending_off[reg]) {
+            continue;
+        }
+        primask = __get_PRIMASK();
+        __disable_irq();
+        disable_peripheral_clock(reg, pending_off[reg]);
+        pending_off[reg] = 0;
+        __set_PRIMASK(primask);
+    }
+}
+
+void print_clock_report(void) {
+    /* A bit with 0 users was turned on outside of this module */
+    printf("Clock enables (bit:users)\r\n");
+    for (uint32_t reg = 0; reg < CLOCK_REGISTERS; reg++) {
+        uint32_t enr = read_peripheral_clocks(reg);
+
+        printf("%s: 0x%08lX", register_names[reg], enr);
+        for (uint32_t bits = enr; bits; bits &= bits - 1) {
+            uint32_t bit = __builtin_ctz(bits);
+            printf(" %lu:%u", bit, refs[reg][bit]);
+        }
+        if (pending_off[reg]) {
+            printf(" (gating 0x%08lX)", pending_off[reg]);
+        }
+        printf("\r\n");
+    }
+}
@@ -7,6 +7,7 @@
 
 #include "core_m4.h"
 #include "stm_utils.h"
+#include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -51,6 +52,20 @@
 #define SCB_BFAR          14
 #define SCB_AFSR          15
 
+#define DWT_BASE(x)       *(((uint32_t *)(CORE_BASE + 0x1000)) + x)
+#define DWT_CTRL          0
+#define DWT_CYCCNT        1
+#define CORE_DEMCR        *((uint32_t *)(CORE_BASE + SCS_OFFSET + 0xDFC))
+#define DEMCR_TRCENA      (1UL << 24)
+#define DWT_CYCCNTENA     BIT0
+
+extern const uint32_t g_pfnVectors[];
+
+__attribute__((section(".ram_vector"),
+               aligned(512))) static uint32_t ram_vectors[NUM_VECTORS];
+
+static isr_profile_t isr_profiles[NUM_ISR_PROFILES];
+
 static uint32_t generate_mask(uint32_t interrupt, uint32_t *reg) {
     uint32_t x = interrupt >> 5;
     if (x >= NUM_NORM_INT_REGS || interrupt > MAX_INT_ID) {
@@ -123,10 +138,26 @@ __attribute__((always_inline)) __STATIC_INLINE void __disable_irq(void) {
     __asm volatile("cpsid i" : : : "memory");
 }
 
+__attribute__((always_inline)) __STATIC_INLINE uint32_t __get_PRIMASK(void) {
+    uint32_t result;
+
+    __asm volatile("MRS %0, primask" : "=r"(result)::"memory");
+    return result;
+}
+
+__attribute__((always_inline)) __STATIC_INLINE void
+__set_PRIMASK(uint32_t priMask) {
+    __asm volatile("MSR primask, %0" : : "r"(priMask) : "memory");
+}
+
 __attribute__((always_inline)) __STATIC_INLINE void __DSB(void) {
     __asm volatile("dsb 0xF" ::: "memory");
 }
 
+__attribute__((always_inline)) __STATIC_INLINE void __ISB(void) {
+    __asm volatile("isb 0xF" ::: "memory");
+}
+
 __attribute__((always_inline)) __STATIC_INLINE void __NOP(void) {
     __asm volatile("nop");
 }
@@ -187,3 +218,51 @@ void reset_system(void) {
         __NOP();
     }
 }
+
+void relocate_vector_table(void) {
+    for (uint32_t i = 0; i < NUM_VECTORS; i++) {
+        ram_vectors[i] = g_pfnVectors[i];
+    }
+
+    __disable_irq();
+    SCB_BASE(SCB_VTOR) = (uint32_t)ram_vectors;
+    __DSB();
+    __ISB();
+    __enable_irq();
+}
+
+void enable_cycle_counter(void) {
+    CORE_DEMCR |= DEMCR_TRCENA;
+    DWT_BASE(DWT_CTRL) |= DWT_CYCCNTENA;
+}
+
+FASTCODE void update_isr_profile(isr_profile_id_t id, uint32_t cycles) {
+    isr_profile_t *profile = &isr_profiles[id];
+
+    profile->count++;
+    profile->total += cycles;
+    if (cycles > profile->max) {
+        profile->max = cycles;
+    }
+}
+
+void get_isr_profile(isr_profile_id_t id, isr_profile_t *profile) {
+    uint32_t primask = __get_PRIMASK();
+
+    assert(id < NUM_ISR_PROFILES);
+    __disable_irq();
+    *profile = isr_profiles[id];
+    __set_PRIMASK(primask);
+}
+
+void clear_isr_profiles(void) {
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    for (uint32_t i = 0; i < NUM_ISR_PROFILES; i++) {
+        isr_profiles[i].count = 0;
+        isr_profiles[i].total = 0;
+        isr_profiles[i].max = 0;
+    }
+    __set_PRIMASK(primask);
+}
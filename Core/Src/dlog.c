@@ -0,0 +1,106 @@
+/*
+ * dlog.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Multi producer, single consumer ring of fixed size entries. A producer
+ * claims a slot by advancing write_index with a compare and swap (LDREX/STREX
+ * on the M4), so nested ISRs never block each other. The header is stored
+ * last and the consumer only takes a slot once its header is set, so it never
+ * sees a half written entry.
+ */
+
+#include "dlog.h"
+#include "core_m4.h"
+#include "stdio.h"
+#include "timers.h"
+#include "usb_cdc.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define RING_MASK (DLOG_RING_SIZE - 1)
+
+/* Entries emitted per dlog_service() call */
+#define DLOG_BATCH 4
+
+extern const char __dlog_fmt_start[];
+
+static dlog_entry_t ring[DLOG_RING_SIZE];
+static uint32_t write_index = 0;
+static uint32_t read_index = 0;
+static uint32_t dropped = 0;
+static uint32_t reported_drops = 0;
+static bool raw_mode = false;
+
+FASTCODE void dlog_write(const char *fmt, uint32_t nargs,
+                         const uint32_t *args) {
+    uint32_t index = __atomic_load_n(&write_index, __ATOMIC_RELAXED);
+    dlog_entry_t *entry;
+
+    do {
+        if (index - read_index >= DLOG_RING_SIZE) {
+            __atomic_fetch_add(&dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&write_index, &index, index + 1,
+                                          true, __ATOMIC_RELAXED,
+                                          __ATOMIC_RELAXED));
+
+    entry = &ring[index & RING_MASK];
+    entry->timestamp = current_ts();
+    for (uint32_t i = 0; i < DLOG_MAX_ARGS; i++) {
+        entry->args[i] = args[i];
+    }
+    __atomic_store_n(&entry->header,
+                     DLOG_MAGIC | (nargs << 16) |
+                         (uint32_t)(fmt - __dlog_fmt_start),
+                     __ATOMIC_RELEASE);
+}
+
+static void emit_text(const dlog_entry_t *entry) {
+    const char *fmt = __dlog_fmt_start + (entry->header & 0xFFFF);
+
+    printf("[%lu] ", entry->timestamp);
+    printf(fmt, entry->args[0], entry->args[1], entry->args[2],
+           entry->args[3]);
+    printf("\r\n");
+}
+
+/**
+ * @brief Emits up to DLOG_BATCH entries. Meant for the lowest priority slot
+ * of the main loop.
+ */
+void dlog_service(void) {
+    for (uint32_t n = 0; n < DLOG_BATCH; n++) {
+        dlog_entry_t *entry = &ring[read_index & RING_MASK];
+
+        if (!__atomic_load_n(&entry->header, __ATOMIC_ACQUIRE)) {
+            break;
+        }
+        if (raw_mode) {
+            /* Keep the stream aligned, wait for room for a whole entry */
+            if (!usb_cdc_connected() || usb_cdc_tx_free() < sizeof(*entry)) {
+                break;
+            }
+            usb_cdc_write(entry, sizeof(*entry));
+        } else {
+            emit_text(entry);
+        }
+        entry->header = 0;
+        __atomic_store_n(&read_index, read_index + 1, __ATOMIC_RELEASE);
+    }
+
+    if (!raw_mode && dropped != reported_drops) {
+        printf("dlog: %lu entries dropped\r\n", dropped - reported_drops);
+        reported_drops = dropped;
+    }
+}
+
+void dlog_set_raw(bool raw) {
+    raw_mode = raw;
+}
+
+uint32_t dlog_dropped(void) {
+    return dropped;
+}
@@ -0,0 +1,363 @@
+/*
+ * dma.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Driver for the 16 streams of DMA1 and DMA2. A stream has to be claimed
+ * before it is configured, so two drivers can never program the same one, and
+ * the claim holds a reference on the controller clock. Every stream interrupt
+ * reads and clears its flags and passes them to the callback of the owner.
+ */
+
+#include "dma.h"
+#include "clock_gate.h"
+#include "core_m4.h"
+#include "productDef.h"
+#include "stdio.h"
+#include "stm_rcc.h"
+#include "stm_utils.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define DMA_BASE(stream)      (0x40026000UL + ((uint32_t)(stream) >> 3) * 0x400)
+#define DMA_REG(stream, n)    *(((volatile uint32_t *)DMA_BASE(stream)) + (n))
+#define DMA_NUMBER(stream)    ((uint32_t)(stream) & 0x7)
+
+/* LISR/LIFCR for streams 0-3, HISR/HIFCR for streams 4-7 */
+#define DMA_ISR(stream)       (DMA_NUMBER(stream) >> 2)
+#define DMA_IFCR(stream)      (2 + DMA_ISR(stream))
+#define DMA_SxCR(stream)      (4 + 6 * DMA_NUMBER(stream))
+#define DMA_SxNDTR(stream)    (DMA_SxCR(stream) + 1)
+#define DMA_SxPAR(stream)     (DMA_SxCR(stream) + 2)
+#define DMA_SxM0AR(stream)    (DMA_SxCR(stream) + 3)
+#define DMA_SxM1AR(stream)    (DMA_SxCR(stream) + 4)
+#define DMA_SxFCR(stream)     (DMA_SxCR(stream) + 5)
+
+// SxCR
+#define SxCR_EN               BIT0
+#define SxCR_DMEIE            BIT1
+#define SxCR_TEIE             BIT2
+#define SxCR_HTIE             BIT3
+#define SxCR_TCIE             BIT4
+#define SxCR_DIR_SHIFT        6
+#define SxCR_CIRC             BIT8
+#define SxCR_PINC             BIT9
+#define SxCR_MINC             BITA
+#define SxCR_PSIZE_SHIFT      11
+#define SxCR_MSIZE_SHIFT      13
+#define SxCR_PL_SHIFT         16
+#define SxCR_DBM              UPPER16BITS(BIT2)
+#define SxCR_CT               UPPER16BITS(BIT3)
+#define SxCR_PBURST_SHIFT     21
+#define SxCR_MBURST_SHIFT     23
+#define SxCR_CHSEL_SHIFT      25
+
+// SxFCR
+#define SxFCR_DMDIS           BIT2
+#define SxFCR_FEIE            BIT7
+
+static const uint8_t flag_shifts[4] = {0, 6, 16, 22};
+
+static const uint8_t stream_irqs[DMA_STREAMS] = {
+    INT_NUM_DMA1_STREAM0, INT_NUM_DMA1_STREAM1, INT_NUM_DMA1_STREAM2,
+    INT_NUM_DMA1_STREAM3, INT_NUM_DMA1_STREAM4, INT_NUM_DMA1_STREAM5,
+    INT_NUM_DMA1_STREAM6, INT_NUM_DMA1_STREAM7, INT_NUM_DMA2_STREAM0,
+    INT_NUM_DMA2_STREAM1, INT_NUM_DMA2_STREAM2, INT_NUM_DMA2_STREAM3,
+    INT_NUM_DMA2_STREAM4, INT_NUM_DMA2_STREAM5, INT_NUM_DMA2_STREAM6,
+    INT_NUM_DMA2_STREAM7};
+
+static const char *owners[DMA_STREAMS];
+static dma_callback_t callbacks[DMA_STREAMS];
+static uint8_t irq_priorities[DMA_STREAMS];
+
+static irq_info_t stream_irq(dma_stream_t stream) {
+    irq_info_t irq = {stream_irqs[stream], irq_priorities[stream]};
+    return irq;
+}
+
+static void acquire_controller(dma_stream_t stream) {
+    if (stream < DMA2_STREAM0) {
+        acquire_clock(DMA1_EN);
+    } else {
+        acquire_clock(DMA2_EN);
+    }
+}
+
+static void release_controller(dma_stream_t stream) {
+    if (stream < DMA2_STREAM0) {
+        release_clock(DMA1_EN);
+    } else {
+        release_clock(DMA2_EN);
+    }
+}
+
+/**
+ * @brief Takes a stream for a driver. Returns false if someone else has it.
+ */
+bool dma_claim(dma_stream_t stream, const char *owner) {
+    uint32_t primask = __get_PRIMASK();
+    bool claimed = false;
+
+    assert(stream < DMA_STREAMS && owner);
+
+    __disable_irq();
+    if (!owners[stream]) {
+        owners[stream] = owner;
+        claimed = true;
+    }
+    __set_PRIMASK(primask);
+
+    if (claimed) {
+        acquire_controller(stream);
+        dma_stop(stream);
+    }
+    return claimed;
+}
+
+void dma_release(dma_stream_t stream) {
+    assert(stream < DMA_STREAMS && owners[stream]);
+
+    dma_stop(stream);
+    if (callbacks[stream]) {
+        disable_irq(stream_irq(stream));
+        callbacks[stream] = NULL;
+    }
+    owners[stream] = NULL;
+    release_controller(stream);
+}
+
+/**
+ * @brief Programs everything but the addresses and the count. The stream is
+ * stopped first, registers only take writes while it is off.
+ */
+void dma_configure(dma_stream_t stream, const dma_config_t *config) {
+    uint32_t cr, fcr;
+
+    assert(stream < DMA_STREAMS && owners[stream]);
+    assert(config->channel < 8);
+    /* Only DMA2 can read memory on both ports */
+    assert(config->direction != DMA_MEM_TO_MEM || stream >= DMA2_STREAM0);
+    assert(config->direction != DMA_MEM_TO_MEM ||
+           (!config->circular && !config->double_buffer));
+    assert(config->fifo || (config->peripheral_burst == DMA_BURST_SINGLE &&
+                            config->memory_burst == DMA_BURST_SINGLE));
+
+    dma_stop(stream);
+
+    cr = ((uint32_t)config->channel << SxCR_CHSEL_SHIFT) |
+         ((uint32_t)config->memory_burst << SxCR_MBURST_SHIFT) |
+         ((uint32_t)config->peripheral_burst << SxCR_PBURST_SHIFT) |
+         ((uint32_t)config->priority << SxCR_PL_SHIFT) |
+         ((uint32_t)config->memory_size << SxCR_MSIZE_SHIFT) |
+         ((uint32_t)config->peripheral_size << SxCR_PSIZE_SHIFT) |
+         ((uint32_t)config->direction << SxCR_DIR_SHIFT);
+    if (config->memory_increment) {
+        cr |= SxCR_MINC;
+    }
+    if (config->peripheral_increment) {
+        cr |= SxCR_PINC;
+    }
+    /* Double buffering is circular by definition */
+    if (config->circular || config->double_buffer) {
+        cr |= SxCR_CIRC;
+    }
+    if (config->double_buffer) {
+        cr |= SxCR_DBM;
+    }
+    if (config->events & DMA_EVENT_DIRECT_ERROR) {
+        cr |= SxCR_DMEIE;
+    }
+    if (config->events & DMA_EVENT_TRANSFER_ERROR) {
+        cr |= SxCR_TEIE;
+    }
+    if (config->events & DMA_EVENT_HALF_TRANSFER) {
+        cr |= SxCR_HTIE;
+    }
+    if (config->events & DMA_EVENT_TRANSFER_DONE) {
+        cr |= SxCR_TCIE;
+    }
+
+    fcr = config->fifo ? (SxFCR_DMDIS | (uint32_t)config->fifo_threshold) : 0;
+    if (config->events & DMA_EVENT_FIFO_ERROR) {
+        fcr |= SxFCR_FEIE;
+    }
+
+    DMA_REG(stream, DMA_SxCR(stream)) = cr;
+    DMA_REG(stream, DMA_SxFCR(stream)) = fcr;
+    DMA_REG(stream, DMA_SxPAR(stream)) = config->peripheral;
+
+    callbacks[stream] = config->callback;
+    irq_priorities[stream] = config->irq_priority;
+    if (config->callback && config->events) {
+        configure_interrupt(stream_irq(stream));
+    } else {
+        disable_irq(stream_irq(stream));
+    }
+}
+
+/**
+ * @brief Changes the peripheral (or mem-to-mem source) address while the
+ * stream is stopped.
+ */
+void dma_set_peripheral(dma_stream_t stream, uint32_t address) {
+    assert(!dma_busy(stream));
+    DMA_REG(stream, DMA_SxPAR(stream)) = address;
+}
+
+/**
+ * @brief Starts count transfers into/out of memory0. memory1 is only used in
+ * double buffer mode and ignored otherwise.
+ */
+void dma_start(dma_stream_t stream, uint32_t memory0, uint32_t memory1,
+               uint16_t count) {
+    assert(stream < DMA_STREAMS && owners[stream] && count);
+
+    dma_stop(stream);
+    DMA_REG(stream, DMA_SxM0AR(stream)) = memory0;
+    DMA_REG(stream, DMA_SxM1AR(stream)) = memory1;
+    DMA_REG(stream, DMA_SxNDTR(stream)) = count;
+    DMA_REG(stream, DMA_SxCR(stream)) =
+        (DMA_REG(stream, DMA_SxCR(stream)) & ~SxCR_CT) | SxCR_EN;
+}
+
+/**
+ * @brief Stops the stream, waiting for the current transfer to finish, and
+ * drops its pending events.
+ */
+void dma_stop(dma_stream_t stream) {
+    DMA_REG(stream, DMA_SxCR(stream)) &= ~SxCR_EN;
+    while (DMA_REG(stream, DMA_SxCR(stream)) & SxCR_EN) {
+    }
+    dma_clear_events(stream, DMA_EVENT_ALL);
+}
+
+bool dma_busy(dma_stream_t stream) {
+    return (DMA_REG(stream, DMA_SxCR(stream)) & SxCR_EN) != 0;
+}
+
+/**
+ * @brief Transfers left, in peripheral sized items.
+ */
+uint16_t dma_remaining(dma_stream_t stream) {
+    return (uint16_t)DMA_REG(stream, DMA_SxNDTR(stream));
+}
+
+/**
+ * @brief Buffer (0 or 1) the hardware is using in double buffer mode.
+ */
+uint8_t dma_current_target(dma_stream_t stream) {
+    return (DMA_REG(stream, DMA_SxCR(stream)) & SxCR_CT) ? 1 : 0;
+}
+
+/**
+ * @brief Points a double buffer target at a new buffer. Only the target the
+ * hardware is not using may be changed while the stream runs.
+ */
+void dma_set_memory(dma_stream_t stream, uint8_t target, uint32_t address) {
+    assert(target < 2);
+    assert(!dma_busy(stream) || target != dma_current_target(stream));
+
+    if (target) {
+        DMA_REG(stream, DMA_SxM1AR(stream)) = address;
+    } else {
+        DMA_REG(stream, DMA_SxM0AR(stream)) = address;
+    }
+}
+
+uint32_t dma_read_events(dma_stream_t stream) {
+    return (DMA_REG(stream, DMA_ISR(stream)) >>
+            flag_shifts[DMA_NUMBER(stream) & 0x3]) &
+           DMA_EVENT_ALL;
+}
+
+void dma_clear_events(dma_stream_t stream, uint32_t events) {
+    DMA_REG(stream, DMA_IFCR(stream)) =
+        (events & DMA_EVENT_ALL) << flag_shifts[DMA_NUMBER(stream) & 0x3];
+}
+
+void print_dma_streams(void) {
+    for (uint32_t i = 0; i < DMA_STREAMS; i++) {
+        if (!owners[i]) {
+            continue;
+        }
+        printf("DMA%lu stream %lu: %s%s, %u left\r\n",
+               i / DMA_STREAMS_PER_CONTROLLER + 1, DMA_NUMBER(i), owners[i],
+               dma_busy((dma_stream_t)i) ? " (running)" : "",
+               dma_remaining((dma_stream_t)i));
+    }
+}
+
+FASTCODE static void dispatch(dma_stream_t stream) {
+    uint32_t events = dma_read_events(stream);
+
+    dma_clear_events(stream, events);
+    if (callbacks[stream]) {
+        callbacks[stream](stream, events);
+    }
+}
+
+FASTCODE void DMA1_Stream0_IRQHandler(void) {
+    dispatch(DMA1_STREAM0);
+}
+
+FASTCODE void DMA1_Stream1_IRQHandler(void) {
+    dispatch(DMA1_STREAM1);
+}
+
+FASTCODE void DMA1_Stream2_IRQHandler(void) {
+    dispatch(DMA1_STREAM2);
+}
+
+FASTCODE void DMA1_Stream3_IRQHandler(void) {
+    dispatch(DMA1_STREAM3);
+}
+
+FASTCODE void DMA1_Stream4_IRQHandler(void) {
+    dispatch(DMA1_STREAM4);
+}
+
+FASTCODE void DMA1_Stream5_IRQHandler(void) {
+    dispatch(DMA1_STREAM5);
+}
+
+FASTCODE void DMA1_Stream6_IRQHandler(void) {
+    dispatch(DMA1_STREAM6);
+}
+
+FASTCODE void DMA1_Stream7_IRQHandler(void) {
+    dispatch(DMA1_STREAM7);
+}
+
+FASTCODE void DMA2_Stream0_IRQHandler(void) {
+    dispatch(DMA2_STREAM0);
+}
+
+FASTCODE void DMA2_Stream1_IRQHandler(void) {
+    dispatch(DMA2_STREAM1);
+}
+
+FASTCODE void DMA2_Stream2_IRQHandler(void) {
+    dispatch(DMA2_STREAM2);
+}
+
+FASTCODE void DMA2_Stream3_IRQHandler(void) {
+    dispatch(DMA2_STREAM3);
+}
+
+FASTCODE void DMA2_Stream4_IRQHandler(void) {
+    dispatch(DMA2_STREAM4);
+}
+
+FASTCODE void DMA2_Stream5_IRQHandler(void) {
+    dispatch(DMA2_STREAM5);
+}
+
+FASTCODE void DMA2_Stream6_IRQHandler(void) {
+    dispatch(DMA2_STREAM6);
+}
+
+FASTCODE void DMA2_Stream7_IRQHandler(void) {
+    dispatch(DMA2_STREAM7);
+}
@@ -0,0 +1,253 @@
+/*
+ * dma_copy.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * memcpy and memset on DMA2 stream 1, the only controller that can do memory
+ * to memory. Requests are queued and run back to back from the transfer
+ * complete interrupt, so the CPU only sets up each one. Small requests, and
+ * requests that find the queue full, are done by the CPU right away with the
+ * library routines.
+ *
+ * Word transfers are used when the addresses and the length allow it, bytes
+ * otherwise. A fill reads the same source word over and over (no source
+ * increment). Requests longer than one NDTR load are split in chunks.
+ */
+
+#include "dma_copy.h"
+#include "core_m4.h"
+#include "dma.h"
+#include "productDef.h"
+#include "stdio.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define COPY_STREAM      DMA2_STREAM1
+#define COPY_MAX_ITEMS   0xFFFFUL
+
+#define BENCH_BUFFER     1024
+#define BENCH_MIN        16
+
+typedef struct {
+    uint8_t *dst;
+    /* NULL for a fill */
+    const uint8_t *src;
+    uint32_t length;
+    uint8_t value;
+    dma_copy_callback_t callback;
+    void *context;
+} copy_request_t;
+
+static void chunk_done(dma_stream_t stream, uint32_t events);
+
+static dma_config_t copy_dma = {.channel = 0,
+                                .direction = DMA_MEM_TO_MEM,
+                                .memory_increment = true,
+                                .priority = DMA_PRIO_LOW,
+                                .fifo = true,
+                                .fifo_threshold = DMA_FIFO_HALF,
+                                .events = DMA_EVENT_TRANSFER_DONE |
+                                          DMA_EVENT_TRANSFER_ERROR,
+                                .callback = chunk_done,
+                                .irq_priority = DMA_COPY_PRIORITY};
+
+/* The running request is queue[head] */
+static copy_request_t queue[DMA_COPY_QUEUE + 1];
+static uint32_t head = 0;
+static volatile uint32_t pending = 0;
+static uint32_t chunk_bytes = 0;
+static uint32_t fill_word = 0;
+static bool ready = false;
+
+static uint32_t dma_copies = 0;
+static uint32_t cpu_copies = 0;
+static uint32_t dma_errors = 0;
+
+static void cpu_finish(const copy_request_t *request) {
+    if (request->src) {
+        memcpy(request->dst, request->src, request->length);
+    } else {
+        memset(request->dst, request->value, request->length);
+    }
+}
+
+/**
+ * @brief Starts the next chunk of queue[head]. Called with interrupts masked
+ * or from the stream interrupt.
+ */
+static void start_chunk(void) {
+    const copy_request_t *request = &queue[head];
+    uint32_t src = request->src ? (uint32_t)request->src : (uint32_t)&fill_word;
+    dma_size_t size = DMA_SIZE_BYTE;
+    uint32_t items;
+
+    if (!(((uint32_t)request->dst | src | request->length) & 0x3)) {
+        size = DMA_SIZE_WORD;
+    }
+    items = request->length >> size;
+    if (items > COPY_MAX_ITEMS) {
+        items = COPY_MAX_ITEMS;
+    }
+    chunk_bytes = items << size;
+
+    fill_word = request->value * 0x01010101UL;
+    copy_dma.peripheral = src;
+    copy_dma.peripheral_increment = request->src != NULL;
+    copy_dma.peripheral_size = size;
+    copy_dma.memory_size = size;
+    dma_configure(COPY_STREAM, &copy_dma);
+    dma_start(COPY_STREAM, (uint32_t)request->dst, 0, (uint16_t)items);
+}
+
+FASTCODE static void chunk_done(dma_stream_t stream, uint32_t events) {
+    copy_request_t *request = &queue[head];
+    copy_request_t done;
+
+    (void)stream;
+    if (events & DMA_EVENT_TRANSFER_ERROR) {
+        dma_errors++;
+        cpu_finish(request);
+        request->length = 0;
+    } else if (events & DMA_EVENT_TRANSFER_DONE) {
+        request->dst += chunk_bytes;
+        if (request->src) {
+            request->src += chunk_bytes;
+        }
+        request->length -= chunk_bytes;
+    } else {
+        return;
+    }
+
+    if (request->length) {
+        start_chunk();
+        return;
+    }
+
+    /* Dequeue first, the callback may queue the next request */
+    done = *request;
+    head = (head + 1) % (DMA_COPY_QUEUE + 1);
+    pending--;
+    if (pending) {
+        start_chunk();
+    }
+    if (done.callback) {
+        done.callback(done.context);
+    }
+}
+
+/**
+ * @brief Queues a request for the DMA. Returns false if the queue is full.
+ */
+static bool submit(const copy_request_t *request) {
+    uint32_t primask = __get_PRIMASK();
+    bool queued = false;
+
+    __disable_irq();
+    if (pending <= DMA_COPY_QUEUE) {
+        queue[(head + pending) % (DMA_COPY_QUEUE + 1)] = *request;
+        queued = true;
+        if (!pending++) {
+            start_chunk();
+        }
+        dma_copies++;
+    }
+    __set_PRIMASK(primask);
+    return queued;
+}
+
+static void run(const copy_request_t *request) {
+    if (request->length >= DMA_COPY_THRESHOLD && ready && submit(request)) {
+        return;
+    }
+    cpu_copies++;
+    cpu_finish(request);
+    if (request->callback) {
+        request->callback(request->context);
+    }
+}
+
+void init_dma_copy(void) {
+    if (!dma_claim(COPY_STREAM, "dma_copy")) {
+        assert(false);
+    }
+    head = 0;
+    pending = 0;
+    ready = true;
+}
+
+/**
+ * @brief Copies length bytes. The buffers must stay valid and untouched until
+ * the callback runs.
+ */
+void dma_memcpy(void *dst, const void *src, uint32_t length,
+                dma_copy_callback_t callback, void *context) {
+    copy_request_t request = {dst, src, length, 0, callback, context};
+
+    assert(dst && src);
+    run(&request);
+}
+
+void dma_memset(void *dst, uint8_t value, uint32_t length,
+                dma_copy_callback_t callback, void *context) {
+    copy_request_t request = {dst, NULL, length, value, callback, context};
+
+    assert(dst);
+    run(&request);
+}
+
+bool dma_copy_busy(void) {
+    return pending != 0;
+}
+
+/**
+ * @brief Waits for every queued request. Needs the stream interrupt, so not
+ * from code that runs with interrupts masked or above DMA_COPY_PRIORITY.
+ */
+void dma_copy_wait(void) {
+    while (pending) {
+    }
+}
+
+static uint32_t time_dma(uint8_t *dst, const uint8_t *src, uint32_t length) {
+    copy_request_t request = {dst, src, length, 0, NULL, NULL};
+    uint32_t start = CYCLE_COUNTER;
+
+    if (!submit(&request)) {
+        return 0;
+    }
+    dma_copy_wait();
+    return CYCLE_COUNTER - start;
+}
+
+/**
+ * @brief Times word aligned copies on both engines and prints the size where
+ * the DMA starts to win, to check the estimate in DMA_COPY_THRESHOLD.
+ */
+void print_dma_copy_benchmark(void) {
+    static uint32_t src[BENCH_BUFFER / 4], dst[BENCH_BUFFER / 4];
+    uint32_t crossover = 0;
+
+    if (!ready) {
+        return;
+    }
+    dma_copy_wait();
+    printf("bytes cpu dma (cycles)\r\n");
+    for (uint32_t n = BENCH_MIN; n <= BENCH_BUFFER; n <<= 1) {
+        uint32_t start = CYCLE_COUNTER;
+        uint32_t cpu, dma;
+
+        memcpy(dst, src, n);
+        cpu = CYCLE_COUNTER - start;
+        dma = time_dma((uint8_t *)dst, (const uint8_t *)src, n);
+        printf("%lu %lu %lu\r\n", n, cpu, dma);
+        if (!crossover && dma && dma < cpu) {
+            crossover = n;
+        }
+    }
+    printf("Crossover %lu bytes (threshold %u), %lu DMA, %lu CPU, "
+           "%lu errors\r\n",
+           crossover, DMA_COPY_THRESHOLD, dma_copies, cpu_copies, dma_errors);
+}
@@ -0,0 +1,116 @@
+/*
+ * encoder.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Quadrature encoder on TIM5 (CH1 PA0, CH2 PA1) in encoder mode 3. The
+ * hardware counter is free running over the full 32 bits; positions are
+ * built from signed differences between snapshots, so a wrap of the counter
+ * is harmless. Velocity is the change over the last ENCODER_VELOCITY_SPAN
+ * snapshots.
+ */
+
+#include "encoder.h"
+#include "core_m4.h"
+#include "general_timers.h"
+#include "gpio.h"
+#include "productDef.h"
+#include <stdint.h>
+
+#define ENCODER_TIMER  TIMER5
+#define ENCODER_FILTER 0x3 // 8 samples at fCK_INT / 1
+
+static const gpio_config_t encoder_a = {.gpio_bank = bank_a,
+                                        .pin_number = 0,
+                                        .mode = alternate_function,
+                                        .alternate_function = 2,
+                                        .resistor = pull_up,
+                                        .output_type = push_pull,
+                                        .speed = high_speed};
+
+static const gpio_config_t encoder_b = {.gpio_bank = bank_a,
+                                        .pin_number = 1,
+                                        .mode = alternate_function,
+                                        .alternate_function = 2,
+                                        .resistor = pull_up,
+                                        .output_type = push_pull,
+                                        .speed = high_speed};
+
+static const inputCaptureMode_t encoder_input = {
+    .inputCaptureFilter = ENCODER_FILTER, .captureCompareSelection = 1};
+
+/* No ARR preload, so the 32-bit reload written after this applies at once */
+static const general_timer_attr_t tim5 = {
+    .autoReload = false,
+    .direction = UP_COUNTER,
+    .slaveAttr = {.SMS = SMS_ENCODER_MODE_3},
+    .capture1 = encoder_input,
+    .capture2 = encoder_input,
+    .ccMode1 = CAPTURE_MODE,
+    .ccMode2 = CAPTURE_MODE,
+    .captureCompareOutputPolarity1 = CAPTURE_NONINVERTING_RISING,
+    .captureCompareOutputPolarity2 = CAPTURE_NONINVERTING_RISING,
+    .enableAfterConfig = false};
+
+static uint32_t last_count = 0;
+static volatile int32_t position = 0;
+static volatile int32_t velocity = 0;
+static int32_t history[ENCODER_VELOCITY_SPAN];
+static uint32_t history_index = 0;
+
+void init_encoder(void) {
+    init_gpio(encoder_a);
+    init_gpio(encoder_b);
+
+    configureGeneralTimer(ENCODER_TIMER, tim5);
+    setAutoReload32(ENCODER_TIMER, UINT32_MAX);
+    setCounterValue32(ENCODER_TIMER, 0);
+    enableTimer(ENCODER_TIMER);
+
+    last_count = 0;
+    encoder_set_position(0);
+}
+
+/**
+ * @brief Takes a snapshot of the counter. Must run at ENCODER_SAMPLE_HZ.
+ */
+FASTCODE void encoder_sample(void) {
+    uint32_t count = getCounterValue32(ENCODER_TIMER);
+    int32_t oldest;
+
+    position += (int32_t)(count - last_count);
+    last_count = count;
+
+    oldest = history[history_index];
+    history[history_index] = position;
+    history_index = (history_index + 1) % ENCODER_VELOCITY_SPAN;
+    velocity =
+        (position - oldest) * (ENCODER_SAMPLE_HZ / ENCODER_VELOCITY_SPAN);
+}
+
+int32_t encoder_position(void) {
+    return position;
+}
+
+/**
+ * @brief Counts per second.
+ */
+int32_t encoder_velocity(void) {
+    return velocity;
+}
+
+/**
+ * @brief Re-references the position, e.g. at an end stop.
+ */
+void encoder_set_position(int32_t counts) {
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    position = counts;
+    velocity = 0;
+    for (uint32_t i = 0; i < ENCODER_VELOCITY_SPAN; i++) {
+        history[i] = counts;
+    }
+    __set_PRIMASK(primask);
+}
@@ -0,0 +1,151 @@
+/*
+ * entropy.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * The F446 has no RNG, so randomness is collected from what the board already
+ * does: the LSBs of the FSR conversions (ADC3 sampler), the cycle counter at
+ * every heartbeat (interrupt and dispatch jitter) and the cycle counter at
+ * human events like button presses and reactions. Samples are folded into a 128
+ * bit pool and credited with a conservative number of bits.
+ *
+ * Numbers come from xoshiro128++ (Blackman and Vigna), which is seeded from
+ * the pool at boot and has the pool folded into its state every time
+ * ENTROPY_RESEED_BITS have been collected. A word of output is kept in flash
+ * so the next boot does not start from the same state.
+ */
+
+#include "entropy.h"
+#include "adc_sampler.h"
+#include "core_m4.h"
+#include "productDef.h"
+#include "storage.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define POOL_WORDS   4
+#define MIX_MULTIPLY 0x9E3779B9UL
+
+static uint32_t pool[POOL_WORDS];
+static uint32_t pool_index = 0;
+static volatile uint32_t pool_bits = 0;
+
+static uint32_t state[4];
+static bool seed_saved = false;
+
+static inline uint32_t rotl(uint32_t x, uint32_t k) {
+    return (x << k) | (x >> (32 - k));
+}
+
+/**
+ * @brief Folds a sample into the pool. Safe to call from interrupts.
+ */
+FASTCODE void entropy_add(uint32_t sample, uint32_t bits) {
+    uint32_t primask = __get_PRIMASK();
+    uint32_t i;
+
+    __disable_irq();
+    i = pool_index++ & (POOL_WORDS - 1);
+    pool[i] = rotl(pool[i] ^ sample, 13) * MIX_MULTIPLY +
+              pool[(i + POOL_WORDS - 1) & (POOL_WORDS - 1)];
+    pool_bits += bits;
+    __set_PRIMASK(primask);
+}
+
+/**
+ * @brief Per heartbeat sample of the cycle counter and the FSR conversion.
+ */
+FASTCODE void harvest_entropy(void) {
+    uint32_t adc = adc_sampler_latest(0);
+
+    entropy_add(CYCLE_COUNTER ^ (adc << 16), ENTROPY_HEARTBEAT_BITS);
+}
+
+static void reseed(void) {
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    for (uint32_t i = 0; i < POOL_WORDS; i++) {
+        state[i] ^= pool[i];
+    }
+    pool_bits = 0;
+    __set_PRIMASK(primask);
+
+    /* xoshiro must never be all zero */
+    if (!(state[0] | state[1] | state[2] | state[3])) {
+        state[0] = MIX_MULTIPLY;
+    }
+}
+
+void init_entropy(void) {
+    const uint32_t *uid = (const uint32_t *)UID_BASE;
+
+    /* Not much to go on this early, but no two boards or boots match */
+    for (uint32_t i = 0; i < 3; i++) {
+        entropy_add(uid[i], 0);
+    }
+    entropy_add(storage_get_or(KEY_RANDOM_SEED, 0), 0);
+    entropy_add(CYCLE_COUNTER, 0);
+    reseed();
+}
+
+/**
+ * @brief Reseeds once enough entropy was collected. Meant for the background
+ * slot of the main loop.
+ */
+void entropy_service(void) {
+    if (pool_bits < ENTROPY_RESEED_BITS) {
+        return;
+    }
+    reseed();
+    if (!seed_saved) {
+        storage_set(KEY_RANDOM_SEED, random_u32());
+        seed_saved = true;
+    }
+}
+
+uint32_t random_u32(void) {
+    uint32_t result = rotl(state[0] + state[3], 7) + state[0];
+    uint32_t t = state[1] << 9;
+
+    state[2] ^= state[0];
+    state[3] ^= state[1];
+    state[1] ^= state[2];
+    state[0] ^= state[3];
+    state[2] ^= t;
+    state[3] = rotl(state[3], 11);
+    return result;
+}
+
+/**
+ * @brief Uniform in [0, bound) without modulo bias (Lemire). The division
+ * only runs for the rare draws that land in the biased zone.
+ */
+uint32_t random_below(uint32_t bound) {
+    uint64_t m;
+
+    assert(bound);
+
+    m = (uint64_t)random_u32() * bound;
+    if ((uint32_t)m < bound) {
+        uint32_t threshold = -bound % bound;
+
+        while ((uint32_t)m < threshold) {
+            m = (uint64_t)random_u32() * bound;
+        }
+    }
+    return (uint32_t)(m >> 32);
+}
+
+/**
+ * @brief Uniform in [min, max], both included.
+ */
+uint32_t random_range(uint32_t min, uint32_t max) {
+    uint32_t span = max - min + 1;
+
+    assert(min <= max);
+
+    return span ? min + random_below(span) : random_u32();
+}
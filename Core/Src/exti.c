@@ -6,6 +6,7 @@
  */
 
 #include "exti.h"
+#include "core_m4.h"
 #include "sysconfig.h"
 #include <assert.h>
 #include <stdint.h>
@@ -88,11 +89,11 @@ static uint32_t read_exti_software_int_event(void) {
     return EXTI_BASE(EXTI_SWIER);
 }
 
-static uint32_t read_exti_pending(void) {
+FASTCODE static uint32_t read_exti_pending(void) {
     return EXTI_BASE(EXTI_PR);
 }
 
-static void clear_exti_pending(uint32_t mask) {
+FASTCODE static void clear_exti_pending(uint32_t mask) {
     mask &= EXTI_VALID_MASK;
     EXTI_BASE(EXTI_PR) = mask;
 }
@@ -112,6 +113,7 @@ static void config_gpio_exti(exti_config_t config) {
     uint32_t mask = 0;
     start_sysconfig();
     configure_exti_line(config.exti_gpio);
+    stop_sysconfig();
     SET_BIT(mask, config.exti_gpio.pin);
 
     configure_exti_channel(config.unmask_int, set_exti_int_mask,
@@ -153,7 +155,9 @@ void get_exti_configs(uint8_t channel, exti_config_t *config) {
     assert(channel < EXTI_CHANNELS);
 
     if (channel < PINS_PER_BANK) {
+        start_sysconfig();
         get_exti_line_config(channel, &(config->exti_gpio));
+        stop_sysconfig();
     } else {
         config->exti_line = channel;
     }
@@ -180,13 +184,17 @@ bool exti_software_event_generated(uint8_t channel) {
     return (read_exti_software_int_event() & mask) != 0;
 }
 
-bool check_exti_channel_pending(uint8_t channel) {
+FASTCODE bool check_exti_channel_pending(uint8_t channel) {
     uint32_t mask = 0;
     assert(channel < EXTI_CHANNELS);
     SET_BIT(mask, channel);
     return (read_exti_pending() & mask) != 0;
 }
 
+FASTCODE uint32_t read_pending_exti_events(uint32_t mask) {
+    return read_exti_pending() & mask;
+}
+
 void acknowledge_exti_event(uint8_t channel) {
     uint32_t mask = 0;
     assert(channel < EXTI_CHANNELS);
@@ -194,7 +202,7 @@ void acknowledge_exti_event(uint8_t channel) {
     clear_exti_pending(mask);
 }
 
-static uint32_t generate_channel_mask(uint8_t channel) {
+FASTCODE static uint32_t generate_channel_mask(uint8_t channel) {
     uint32_t mask = 0;
     if (channel < EXTI_CHANNELS) {
         SET_BIT(mask, channel);
@@ -202,9 +210,12 @@ static uint32_t generate_channel_mask(uint8_t channel) {
     return mask;
 }
 
-void acknowledge_multiple_exti_events(uint8_t channel0, uint8_t channel1,
-                                      uint8_t channel2, uint8_t channel3,
-                                      uint8_t channel4, uint8_t channel5) {
+FASTCODE void acknowledge_multiple_exti_events(uint8_t channel0,
+                                               uint8_t channel1,
+                                               uint8_t channel2,
+                                               uint8_t channel3,
+                                               uint8_t channel4,
+                                               uint8_t channel5) {
     uint32_t mask = 0;
 
     mask |= generate_channel_mask(channel0);
@@ -217,6 +228,10 @@ void acknowledge_multiple_exti_events(uint8_t channel0, uint8_t channel1,
     clear_exti_pending(mask);
 }
 
+FASTCODE void acknowledge_exti_events(uint32_t mask) {
+    clear_exti_pending(mask);
+}
+
 void clear_pending_exti_events(void) {
     clear_exti_pending(EXTI_VALID_MASK);
 }
@@ -6,6 +6,8 @@
  */
 
 #include "general_timers.h"
+#include "clock_gate.h"
+#include "core_m4.h"
 #include "stm_rcc.h"
 #include "stm_utils.h"
 #include <assert.h>
@@ -140,7 +142,7 @@ static void enableTimerInterrupts(general_timers_32bit_t timer, uint16_t mask) {
 }
 
 // Interrupt status register
-bool checkTimerStatus(general_timers_32bit_t timer, uint16_t mask) {
+FASTCODE bool checkTimerStatus(general_timers_32bit_t timer, uint16_t mask) {
     uint16_t status;
     mask &= ~GEN_TIMER_SR_RESERVED;
     status = TIMER_BASE_32BIT((uint32_t)timer, TIMER32BIT_SR) & mask;
@@ -252,6 +254,21 @@ uint16_t getCounterValue(general_timers_32bit_t timer) {
     return (uint16_t)TIMER_BASE_32BIT((uint32_t)timer, TIMER32BIT_CNT);
 }
 
+FASTCODE uint32_t getCounterValue32(general_timers_32bit_t timer) {
+    assert(timer == TIMER2 || timer == TIMER5);
+    return TIMER_BASE_32BIT((uint32_t)timer, TIMER32BIT_CNT);
+}
+
+void setCounterValue32(general_timers_32bit_t timer, uint32_t value) {
+    assert(timer == TIMER2 || timer == TIMER5);
+    TIMER_BASE_32BIT((uint32_t)timer, TIMER32BIT_CNT) = value;
+}
+
+void setAutoReload32(general_timers_32bit_t timer, uint32_t value) {
+    assert(timer == TIMER2 || timer == TIMER5);
+    TIMER_BASE_32BIT((uint32_t)timer, TIMER32BIT_ARR) = value;
+}
+
 static void setPrescalar(general_timers_32bit_t timer, uint16_t value) {
     TIMER_BASE_32BIT((uint32_t)timer, TIMER32BIT_PSC) = (uint32_t)value;
 }
@@ -367,18 +384,30 @@ static void configureCaptureCompare(general_timers_32bit_t timer,
 }
 
 static void enableClock(general_timers_32bit_t timer) {
+    static uint32_t clocked = 0;
+    uint32_t held = 1UL << ((timer == TIMER8) ? 4 : (uint32_t)timer >> 8);
+
+    /* One reference per timer, however often it is reconfigured */
+    if (clocked & held) {
+        return;
+    }
+    clocked |= held;
+
     switch (timer) {
     case TIMER2:
-        enable_peripheral_clock(TIM2_EN);
+        acquire_clock(TIM2_EN);
         break;
     case TIMER3:
-        enable_peripheral_clock(TIM3_EN);
+        acquire_clock(TIM3_EN);
         break;
     case TIMER4:
-        enable_peripheral_clock(TIM4_EN);
+        acquire_clock(TIM4_EN);
         break;
     case TIMER5:
-        enable_peripheral_clock(TIM5_EN);
+        acquire_clock(TIM5_EN);
+        break;
+    case TIMER8:
+        acquire_clock(TIM8_EN);
         break;
     default:
         assert(0);
@@ -462,7 +491,7 @@ uint32_t readCaptureValue(general_timers_32bit_t timer, uint8_t channel) {
     return readCapture(timer, channel);
 }
 
-void clearTimerStatusRegister(general_timers_32bit_t timer) {
+FASTCODE void clearTimerStatusRegister(general_timers_32bit_t timer) {
     TIMER_BASE_32BIT((uint32_t)timer, TIMER32BIT_SR) = 0;
 }
 
@@ -6,6 +6,7 @@
  */
 
 #include "gpio.h"
+#include "clock_gate.h"
 #include "stm_rcc.h"
 #include <stdint.h>
 
@@ -62,7 +63,7 @@ static void set_alt_function(uint32_t bank, uint32_t pin, uint32_t altFunc) {
 }
 
 void init_gpio(gpio_config_t config) {
-    enable_gpio_clock(config.gpio_bank);
+    acquire_gpio_clock(config.gpio_bank);
     set_mode((uint32_t)config.gpio_bank, (uint32_t)config.pin_number,
              (uint32_t)config.mode);
     set_output_type((uint32_t)config.gpio_bank, (uint32_t)config.pin_number,
@@ -0,0 +1,308 @@
+/*
+ * idle.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Picks the deepest power state that wakes up before the next tick.
+ * SLEEP (WFI) stops only the core clock and wakes on any interrupt. STOP
+ * turns off HSE and the PLL, so the RTC wakeup timer (on LSI) is armed to end
+ * it early enough for the clocks to be back before the tick is due. With
+ * tickless idle the tick is first pushed out, see suppress_ticks().
+ * The restore time is measured on every wake and the worst case is used for
+ * the next decision.
+ *
+ * The cycle counter runs on the core clock, so it stops in both states. A
+ * sleep is timed with the tick timer, STOP with the RTC subsecond counter
+ * (the tick timer stops too), and the counter and in STOP the tick are moved
+ * forward by it. The tick keeps its phase and cycle based measurements stay
+ * continuous without the debug option that keeps the core clock running.
+ */
+
+#include "idle.h"
+#include "clock_gate.h"
+#include "core_m4.h"
+#include "productDef.h"
+#include "serial.h"
+#include "stdio.h"
+#include "stm_rcc.h"
+#include "stm_utils.h"
+#include "sysclock.h"
+#include "timers.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PWR_REGISTER(n)      *(((volatile uint32_t *)0x40007000) + n)
+#define PWR_CR               0
+#define PWR_LPDS             BIT0
+#define PWR_PDDS             BIT1
+#define PWR_CWUF             BIT2
+#define PWR_DBP              BIT8
+
+#define RTC_REGISTER(n)      *(((volatile uint32_t *)0x40002800) + n)
+#define RTC_CR               2
+#define RTC_ISR              3
+#define RTC_PRER             4
+#define RTC_WUTR             5
+#define RTC_WPR              9
+#define RTC_SSR              10
+
+#define CR_WUCKSEL_MASK      (BIT2 | BIT1 | BIT0)
+#define CR_WUCKSEL_DIV2      (BIT1 | BIT0)
+#define CR_BYPSHAD           BIT5
+#define CR_WUTE              BITA
+#define CR_WUTIE             BITE
+#define ISR_WUTWF            BIT2
+#define ISR_INITF            BIT6
+#define ISR_INIT             BIT7
+#define ISR_WUTF             BITA
+
+/* LSI straight into the subsecond counter, one count per LSI period */
+#define RTC_PREDIV_S         0x7FFF
+#define RTC_SEL_MASK         (BIT9 | BIT8)
+
+#define EXTI_REGISTER(n)     *(((volatile uint32_t *)0x40013C00) + n)
+#define EXTI_IMR             0
+#define EXTI_RTSR            2
+#define EXTI_PR              5
+#define EXTI_RTC_WAKEUP      UPPER16BITS(BIT6)
+
+#define FLASH_SR             *((volatile uint32_t *)0x40023C0C)
+#define FLASH_BSY            UPPER16BITS(BIT0)
+
+/* Wake latencies. Sleep is a few cycles of exception entry, STOP with the
+ * low power regulator adds the regulator wake up to the measured restore. */
+#define SLEEP_LATENCY_CYCLES 64
+#define STOP_EXIT_US         110
+#define STOP_MARGIN_US       50
+#define STOP_INITIAL_US      400
+#define LSI_CALIBRATION      64
+
+typedef struct {
+    uint32_t entries;
+    uint64_t cycles;
+} power_stats_t;
+
+static const irq_info_t rtc_wakeup_irq = {INT_NUM_RTC_WKUP, IDLE_PRIORITY};
+
+static volatile uint32_t stop_blockers = 0;
+static bool rtc_ready = false;
+static uint32_t lsi_hz = 32000;
+static uint32_t stop_latency_cycles = 0;
+
+static power_stats_t stats[NUM_POWER_STATES];
+static uint32_t stats_start_ms = 0;
+
+static uint32_t cycles_per_us(void) {
+    return SystemCoreClock / 1000000;
+}
+
+static uint32_t read_subseconds(void) {
+    uint32_t ssr;
+
+    /* Shadow registers are bypassed, read until two reads agree */
+    do {
+        ssr = RTC_REGISTER(RTC_SSR);
+    } while (ssr != RTC_REGISTER(RTC_SSR));
+    return ssr;
+}
+
+/**
+ * @brief LSI is only good to a few tens of percent, so time it against the
+ * cycle counter.
+ */
+static uint32_t measure_lsi(void) {
+    uint32_t start_ssr = read_subseconds(), start, cycles;
+
+    while (read_subseconds() == start_ssr)
+        ;
+    start_ssr = read_subseconds();
+    start = CYCLE_COUNTER;
+    while (((start_ssr - read_subseconds()) & RTC_PREDIV_S) < LSI_CALIBRATION)
+        ;
+    cycles = CYCLE_COUNTER - start;
+
+    return (uint32_t)((uint64_t)LSI_CALIBRATION * SystemCoreClock / cycles);
+}
+
+static void init_rtc(void) {
+    acquire_clock(PWR_EN);
+    PWR_REGISTER(PWR_CR) |= PWR_DBP;
+
+    enable_low_speed_oscillator();
+    while (!read_clock_control_and_status_register(
+        INTERNAL_LOW_SPEED_OSCILLATOR))
+        ;
+
+    /* The RTC clock source can only change after a backup domain reset */
+    if (read_backup_domain(RTC_SEL_MASK) != ((uint32_t)lsi_clock << 8)) {
+        reset_backup_domain(false);
+        select_rtc_clock(lsi_clock);
+    }
+    enable_rtc_clock();
+
+    /* Left unlocked, the wakeup timer is reprogrammed on every STOP */
+    RTC_REGISTER(RTC_WPR) = 0xCA;
+    RTC_REGISTER(RTC_WPR) = 0x53;
+
+    RTC_REGISTER(RTC_ISR) |= ISR_INIT;
+    while (!(RTC_REGISTER(RTC_ISR) & ISR_INITF))
+        ;
+    RTC_REGISTER(RTC_PRER) = RTC_PREDIV_S;
+    RTC_REGISTER(RTC_CR) &= ~(CR_WUTE | CR_WUTIE | CR_WUCKSEL_MASK);
+    RTC_REGISTER(RTC_CR) |= CR_WUCKSEL_DIV2 | CR_BYPSHAD;
+    RTC_REGISTER(RTC_ISR) &= ~ISR_INIT;
+
+    EXTI_REGISTER(EXTI_RTSR) |= EXTI_RTC_WAKEUP;
+    EXTI_REGISTER(EXTI_IMR) |= EXTI_RTC_WAKEUP;
+    configure_interrupt(rtc_wakeup_irq);
+}
+
+static void clear_wakeup_flags(void) {
+    RTC_REGISTER(RTC_ISR) = ~ISR_WUTF | (RTC_REGISTER(RTC_ISR) & ISR_INIT);
+    EXTI_REGISTER(EXTI_PR) = EXTI_RTC_WAKEUP;
+}
+
+static void arm_wakeup(uint32_t ticks) {
+    RTC_REGISTER(RTC_CR) &= ~(CR_WUTE | CR_WUTIE);
+    while (!(RTC_REGISTER(RTC_ISR) & ISR_WUTWF))
+        ;
+    RTC_REGISTER(RTC_WUTR) = ticks - 1;
+    clear_wakeup_flags();
+    RTC_REGISTER(RTC_CR) |= CR_WUTE | CR_WUTIE;
+}
+
+static void disarm_wakeup(void) {
+    RTC_REGISTER(RTC_CR) &= ~(CR_WUTE | CR_WUTIE);
+    clear_wakeup_flags();
+}
+
+void RTC_WKUP_IRQHandler(void) {
+    clear_wakeup_flags();
+}
+
+/**
+ * @brief Calibrates LSI, which takes a couple of milliseconds, so run it
+ * deferred. STOP is not used before this.
+ */
+void init_idle(void) {
+    stop_latency_cycles = STOP_INITIAL_US * cycles_per_us();
+    clear_power_stats();
+    if (IDLE_ALLOW_STOP) {
+        init_rtc();
+        lsi_hz = measure_lsi();
+        rtc_ready = true;
+    }
+}
+
+void idle_block_stop(uint32_t source) {
+    __atomic_fetch_or(&stop_blockers, source, __ATOMIC_RELAXED);
+}
+
+void idle_allow_stop(uint32_t source) {
+    __atomic_fetch_and(&stop_blockers, ~source, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Wake up timer ticks (2 LSI periods) that fit in the budget, or 0
+ * if STOP is not possible right now.
+ */
+static uint32_t stop_ticks(uint32_t budget) {
+    uint32_t overhead = stop_latency_cycles + STOP_MARGIN_US * cycles_per_us();
+
+    if (!rtc_ready || stop_blockers || budget <= overhead) {
+        return 0;
+    }
+    /* Flash operations and UART output must not be cut off */
+    if ((FLASH_SR & FLASH_BSY) || !uart_tx_idle()) {
+        return 0;
+    }
+    return (uint32_t)((uint64_t)(budget - overhead) * lsi_hz /
+                      SystemCoreClock / 2);
+}
+
+static void enter_stop(uint32_t ticks) {
+    uint32_t ssr, wake, restore, slept, latency;
+
+    arm_wakeup(ticks);
+    ssr = read_subseconds();
+
+    PWR_REGISTER(PWR_CR) &= ~PWR_PDDS;
+    PWR_REGISTER(PWR_CR) |= PWR_LPDS | PWR_CWUF;
+    SCB->SCR |= SCB_SCR_SLEEPDEEP_Msk;
+    __DSB();
+    __WFI();
+    SCB->SCR &= ~SCB_SCR_SLEEPDEEP_Msk;
+
+    /* Running from HSI until the PLL is back */
+    wake = CYCLE_COUNTER;
+    restore_system_clock();
+    restore = (CYCLE_COUNTER - wake) * (SystemCoreClock / HSI_VALUE);
+    disarm_wakeup();
+
+    slept = (uint32_t)((uint64_t)((ssr - read_subseconds()) & RTC_PREDIV_S) *
+                       SystemCoreClock / lsi_hz);
+    CYCLE_COUNTER += slept;
+    advance_ticks(slept);
+
+    latency = restore + STOP_EXIT_US * cycles_per_us();
+    if (latency > stop_latency_cycles) {
+        stop_latency_cycles = latency;
+    }
+    stats[POWER_STOP].entries++;
+    stats[POWER_STOP].cycles += slept;
+}
+
+/**
+ * @brief Called by the scheduler with interrupts masked when nothing is
+ * ready. Returns after the next interrupt is pending; it runs once the
+ * caller unmasks them.
+ */
+void idle_sleep(void) {
+    uint32_t budget = suppress_ticks();
+    uint32_t start, slept, ticks;
+
+    if (budget < SLEEP_LATENCY_CYCLES) {
+        /* The tick is due, not worth sleeping */
+        stats[POWER_RUN].entries++;
+        return;
+    }
+
+    ticks = stop_ticks(budget);
+    if (ticks >= 2) {
+        enter_stop(ticks);
+    } else {
+        /* The core clock, and with it the cycle counter, stops in WFI */
+        start = read_tick_cycles();
+        __WFI();
+        slept = read_tick_cycles() - start;
+        CYCLE_COUNTER += slept;
+        stats[POWER_SLEEP].entries++;
+        stats[POWER_SLEEP].cycles += slept;
+    }
+    resume_ticks();
+}
+
+void print_power_stats(void) {
+    uint32_t total_ms = current_ts() - stats_start_ms;
+    uint32_t cycles_per_ms = SystemCoreClock / 1000;
+    uint32_t sleep_ms = (uint32_t)(stats[POWER_SLEEP].cycles / cycles_per_ms);
+    uint32_t stop_ms = (uint32_t)(stats[POWER_STOP].cycles / cycles_per_ms);
+    uint32_t asleep_ms = sleep_ms + stop_ms;
+
+    printf("Power over %lu ms: run %lu ms, sleep %lu ms (%lu), "
+           "stop %lu ms (%lu)\r\n",
+           total_ms, (total_ms > asleep_ms) ? total_ms - asleep_ms : 0,
+           sleep_ms, stats[POWER_SLEEP].entries, stop_ms,
+           stats[POWER_STOP].entries);
+    printf("STOP wake latency %lu us, LSI %lu Hz%s\r\n",
+           stop_latency_cycles / cycles_per_us(), lsi_hz,
+           rtc_ready ? "" : " (STOP disabled)");
+}
+
+void clear_power_stats(void) {
+    for (uint32_t i = 0; i < NUM_POWER_STATES; i++) {
+        stats[i] = (power_stats_t){0};
+    }
+    stats_start_ms = current_ts();
+}
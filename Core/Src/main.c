@@ -1,51 +1,91 @@
 
+#include "boot.h"
 #include "button_io.h"
+#include "clock_gate.h"
 #include "core_m4.h"
+#include "dlog.h"
+#include "dma_copy.h"
+#include "entropy.h"
 #include "gpio.h"
+#include "idle.h"
 #include "motor.h"
+#include "motor_control.h"
 #include "productDef.h"
 #include "reaction.h"
+#include "reaction_stats.h"
+#include "sched.h"
 #include "sensors.h"
 #include "serial.h"
+#include "shell.h"
 #include "slapper.h"
 #include "stdio.h"
 #include "stm_rcc.h"
 #include "stm_utils.h"
+#include "storage.h"
+#include "sysclock.h"
 #include "timers.h"
+#include "trace.h"
 
 // TODO: Switch button IO to appropriate pins
 // TODO: Transfer motor stuff into project
 
-#define ALLOW_PREEMPTION true
+/* Task priorities, 0 runs first */
+#define HEARTBEAT_TASK 0
+#define REACTION_TASK  1
+#define ACTUATION_TASK 2
+#define COMMAND_TASK   3
+#define HAND_TASK      4
 
-#if ALLOW_PREEMPTION
-#define CONTINUE continue
-#else
-#define CONTINUE
-#endif
-
-volatile uint32_t gEvents = 0;
+static uint32_t user_score = 0, cpu_score = 0;
+static bool actuation_done = false;
 
 const gpio_config_t led0_configs = {14,     0,         LOW,        bank_b,
                                     output, push_pull, high_speed, no_pull};
 
-/* Private function prototypes -----------------------------------------------*/
-void SystemClock_Config(void);
+static void print_welcome(void) {
+    printf("Welcome to this reaction time game.\r\n");
+    printf("Are you confident enough in your reflexes to press the start "
+           "button?\r\n");
+}
 
 void init(void) {
+    /* Serve exceptions from the SRAM copy of the vector table */
+    relocate_vector_table();
+    enable_cycle_counter();
+    boot_mark(BOOT_START);
+
     /* Reset of all peripherals, Initializes the Flash interface and the
      * Systick. */
     HAL_Init();
+    boot_mark(BOOT_HAL_READY);
 
-    /* Configure the system clock */
-    SystemClock_Config();
-
-    /* Initialize all configured peripherals */
-    USB_GPIO_Init();
-    MX_USART3_UART_Init();
-    MX_USB_OTG_FS_PCD_Init();
+    /* Let the PLL lock while the clock independent setup runs on HSI */
+    start_system_clock();
+    boot_mark(BOOT_PLL_STARTED);
 
     init_gpio(led0_configs);
+    initialize_ir_sensors();
+    init_buttons();
+    init_motor_pins();
+    config_reaction();
+    initialize_fsr();
+    boot_mark(BOOT_GPIO_READY);
+
+    finish_system_clock();
+    boot_mark(BOOT_SYSCLK_READY);
+
+    /* Scans the flash log, so run it at full speed */
+    init_storage();
+    user_score = storage_get_or(KEY_USER_SCORE, 0);
+    cpu_score = storage_get_or(KEY_CPU_SCORE, 0);
+    load_fsr_calibration();
+    init_slapper();
+    init_entropy();
+    init_dma_copy();
+
+    /* Everything below depends on the final bus clocks */
+    init_uart();
+    init_shell();
 
     if (check_clock_flag(SOFTWARE_RESET)) {
         clear_clock_flags();
@@ -53,20 +93,38 @@ void init(void) {
     }
     clear_clock_flags();
 
-    initialize_ir_sensors();
-    initialize_fsr();
-    init_buttons();
-    init_motor_pins();
-    // init_motor_timer();
-    // init_pid_timer();
-    config_reaction();
+    init_motor_control();
+    init_system_tick();
+    boot_mark(BOOT_PERIPHERALS_READY);
 
-    init_heartbeat();
+    /* Not needed for the first heartbeat. The FSRs are sampled from the start
+     * of a round on */
+    boot_defer(print_welcome);
+    boot_defer(init_usb);
+    boot_defer(init_idle);
 }
 
+#if PROFILE_ISRS
+static void print_isr_profiles(void) {
+    static const char *const names[NUM_ISR_PROFILES] = {
+        "tick", "EXTI9_5", "EXTI15_10", "TIM4", "DMA2_S0"};
+    isr_profile_t profile;
+
+    for (uint32_t i = 0; i < NUM_ISR_PROFILES; i++) {
+        get_isr_profile((isr_profile_id_t)i, &profile);
+        if (!profile.count) {
+            continue;
+        }
+        printf("%s ISR: %lu calls, avg %lu cycles, max %lu cycles (%s)\r\n",
+               names[i], profile.count, profile.total / profile.count,
+               profile.max, FASTCODE_IN_RAM ? "SRAM" : "flash");
+    }
+    clear_isr_profiles();
+}
+#endif
+
 static void peform_slapper_action(slapper_action_t action) {
     static slapper_action_t prevAction = NO_ACTION;
-    static uint32_t user_score = 0, cpu_score = 0;
 
     if (action == prevAction) {
         return;
@@ -76,6 +134,9 @@ static void peform_slapper_action(slapper_action_t action) {
     case NO_ACTION:
         // Do nothing
         break;
+    case START_ROUND:
+        start_fsr();
+        break;
     case SENSORS_USER_QUERY:
         printf("Please place your hand in the proper location\r\n");
     case PRINT_PAUSED:
@@ -96,14 +157,25 @@ static void peform_slapper_action(slapper_action_t action) {
         break;
     case UPDATE_SCORE_CPU:
         cpu_score++;
+        storage_set(KEY_CPU_SCORE, cpu_score);
         break;
     case UPDATE_SCORE_USER:
         user_score++;
+        storage_set(KEY_USER_SCORE, user_score);
         break;
     case QUERY_PLAY_AGAIN:
+        /* Any reset move has settled by now */
         block_actuation_events();
+        release_slap();
+        stop_reaction();
+        stop_fsr();
         printf("User score: %lu, CPU score: %lu\r\n", user_score, cpu_score);
+        print_reaction_round();
+        print_reaction_stats();
         printf("Press start to play again\r\n");
+#if PROFILE_ISRS
+        print_isr_profiles();
+#endif
         break;
     default:
         assert(false);
@@ -112,88 +184,88 @@ static void peform_slapper_action(slapper_action_t action) {
     prevAction = action;
 }
 
-/**
- * @brief  The application entry point.
- * @retval int
- */
-int main(void) {
-    bool actuation_done = false, start_btn, pause_btn;
-    slapper_action_t action = NO_ACTION;
-    init();
-
-    printf("Welcome to this reaction time game.\r\n");
-    printf("Are you confident enough in your reflexes to press the start "
-           "button?\r\n");
+FASTCODE static void heartbeat_task(uint32_t events) {
+    bool start_btn, pause_btn;
+    slapper_action_t action;
 
-    while (1) {
-        // Highest Priority
-        if (gEvents & E_HEARTBEAT) {
-            // run state machine for game
-            start_btn = button_changed_state(START_BUTTON);
-            pause_btn = button_changed_state(PAUSE_BUTTON);
-            action = run_slapper(start_btn, pause_btn, actuation_done);
-            peform_slapper_action(action);
-            actuation_done = false;
-            gEvents &= ~E_HEARTBEAT;
-            CONTINUE;
-        }
-        if (gEvents & E_REACTION) {
-            printf("Reaction time: %lu ms\r\n", read_reaction());
-            gEvents &= ~E_REACTION;
-            CONTINUE;
-        }
-        if (gEvents & E_ACTUATION_DONE) {
-            actuation_done = done_with_actuation();
-            gEvents &= ~E_ACTUATION_DONE;
-            CONTINUE;
-        }
-        // Lowest Priority
+    boot_mark(BOOT_FIRST_HEARTBEAT);
+    // run state machine for game
+    start_btn = button_changed_state(START_BUTTON);
+    pause_btn = button_changed_state(PAUSE_BUTTON);
+    harvest_entropy();
+    if (start_btn || pause_btn) {
+        entropy_add(CYCLE_COUNTER, ENTROPY_EVENT_BITS);
     }
+    action = run_slapper(start_btn, pause_btn, actuation_done);
+    peform_slapper_action(action);
+    actuation_done = false;
 
-    return 1;
+    /* Only the start button is polled while the game waits */
+    set_tickless_limit(slapper_idle() ? TICKLESS_MAX_TICKS : 1);
+    /* A flash erase stalls the loop, only take that while nothing is timed */
+    storage_allow_erase(slapper_idle());
+}
+
+static void reaction_task(uint32_t events) {
+    uint32_t reaction_ms = read_reaction();
+
+    record_reaction(reaction_ms, current_ts());
+    DLOG("Reaction time: %lu ms", reaction_ms);
+}
+
+static void actuation_task(uint32_t events) {
+    actuation_done = done_with_actuation();
+}
+
+static void command_task(uint32_t events) {
+    shell_process();
+}
+
+static void hand_task(uint32_t events) {
+    bool on = fsr_asserted();
+
+    if (on) {
+        DLOG("Hand on at %lu ms", fsr_change_ts());
+    } else {
+        DLOG("Hand off at %lu ms", fsr_change_ts());
+    }
+    peform_slapper_action(slapper_hand_changed(on));
 }
 
 /**
- * @brief System Clock Configuration
- * @retval None
+ * @brief  Registers the event tasks and the background work. Has to run
+ * before the interrupts that post events are enabled.
  */
-void SystemClock_Config(void) {
-    RCC_OscInitTypeDef RCC_OscInitStruct = {0};
-    RCC_ClkInitTypeDef RCC_ClkInitStruct = {0};
+static void register_tasks(void) {
+    sched_add_task("heartbeat", HEARTBEAT_TASK, E_HEARTBEAT, heartbeat_task);
+    sched_add_task("reaction", REACTION_TASK, E_REACTION, reaction_task);
+    sched_add_task("actuation", ACTUATION_TASK, E_ACTUATION_DONE,
+                   actuation_task);
+    sched_add_task("command", COMMAND_TASK, E_COMMAND, command_task);
+    sched_add_task("hand", HAND_TASK, E_HAND, hand_task);
 
-    /** Configure the main internal regulator output voltage
-     */
-    __HAL_RCC_PWR_CLK_ENABLE();
-    __HAL_PWR_VOLTAGESCALING_CONFIG(PWR_REGULATOR_VOLTAGE_SCALE1);
+    sched_add_background(boot_run_deferred);
+    sched_add_background(dlog_service);
+#if TRACE_ENABLE
+    sched_add_background(trace_service);
+#endif
+    sched_add_background(storage_service);
+    sched_add_background(watchdog_service);
+    sched_add_background(flush_clock_releases);
+    sched_add_background(entropy_service);
+    sched_add_background(fsr_stream_service);
+}
 
-    /** Initializes the RCC Oscillators according to the specified parameters
-     * in the RCC_OscInitTypeDef structure.
-     */
-    RCC_OscInitStruct.OscillatorType = RCC_OSCILLATORTYPE_HSE;
-    RCC_OscInitStruct.HSEState = RCC_HSE_BYPASS;
-    RCC_OscInitStruct.PLL.PLLState = RCC_PLL_ON;
-    RCC_OscInitStruct.PLL.PLLSource = RCC_PLLSOURCE_HSE;
-    RCC_OscInitStruct.PLL.PLLM = 4;
-    RCC_OscInitStruct.PLL.PLLN = 168;
-    RCC_OscInitStruct.PLL.PLLP = RCC_PLLP_DIV2;
-    RCC_OscInitStruct.PLL.PLLQ = 7;
-    RCC_OscInitStruct.PLL.PLLR = 2;
-    if (HAL_RCC_OscConfig(&RCC_OscInitStruct) != HAL_OK) {
-        Error_Handler();
-    }
+/**
+ * @brief  The application entry point.
+ * @retval int
+ */
+int main(void) {
+    register_tasks();
+    init();
+    sched_run();
 
-    /** Initializes the CPU, AHB and APB buses clocks
-     */
-    RCC_ClkInitStruct.ClockType = RCC_CLOCKTYPE_HCLK | RCC_CLOCKTYPE_SYSCLK |
-                                  RCC_CLOCKTYPE_PCLK1 | RCC_CLOCKTYPE_PCLK2;
-    RCC_ClkInitStruct.SYSCLKSource = RCC_SYSCLKSOURCE_PLLCLK;
-    RCC_ClkInitStruct.AHBCLKDivider = RCC_SYSCLK_DIV1;
-    RCC_ClkInitStruct.APB1CLKDivider = RCC_HCLK_DIV4;
-    RCC_ClkInitStruct.APB2CLKDivider = RCC_HCLK_DIV2;
-
-    if (HAL_RCC_ClockConfig(&RCC_ClkInitStruct, FLASH_LATENCY_5) != HAL_OK) {
-        Error_Handler();
-    }
+    return 1;
 }
 
 /**
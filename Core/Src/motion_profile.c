@@ -0,0 +1,171 @@
+/*
+ * motion_profile.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Trapezoidal and S-curve (jerk limited, 7 segment) point to point profiles.
+ * The planning and table building use floats once at startup; the control loop
+ * only interpolates the resulting Q31 tables.
+ */
+
+#include "motion_profile.h"
+#include "core_m4.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define Q31_ONE  2147483648.0f
+#define SEGMENTS 7
+
+/* Each segment starts from a known state and runs at constant jerk, so any
+ * point of the move is a cubic in the time since its segment started */
+typedef struct {
+    float end[SEGMENTS];
+    float jerk[SEGMENTS];
+    float accel[SEGMENTS];
+    float velocity[SEGMENTS];
+    float position[SEGMENTS];
+} motion_plan_t;
+
+/**
+ * @brief Fits the limits to the move, lowering velocity (and acceleration for
+ * the S-curve) when the move is too short to reach them. All values are in
+ * units of the move length.
+ */
+static void plan_motion(motion_plan_t *plan, motion_limits_t limits,
+                        float distance) {
+    float v = limits.max_velocity / distance;
+    float a = limits.max_acceleration / distance;
+    float j = (limits.shape == MOTION_S_CURVE) ? limits.max_jerk / distance
+                                               : 0.0f;
+    float tj, ta, tv;
+
+    if (j > 0.0f) {
+        /* Acceleration ramps of a / j, does it reach a before v? */
+        if (a * a / j > v) {
+            a = sqrtf(v * j);
+        }
+        /* Accelerating and braking take v * (v / a + a / j) */
+        if (v * (v / a + a / j) > 1.0f) {
+            v = a / 2.0f * (-a / j + sqrtf(a * a / (j * j) + 4.0f / a));
+            if (a * a / j > v) {
+                v = cbrtf(j / 4.0f);
+                a = sqrtf(v * j);
+            }
+        }
+        tj = a / j;
+        ta = v / a - tj;
+    } else {
+        if (v * v / a > 1.0f) {
+            v = sqrtf(a);
+        }
+        tj = 0.0f;
+        ta = v / a;
+    }
+    tv = 1.0f / v - ta - 2.0f * tj;
+    if (tv < 0.0f) {
+        tv = 0.0f;
+    }
+
+    const float durations[SEGMENTS] = {tj, ta, tj, tv, tj, ta, tj};
+    const float jerks[SEGMENTS] = {j, 0.0f, -j, 0.0f, -j, 0.0f, j};
+    const float accels[SEGMENTS] = {0.0f, a, 0.0f, 0.0f, 0.0f, -a, 0.0f};
+    float t = 0.0f, position = 0.0f, velocity = 0.0f, accel = 0.0f;
+
+    for (uint32_t i = 0; i < SEGMENTS; i++) {
+        float d = durations[i];
+
+        /* Trapezoids set the acceleration, S-curves carry it over */
+        if (j == 0.0f) {
+            accel = accels[i];
+        }
+        plan->jerk[i] = jerks[i];
+        plan->accel[i] = accel;
+        plan->velocity[i] = velocity;
+        plan->position[i] = position;
+        position += velocity * d + accel * d * d / 2.0f +
+                    jerks[i] * d * d * d / 6.0f;
+        velocity += accel * d + jerks[i] * d * d / 2.0f;
+        accel += jerks[i] * d;
+        t += d;
+        plan->end[i] = t;
+    }
+}
+
+/**
+ * @brief Position and velocity at time t into the move. Stepping the plan tick
+ * by tick instead picks up an error at every segment change, and the move
+ * then ends with a velocity step.
+ */
+static void evaluate_motion(const motion_plan_t *plan, float t, float *p,
+                            float *v) {
+    bool done = t >= plan->end[SEGMENTS - 1];
+    uint32_t segment = 0;
+    float d;
+
+    if (done) {
+        t = plan->end[SEGMENTS - 1];
+    }
+    while (segment < SEGMENTS - 1 && t >= plan->end[segment]) {
+        segment++;
+    }
+    d = t - (segment ? plan->end[segment - 1] : 0.0f);
+    *p = plan->position[segment] + plan->velocity[segment] * d +
+         plan->accel[segment] * d * d / 2.0f +
+         plan->jerk[segment] * d * d * d / 6.0f;
+    *v = plan->velocity[segment] + plan->accel[segment] * d +
+         plan->jerk[segment] * d * d / 2.0f;
+    if (done) {
+        *v = 0.0f;
+    }
+}
+
+void build_motion_profile(motion_profile_t *profile, motion_limits_t limits,
+                          q15_t distance, uint32_t tick_hz) {
+    motion_plan_t plan;
+    const float dt = 1.0f / (float)tick_hz;
+    float p, v, scale;
+
+    assert(profile && distance > 0 && tick_hz);
+    assert(limits.max_velocity > 0.0f && limits.max_acceleration > 0.0f);
+    assert(limits.shape != MOTION_S_CURVE || limits.max_jerk > 0.0f);
+
+    plan_motion(&plan, limits, (float)distance / 32768.0f);
+    profile->ticks = (uint32_t)ceilf(plan.end[SEGMENTS - 1] * (float)tick_hz);
+    assert(profile->ticks <= MOTION_MAX_TICKS);
+
+    /* Scale out the rounding so the move ends exactly on target */
+    evaluate_motion(&plan, plan.end[SEGMENTS - 1], &scale, &v);
+    scale = 1.0f / scale;
+    for (uint32_t i = 0; i < MOTION_TABLE_SIZE; i++) {
+        evaluate_motion(&plan, (float)(i << MOTION_TABLE_SHIFT) * dt, &p, &v);
+        p *= scale;
+        profile->position[i] = (p >= 1.0f) ? INT32_MAX : (q31_t)(p * Q31_ONE);
+        profile->velocity[i] = (q31_t)(v * dt * scale * Q31_ONE);
+    }
+}
+
+/**
+ * @brief Interpolates the setpoint for a tick since the start of the move.
+ */
+FASTCODE void sample_motion_profile(const motion_profile_t *profile,
+                                    uint32_t tick, q31_t *position,
+                                    q31_t *velocity) {
+    uint32_t index = tick >> MOTION_TABLE_SHIFT;
+    int32_t frac = tick & ((1 << MOTION_TABLE_SHIFT) - 1);
+    q31_t p0, p1, v0, v1;
+
+    if (index >= MOTION_TABLE_SIZE - 1) {
+        *position = profile->position[MOTION_TABLE_SIZE - 1];
+        *velocity = 0;
+        return;
+    }
+    p0 = profile->position[index];
+    p1 = profile->position[index + 1];
+    v0 = profile->velocity[index];
+    v1 = profile->velocity[index + 1];
+    *position = p0 + (q31_t)(((int64_t)(p1 - p0) * frac) >> MOTION_TABLE_SHIFT);
+    *velocity = v0 + (((v1 - v0) * frac) >> MOTION_TABLE_SHIFT);
+}
@@ -7,12 +7,17 @@
 
 #include "motor.h"
 #include "core_m4.h"
+#include "dlog.h"
 #include "exti.h"
 #include "general_timers.h"
 #include "gpio.h"
+#include "motor_control.h"
+#include "motor_pwm.h"
 #include "pinout.h"
 #include "productDef.h"
+#include "sched.h"
 #include "timers.h"
+#include "trace.h"
 #include <assert.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -20,6 +25,13 @@
 #define MOTOR_TX PIN_B0
 #define MOTOR_RX PIN_B12
 
+/* Drive modes */
+#define MOTOR_DRIVE_ON_OFF      0 // MOTOR_TX on/off, done on the end stop edge
+#define MOTOR_DRIVE_CLOSED_LOOP 1 // position PID on TIM4 sets the PWM duty
+#define MOTOR_DRIVE_PWM_PROFILE 2 // precomputed duty profile streamed by DMA
+
+#define MOTOR_DRIVE_MODE        MOTOR_DRIVE_CLOSED_LOOP
+
 const gpio_config_t motorTx = {.gpio_bank = bank_b,
                                .pin_number = 0,
                                .intialOutValue = LOW,
@@ -28,6 +40,14 @@ const gpio_config_t motorTx = {.gpio_bank = bank_b,
                                .output_type = push_pull,
                                .speed = high_speed};
 
+const gpio_config_t motorPwm = {.gpio_bank = bank_b,
+                                .pin_number = 0,
+                                .mode = alternate_function,
+                                .alternate_function = 2,
+                                .resistor = no_pull,
+                                .output_type = push_pull,
+                                .speed = high_speed};
+
 const gpio_config_t motorRx = {.gpio_bank = bank_b,
                                .pin_number = 12,
                                .mode = input,
@@ -40,20 +60,30 @@ const exti_config_t exti15_10 = {.exti_gpio = {12, bank_b},
                                  .rising_edge = true,
                                  .unmask_int = true};
 
-const irq_info_t exti15_10_info = {.interrupt_id = INT_NUM_EXTI9_5,
+const irq_info_t exti15_10_info = {.interrupt_id = INT_NUM_EXTI15_10,
                                    .priority = MOTOR_PRIORITY};
 
 static bool actuation_done = false;
 
-void EXTI15_10_IRQHandler(void) {
+FASTCODE void EXTI15_10_IRQHandler(void) {
+    ISR_PROFILE_ENTER();
     if (check_exti_channel_pending(12)) {
-        gEvents |= E_ACTUATION_DONE;
+        TRACE(TRACE_EXTI15_10, 0);
+        sched_post(E_ACTUATION_DONE);
         actuation_done = true;
+        acknowledge_exti_event(12);
+        DLOG("Actuator end stop");
     }
+    ISR_PROFILE_EXIT(PROFILE_EXTI15_10);
 }
 
 void init_motor_pins(void) {
+#if MOTOR_DRIVE_MODE == MOTOR_DRIVE_ON_OFF
     init_gpio(motorTx);
+#else
+    init_gpio(motorPwm);
+    init_motor_pwm();
+#endif
     init_gpio(motorRx);
     configure_interrupt(exti15_10_info);
     disable_irq(exti15_10_info);
@@ -61,19 +91,49 @@ void init_motor_pins(void) {
 }
 
 void start_slap(void) {
+#if MOTOR_DRIVE_MODE == MOTOR_DRIVE_CLOSED_LOOP
+    motor_move(MOVE_SLAP);
+#elif MOTOR_DRIVE_MODE == MOTOR_DRIVE_PWM_PROFILE
+    start_pwm_profile(PROFILE_SLAP);
+#else
+    actuation_done = false;
     acknowledge_multiple_exti_events(10, 11, 12, 13, 14, 15);
     enable_irq(exti15_10_info);
     setPin(MOTOR_TX);
+#endif
 }
 
 void reset_slap(void) {
+#if MOTOR_DRIVE_MODE == MOTOR_DRIVE_CLOSED_LOOP
+    motor_move(MOVE_RESET);
+#elif MOTOR_DRIVE_MODE == MOTOR_DRIVE_PWM_PROFILE
+    start_pwm_profile(PROFILE_RESET);
+#else
+    actuation_done = false;
     acknowledge_multiple_exti_events(10, 11, 12, 13, 14, 15);
     enable_irq(exti15_10_info);
     clearPin(MOTOR_TX);
+#endif
+}
+
+/**
+ * @brief Lets go of the actuator at the end of a round. The closed loop holds
+ * the reset position until then, which keeps STOP mode out.
+ */
+void release_slap(void) {
+#if MOTOR_DRIVE_MODE == MOTOR_DRIVE_CLOSED_LOOP
+    motor_stop();
+#endif
 }
 
 bool done_with_actuation(void) {
+#if MOTOR_DRIVE_MODE == MOTOR_DRIVE_CLOSED_LOOP
+    return motor_at_target();
+#elif MOTOR_DRIVE_MODE == MOTOR_DRIVE_PWM_PROFILE
+    return pwm_profile_done();
+#else
     return actuation_done;
+#endif
 }
 
 void block_actuation_events(void) {
@@ -0,0 +1,250 @@
+/*
+ * motor_control.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Position loop for the slapper actuator, run from the TIM4 update interrupt
+ * at MOTOR_CONTROL_HZ. Moves follow a trapezoidal or S-curve motion profile,
+ * then the loop holds the target and posts E_ACTUATION_DONE once the position
+ * has settled.
+ * The cost of every iteration is recorded in the TIM4 ISR profile.
+ */
+
+#include "motor_control.h"
+#include "core_m4.h"
+#include "encoder.h"
+#include "general_timers.h"
+#include "gpio.h"
+#include "idle.h"
+#include "motion_profile.h"
+#include "motor_pwm.h"
+#include "pid.h"
+#include "pinout.h"
+#include "productDef.h"
+#include "sched.h"
+#include "timers.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define MOTOR_END_STOP PIN_B12
+
+/* Settled once within tolerance for this long */
+#define TOLERANCE      Q15(0.02f)
+#define SETTLE_TICKS   MS_TO_TICKS(5)
+
+/* Position feedback from the TIM5 encoder, otherwise from a model of the
+ * spring return actuator that relaxes towards the drive level with a time
+ * constant of 2^MODEL_SHIFT ticks. Both are re-referenced at the end stop. */
+#define MOTOR_USE_ENCODER     true
+#define ENCODER_TRAVEL_COUNTS 2048
+#define MODEL_SHIFT           7
+
+typedef enum {
+    MOTOR_IDLE,
+    MOTOR_MOVING,
+    MOTOR_SETTLING,
+    MOTOR_HOLDING
+} motor_state_t;
+
+/* Kp 2.0, Ki 0.01, Kd 1.0 per tick; tune on the hardware */
+static pid_controller_t position_pid = {.kp = Q15(0.5f),
+                                        .ki = Q15(0.0025f),
+                                        .kd = Q15(0.25f),
+                                        .gain_shift = 2,
+                                        .out_min = 0,
+                                        .out_max = Q15_MAX};
+
+static const q15_t move_targets[NUM_MOTOR_MOVES] = {SLAP_POSITION,
+                                                    RESET_POSITION};
+
+static motion_limits_t move_limits[NUM_MOTOR_MOVES] = {
+    {.shape = MOTION_S_CURVE,
+     .max_velocity = 40.0f,
+     .max_acceleration = 2000.0f,
+     .max_jerk = 200000.0f},
+    {.shape = MOTION_TRAPEZOID,
+     .max_velocity = 10.0f,
+     .max_acceleration = 400.0f}};
+
+static motion_profile_t move_profiles[NUM_MOTOR_MOVES];
+
+static volatile motor_state_t state = MOTOR_IDLE;
+static const motion_profile_t *profile = 0;
+static uint32_t move_tick = 0;
+static q31_t move_start = 0;
+static q31_t move_delta = 0;
+static q31_t setpoint = 0;
+static q31_t setpoint_velocity = 0;
+static q15_t target = RESET_POSITION;
+static uint32_t settle_count = 0;
+
+static q31_t estimate = 0;
+
+#if MOTOR_USE_ENCODER
+static q15_t counts_to_q15(int32_t counts) {
+    int32_t position = counts * (32768 / ENCODER_TRAVEL_COUNTS);
+
+    if (position > Q15_MAX) {
+        return Q15_MAX;
+    }
+    if (position < Q15_MIN) {
+        return Q15_MIN;
+    }
+    return (q15_t)position;
+}
+#endif
+
+static q15_t read_position(q15_t output) {
+    bool end_stop = readPin(MOTOR_END_STOP) != 0;
+#if MOTOR_USE_ENCODER
+    static bool was_at_end_stop = false;
+
+    encoder_sample();
+    if (end_stop && !was_at_end_stop) {
+        encoder_set_position(ENCODER_TRAVEL_COUNTS);
+    }
+    was_at_end_stop = end_stop;
+    (void)output;
+    estimate = (q31_t)counts_to_q15(encoder_position()) << 16;
+#else
+    if (end_stop) {
+        estimate = (q31_t)Q15_MAX << 16;
+    } else {
+        estimate += (((q31_t)output << 16) - estimate) >> MODEL_SHIFT;
+    }
+#endif
+    return (q15_t)(estimate >> 16);
+}
+
+static void control_step(void) {
+    static q15_t output = 0;
+    q15_t position = read_position(output);
+    q15_t error;
+
+    /* The PWM is left alone, a duty profile may be streaming */
+    if (state == MOTOR_IDLE) {
+        output = 0;
+        return;
+    }
+
+    if (state == MOTOR_MOVING) {
+        q31_t fraction, velocity;
+
+        sample_motion_profile(profile, move_tick, &fraction, &velocity);
+        setpoint = move_start + (q31_t)(((int64_t)move_delta * fraction) >> 31);
+        setpoint_velocity = (q31_t)(((int64_t)move_delta * velocity) >> 31);
+        if (++move_tick > profile->ticks) {
+            setpoint = (q31_t)target << 16;
+            setpoint_velocity = 0;
+            state = MOTOR_SETTLING;
+            settle_count = 0;
+        }
+    }
+
+    output = pid_update(&position_pid, (q15_t)(setpoint >> 16), position);
+    set_motor_duty(output);
+
+    if (state == MOTOR_SETTLING) {
+        error = target - position;
+        settle_count = (error <= TOLERANCE && error >= -TOLERANCE)
+                           ? settle_count + 1
+                           : 0;
+        if (settle_count >= SETTLE_TICKS) {
+            state = MOTOR_HOLDING;
+            sched_post(E_ACTUATION_DONE);
+        }
+    }
+}
+
+FASTCODE void TIM4_IRQHandler(void) {
+    ISR_PROFILE_ENTER();
+    if (checkTimerStatus(TIMER4, UIF)) {
+        control_step();
+    }
+    clearTimerStatusRegister(TIMER4);
+    ISR_PROFILE_EXIT(PROFILE_TIM4);
+}
+
+void init_motor_control(void) {
+#if MOTOR_USE_ENCODER
+    init_encoder();
+#endif
+    state = MOTOR_IDLE;
+    estimate = 0;
+    pid_reset(&position_pid, 0);
+    for (uint32_t i = 0; i < NUM_MOTOR_MOVES; i++) {
+        configure_motor_move((motor_move_t)i, move_limits[i]);
+    }
+    init_pid_timer();
+}
+
+/**
+ * @brief Rebuilds the profile table of a move. Only while the motor is idle
+ * or holding.
+ */
+void configure_motor_move(motor_move_t move, motion_limits_t limits) {
+    q15_t distance = move_targets[MOVE_SLAP] - move_targets[MOVE_RESET];
+
+    assert(move < NUM_MOTOR_MOVES);
+    assert(state == MOTOR_IDLE || state == MOTOR_HOLDING);
+    move_limits[move] = limits;
+    build_motion_profile(&move_profiles[move], limits, distance,
+                         MOTOR_CONTROL_HZ);
+}
+
+/**
+ * @brief Starts a move from the current position to the target of move. The
+ * table is scaled to the actual distance.
+ */
+void motor_move(motor_move_t move) {
+    q15_t position = motor_position();
+
+    assert(move < NUM_MOTOR_MOVES);
+    disable_global_irq();
+    target = move_targets[move];
+    profile = &move_profiles[move];
+    move_tick = 0;
+    move_start = (q31_t)position << 16;
+    move_delta = ((q31_t)target << 16) - move_start;
+    setpoint = move_start;
+    pid_reset(&position_pid, position);
+    state = MOTOR_MOVING;
+    enable_global_irq();
+    /* The loop keeps running while holding, until motor_stop() */
+    idle_block_stop(IDLE_BLOCK_MOTOR);
+}
+
+void motor_stop(void) {
+    state = MOTOR_IDLE;
+    set_motor_duty(0);
+    idle_allow_stop(IDLE_BLOCK_MOTOR);
+}
+
+bool motor_at_target(void) {
+    return state == MOTOR_HOLDING;
+}
+
+q15_t motor_position(void) {
+    return (q15_t)(estimate >> 16);
+}
+
+/**
+ * @brief Current setpoint, velocity in Q15 travel << 16 per control tick.
+ */
+void motor_setpoint(q15_t *position, q31_t *velocity) {
+    *position = (q15_t)(setpoint >> 16);
+    *velocity = setpoint_velocity;
+}
+
+/**
+ * @brief Encoder counts per second, 0 without an encoder.
+ */
+int32_t motor_velocity(void) {
+#if MOTOR_USE_ENCODER
+    return encoder_velocity();
+#else
+    return 0;
+#endif
+}
@@ -0,0 +1,151 @@
+/*
+ * motor_pwm.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Hardware PWM for the actuator on TIM3 CH3 (PB0). Duty profiles are built
+ * once at startup and streamed into CCR3 by DMA1 stream 2 (channel 5,
+ * TIM3_UP): every update event bursts one half word through TIM3_DMAR, which
+ * the DCR points at CCR3. After start_pwm_profile() the CPU is only involved
+ * again for the transfer complete interrupt.
+ */
+
+#include "motor_pwm.h"
+#include "core_m4.h"
+#include "dma.h"
+#include "general_timers.h"
+#include "idle.h"
+#include "pid.h"
+#include "productDef.h"
+#include "sched.h"
+#include "stm_utils.h"
+#include "timers.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PROFILE_STREAM    DMA1_STREAM2
+/* TIM3_UP */
+#define PROFILE_CHANNEL   5
+
+#define TIM3_DMAR_ADDRESS 0x4000044CUL
+
+typedef struct {
+    q15_t peak;
+    uint16_t accel_periods;
+    uint16_t hold_periods;
+    uint16_t brake_periods;
+} profile_shape_t;
+
+/* Accelerate, hold and brake, then off */
+#define SLAP_ACCEL      100
+#define SLAP_HOLD       500
+#define SLAP_BRAKE      100
+/* Let the spring return against a fading hold */
+#define RESET_ACCEL     0
+#define RESET_HOLD      0
+#define RESET_BRAKE     1000
+
+#define PROFILE_LEN(p)  ((p##_ACCEL) + (p##_HOLD) + (p##_BRAKE) + 1)
+
+static const profile_shape_t shapes[NUM_PWM_PROFILES] = {
+    {Q15(0.95f), SLAP_ACCEL, SLAP_HOLD, SLAP_BRAKE},
+    {Q15(0.4f), RESET_ACCEL, RESET_HOLD, RESET_BRAKE}};
+
+static uint16_t slap_duty[PROFILE_LEN(SLAP)];
+static uint16_t reset_duty[PROFILE_LEN(RESET)];
+
+static uint16_t *const profiles[NUM_PWM_PROFILES] = {slap_duty, reset_duty};
+static const uint16_t profile_lengths[NUM_PWM_PROFILES] = {
+    PROFILE_LEN(SLAP), PROFILE_LEN(RESET)};
+
+static void profile_finished(dma_stream_t stream, uint32_t events);
+
+static const dma_config_t profile_dma = {
+    .channel = PROFILE_CHANNEL,
+    .direction = DMA_MEM_TO_PERIPH,
+    .peripheral = TIM3_DMAR_ADDRESS,
+    .peripheral_size = DMA_SIZE_HALF_WORD,
+    .memory_size = DMA_SIZE_HALF_WORD,
+    .memory_increment = true,
+    .priority = DMA_PRIO_HIGH,
+    .events = DMA_EVENT_TRANSFER_DONE,
+    .callback = profile_finished,
+    .irq_priority = MOTOR_PRIORITY};
+
+static volatile bool profile_done = true;
+
+static uint16_t duty_to_compare(q15_t duty) {
+    if (duty < 0) {
+        duty = 0;
+    }
+    return (uint16_t)(((uint32_t)duty * PWM_PERIOD) >> 15);
+}
+
+static void build_profile(uint16_t *out, profile_shape_t shape) {
+    uint16_t peak = duty_to_compare(shape.peak);
+    uint32_t n = 0;
+
+    for (uint32_t i = 1; i <= shape.accel_periods; i++) {
+        out[n++] = (uint16_t)(peak * i / shape.accel_periods);
+    }
+    for (uint32_t i = 0; i < shape.hold_periods; i++) {
+        out[n++] = peak;
+    }
+    for (uint32_t i = shape.brake_periods; i > 0; i--) {
+        out[n++] = (uint16_t)(peak * i / shape.brake_periods);
+    }
+    out[n] = 0;
+}
+
+FASTCODE static void profile_finished(dma_stream_t stream, uint32_t events) {
+    (void)stream;
+    if (events & DMA_EVENT_TRANSFER_DONE) {
+        profile_done = true;
+        idle_allow_stop(IDLE_BLOCK_PWM);
+        sched_post(E_ACTUATION_DONE);
+    }
+}
+
+void init_motor_pwm(void) {
+    for (uint32_t i = 0; i < NUM_PWM_PROFILES; i++) {
+        build_profile(profiles[i], shapes[i]);
+    }
+
+    if (!dma_claim(PROFILE_STREAM, "motor_pwm")) {
+        assert(false);
+    }
+    dma_configure(PROFILE_STREAM, &profile_dma);
+
+    init_motor_timer();
+}
+
+void set_motor_duty(q15_t duty) {
+    reconfigureCompareChannel(TIMER3, 3, duty_to_compare(duty));
+    /* TIM3 would freeze with the output on in STOP */
+    if (duty > 0) {
+        idle_block_stop(IDLE_BLOCK_PWM);
+    } else if (profile_done) {
+        idle_allow_stop(IDLE_BLOCK_PWM);
+    }
+}
+
+void start_pwm_profile(pwm_profile_t profile) {
+    assert(profile < NUM_PWM_PROFILES);
+
+    profile_done = false;
+    idle_block_stop(IDLE_BLOCK_PWM);
+    dma_start(PROFILE_STREAM, (uint32_t)profiles[profile], 0,
+              profile_lengths[profile]);
+}
+
+void stop_pwm_profile(void) {
+    dma_stop(PROFILE_STREAM);
+    profile_done = true;
+    set_motor_duty(0);
+}
+
+bool pwm_profile_done(void) {
+    return profile_done;
+}
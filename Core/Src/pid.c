@@ -0,0 +1,76 @@
+/*
+ * pid.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Fixed-point PID. Errors and outputs are Q15, the products are Q30 and summed
+ * in 64 bits so nothing wraps before the final saturation. The derivative
+ * acts on the measurement so setpoint steps do not kick the output.
+ */
+
+#include "pid.h"
+#include "core_m4.h"
+#include <assert.h>
+#include <stdint.h>
+
+static q15_t saturate_q15(int32_t value) {
+    if (value > Q15_MAX) {
+        return Q15_MAX;
+    }
+    if (value < Q15_MIN) {
+        return Q15_MIN;
+    }
+    return (q15_t)value;
+}
+
+void pid_reset(pid_controller_t *pid, q15_t measurement) {
+    assert(pid);
+    assert(pid->out_min < pid->out_max);
+    assert(pid->gain_shift <= 15);
+    pid->integral = 0;
+    pid->prev_measurement = measurement;
+}
+
+/**
+ * @brief Runs one controller step. The integrator is clamped to the output
+ * range and frozen while the output is saturated in the direction the error
+ * pushes it (anti-windup).
+ */
+FASTCODE q15_t pid_update(pid_controller_t *pid, q15_t setpoint,
+                          q15_t measurement) {
+    const uint8_t shift = 15 - pid->gain_shift;
+    const int64_t i_max = (int64_t)pid->out_max << shift;
+    const int64_t i_min = (int64_t)pid->out_min << shift;
+    q15_t error = saturate_q15((int32_t)setpoint - measurement);
+    q15_t delta = saturate_q15((int32_t)measurement - pid->prev_measurement);
+    int64_t integral = pid->integral + (int32_t)pid->ki * error;
+    int64_t sum;
+    int32_t output;
+
+    if (integral > i_max) {
+        integral = i_max;
+    } else if (integral < i_min) {
+        integral = i_min;
+    }
+
+    sum = (int64_t)((int32_t)pid->kp * error) + integral -
+          (int32_t)pid->kd * delta;
+    output = (int32_t)(sum >> shift);
+    pid->prev_measurement = measurement;
+
+    if (output >= pid->out_max) {
+        if (error < 0) {
+            pid->integral = integral;
+        }
+        return pid->out_max;
+    }
+    if (output <= pid->out_min) {
+        if (error > 0) {
+            pid->integral = integral;
+        }
+        return pid->out_min;
+    }
+    pid->integral = integral;
+    return (q15_t)output;
+}
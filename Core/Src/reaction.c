@@ -7,12 +7,19 @@
 
 #include "reaction.h"
 #include "core_m4.h"
+#include "entropy.h"
 #include "exti.h"
 #include "productDef.h"
+#include "sched.h"
+#include "stdio.h"
 #include "stm_utils.h"
 #include "timers.h"
+#include "trace.h"
+#include <stdbool.h>
 #include <stdint.h>
 
+#define REACTION_EXTI_MASK (0x1FUL << REACTION_FIRST_LINE)
+
 static const exti_config_t ir_exti_5 = {
     .exti_gpio = {5, bank_d}, .rising_edge = true, .unmask_int = true};
 
@@ -30,6 +37,10 @@ static const exti_config_t ir_exti_9 = {
 
 static const irq_info_t exti5_9_irq = {INT_NUM_EXTI9_5, REACTION_PRIORITY};
 
+static volatile uint32_t round_start = 0;
+static volatile uint32_t lifted = 0;
+static volatile uint32_t lift_cycles[REACTION_LINES];
+
 void config_reaction(void) {
     disable_global_irq();
     configure_interrupt(exti5_9_irq);
@@ -42,14 +53,38 @@ void config_reaction(void) {
     enable_global_irq();
 }
 
-void EXTI9_5_IRQHandler(void) {
-    stop_measurement();
-    gEvents |= E_REACTION;
-    acknowledge_multiple_exti_events(5, 6, 7, 8, 9, UNUSED_CHANNEL);
+/**
+ * @brief The first line to lift ends the reaction measurement. Every line
+ * gets one cycle counter stamp per round, later edges of it are ignored.
+ */
+FASTCODE void EXTI9_5_IRQHandler(void) {
+    ISR_PROFILE_ENTER();
+    uint32_t now = CYCLE_COUNTER;
+    uint32_t pending = read_pending_exti_events(REACTION_EXTI_MASK);
+    uint32_t fresh = pending & ~lifted;
+
+    TRACE(TRACE_EXTI9_5, pending >> REACTION_FIRST_LINE);
+    acknowledge_exti_events(pending);
+
+    if (fresh && !lifted) {
+        stop_measurement();
+        entropy_add(now, ENTROPY_EVENT_BITS);
+        sched_post(E_REACTION);
+    }
+    lifted |= fresh;
+    for (; fresh; fresh &= fresh - 1) {
+        lift_cycles[__builtin_ctz(fresh) - REACTION_FIRST_LINE] = now;
+    }
+    if (lifted == REACTION_EXTI_MASK) {
+        disable_irq(exti5_9_irq);
+    }
+    ISR_PROFILE_EXIT(PROFILE_EXTI9_5);
 }
 
 void start_reaction(void) {
-    acknowledge_multiple_exti_events(5, 6, 7, 8, 9, UNUSED_CHANNEL);
+    acknowledge_exti_events(REACTION_EXTI_MASK);
+    lifted = 0;
+    round_start = CYCLE_COUNTER;
     enable_irq(exti5_9_irq);
     start_measurement();
 }
@@ -61,3 +96,58 @@ void stop_reaction(void) {
 uint32_t read_reaction(void) {
     return read_measurement();
 }
+
+/**
+ * @brief Returns false until a line lifted this round.
+ */
+bool read_reaction_round(reaction_round_t *round) {
+    uint32_t cycles_per_us = SystemCoreClock / 1000000;
+    uint32_t stamps[REACTION_LINES];
+    uint32_t start, mask;
+
+    disable_global_irq();
+    start = round_start;
+    mask = lifted >> REACTION_FIRST_LINE;
+    for (uint32_t i = 0; i < REACTION_LINES; i++) {
+        stamps[i] = lift_cycles[i];
+    }
+    enable_global_irq();
+
+    round->lifted = (uint8_t)mask;
+    round->first_us = mask ? UINT32_MAX : 0;
+    round->last_us = 0;
+    for (uint32_t i = 0; i < REACTION_LINES; i++) {
+        uint32_t us = 0;
+
+        if (mask & (1UL << i)) {
+            us = (stamps[i] - start) / cycles_per_us;
+            if (us < round->first_us) {
+                round->first_us = us;
+            }
+            if (us > round->last_us) {
+                round->last_us = us;
+            }
+        }
+        round->lift_us[i] = us;
+    }
+    round->spread_us = round->last_us - round->first_us;
+    return mask != 0;
+}
+
+void print_reaction_round(void) {
+    reaction_round_t round;
+
+    if (!read_reaction_round(&round)) {
+        return;
+    }
+    printf("Lift times:");
+    for (uint32_t i = 0; i < REACTION_LINES; i++) {
+        if (round.lifted & (1UL << i)) {
+            printf(" %lu", round.lift_us[i]);
+        } else {
+            printf(" -");
+        }
+    }
+    printf(" us\r\nFirst %lu us, last %lu us, spread %lu us\r\n",
+           round.first_us, round.last_us, round.spread_us);
+}
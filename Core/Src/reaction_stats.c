@@ -0,0 +1,246 @@
+/*
+ * reaction_stats.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Keeps the last REACTION_HISTORY_SIZE reaction times and running statistics
+ * over every sample since the last clear. All updates are O(1): the mean and
+ * variance use Welford's method and the percentiles use the P-square
+ * estimator (Jain and Chlamtac), which tracks a quantile with 5 markers.
+ */
+
+#include "reaction_stats.h"
+#include "stdio.h"
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define HISTORY_MASK (REACTION_HISTORY_SIZE - 1)
+#define P2_MARKERS   5
+
+typedef struct {
+    float p;
+    float height[P2_MARKERS];
+    /* Exact up to 2^24 samples, far more than a session */
+    float pos[P2_MARKERS];
+    /* Desired positions at the fifth sample, they move by step per sample */
+    float desired[P2_MARKERS];
+    float step[P2_MARKERS];
+    uint32_t count;
+} p2_quantile_t;
+
+static reaction_sample_t history[REACTION_HISTORY_SIZE];
+static uint32_t history_head = 0;
+static uint32_t history_count = 0;
+
+/* Double, in float the mean and deviation drift by tenths of a percent over
+ * millions of samples. There is one insert per reaction, the software double
+ * math costs nothing that matters. */
+static uint32_t count = 0;
+static double mean = 0.0;
+static double m2 = 0.0;
+static uint32_t min_ms = UINT32_MAX;
+static uint32_t max_ms = 0;
+
+static p2_quantile_t p50;
+static p2_quantile_t p90;
+
+static void p2_init(p2_quantile_t *q, float p) {
+    q->p = p;
+    q->count = 0;
+    for (uint32_t i = 0; i < P2_MARKERS; i++) {
+        q->pos[i] = (float)(i + 1);
+    }
+    q->desired[0] = 1.0f;
+    q->desired[1] = 1.0f + 2.0f * p;
+    q->desired[2] = 1.0f + 4.0f * p;
+    q->desired[3] = 3.0f + 2.0f * p;
+    q->desired[4] = 5.0f;
+    q->step[0] = 0.0f;
+    q->step[1] = p / 2.0f;
+    q->step[2] = p;
+    q->step[3] = (1.0f + p) / 2.0f;
+    q->step[4] = 1.0f;
+}
+
+static void sort_floats(float *values, uint32_t n) {
+    for (uint32_t i = 1; i < n; i++) {
+        float v = values[i];
+        uint32_t j = i;
+        for (; j > 0 && values[j - 1] > v; j--) {
+            values[j] = values[j - 1];
+        }
+        values[j] = v;
+    }
+}
+
+static float p2_parabolic(const p2_quantile_t *q, uint32_t i, float d) {
+    const float *h = q->height, *n = q->pos;
+    return h[i] + d / (n[i + 1] - n[i - 1]) *
+                      ((n[i] - n[i - 1] + d) * (h[i + 1] - h[i]) /
+                           (n[i + 1] - n[i]) +
+                       (n[i + 1] - n[i] - d) * (h[i] - h[i - 1]) /
+                           (n[i] - n[i - 1]));
+}
+
+static float p2_linear(const p2_quantile_t *q, uint32_t i, int32_t d) {
+    const float *h = q->height, *n = q->pos;
+    return h[i] + (float)d * (h[i + d] - h[i]) / (n[i + d] - n[i]);
+}
+
+static void p2_insert(p2_quantile_t *q, float x) {
+    uint32_t k;
+    float moved;
+
+    if (q->count < P2_MARKERS) {
+        q->height[q->count++] = x;
+        if (q->count == P2_MARKERS) {
+            sort_floats(q->height, P2_MARKERS);
+        }
+        return;
+    }
+
+    /* Find the cell holding x, extending the extremes if needed */
+    if (x < q->height[0]) {
+        q->height[0] = x;
+        k = 0;
+    } else if (x >= q->height[4]) {
+        q->height[4] = x;
+        k = 3;
+    } else {
+        for (k = 0; k < 3 && x >= q->height[k + 1]; k++) {
+        }
+    }
+
+    for (uint32_t i = k + 1; i < P2_MARKERS; i++) {
+        q->pos[i] += 1.0f;
+    }
+    /* Nudge the middle markers towards their desired positions. Summing the
+     * steps instead drifts by whole positions over a long run, most of the
+     * steps are not exact in binary. */
+    moved = (float)(q->count + 1 - P2_MARKERS);
+    for (uint32_t i = 1; i < P2_MARKERS - 1; i++) {
+        float d = q->desired[i] + moved * q->step[i] - q->pos[i];
+
+        if ((d >= 1.0f && q->pos[i + 1] - q->pos[i] > 1.0f) ||
+            (d <= -1.0f && q->pos[i - 1] - q->pos[i] < -1.0f)) {
+            int32_t s = (d >= 0.0f) ? 1 : -1;
+            float h = p2_parabolic(q, i, (float)s);
+
+            if (q->height[i - 1] < h && h < q->height[i + 1]) {
+                q->height[i] = h;
+            } else {
+                q->height[i] = p2_linear(q, i, s);
+            }
+            q->pos[i] += (float)s;
+        }
+    }
+    q->count++;
+}
+
+static float p2_value(const p2_quantile_t *q) {
+    float sorted[P2_MARKERS];
+
+    if (q->count >= P2_MARKERS) {
+        return q->height[2];
+    }
+    if (!q->count) {
+        return 0.0f;
+    }
+
+    /* Too few samples for the markers, use the exact value */
+    for (uint32_t i = 0; i < q->count; i++) {
+        sorted[i] = q->height[i];
+    }
+    sort_floats(sorted, q->count);
+    return sorted[(uint32_t)(q->p * (float)(q->count - 1) + 0.5f)];
+}
+
+void record_reaction(uint32_t reaction_ms, uint32_t timestamp) {
+    double x = (double)reaction_ms;
+    double delta;
+
+    /* Sets up the quantile markers on the first sample */
+    if (!count) {
+        clear_reaction_stats();
+    }
+
+    history[history_head].timestamp = timestamp;
+    history[history_head].reaction_ms = reaction_ms;
+    history_head = (history_head + 1) & HISTORY_MASK;
+    if (history_count < REACTION_HISTORY_SIZE) {
+        history_count++;
+    }
+
+    count++;
+    delta = x - mean;
+    mean += delta / (double)count;
+    m2 += delta * (x - mean);
+
+    if (reaction_ms < min_ms) {
+        min_ms = reaction_ms;
+    }
+    if (reaction_ms > max_ms) {
+        max_ms = reaction_ms;
+    }
+
+    p2_insert(&p50, (float)reaction_ms);
+    p2_insert(&p90, (float)reaction_ms);
+}
+
+/**
+ * @brief Copies up to max samples, newest first, and returns how many.
+ */
+uint32_t get_reaction_history(reaction_sample_t *samples, uint32_t max) {
+    uint32_t n = (max < history_count) ? max : history_count;
+
+    assert(samples || !max);
+    for (uint32_t i = 0; i < n; i++) {
+        samples[i] = history[(history_head - 1 - i) & HISTORY_MASK];
+    }
+    return n;
+}
+
+void get_reaction_summary(reaction_summary_t *summary) {
+    assert(summary);
+    summary->count = count;
+    summary->min = count ? min_ms : 0;
+    summary->max = max_ms;
+    summary->mean = (float)mean;
+    summary->stddev =
+        (count > 1) ? (float)sqrt(m2 / (double)(count - 1)) : 0.0f;
+    summary->p50 = p2_value(&p50);
+    summary->p90 = p2_value(&p90);
+}
+
+void clear_reaction_stats(void) {
+    history_head = 0;
+    history_count = 0;
+    count = 0;
+    mean = 0.0;
+    m2 = 0.0;
+    min_ms = UINT32_MAX;
+    max_ms = 0;
+    p2_init(&p50, 0.5f);
+    p2_init(&p90, 0.9f);
+}
+
+void print_reaction_stats(void) {
+    reaction_summary_t s;
+
+    get_reaction_summary(&s);
+    if (!s.count) {
+        printf("No reaction times recorded\r\n");
+        return;
+    }
+    /* printf is built without float support */
+    printf("Reactions: %lu, min %lu ms, max %lu ms, mean %lu ms, "
+           "stddev %lu ms\r\n",
+           s.count, s.min, s.max, (uint32_t)(s.mean + 0.5f),
+           (uint32_t)(s.stddev + 0.5f));
+    printf("P50 %lu ms, P90 %lu ms, last %lu samples kept\r\n",
+           (uint32_t)(s.p50 + 0.5f), (uint32_t)(s.p90 + 0.5f),
+           history_count);
+}
@@ -0,0 +1,177 @@
+/*
+ * sched.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Run to completion scheduler. Every task owns a priority level and a set of
+ * event bits. sched_post() sets the events in gEvents and the task's bit in a
+ * ready bitmap (priority 0 in bit 31), so picking the next task is a single
+ * CLZ. A task always runs to completion and the highest ready task is picked
+ * again afterwards. Background tasks are polled whenever nothing is ready,
+ * then the idle manager sleeps until the next interrupt.
+ */
+
+#include "sched.h"
+#include "core_m4.h"
+#include "idle.h"
+#include "productDef.h"
+#include "stdio.h"
+#include "trace.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PRIO_BIT(p) (0x80000000UL >> (p))
+#define NO_TASK     0xFF
+
+typedef struct {
+    const char *name;
+    uint32_t events;
+    task_handler_t handler;
+    task_stats_t stats;
+} task_t;
+
+volatile uint32_t gEvents = 0;
+
+static task_t tasks[SCHED_NUM_PRIORITIES];
+static uint8_t event_priority[32] = {[0 ... 31] = NO_TASK};
+static volatile uint32_t ready = 0;
+static volatile uint32_t post_cycles[SCHED_NUM_PRIORITIES];
+
+static background_task_t background[SCHED_MAX_BACKGROUND];
+static uint32_t num_background = 0;
+
+bool sched_add_task(const char *name, uint8_t priority, uint32_t events,
+                    task_handler_t handler) {
+    assert(priority < SCHED_NUM_PRIORITIES && handler);
+
+    if (tasks[priority].handler) {
+        return false;
+    }
+    for (uint32_t i = 0; i < 32; i++) {
+        if (events & (1UL << i)) {
+            assert(event_priority[i] == NO_TASK);
+            event_priority[i] = priority;
+        }
+    }
+    tasks[priority].name = name;
+    tasks[priority].events = events;
+    tasks[priority].handler = handler;
+    return true;
+}
+
+bool sched_add_background(background_task_t task) {
+    if (num_background >= SCHED_MAX_BACKGROUND) {
+        return false;
+    }
+    background[num_background++] = task;
+    return true;
+}
+
+/**
+ * @brief Makes the owners of the events ready. Safe from any ISR.
+ */
+FASTCODE void sched_post(uint32_t events) {
+    uint32_t bits = 0;
+
+    __atomic_fetch_or(&gEvents, events, __ATOMIC_RELAXED);
+    while (events) {
+        uint32_t event = __builtin_ctz(events);
+        uint8_t priority = event_priority[event];
+
+        events &= events - 1;
+        if (priority != NO_TASK) {
+            bits |= PRIO_BIT(priority);
+        }
+    }
+
+    bits &= ~__atomic_fetch_or(&ready, bits, __ATOMIC_RELAXED);
+    while (bits) {
+        /* Latency is measured from the first post */
+        post_cycles[__builtin_clz(bits)] = CYCLE_COUNTER;
+        bits &= bits - 1;
+    }
+}
+
+static void idle(void) {
+    for (uint32_t i = 0; i < num_background; i++) {
+        background[i]();
+    }
+
+    /* An interrupt between the check and the sleep still wakes the core */
+    __disable_irq();
+    if (!ready) {
+        idle_sleep();
+    }
+    __enable_irq();
+}
+
+FASTCODE static void dispatch(uint32_t priority) {
+    task_t *task = &tasks[priority];
+    uint32_t events, start, cycles;
+
+    __atomic_fetch_and(&ready, ~PRIO_BIT(priority), __ATOMIC_RELAXED);
+    events = __atomic_fetch_and(&gEvents, ~task->events, __ATOMIC_RELAXED) &
+             task->events;
+    if (!events) {
+        return;
+    }
+
+    start = CYCLE_COUNTER;
+    if (start - post_cycles[priority] > task->stats.max_latency) {
+        task->stats.max_latency = start - post_cycles[priority];
+    }
+
+    TRACE(TRACE_DISPATCH_BEGIN, events);
+    task->handler(events);
+    TRACE(TRACE_DISPATCH_END, events);
+
+    cycles = CYCLE_COUNTER - start;
+    task->stats.runs++;
+    task->stats.total_cycles += cycles;
+    if (cycles > task->stats.max_cycles) {
+        task->stats.max_cycles = cycles;
+    }
+}
+
+/**
+ * @brief Never returns.
+ */
+FASTCODE void sched_run(void) {
+    while (1) {
+        uint32_t pending = ready;
+
+        if (pending) {
+            dispatch(__builtin_clz(pending));
+        } else {
+            idle();
+        }
+    }
+}
+
+void sched_print_stats(void) {
+    uint32_t us = SystemCoreClock / 1000000;
+
+    for (uint32_t i = 0; i < SCHED_NUM_PRIORITIES; i++) {
+        const task_t *task = &tasks[i];
+        uint32_t avg;
+
+        if (!task->handler) {
+            continue;
+        }
+        avg = task->stats.runs
+                  ? (uint32_t)(task->stats.total_cycles / task->stats.runs)
+                  : 0;
+        printf("%-10s prio %lu: %lu runs, avg %lu us, max %lu us, "
+               "max latency %lu us\r\n",
+               task->name, i, task->stats.runs, avg / us,
+               task->stats.max_cycles / us, task->stats.max_latency / us);
+    }
+}
+
+void sched_clear_stats(void) {
+    for (uint32_t i = 0; i < SCHED_NUM_PRIORITIES; i++) {
+        tasks[i].stats = (task_stats_t){0};
+    }
+}
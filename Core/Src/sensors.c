@@ -7,12 +7,19 @@
 
 #include "sensors.h"
 #include "adc_bad.h"
-#include "dma_bad.h"
+#include "adc_sampler.h"
+#include "core_m4.h"
 #include "gpio.h"
 #include "pinout.h"
+#include "productDef.h"
+#include "sched.h"
 #include "stm_utils.h"
+#include "storage.h"
+#include "timers.h"
+#include "usb_cdc.h"
 #include <assert.h>
 #include <sensors.h>
+#include <stdbool.h>
 #include <stdint.h>
 
 /*** IR Sensor Macros ***/
@@ -33,7 +40,37 @@
 #define IR_OPERATOR    ==
 
 /*** FSR Macros ***/
-#define FSR_THRESHOLD 750UL
+#define FSR_THRESHOLD  750UL
+/* The hand is on above threshold + hysteresis, off below threshold - it */
+#define FSR_HYSTERESIS 40UL
+#define ADC_MAX        0xFFF
+/* PF7 */
+#define FSR_CHANNEL    5
+#define FSR_RATE_HZ    10000
+
+/* Samples staged for the USB CDC port, must be a power of 2 */
+#define FSR_STREAM_SIZE 512
+#define FSR_STREAM_MASK (FSR_STREAM_SIZE - 1)
+
+static uint32_t fsr_threshold = FSR_THRESHOLD;
+static volatile bool fsr_on = false;
+static volatile uint32_t fsr_ts = 0;
+
+static const irq_info_t adc_irq = {INT_NUM_ADC, ADC_PRIORITY};
+
+static void fsr_crossed(void);
+static void fsr_block(const volatile uint16_t *block, uint16_t length);
+
+static const adc_channel_t fsr_channels[] = {
+    {FSR_CHANNEL, ADC_SAMPLE_480_CYCLES}};
+
+static const adc_sampler_config_t fsr_sampling = {
+    .rate_hz = FSR_RATE_HZ,
+    .resolution = ADC_RESOLUTION_12_BITS,
+    .channels = fsr_channels,
+    .num_channels = 1,
+    .on_block = fsr_block,
+    .on_watchdog = FSR_ANALOG_WATCHDOG ? fsr_crossed : NULL};
 
 const gpio_config_t ir0 = {.pin_number = 8,
                            .gpio_bank = bank_c,
@@ -72,6 +109,13 @@ const gpio_config_t ir4 = {.pin_number = 5,
 
 static bool ir_readings[NUM_IR_SENSORS] = {0};
 
+/* Free running, the difference is the number of staged samples */
+static uint16_t stream_ring[FSR_STREAM_SIZE];
+static volatile uint32_t stream_head = 0;
+static volatile uint32_t stream_tail = 0;
+static volatile bool streaming = false;
+static volatile uint32_t stream_dropped = 0;
+
 void initialize_ir_sensors(void) {
     init_gpio(ir0);
     init_gpio(ir1);
@@ -126,11 +170,146 @@ bool read_ir_sensor(ir_sensor_t sensor) {
     return retVal;
 }
 
+/**
+ * @brief Sets the watchdog window around the current state, so the only
+ * conversion that leaves it is the one crossing to the other state.
+ */
+static void arm_fsr_watchdog(bool on) {
+    if (on) {
+        setADC3WatchdogWindow(fsr_threshold > FSR_HYSTERESIS
+                                  ? fsr_threshold - FSR_HYSTERESIS
+                                  : 0,
+                              ADC_MAX);
+    } else {
+        setADC3WatchdogWindow(0, fsr_threshold + FSR_HYSTERESIS);
+    }
+}
+
+/**
+ * @brief Watchdog callback of the sampler, runs in the ADC interrupt.
+ */
+FASTCODE static void fsr_crossed(void) {
+    fsr_on = !fsr_on;
+    fsr_ts = current_ts();
+    arm_fsr_watchdog(fsr_on);
+    sched_post(E_HAND);
+}
+
+/**
+ * @brief Block callback of the sampler, runs in the DMA interrupt. That can
+ * preempt the USB interrupt, so the samples are only staged here and
+ * fsr_stream_service() hands them to the port.
+ */
+FASTCODE static void fsr_block(const volatile uint16_t *block,
+                               uint16_t length) {
+    uint32_t head = stream_head;
+
+    if (!streaming) {
+        return;
+    }
+    if (FSR_STREAM_SIZE - (head - stream_tail) < length) {
+        stream_dropped += length;
+        return;
+    }
+    for (uint16_t i = 0; i < length; i++) {
+        stream_ring[(head + i) & FSR_STREAM_MASK] = block[i];
+    }
+    stream_head = head + length;
+}
+
 void initialize_fsr(void) {
-    initADC3_5();
-    startADCConversion();
+    init_adc_sampler(&fsr_sampling);
+#if FSR_ANALOG_WATCHDOG
+    fsr_on = false;
+    arm_fsr_watchdog(false);
+    enableADC3Watchdog(FSR_CHANNEL);
+#endif
+}
+
+void start_fsr(void) {
+    start_adc_sampler();
+}
+
+/**
+ * @brief Stops sampling between rounds. The watchdog stays armed around the
+ * last state, so a hand that moved meanwhile posts E_HAND on the restart.
+ */
+void stop_fsr(void) {
+    stop_adc_sampler();
+}
+
+/**
+ * @brief Streams the raw FSR samples to the USB CDC port as little endian 16
+ * bit words while a round samples them.
+ */
+void fsr_stream(bool on) {
+    streaming = false;
+    stream_tail = stream_head;
+    stream_dropped = 0;
+    streaming = on;
+}
+
+uint32_t fsr_stream_dropped(void) {
+    return stream_dropped;
+}
+
+/**
+ * @brief Sends what fits of the staged samples, whole samples only so the
+ * stream stays aligned. Meant for the main loop.
+ */
+void fsr_stream_service(void) {
+    uint32_t tail = stream_tail;
+    uint32_t start = tail & FSR_STREAM_MASK;
+    uint32_t n = stream_head - tail;
+
+    if (!n) {
+        return;
+    }
+    if (!usb_cdc_connected()) {
+        stream_dropped += n;
+        stream_tail = tail + n;
+        return;
+    }
+    /* Up to the end of the ring, the rest goes on the next pass */
+    if (n > FSR_STREAM_SIZE - start) {
+        n = FSR_STREAM_SIZE - start;
+    }
+    if (n > usb_cdc_tx_free() / sizeof(uint16_t)) {
+        n = usb_cdc_tx_free() / sizeof(uint16_t);
+    }
+    usb_cdc_write(&stream_ring[start], n * sizeof(uint16_t));
+    stream_tail = tail + n;
+}
+
+void load_fsr_calibration(void) {
+    fsr_threshold = storage_get_or(KEY_FSR_THRESHOLD, FSR_THRESHOLD);
+}
+
+uint32_t get_fsr_threshold(void) {
+    return fsr_threshold;
+}
+
+void set_fsr_threshold(uint32_t threshold) {
+    fsr_threshold = threshold;
+    storage_set(KEY_FSR_THRESHOLD, threshold);
+#if FSR_ANALOG_WATCHDOG
+    disable_irq(adc_irq);
+    arm_fsr_watchdog(fsr_on);
+    enable_irq(adc_irq);
+#endif
 }
 
 bool fsr_asserted(void) {
-    return returnADC3StoredValueforone() > FSR_THRESHOLD;
+#if FSR_ANALOG_WATCHDOG
+    return fsr_on;
+#else
+    return adc_sampler_latest(0) > fsr_threshold;
+#endif
+}
+
+/**
+ * @brief Time of the last hand on/off crossing, in ms.
+ */
+uint32_t fsr_change_ts(void) {
+    return fsr_ts;
 }
@@ -6,12 +6,66 @@
  */
 
 #include "serial.h"
+#include "clock_gate.h"
+#include "core_m4.h"
+#include "gpio.h"
 #include "productDef.h"
+#include "sched.h"
 #include "stdio.h"
+#include "usart.h"
+#include "usb_cdc.h"
+
+#define RX_MASK    (UART_RX_BUFFER_SIZE - 1)
+#define TX_MASK    (UART_TX_BUFFER_SIZE - 1)
+
+#define CONSOLE    usart_3
+#define CONSOLE_TX 8
+#define CONSOLE_RX 9
 
-UART_HandleTypeDef huart3;
 PCD_HandleTypeDef hpcd_USB_OTG_FS;
 
+static const usart_config_t console = {.port = CONSOLE,
+                                       .baud_rate = 115200,
+                                       .parity = no_parity,
+                                       .stop_bits = one_stop_bit};
+
+static const gpio_config_t console_pins[] = {
+    {.gpio_bank = bank_d,
+     .pin_number = CONSOLE_TX,
+     .alternate_function = 7,
+     .mode = alternate_function,
+     .output_type = push_pull,
+     .speed = high_speed,
+     .resistor = no_pull},
+    {.gpio_bank = bank_d,
+     .pin_number = CONSOLE_RX,
+     .alternate_function = 7,
+     .mode = alternate_function,
+     .output_type = push_pull,
+     .speed = high_speed,
+     .resistor = no_pull}};
+
+static const irq_info_t usart3_irq = {INT_NUM_USART3, UART_PRIORITY};
+
+static volatile char rx_buffer[UART_RX_BUFFER_SIZE];
+static volatile uint32_t rx_head = 0;
+static volatile uint32_t rx_tail = 0;
+
+static volatile uint8_t tx_buffer[UART_TX_BUFFER_SIZE];
+static volatile uint32_t tx_head = 0;
+static volatile uint32_t tx_tail = 0;
+static bool uart_ready = false;
+
+/**
+ * @brief Writes out whatever is queued by polling. Interrupts must be masked.
+ */
+static void drain_tx(void) {
+    while (tx_tail != tx_head) {
+        usart_write_byte(CONSOLE, tx_buffer[tx_tail]);
+        tx_tail = (tx_tail + 1) & TX_MASK;
+    }
+}
+
 #ifdef __GNUC__
 /* With GCC, small printf (option LD Linker->Libraries->Small printf
    set to 'Yes') calls __io_putchar() */
@@ -21,36 +75,47 @@ PCD_HandleTypeDef hpcd_USB_OTG_FS;
 #endif /* __GNUC__ */
 
 /**
- * @brief  Retargets the C library printf function to the USART.
- * @param  None
- * @retval None
+ * @brief Retargets printf to USART3. From thread mode the byte is queued and
+ * sent by the TXE interrupt, waiting only if the ring is full. With
+ * interrupts masked, or from a handler, the ring is drained and the byte
+ * written directly so the order is kept.
  */
 PUTCHAR_PROTOTYPE {
-    /* Place your implementation of fputc here */
-    /* e.g. write a character to the USART3 and Loop until the end of
-     * transmission */
-    HAL_UART_Transmit(&huart3, (uint8_t *)&ch, 1, 0xFFFF);
+    uint32_t next;
+
+    if (!uart_ready) {
+        return ch;
+    }
+    if (__get_PRIMASK() || __get_IPSR()) {
+        uint32_t primask = __get_PRIMASK();
+
+        __disable_irq();
+        drain_tx();
+        usart_write_byte(CONSOLE, (uint8_t)ch);
+        __set_PRIMASK(primask);
+        return ch;
+    }
+
+    next = (tx_head + 1) & TX_MASK;
+    while (next == tx_tail) {
+    }
+    tx_buffer[tx_head] = (uint8_t)ch;
+    tx_head = next;
+    enable_usart_interrupts(CONSOLE, USART_TXE);
 
     return ch;
 }
 
 /**
- * @brief USART3 Initialization Function
- * @param None
- * @retval None
+ * @brief Sets up USART3 on the ST-LINK virtual COM port (PD8 TX, PD9 RX).
+ * The baud rate divider is computed from the bus clock at the time of the
+ * call, so this runs after finish_system_clock().
  */
-void MX_USART3_UART_Init(void) {
-    huart3.Instance = USART3;
-    huart3.Init.BaudRate = 115200;
-    huart3.Init.WordLength = UART_WORDLENGTH_8B;
-    huart3.Init.StopBits = UART_STOPBITS_1;
-    huart3.Init.Parity = UART_PARITY_NONE;
-    huart3.Init.Mode = UART_MODE_TX_RX;
-    huart3.Init.HwFlowCtl = UART_HWCONTROL_NONE;
-    huart3.Init.OverSampling = UART_OVERSAMPLING_16;
-    if (HAL_UART_Init(&huart3) != HAL_OK) {
-        Error_Handler();
-    }
+void init_uart(void) {
+    tx_head = tx_tail = 0;
+    init_gpios(console_pins, sizeof(console_pins) / sizeof(console_pins[0]));
+    init_usart(console);
+    uart_ready = true;
 }
 
 /**
@@ -85,11 +150,11 @@ void USB_GPIO_Init(void) {
     /* USER CODE END MX_GPIO_Init_1 */
 
     /* GPIO Ports Clock Enable */
-    __HAL_RCC_GPIOC_CLK_ENABLE();
-    __HAL_RCC_GPIOH_CLK_ENABLE();
-    __HAL_RCC_GPIOD_CLK_ENABLE();
-    __HAL_RCC_GPIOG_CLK_ENABLE();
-    __HAL_RCC_GPIOA_CLK_ENABLE();
+    acquire_gpio_clock(bank_c);
+    acquire_gpio_clock(bank_h);
+    acquire_gpio_clock(bank_d);
+    acquire_gpio_clock(bank_g);
+    acquire_gpio_clock(bank_a);
 
     /*Configure GPIO pin Output Level */
     HAL_GPIO_WritePin(USB_PowerSwitchOn_GPIO_Port, USB_PowerSwitchOn_Pin,
@@ -111,3 +176,102 @@ void USB_GPIO_Init(void) {
     /* USER CODE BEGIN MX_GPIO_Init_2 */
     /* USER CODE END MX_GPIO_Init_2 */
 }
+
+/**
+ * @brief Brings up USB OTG FS. Not needed by the game, so it is deferred until
+ * after the main loop is running.
+ */
+void init_usb(void) {
+    USB_GPIO_Init();
+    MX_USB_OTG_FS_PCD_Init();
+    init_usb_cdc(&hpcd_USB_OTG_FS);
+}
+
+/**
+ * @brief Receives into one ring buffer and transmits from the other. A line
+ * ending posts E_COMMAND.
+ */
+FASTCODE void USART3_IRQHandler(void) {
+    uint32_t primask;
+    uint8_t c;
+
+    if (usart_read_byte(CONSOLE, &c)) {
+        if (((rx_head + 1) & RX_MASK) != rx_tail) {
+            rx_buffer[rx_head] = (char)c;
+            rx_head = (rx_head + 1) & RX_MASK;
+        }
+        if (c == '\r' || c == '\n') {
+            sched_post(E_COMMAND);
+        }
+    }
+
+    if (usart_interrupt_enabled(CONSOLE, USART_TXE) &&
+        (read_usart_status(CONSOLE) & USART_TXE)) {
+        /* A handler printing at a higher priority drains the same ring */
+        primask = __get_PRIMASK();
+        __disable_irq();
+        if (tx_tail != tx_head) {
+            usart_write_byte(CONSOLE, tx_buffer[tx_tail]);
+            tx_tail = (tx_tail + 1) & TX_MASK;
+        }
+        if (tx_tail == tx_head) {
+            disable_usart_interrupts(CONSOLE, USART_TXE);
+        }
+        __set_PRIMASK(primask);
+    }
+}
+
+void init_uart_rx(void) {
+    rx_head = rx_tail = 0;
+    enable_usart_interrupts(CONSOLE, USART_RXNE);
+    configure_interrupt(usart3_irq);
+}
+
+bool uart_read_char(char *c) {
+    if (rx_tail == rx_head) {
+        return false;
+    }
+    *c = rx_buffer[rx_tail];
+    rx_tail = (rx_tail + 1) & RX_MASK;
+    return true;
+}
+
+bool uart_rx_pending(void) {
+    return rx_tail != rx_head;
+}
+
+/**
+ * @brief True once everything queued has left the pin.
+ */
+bool uart_tx_idle(void) {
+    return tx_tail == tx_head && (read_usart_status(CONSOLE) & USART_TC);
+}
+
+/**
+ * @brief Sends everything queued by polling, for use before a reset.
+ */
+void uart_flush(void) {
+    uint32_t primask = __get_PRIMASK();
+
+    if (!uart_ready) {
+        return;
+    }
+    __disable_irq();
+    drain_tx();
+    __set_PRIMASK(primask);
+    usart_flush(CONSOLE);
+}
+
+void print_uart_stats(void) {
+    usart_errors_t errors;
+
+    read_usart_errors(CONSOLE, &errors);
+    printf("UART %lu baud: %lu parity, %lu framing, %lu noise, "
+           "%lu overrun errors\r\n",
+           console.baud_rate, errors.parity, errors.framing, errors.noise,
+           errors.overrun);
+}
+
+void clear_uart_stats(void) {
+    clear_usart_errors(CONSOLE);
+}
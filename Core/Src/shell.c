@@ -0,0 +1,380 @@
+/*
+ * shell.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Line based command shell on the USART3 console. Characters are collected by
+ * the receive interrupt and only parsed here, from the main loop, when a line
+ * ending posts E_COMMAND. The line is split in place, so nothing is allocated.
+ */
+
+#include "shell.h"
+#include "adc_sampler.h"
+#include "boot.h"
+#include "clock_gate.h"
+#include "core_m4.h"
+#include "dlog.h"
+#include "dma.h"
+#include "dma_copy.h"
+#include "idle.h"
+#include "motor.h"
+#include "productDef.h"
+#include "reaction_stats.h"
+#include "sched.h"
+#include "sensors.h"
+#include "serial.h"
+#include "slapper.h"
+#include "stdio.h"
+#include "storage.h"
+#include "trace.h"
+#include "usb_cdc.h"
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef void (*command_handler_t)(int argc, char *argv[]);
+
+typedef struct {
+    const char *name;
+    const char *usage;
+    uint8_t min_args;
+    command_handler_t handler;
+} command_t;
+
+typedef struct {
+    const char *name;
+    uint32_t (*get)(void);
+    void (*set)(uint32_t value);
+} parameter_t;
+
+static void cmd_help(int argc, char *argv[]);
+static void cmd_get(int argc, char *argv[]);
+static void cmd_set(int argc, char *argv[]);
+static void cmd_stats(int argc, char *argv[]);
+static void cmd_clear(int argc, char *argv[]);
+static void cmd_slap(int argc, char *argv[]);
+static void cmd_retract(int argc, char *argv[]);
+static void cmd_boot(int argc, char *argv[]);
+static void cmd_reboot(int argc, char *argv[]);
+static void cmd_log(int argc, char *argv[]);
+static void cmd_trace(int argc, char *argv[]);
+static void cmd_tasks(int argc, char *argv[]);
+static void cmd_power(int argc, char *argv[]);
+static void cmd_clocks(int argc, char *argv[]);
+static void cmd_adc(int argc, char *argv[]);
+static void cmd_dma(int argc, char *argv[]);
+static void cmd_uart(int argc, char *argv[]);
+
+static uint32_t get_user_score(void) {
+    return storage_get_or(KEY_USER_SCORE, 0);
+}
+
+static uint32_t get_cpu_score(void) {
+    return storage_get_or(KEY_CPU_SCORE, 0);
+}
+
+static const command_t commands[] = {
+    {"help", "help", 0, cmd_help},
+    {"get", "get [parameter]", 0, cmd_get},
+    {"set", "set <parameter> <value>", 2, cmd_set},
+    {"stats", "stats [usb]", 0, cmd_stats},
+    {"clear", "clear", 0, cmd_clear},
+    {"slap", "slap", 0, cmd_slap},
+    {"retract", "retract", 0, cmd_retract},
+    {"boot", "boot", 0, cmd_boot},
+    {"reboot", "reboot", 0, cmd_reboot},
+    {"log", "log <text|raw>", 1, cmd_log},
+    {"trace", "trace [clear|usb]", 0, cmd_trace},
+    {"tasks", "tasks [clear]", 0, cmd_tasks},
+    {"power", "power [clear]", 0, cmd_power},
+    {"clocks", "clocks", 0, cmd_clocks},
+    {"adc", "adc [clear|usb <on|off>]", 0, cmd_adc},
+    {"dma", "dma [bench]", 0, cmd_dma},
+    {"uart", "uart [clear]", 0, cmd_uart}};
+
+#define NUM_COMMANDS   (sizeof(commands) / sizeof(commands[0]))
+
+/* Parameters without a setter are read only */
+static const parameter_t parameters[] = {
+    {"threshold", get_fsr_threshold, set_fsr_threshold},
+    {"difficulty", get_difficulty, set_difficulty},
+    {"user_score", get_user_score, NULL},
+    {"cpu_score", get_cpu_score, NULL}};
+
+#define NUM_PARAMETERS (sizeof(parameters) / sizeof(parameters[0]))
+
+static char line[SHELL_LINE_SIZE];
+static uint32_t line_len = 0;
+static bool line_overflow = false;
+
+static const parameter_t *find_parameter(const char *name) {
+    for (uint32_t i = 0; i < NUM_PARAMETERS; i++) {
+        if (!strcmp(parameters[i].name, name)) {
+            return &parameters[i];
+        }
+    }
+    printf("Unknown parameter: %s\r\n", name);
+    return NULL;
+}
+
+static void cmd_help(int argc, char *argv[]) {
+    for (uint32_t i = 0; i < NUM_COMMANDS; i++) {
+        printf("  %s\r\n", commands[i].usage);
+    }
+}
+
+static void cmd_get(int argc, char *argv[]) {
+    const parameter_t *param;
+
+    if (argc < 2) {
+        for (uint32_t i = 0; i < NUM_PARAMETERS; i++) {
+            printf("%s = %lu\r\n", parameters[i].name, parameters[i].get());
+        }
+        return;
+    }
+    if ((param = find_parameter(argv[1]))) {
+        printf("%s = %lu\r\n", param->name, param->get());
+    }
+}
+
+static void cmd_set(int argc, char *argv[]) {
+    const parameter_t *param = find_parameter(argv[1]);
+    char *end;
+    uint32_t value;
+
+    if (!param) {
+        return;
+    }
+    if (!param->set) {
+        printf("%s is read only\r\n", param->name);
+        return;
+    }
+    value = strtoul(argv[2], &end, 0);
+    if (end == argv[2] || *end) {
+        printf("Not a number: %s\r\n", argv[2]);
+        return;
+    }
+    /* Persisted by storage_service() from the main loop */
+    param->set(value);
+    printf("%s = %lu\r\n", param->name, param->get());
+}
+
+/**
+ * @brief Sends the summary and the kept samples, oldest first, to the USB CDC
+ * port as "timestamp,reaction_ms" lines for the host.
+ */
+static void send_reaction_stats(void) {
+    static reaction_sample_t samples[REACTION_HISTORY_SIZE];
+    reaction_summary_t s;
+    uint32_t n = get_reaction_history(samples, REACTION_HISTORY_SIZE);
+    uint32_t sent = 0;
+
+    get_reaction_summary(&s);
+    if (usb_cdc_printf("# reactions %lu %lu %lu %lu %lu %lu %lu\r\n",
+                       s.count, s.min, s.max, (uint32_t)(s.mean + 0.5f),
+                       (uint32_t)(s.stddev + 0.5f), (uint32_t)(s.p50 + 0.5f),
+                       (uint32_t)(s.p90 + 0.5f))) {
+        while (sent < n &&
+               usb_cdc_printf("%lu,%lu\r\n", samples[n - 1 - sent].timestamp,
+                              samples[n - 1 - sent].reaction_ms)) {
+            sent++;
+        }
+        if (sent == n) {
+            return;
+        }
+    }
+    printf("USB port not open or full, %lu of %lu samples sent\r\n", sent,
+           n);
+}
+
+static void cmd_stats(int argc, char *argv[]) {
+    if (argc > 1 && !strcmp(argv[1], "usb")) {
+        send_reaction_stats();
+    } else {
+        print_reaction_stats();
+    }
+}
+
+static void cmd_clear(int argc, char *argv[]) {
+    clear_reaction_stats();
+}
+
+static void cmd_slap(int argc, char *argv[]) {
+    start_slap();
+}
+
+static void cmd_retract(int argc, char *argv[]) {
+    reset_slap();
+}
+
+static void cmd_boot(int argc, char *argv[]) {
+    print_boot_log();
+}
+
+static void cmd_reboot(int argc, char *argv[]) {
+    storage_flush();
+    uart_flush();
+    reset_system();
+}
+
+static void cmd_log(int argc, char *argv[]) {
+    if (!strcmp(argv[1], "raw")) {
+        /* Binary entries go to the USB CDC port */
+        dlog_set_raw(true);
+    } else if (!strcmp(argv[1], "text")) {
+        dlog_set_raw(false);
+    } else {
+        printf("Usage: log <text|raw>\r\n");
+    }
+}
+
+static void cmd_trace(int argc, char *argv[]) {
+#if TRACE_ENABLE
+    if (argc > 1 && !strcmp(argv[1], "clear")) {
+        trace_clear();
+    } else {
+        trace_dump(argc > 1 && !strcmp(argv[1], "usb"));
+    }
+#else
+    printf("Tracing is off, build with -DTRACE_ENABLE=1\r\n");
+#endif
+}
+
+static void cmd_tasks(int argc, char *argv[]) {
+    if (argc > 1 && !strcmp(argv[1], "clear")) {
+        sched_clear_stats();
+    } else {
+        sched_print_stats();
+    }
+}
+
+static void cmd_power(int argc, char *argv[]) {
+    if (argc > 1 && !strcmp(argv[1], "clear")) {
+        clear_power_stats();
+    } else {
+        print_power_stats();
+    }
+}
+
+static void cmd_clocks(int argc, char *argv[]) {
+    print_clock_report();
+}
+
+static void cmd_adc(int argc, char *argv[]) {
+    if (argc > 2 && !strcmp(argv[1], "usb")) {
+        /* Raw FSR samples while a round runs, see fsr_stream() */
+        if (!strcmp(argv[2], "on")) {
+            fsr_stream(true);
+        } else if (!strcmp(argv[2], "off")) {
+            printf("%lu samples dropped\r\n", fsr_stream_dropped());
+            fsr_stream(false);
+        } else {
+            printf("Usage: adc [clear|usb <on|off>]\r\n");
+        }
+    } else if (argc > 1 && !strcmp(argv[1], "clear")) {
+        clear_adc_sampler_stats();
+    } else {
+        print_adc_sampler_stats();
+    }
+}
+
+static void cmd_dma(int argc, char *argv[]) {
+    if (argc > 1 && !strcmp(argv[1], "bench")) {
+        print_dma_copy_benchmark();
+    } else {
+        print_dma_streams();
+    }
+}
+
+static void cmd_uart(int argc, char *argv[]) {
+    if (argc > 1 && !strcmp(argv[1], "clear")) {
+        clear_uart_stats();
+    } else {
+        print_uart_stats();
+    }
+}
+
+/**
+ * @brief Splits the line in place on spaces and tabs. Returns the number of
+ * tokens, extra tokens are left in the last one.
+ */
+static int tokenize(char *str, char *argv[]) {
+    int argc = 0;
+
+    while (*str && argc < SHELL_MAX_ARGS) {
+        while (*str == ' ' || *str == '\t') {
+            *str++ = '\0';
+        }
+        if (!*str) {
+            break;
+        }
+        argv[argc++] = str;
+        while (*str && *str != ' ' && *str != '\t') {
+            str++;
+        }
+    }
+    return argc;
+}
+
+static void execute(char *str) {
+    char *argv[SHELL_MAX_ARGS];
+    int argc = tokenize(str, argv);
+
+    if (!argc) {
+        return;
+    }
+    for (uint32_t i = 0; i < NUM_COMMANDS; i++) {
+        if (strcmp(commands[i].name, argv[0])) {
+            continue;
+        }
+        if (argc - 1 < commands[i].min_args) {
+            printf("Usage: %s\r\n", commands[i].usage);
+        } else {
+            commands[i].handler(argc, argv);
+        }
+        return;
+    }
+    printf("Unknown command: %s, try help\r\n", argv[0]);
+}
+
+void init_shell(void) {
+    line_len = 0;
+    line_overflow = false;
+    init_uart_rx();
+}
+
+/**
+ * @brief Runs at most one command per call. If more input is buffered
+ * E_COMMAND is posted again, so the heartbeat gets in between.
+ */
+void shell_process(void) {
+    char c;
+
+    while (uart_read_char(&c)) {
+        if (c == '\r' || c == '\n') {
+            if (line_overflow) {
+                printf("Line too long\r\n");
+            } else if (line_len) {
+                line[line_len] = '\0';
+                execute(line);
+            }
+            line_len = 0;
+            line_overflow = false;
+            if (uart_rx_pending()) {
+                sched_post(E_COMMAND);
+            }
+            return;
+        }
+        if (c == '\b' || c == 0x7F) {
+            if (line_len) {
+                line_len--;
+            }
+        } else if (line_len < SHELL_LINE_SIZE - 1) {
+            line[line_len++] = c;
+        } else {
+            line_overflow = true;
+        }
+    }
+}
@@ -5,9 +5,12 @@
  */
 
 #include "slapper.h"
+#include "entropy.h"
 #include "motor.h"
 #include "sensors.h"
+#include "storage.h"
 #include "timers.h"
+#include "trace.h"
 #include <stdbool.h>
 #include <stdint.h>
 
@@ -33,28 +36,32 @@ typedef enum {
 } _slap_game_state_t;
 #endif
 
+/* In heartbeats, the range the old counter based wait covered */
+#define SLAP_WAIT_MIN 1700
+#define SLAP_WAIT_MAX 3281
+
 FILE_STATIC _slap_game_state_t currentState = SLAPPER_IDLE;
 FILE_STATIC uint32_t difficulty_buffer = 0;
+#if FSR_ANALOG_WATCHDOG
+/* Only follows E_HAND, see slapper_hand_changed() */
+FILE_STATIC bool hand_on = false;
+#endif
 
 /**
- * @brief Crappy algorithm to generate not so random numbers, but works for
- * this purpose. Ideally would want to take in values from the counter, ADC,
- * and some other sensor and use an appropriate algorithm to generate an actual
- * random number. But this should do for the prototype
+ * @brief Heartbeats to wait before the slap, about 1.7 to 3.3 seconds.
  */
 FILE_STATIC uint32_t genrand(void) {
-    const uint32_t scaler = 17;
-    const uint32_t offset = 100;
-
-    uint32_t random = read_heartbeat();
-
-    return (random + offset) * scaler;
+    return random_range(SLAP_WAIT_MIN, SLAP_WAIT_MAX);
 }
 
 FILE_STATIC bool all_sensors_covered(void) {
     bool ir, fsr;
     ir = all_ir_sensors_covered();
+#if FSR_ANALOG_WATCHDOG
+    fsr = hand_on;
+#else
     fsr = fsr_asserted();
+#endif
     return ir == fsr;
 }
 
@@ -62,6 +69,7 @@ FILE_STATIC void run_state_machine(bool start, bool pause, bool actuator_done) {
     static uint32_t buffer = 0;
     static uint32_t Random = 0;
     static uint32_t count = 0;
+    _slap_game_state_t prevState = currentState;
     bool hand_placed = false;
 
     switch (currentState) {
@@ -120,14 +128,19 @@ FILE_STATIC void run_state_machine(bool start, bool pause, bool actuator_done) {
     default:
         assert(false);
     }
+
+    if (currentState != prevState) {
+        TRACE(TRACE_STATE, currentState);
+    }
 }
 
 FILE_STATIC slapper_action_t determine_action(void) {
     switch (currentState) {
     case SLAPPER_IDLE:
-    case SLAPPER_RANDOMIZE:
     case SLAPPER_CHECK_REACTION:
         return NO_ACTION;
+    case SLAPPER_RANDOMIZE:
+        return START_ROUND;
     case SLAPPER_CHECK_HAND:
         return SENSORS_USER_QUERY;
     case SLAPPER_PAUSE:
@@ -152,6 +165,49 @@ FILE_STATIC slapper_action_t determine_action(void) {
     return NO_ACTION;
 }
 
+void init_slapper(void) {
+    difficulty_buffer = storage_get_or(KEY_DIFFICULTY, 0);
+}
+
+uint32_t get_difficulty(void) {
+    return difficulty_buffer;
+}
+
+void set_difficulty(uint32_t difficulty) {
+    difficulty_buffer = difficulty;
+    storage_set(KEY_DIFFICULTY, difficulty);
+}
+
+/**
+ * @brief True while waiting for the start button, nothing is timed then.
+ */
+bool slapper_idle(void) {
+    return currentState == SLAPPER_IDLE;
+}
+
+/**
+ * @brief Handles E_HAND. A round pauses as soon as the hand comes off and the
+ * timer starts as soon as it is placed, without waiting for a heartbeat.
+ */
+slapper_action_t slapper_hand_changed(bool on) {
+    _slap_game_state_t prevState = currentState;
+
+#if FSR_ANALOG_WATCHDOG
+    hand_on = on;
+#endif
+    if (currentState == SLAPPER_RUN_TIMER && !on) {
+        currentState = SLAPPER_PAUSE;
+    } else if (currentState == SLAPPER_CHECK_HAND && on &&
+               all_sensors_covered()) {
+        currentState = SLAPPER_RUN_TIMER;
+    }
+
+    if (currentState != prevState) {
+        TRACE(TRACE_STATE, currentState);
+    }
+    return determine_action();
+}
+
 slapper_action_t run_slapper(bool start, bool pause, bool actuator_done) {
 	refresh_ir_sensors();
     run_state_machine(start, pause, actuator_done);
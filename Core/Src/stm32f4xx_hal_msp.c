@@ -22,6 +22,8 @@
 #include "productDef.h"
 
 /* USER CODE BEGIN Includes */
+#include "clock_gate.h"
+#include "stm_rcc.h"
 
 /* USER CODE END Includes */
 
@@ -66,8 +68,8 @@ void HAL_MspInit(void) {
 
     /* USER CODE END MspInit 0 */
 
-    __HAL_RCC_SYSCFG_CLK_ENABLE();
-    __HAL_RCC_PWR_CLK_ENABLE();
+    /* SYSCFG is only clocked while sysconfig.c accesses it */
+    acquire_clock(PWR_EN);
 
     /* System interrupt init*/
 
@@ -76,65 +78,6 @@ void HAL_MspInit(void) {
     /* USER CODE END MspInit 1 */
 }
 
-/**
- * @brief UART MSP Initialization
- * This function configures the hardware resources used in this example
- * @param huart: UART handle pointer
- * @retval None
- */
-void HAL_UART_MspInit(UART_HandleTypeDef *huart) {
-    GPIO_InitTypeDef GPIO_InitStruct = {0};
-    if (huart->Instance == USART3) {
-        /* USER CODE BEGIN USART3_MspInit 0 */
-
-        /* USER CODE END USART3_MspInit 0 */
-        /* Peripheral clock enable */
-        __HAL_RCC_USART3_CLK_ENABLE();
-
-        __HAL_RCC_GPIOD_CLK_ENABLE();
-        /**USART3 GPIO Configuration
-        PD8     ------> USART3_TX
-        PD9     ------> USART3_RX
-        */
-        GPIO_InitStruct.Pin = STLK_RX_Pin | STLK_TX_Pin;
-        GPIO_InitStruct.Mode = GPIO_MODE_AF_PP;
-        GPIO_InitStruct.Pull = GPIO_NOPULL;
-        GPIO_InitStruct.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
-        GPIO_InitStruct.Alternate = GPIO_AF7_USART3;
-        HAL_GPIO_Init(GPIOD, &GPIO_InitStruct);
-
-        /* USER CODE BEGIN USART3_MspInit 1 */
-
-        /* USER CODE END USART3_MspInit 1 */
-    }
-}
-
-/**
- * @brief UART MSP De-Initialization
- * This function freeze the hardware resources used in this example
- * @param huart: UART handle pointer
- * @retval None
- */
-void HAL_UART_MspDeInit(UART_HandleTypeDef *huart) {
-    if (huart->Instance == USART3) {
-        /* USER CODE BEGIN USART3_MspDeInit 0 */
-
-        /* USER CODE END USART3_MspDeInit 0 */
-        /* Peripheral clock disable */
-        __HAL_RCC_USART3_CLK_DISABLE();
-
-        /**USART3 GPIO Configuration
-        PD8     ------> USART3_TX
-        PD9     ------> USART3_RX
-        */
-        HAL_GPIO_DeInit(GPIOD, STLK_RX_Pin | STLK_TX_Pin);
-
-        /* USER CODE BEGIN USART3_MspDeInit 1 */
-
-        /* USER CODE END USART3_MspDeInit 1 */
-    }
-}
-
 /**
  * @brief PCD MSP Initialization
  * This function configures the hardware resources used in this example
@@ -157,7 +100,7 @@ void HAL_PCD_MspInit(PCD_HandleTypeDef *hpcd) {
             Error_Handler();
         }
 
-        __HAL_RCC_GPIOA_CLK_ENABLE();
+        acquire_gpio_clock(bank_a);
         /**USB_OTG_FS GPIO Configuration
         PA8     ------> USB_OTG_FS_SOF
         PA9     ------> USB_OTG_FS_VBUS
@@ -179,7 +122,7 @@ void HAL_PCD_MspInit(PCD_HandleTypeDef *hpcd) {
         HAL_GPIO_Init(USB_VBUS_GPIO_Port, &GPIO_InitStruct);
 
         /* Peripheral clock enable */
-        __HAL_RCC_USB_OTG_FS_CLK_ENABLE();
+        acquire_clock(USB_OTG_FS_EN);
         /* USER CODE BEGIN USB_OTG_FS_MspInit 1 */
 
         /* USER CODE END USB_OTG_FS_MspInit 1 */
@@ -198,7 +141,7 @@ void HAL_PCD_MspDeInit(PCD_HandleTypeDef *hpcd) {
 
         /* USER CODE END USB_OTG_FS_MspDeInit 0 */
         /* Peripheral clock disable */
-        __HAL_RCC_USB_OTG_FS_CLK_DISABLE();
+        release_clock(USB_OTG_FS_EN);
 
         /**USB_OTG_FS GPIO Configuration
         PA8     ------> USB_OTG_FS_SOF
@@ -209,6 +152,7 @@ void HAL_PCD_MspDeInit(PCD_HandleTypeDef *hpcd) {
         */
         HAL_GPIO_DeInit(GPIOA, USB_SOF_Pin | USB_VBUS_Pin | USB_ID_Pin |
                                    USB_DM_Pin | USB_DP_Pin);
+        release_gpio_clock(bank_a);
 
         /* USER CODE BEGIN USB_OTG_FS_MspDeInit 1 */
 
@@ -164,18 +164,7 @@ void PendSV_Handler(void) {
     /* USER CODE END PendSV_IRQn 1 */
 }
 
-/**
- * @brief This function handles System tick timer.
- */
-void SysTick_Handler(void) {
-    /* USER CODE BEGIN SysTick_IRQn 0 */
-
-    /* USER CODE END SysTick_IRQn 0 */
-    HAL_IncTick();
-    /* USER CODE BEGIN SysTick_IRQn 1 */
-
-    /* USER CODE END SysTick_IRQn 1 */
-}
+/* SysTick_Handler is in timers.c, when SysTick is the system tick */
 
 /******************************************************************************/
 /* STM32F4xx Peripheral Interrupt Handlers                                    */
@@ -10,7 +10,7 @@
 #include <assert.h>
 #include <stdint.h>
 
-#define RCC_BASE(n)    *(((uint32_t *)0x40023800) + n)
+#define RCC_BASE(n)    *(((volatile uint32_t *)0x40023800) + n)
 
 #define RCC_CR         0x0
 #define RCC_PLLCFGR    0x1
@@ -45,16 +45,24 @@
      INTERNAL_HIGH_SPEED_CLK | EXTERNAL_HIGH_SPEED_CLK | MAIN_PLL_CLK |        \
      I2S_PLL_CLK | SAI_PLL_CLK | CLOCK_SECURITY_SYSTEM)
 
-#define VALID_RCC_AHB1ENR_MASK 0x60641000UL
+#define VALID_RCC_AHB1ENR_MASK 0x606410FFUL
 #define VALID_RCC_AHB2ENR_MASK BIT7 | BIT0
 #define VALID_RCC_AHB3ENR_MASK BIT1 | BIT0
 #define VALID_RCC_APB1ENR_MASK 0x3FFFC9FFUL
 #define VALID_RCC_APB2ENR_MASK 0xC77F33UL
 
+#define VALID_RCC_AHB1RSTR_MASK 0x206010FFUL
+#define VALID_RCC_AHB2RSTR_MASK (BIT7 | BIT0)
+#define VALID_RCC_AHB3RSTR_MASK (BIT1 | BIT0)
+#define VALID_RCC_APB1RSTR_MASK 0x3FFFC9FFUL
+#define VALID_RCC_APB2RSTR_MASK 0xC77933UL
+
 #define INCREMENT_MASK         0xFFFE000
-#define MODULATION_MASK        0x1FFF
 
-#define MAX_RESET_ITERATIONS   10000
+/* HSE is the 8 MHz ST-LINK MCO in bypass */
+#define HSI_HZ                 16000000UL
+#define HSE_HZ                 8000000UL
+#define MODULATION_MASK        0x1FFF
 
 /* Clock control */
 void enable_PLL(uint32_t pll) {
@@ -293,591 +301,151 @@ uint32_t check_clock_interrupt(uint32_t mask) {
 }
 
 /* Peripheral reset */
-void reset_gpio_clock(gpio_bank_t bank, bool hold_reset) {
-    RCC_BASE(RCC_AHB1RSTR) |= 1 << (((uint32_t)bank) >> 8);
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_AHB1RSTR) &= ~(1 << (((uint32_t)bank) >> 8));
-}
-
-void reset_usb_otg_hs(bool hold_reset) {
-    RCC_BASE(RCC_AHB1RSTR) |= 1 << 29;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_AHB1RSTR) &= ~(1 << 29);
-}
-
-void reset_dma1(bool hold_reset) {
-    RCC_BASE(RCC_AHB1RSTR) |= 1 << 21;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_AHB1RSTR) &= ~(1 << 21);
-}
-
-void reset_dma2(bool hold_reset) {
-    RCC_BASE(RCC_AHB1RSTR) |= 1 << 22;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_AHB1RSTR) &= ~(1 << 22);
-}
-
-void reset_crc(bool hold_reset) {
-    RCC_BASE(RCC_AHB1RSTR) |= 1 << 12;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_AHB1RSTR) &= ~(1 << 12);
-}
-
-void reset_usb_otg_fs(bool hold_reset) {
-    RCC_BASE(RCC_AHB2RSTR) |= 1 << 7;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_AHB2RSTR) &= ~(1 << 7);
-}
-
-void reset_camera_interface(bool hold_reset) {
-    RCC_BASE(RCC_AHB2RSTR) |= 1;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_AHB2RSTR) &= ~1;
-}
-
-void reset_quad_spi(bool hold_reset) {
-    RCC_BASE(RCC_AHB3RSTR) |= 1 << 1;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_AHB3RSTR) &= ~(1 << 1);
-}
-
-void reset_flexible_memory_controller(bool hold_reset) {
-    RCC_BASE(RCC_AHB3RSTR) |= 1;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_AHB3RSTR) &= ~1;
-}
-
-void reset_dac(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 29;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 29);
-}
-
-void reset_pwr(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 28;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 28);
-}
-
-void reset_cec(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 27;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 27);
-}
-
-void reset_can2(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 26;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 26);
-}
-
-void reset_can1(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 25;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 25);
-}
-
-void reset_fmpi2c(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 24;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 24);
-}
-
-void reset_i2c3(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 23;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 23);
-}
-
-void reset_i2c2(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 22;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 22);
-}
-
-void reset_i2c1(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 21;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 21);
-}
-
-void reset_uart5(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 20;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 20);
-}
-
-void reset_uart4(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 19;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 19);
-}
-
-void reset_usart3(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 18;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 18);
-}
-
-void reset_usart2(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 17;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 17);
-}
-
-void reset_spdif_rx(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 16;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 16);
-}
-
-void reset_spi3(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 15;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 15);
-}
+static const uint32_t reset_offsets[RESET_REGISTERS] = {
+    RCC_AHB1RSTR, RCC_AHB2RSTR, RCC_AHB3RSTR, RCC_APB1RSTR, RCC_APB2RSTR};
 
-void reset_spi2(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 14;
+static const uint32_t valid_reset_masks[RESET_REGISTERS] = {
+    VALID_RCC_AHB1RSTR_MASK, VALID_RCC_AHB2RSTR_MASK, VALID_RCC_AHB3RSTR_MASK,
+    VALID_RCC_APB1RSTR_MASK, VALID_RCC_APB2RSTR_MASK};
 
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 14);
-}
-
-void reset_window_watchdog(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 11;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 11);
-}
-
-void reset_timer14(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 8;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 8);
-}
-
-void reset_timer13(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 7;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 7);
-}
-
-void reset_timer12(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 6;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 6);
-}
-
-void reset_timer7(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 5;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 5);
-}
-
-void reset_timer6(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 4;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 4);
-}
-
-void reset_timer5(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 3;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 3);
-}
-
-void reset_timer4(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 2;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 2);
-}
-
-void reset_timer3(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1 << 1;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~(1 << 1);
-}
-
-void reset_timer2(bool hold_reset) {
-    RCC_BASE(RCC_APB1RSTR) |= 1;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB1RSTR) &= ~1;
-}
-
-void reset_sai2(bool hold_reset) {
-    RCC_BASE(RCC_APB2RSTR) |= 1 << 23;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB2RSTR) &= ~(1 << 23);
-}
-
-void reset_sai1(bool hold_reset) {
-    RCC_BASE(RCC_APB2RSTR) |= 1 << 22;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB2RSTR) &= ~(1 << 22);
-}
-
-void reset_timer11(bool hold_reset) {
-    RCC_BASE(RCC_APB2RSTR) |= 1 << 18;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB2RSTR) &= ~(1 << 18);
-}
-
-void reset_timer10(bool hold_reset) {
-    RCC_BASE(RCC_APB2RSTR) |= 1 << 17;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB2RSTR) &= ~(1 << 17);
+/**
+ * @brief Core clocks per clock of the bus behind a reset register, from the
+ * prescalers currently in CFGR.
+ */
+static uint32_t bus_clock_divider(uint32_t reg) {
+    static const uint8_t ahb_shift[8] = {1, 2, 3, 4, 6, 7, 8, 9};
+    uint32_t cfgr = RCC_BASE(RCC_CFGR);
+    uint32_t hpre = (cfgr >> 4) & 0xF;
+    uint32_t ppre = 0;
+    uint32_t divider = (hpre & 0x8) ? 1UL << ahb_shift[hpre & 0x7] : 1;
+
+    if (reg == RESET_APB1) {
+        ppre = (cfgr >> 10) & 0x7;
+    } else if (reg == RESET_APB2) {
+        ppre = (cfgr >> 13) & 0x7;
+    }
+    if (ppre & 0x4) {
+        divider <<= (ppre & 0x3) + 1;
+    }
+    return divider;
 }
 
-void reset_timer9(bool hold_reset) {
-    RCC_BASE(RCC_APB2RSTR) |= 1 << 16;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB2RSTR) &= ~(1 << 16);
+/**
+ * @brief SYSCLK in Hz, worked out from the clock switch status and the main
+ * PLL settings rather than trusting a cached value.
+ */
+uint32_t read_sysclk_frequency(void) {
+    uint32_t pllcfgr = RCC_BASE(RCC_PLLCFGR);
+    uint32_t sws = (RCC_BASE(RCC_CFGR) >> 2) & 0x3;
+    uint32_t source = ((pllcfgr >> 22) & 0x1) ? HSE_HZ : HSI_HZ;
+    uint32_t m = pllcfgr & 0x3F;
+    uint32_t n = (pllcfgr >> 6) & 0x1FF;
+    uint32_t divider;
+
+    if (sws == 0) {
+        return HSI_HZ;
+    }
+    if (sws == 1) {
+        return HSE_HZ;
+    }
+    /* PLL_P, or PLL_R on the F446 */
+    divider = (sws == 2) ? (((pllcfgr >> 16) & 0x3) + 1) * 2
+                         : (pllcfgr >> 28) & 0x7;
+    if (!m || !divider) {
+        return 0;
+    }
+    return (uint32_t)((uint64_t)source * n / m / divider);
 }
 
-void reset_sys_config(bool hold_reset) {
-    RCC_BASE(RCC_APB2RSTR) |= 1 << 14;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB2RSTR) &= ~(1 << 14);
+/**
+ * @brief Clock in Hz of the bus behind a register of the *_EN macros, e.g.
+ * RESET_APB1 for PCLK1.
+ */
+uint32_t read_bus_frequency(uint32_t reg) {
+    assert(reg < RESET_REGISTERS);
+    return read_sysclk_frequency() / bus_clock_divider(reg);
 }
 
-void reset_spi4(bool hold_reset) {
-    RCC_BASE(RCC_APB2RSTR) |= 1 << 13;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB2RSTR) &= ~(1 << 13);
+/**
+ * @brief Waits at least the given number of core clocks. Every iteration
+ * takes more than one, so this never comes up short.
+ */
+static void hold_reset_cycles(uint32_t cycles) {
+    for (uint32_t i = 0; i < cycles; i++) {
+        __asm volatile("nop");
+    }
 }
 
-void reset_spi1(bool hold_reset) {
-    RCC_BASE(RCC_APB2RSTR) |= 1 << 12;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
+static void collect_resets(const peripheral_reset_t peripherals[], uint8_t n,
+                           uint32_t masks[RESET_REGISTERS]) {
+    for (uint32_t reg = 0; reg < RESET_REGISTERS; reg++) {
+        masks[reg] = 0;
+    }
+    for (uint8_t i = 0; i < n; i++) {
+        uint32_t reg = RESET_REGISTER(peripherals[i]);
+        uint32_t mask = 1UL << RESET_BIT(peripherals[i]);
 
-    RCC_BASE(RCC_APB2RSTR) &= ~(1 << 12);
+        assert(reg < RESET_REGISTERS && (mask & valid_reset_masks[reg]));
+        masks[reg] |= mask;
+    }
 }
 
-void reset_sdio(bool hold_reset) {
-    RCC_BASE(RCC_APB2RSTR) |= 1 << 11;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB2RSTR) &= ~(1 << 11);
+static void release_resets(const uint32_t masks[RESET_REGISTERS]) {
+    for (uint32_t reg = 0; reg < RESET_REGISTERS; reg++) {
+        if (masks[reg]) {
+            RCC_BASE(reset_offsets[reg]) &= ~masks[reg];
+        }
+    }
 }
 
-void reset_adc(bool hold_reset) {
-    RCC_BASE(RCC_APB2RSTR) |= 1 << 8;
-
-    if (hold_reset)
-        return;
+/**
+ * @brief Puts every listed peripheral in reset with one write per reset
+ * register. Unless hold_reset is set they are released together once the
+ * slowest bus involved has seen RESET_HOLD_BUS_CYCLES clocks.
+ */
+void reset_peripherals(const peripheral_reset_t peripherals[], uint8_t n,
+                       bool hold_reset) {
+    uint32_t masks[RESET_REGISTERS];
+    uint32_t divider = 0;
 
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
+    collect_resets(peripherals, n, masks);
 
-    RCC_BASE(RCC_APB2RSTR) &= ~(1 << 8);
-}
+    for (uint32_t reg = 0; reg < RESET_REGISTERS; reg++) {
+        uint32_t bus_divider;
 
-void reset_usart6(bool hold_reset) {
-    RCC_BASE(RCC_APB2RSTR) |= 1 << 5;
+        if (!masks[reg]) {
+            continue;
+        }
+        RCC_BASE(reset_offsets[reg]) |= masks[reg];
+        bus_divider = bus_clock_divider(reg);
+        if (bus_divider > divider) {
+            divider = bus_divider;
+        }
+    }
 
     if (hold_reset)
         return;
 
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB2RSTR) &= ~(1 << 5);
+    /* The read back makes sure the writes reached the RCC */
+    (void)RCC_BASE(RCC_CFGR);
+    hold_reset_cycles(RESET_HOLD_BUS_CYCLES * divider);
+    release_resets(masks);
 }
 
-void reset_usart1(bool hold_reset) {
-    RCC_BASE(RCC_APB2RSTR) |= 1 << 4;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
+void release_peripheral_resets(const peripheral_reset_t peripherals[],
+                               uint8_t n) {
+    uint32_t masks[RESET_REGISTERS];
 
-    RCC_BASE(RCC_APB2RSTR) &= ~(1 << 4);
+    collect_resets(peripherals, n, masks);
+    release_resets(masks);
 }
 
-void reset_timer8(bool hold_reset) {
-    RCC_BASE(RCC_APB2RSTR) |= 1 << 1;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB2RSTR) &= ~(1 << 1);
+void reset_peripheral(peripheral_reset_t peripheral, bool hold_reset) {
+    reset_peripherals(&peripheral, 1, hold_reset);
 }
 
-void reset_timer1(bool hold_reset) {
-    RCC_BASE(RCC_APB2RSTR) |= 1;
-
-    if (hold_reset)
-        return;
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
-
-    RCC_BASE(RCC_APB2RSTR) &= ~1;
+void release_peripheral_reset(peripheral_reset_t peripheral) {
+    release_peripheral_resets(&peripheral, 1);
 }
 
 /* Peripheral clock enable */
@@ -995,6 +563,15 @@ bool check_peripheral_clock(uint32_t reg, uint32_t peripheral) {
     return (RCC_BASE(offset) & peripheral) != 0;
 }
 
+uint32_t read_peripheral_clocks(uint32_t reg) {
+    static const uint32_t offsets[] = {RCC_AHB1ENR, RCC_AHB2ENR, RCC_AHB3ENR,
+                                       RCC_APB1ENR, RCC_APB2ENR};
+
+    assert(reg < sizeof(offsets) / sizeof(offsets[0]));
+
+    return RCC_BASE(offsets[reg]);
+}
+
 void enable_peripheral_low_power_clock(uint32_t reg, uint32_t peripheral) {
     uint32_t valid_mask, offset;
 
@@ -1105,8 +682,8 @@ void reset_backup_domain(bool hold_reset) {
     if (hold_reset)
         return;
 
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
+    (void)RCC_BASE(RCC_BDCR);
+    hold_reset_cycles(RESET_HOLD_BUS_CYCLES * bus_clock_divider(RESET_APB1));
 
     RCC_BASE(RCC_BDCR) &= ~UPPER16BITS(BIT0);
 }
@@ -1170,9 +747,7 @@ bool check_clock_flag(uint32_t clk_flag) {
 
 void clear_clock_flags(void) {
     RCC_BASE(RCC_CSR) |= UPPER16BITS(BIT8);
-
-    for (uint32_t i = 0; i < MAX_RESET_ITERATIONS; i++)
-        ;
+    (void)RCC_BASE(RCC_CSR);
 
     RCC_BASE(RCC_CSR) &= ~UPPER16BITS(BIT8);
 }
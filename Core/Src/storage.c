@@ -0,0 +1,318 @@
+/*
+ * storage.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Log structured key value store in flash sectors 2 and 3 (reserved in the
+ * linker script). Each sector starts with a header {generation, magic} and is
+ * followed by 8 byte records {value, key, crc}. A record is appended for every
+ * change, so the newest record of a key wins. When the active sector fills up
+ * the live values are copied to the other sector (with a higher generation)
+ * and the old one is erased later.
+ *
+ * The F446 has a single flash bank, so while a sector erase runs every fetch
+ * from flash stalls: the main loop and any interrupt handler not in
+ * .fastcode stop for the whole erase (hundreds of ms for these 16 KB
+ * sectors), and ticks that come due meanwhile are merged into one. Erases
+ * therefore only start while storage_allow_erase() says the game can take
+ * the stall. Programming a word stalls for tens of us only.
+ *
+ * The value word is programmed before the key/crc word, so a record torn by a
+ * reset fails its crc and is skipped. The header magic is programmed after
+ * the generation for the same reason.
+ */
+
+#include "storage.h"
+#include "productDef.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define KV_NUM_SECTORS    2
+#define KV_SECTOR_SIZE    0x4000UL
+#define KV_SECTOR_ADDR(n) (0x08008000UL + ((n) * KV_SECTOR_SIZE))
+#define KV_SECTOR_END(n)  (KV_SECTOR_ADDR(n) + KV_SECTOR_SIZE)
+#define KV_WORD(addr)     *((volatile uint32_t *)(addr))
+
+#define KV_MAGIC          0x4B565331UL
+#define KV_ERASED         0xFFFFFFFFUL
+#define KV_HEADER_SIZE    8
+#define KV_RECORD_SIZE    8
+#define KV_NO_SECTOR      -1
+
+#define CRC16_INIT        0xFFFF
+#define CRC16_POLY        0x1021
+
+#define FLASH_ERRORS                                                           \
+    (FLASH_FLAG_OPERR | FLASH_FLAG_WRPERR | FLASH_FLAG_PGAERR |               \
+     FLASH_FLAG_PGPERR | FLASH_FLAG_PGSERR)
+
+static const uint32_t kv_sector_number[KV_NUM_SECTORS] = {FLASH_SECTOR_2,
+                                                          FLASH_SECTOR_3};
+
+static uint32_t values[NUM_STORAGE_KEYS];
+static uint32_t valid_keys = 0;
+static uint32_t dirty_keys = 0;
+
+static int8_t active = 0;
+static uint32_t generation = 0;
+static uint32_t write_addr = 0;
+static int8_t erase_pending = KV_NO_SECTOR;
+static bool erasing = false;
+static bool erase_allowed = false;
+static bool formatted = false;
+
+static uint16_t crc16(uint16_t key, uint32_t value) {
+    uint8_t bytes[6] = {key & 0xFF,           key >> 8,
+                        value & 0xFF,         (value >> 8) & 0xFF,
+                        (value >> 16) & 0xFF, value >> 24};
+    uint16_t crc = CRC16_INIT;
+
+    for (uint32_t i = 0; i < sizeof(bytes); i++) {
+        crc ^= (uint16_t)bytes[i] << 8;
+        for (uint32_t bit = 0; bit < 8; bit++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ CRC16_POLY : crc << 1;
+        }
+    }
+    return crc;
+}
+
+static bool sector_formatted(int8_t sector) {
+    return KV_WORD(KV_SECTOR_ADDR(sector) + 4) == KV_MAGIC;
+}
+
+static uint32_t sector_generation(int8_t sector) {
+    return KV_WORD(KV_SECTOR_ADDR(sector));
+}
+
+static bool sector_blank(int8_t sector) {
+    for (uint32_t addr = KV_SECTOR_ADDR(sector); addr < KV_SECTOR_END(sector);
+         addr += 4) {
+        if (KV_WORD(addr) != KV_ERASED) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * @brief Loads every valid record of a sector into the RAM index and returns
+ * the address of the first free slot.
+ */
+static uint32_t load_sector(int8_t sector) {
+    uint32_t addr = KV_SECTOR_ADDR(sector) + KV_HEADER_SIZE;
+
+    for (; addr < KV_SECTOR_END(sector); addr += KV_RECORD_SIZE) {
+        uint32_t value = KV_WORD(addr);
+        uint32_t header = KV_WORD(addr + 4);
+        uint16_t key = header & 0xFFFF;
+
+        if (value == KV_ERASED && header == KV_ERASED) {
+            break;
+        }
+        if (key >= NUM_STORAGE_KEYS || (header >> 16) != crc16(key, value)) {
+            continue;
+        }
+        values[key] = value;
+        valid_keys |= 1UL << key;
+    }
+    return addr;
+}
+
+static bool program_word(uint32_t addr, uint32_t data) {
+    HAL_StatusTypeDef status;
+
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_ERRORS);
+    status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, addr, data);
+    HAL_FLASH_Lock();
+    return status == HAL_OK;
+}
+
+/**
+ * @brief Starts a sector erase. The next flash fetch, normally the return
+ * from this function, stalls until the erase is done.
+ */
+static void start_erase(int8_t sector) {
+    HAL_FLASH_Unlock();
+    __HAL_FLASH_CLEAR_FLAG(FLASH_ERRORS);
+    FLASH_Erase_Sector(kv_sector_number[sector], FLASH_VOLTAGE_RANGE_3);
+    erasing = true;
+}
+
+static bool erase_busy(void) {
+    return __HAL_FLASH_GET_FLAG(FLASH_FLAG_BSY);
+}
+
+static void finish_erase(void) {
+    CLEAR_BIT(FLASH->CR, (FLASH_CR_SER | FLASH_CR_SNB));
+    HAL_FLASH_Lock();
+
+    /* Drop stale lines of the erased sector from the data cache */
+    __HAL_FLASH_DATA_CACHE_DISABLE();
+    __HAL_FLASH_DATA_CACHE_RESET();
+    __HAL_FLASH_DATA_CACHE_ENABLE();
+    erasing = false;
+}
+
+static bool write_header(int8_t sector, uint32_t gen) {
+    uint32_t addr = KV_SECTOR_ADDR(sector);
+
+    if (!program_word(addr, gen) || !program_word(addr + 4, KV_MAGIC)) {
+        return false;
+    }
+    active = sector;
+    generation = gen;
+    write_addr = addr + KV_HEADER_SIZE;
+    return true;
+}
+
+static void write_record(storage_key_t key) {
+    uint32_t addr = write_addr;
+    uint32_t value = values[key];
+    uint32_t header = ((uint32_t)crc16(key, value) << 16) | key;
+
+    /* A failed slot is left behind, the crc rejects it on the next boot */
+    write_addr += KV_RECORD_SIZE;
+    if (program_word(addr, value) && program_word(addr + 4, header)) {
+        dirty_keys &= ~(1UL << key);
+    }
+}
+
+static storage_key_t next_dirty_key(void) {
+    return (storage_key_t)__builtin_ctz(dirty_keys);
+}
+
+void init_storage(void) {
+    bool ok0 = sector_formatted(0), ok1 = sector_formatted(1);
+    int8_t older, newer;
+
+    if (!ok0 && !ok1) {
+        active = 0;
+        generation = 0;
+        formatted = false;
+        return;
+    }
+
+    if (ok0 && ok1) {
+        /* A compaction was interrupted. Merge both and finish it. */
+        newer = (sector_generation(1) > sector_generation(0)) ? 1 : 0;
+        older = !newer;
+        load_sector(older);
+        write_addr = load_sector(newer);
+        dirty_keys = valid_keys;
+        erase_pending = older;
+    } else {
+        newer = ok0 ? 0 : 1;
+        write_addr = load_sector(newer);
+    }
+    active = newer;
+    generation = sector_generation(newer);
+    formatted = true;
+}
+
+bool storage_get(storage_key_t key, uint32_t *value) {
+    assert(key < NUM_STORAGE_KEYS);
+
+    if (!(valid_keys & (1UL << key))) {
+        return false;
+    }
+    *value = values[key];
+    return true;
+}
+
+uint32_t storage_get_or(storage_key_t key, uint32_t fallback) {
+    uint32_t value;
+    return storage_get(key, &value) ? value : fallback;
+}
+
+/**
+ * @brief Updates the RAM index. The record is written by storage_service().
+ */
+void storage_set(storage_key_t key, uint32_t value) {
+    assert(key < NUM_STORAGE_KEYS);
+
+    if ((valid_keys & (1UL << key)) && values[key] == value) {
+        return;
+    }
+    values[key] = value;
+    valid_keys |= 1UL << key;
+    dirty_keys |= 1UL << key;
+}
+
+/**
+ * @brief Whether an erase, and the stall that comes with it, is acceptable
+ * right now. Records are still written while erases are held back.
+ */
+void storage_allow_erase(bool allow) {
+    erase_allowed = allow;
+}
+
+/**
+ * @brief Does at most one flash operation per call. Meant for the lowest
+ * priority slot of the main loop.
+ */
+void storage_service(void) {
+    int8_t old = active, other = !active;
+
+    if (erasing) {
+        if (!erase_busy()) {
+            finish_erase();
+        }
+        return;
+    }
+
+    if (!formatted) {
+        if (!sector_blank(active)) {
+            if (erase_allowed) {
+                start_erase(active);
+            }
+        } else {
+            formatted = write_header(active, generation + 1);
+        }
+        return;
+    }
+
+    if (dirty_keys) {
+        if (write_addr >= KV_SECTOR_END(active)) {
+            /* Compact into the other sector */
+            if (!sector_blank(other)) {
+                if (erase_allowed) {
+                    start_erase(other);
+                }
+            } else if (write_header(other, generation + 1)) {
+                erase_pending = old;
+                dirty_keys = valid_keys;
+            }
+            return;
+        }
+        write_record(next_dirty_key());
+        return;
+    }
+
+    /* Only once every live value is in the active sector */
+    if (erase_pending != KV_NO_SECTOR && erase_allowed) {
+        start_erase(erase_pending);
+        erase_pending = KV_NO_SECTOR;
+    }
+}
+
+/**
+ * @brief Blocking write of pending records, used right before a reset. Does
+ * not compact, so records that do not fit are dropped. Thread mode only, it
+ * must not interrupt storage_service().
+ */
+void storage_flush(void) {
+    if (erasing) {
+        while (erase_busy()) {
+        }
+        finish_erase();
+    }
+    if (!formatted) {
+        return;
+    }
+    while (dirty_keys && write_addr < KV_SECTOR_END(active)) {
+        write_record(next_dirty_key());
+    }
+}
@@ -0,0 +1,104 @@
+/*
+ * sysclock.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ */
+
+#include "sysclock.h"
+#include "clock_gate.h"
+#include "productDef.h"
+#include "stm_rcc.h"
+#include "stm_utils.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#define PWR_REGISTER(n)   *(((uint32_t *)0x40007000) + n)
+#define PWR_CR            0
+#define PWR_VOS_SCALE1    (BITF | BITE)
+
+#define FLASH_REGISTER(n) *(((uint32_t *)0x40023C00) + n)
+#define FLASH_ACR         0
+#define FLASH_LATENCY_MSK (BIT3 | BIT2 | BIT1 | BIT0)
+#define FLASH_WAIT_STATES 5
+
+#define HPRE_DIV1         0x0
+#define PPRE_DIV2         0x4
+#define PPRE_DIV4         0x5
+#define SW_PLL            0x2
+#define SWS_MASK          (BIT3 | BIT2)
+#define SWS_PLL           BIT3
+
+// 8 MHz HSE bypass / 4 * 168 / 2 = 168 MHz, 48 MHz for USB from Q = 7
+static const pll_config_t main_pll = {.PLLM = 4 | ENABLE_PLL,
+                                      .PLLN = 168 | ENABLE_PLL,
+                                      .PLLP = 0 | ENABLE_PLL,
+                                      .PLLQ = 7 | ENABLE_PLL,
+                                      .PLLR = 2 | ENABLE_PLL,
+                                      .PLLSRC = 1 | ENABLE_PLL};
+
+/**
+ * @brief Brings up HSE and starts the main PLL without waiting for it to lock,
+ * so the caller can do clock independent setup in the meantime.
+ */
+void start_system_clock(void) {
+    acquire_clock(PWR_EN);
+    PWR_REGISTER(PWR_CR) |= PWR_VOS_SCALE1;
+
+    bypass_hse_oscillator(true);
+    update_hse_status(true);
+    while (!hse_ready())
+        ;
+
+    configure_main_pll(main_pll);
+    enable_PLL(MAIN_PLL);
+}
+
+bool system_clock_locked(void) {
+    return check_PLL_locked(MAIN_PLL);
+}
+
+/**
+ * @brief Waits for the PLL started by start_system_clock() and switches
+ * SYSCLK over to it (HCLK 168 MHz, PCLK1 42 MHz, PCLK2 84 MHz).
+ */
+void finish_system_clock(void) {
+    while (!check_PLL_locked(MAIN_PLL))
+        ;
+
+    // Wait states must go up before the clock does
+    FLASH_REGISTER(FLASH_ACR) =
+        (FLASH_REGISTER(FLASH_ACR) & ~FLASH_LATENCY_MSK) | FLASH_WAIT_STATES;
+    while ((FLASH_REGISTER(FLASH_ACR) & FLASH_LATENCY_MSK) !=
+           FLASH_WAIT_STATES)
+        ;
+
+    update_PPRE1(PPRE_DIV4);
+    update_PPRE2(PPRE_DIV2);
+    update_HPRE(HPRE_DIV1);
+    update_SW(SW_PLL);
+    while (read_clk_configs(SWS_MASK) != SWS_PLL)
+        ;
+
+    /* The system tick is started later, from the final HCLK */
+    SystemCoreClockUpdate();
+}
+
+/**
+ * @brief Brings SYSCLK back to the PLL after STOP mode, which leaves the core
+ * on HSI with HSE and the PLL off. The PLL configuration, bus prescalers and
+ * flash wait states are retained.
+ */
+void restore_system_clock(void) {
+    update_hse_status(true);
+    while (!hse_ready())
+        ;
+
+    enable_PLL(MAIN_PLL);
+    while (!check_PLL_locked(MAIN_PLL))
+        ;
+
+    update_SW(SW_PLL);
+    while (read_clk_configs(SWS_MASK) != SWS_PLL)
+        ;
+}
@@ -6,6 +6,7 @@
  */
 
 #include "sysconfig.h"
+#include "clock_gate.h"
 #include "stm_rcc.h"
 #include "stm_utils.h"
 #include <assert.h>
@@ -42,7 +43,15 @@ static void configure_exti_source(gpio_bank_t bank, uint8_t pin) {
 }
 
 void start_sysconfig(void) {
-    enable_peripheral_clock(SYSCONFIG_EN);
+    acquire_clock(SYSCONFIG_EN);
+}
+
+/**
+ * @brief The EXTI source selection is kept while the clock is gated, so it
+ * only needs to run while the registers are accessed.
+ */
+void stop_sysconfig(void) {
+    release_clock(SYSCONFIG_EN);
 }
 
 void configure_exti_line(exti_select_t config) {
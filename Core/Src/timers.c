@@ -9,67 +9,222 @@
 #include "core_m4.h"
 #include "general_timers.h"
 #include "gpio.h"
+#include "motor_pwm.h"
 #include "productDef.h"
+#include "sched.h"
+#include "storage.h"
+#include "trace.h"
 #include <stdbool.h>
 #include <stdint.h>
 
 #define WATCHDOG_RESET 30000
+/* Ticks the main loop gets to flush storage once the watchdog expired */
+#define WATCHDOG_GRACE 100
 
-const general_timer_attr_t tim2 = {.autoReload = true,
+#if SYSTEM_TICK_SOURCE == TICK_SOURCE_TIM2
+/* TIM2 counts in us, the timer clock is HCLK / 2 */
+#define TICK_PRESCALER        83
+#define TICK_CYCLES_PER_COUNT ((TICK_PRESCALER + 1) * 2)
+#define TICK_MAX_COUNTS       0x80000000UL
+#else
+/* SysTick counts HCLK cycles in 24 bits */
+#define TICK_CYCLES_PER_COUNT 1
+#define TICK_MAX_COUNTS       0x01000000UL
+#endif
+
+/* Shortest one off period, so the interrupt cannot be missed */
+#define TICK_MIN_COUNTS       2
+
+#if SYSTEM_TICK_SOURCE == TICK_SOURCE_TIM2
+/* No preload, so a new period takes effect right away */
+const general_timer_attr_t tim2 = {.autoReload = false,
                                    .direction = UP_COUNTER,
-                                   .prescaler = 899,
-                                   .auto_reload_value = 93,
+                                   .prescaler = TICK_PRESCALER,
+                                   .auto_reload_value =
+                                       1000000UL / SYSTEM_TICK_HZ - 1,
                                    .enableAfterConfig = false,
                                    .interruptEnableMask = UIE};
 
+const irq_info_t tim2_irq = {INT_NUM_TIM2, HEARTBEAT_PRIORITY};
+#endif
+
 const outputCompareMode_t outCompare = {.outputCompareMode = COMPARE_PWM_MODE_1,
                                         .captureCompareSelection = 0,
                                         .compareValue = 0,
                                         .outputComparePreloadEnable = true};
 
+/* 20 kHz PWM on CH3, update DMA bursts one transfer into CCR3 */
 const general_timer_attr_t tim3 = {.autoReload = true,
                                    .direction = UP_COUNTER,
-                                   .prescaler = 99,
-                                   .auto_reload_value = 30,
-                                   .enableAfterConfig = true,
+                                   .prescaler = 0,
+                                   .auto_reload_value = PWM_PERIOD - 1,
                                    .compare3 = outCompare,
                                    .ccMode3 = COMPARE_MODE,
-                                   .enableAfterConfig = true};
+                                   .interruptEnableMask = UDE,
+                                   .dmaBaseAddr = TIM_DMA_BASE_CCR3,
+                                   .dmaBurstLength = 0,
+                                   .enableAfterConfig = false};
 
+/* 10 kHz motor control loop */
 const general_timer_attr_t tim4 = {.autoReload = true,
                                    .direction = UP_COUNTER,
-                                   .prescaler = 8999,
-                                   .auto_reload_value = 65000,
-                                   .enableAfterConfig = true};
+                                   .prescaler = 0,
+                                   .auto_reload_value = 8399,
+                                   .enableAfterConfig = false,
+                                   .interruptEnableMask = UIE};
 
-const irq_info_t tim2_irq = {INT_NUM_TIM2, HEARTBEAT_PRIORITY};
+const irq_info_t tim4_irq = {INT_NUM_TIM4, MOTOR_CONTROL_PRIORITY};
 
 static volatile uint16_t watchdog_count = WATCHDOG_RESET;
+static volatile bool watchdog_expired = false;
+static uint32_t watchdog_grace = WATCHDOG_GRACE;
 static bool allow_dog_kicking = true;
 static bool measure = false;
 static volatile uint32_t measurement = 0;
 static volatile uint32_t timems = 0;
 
-void TIM2_IRQHandler(void) {
-    if (checkTimerStatus(TIMER2, UIF)) {
-        gEvents |= E_HEARTBEAT;
-        watchdog_count--;
-        timems++;
+/* Counts per tick, and of the period running now */
+static uint32_t tick_counts = 0;
+static uint32_t period_counts = 0;
+/* Ticks the next interrupt stands for, more than one while suppressed */
+static volatile uint32_t next_ticks = 1;
+static uint32_t tickless_limit = 1;
+
+#if SYSTEM_TICK_SOURCE == TICK_SOURCE_TIM2
+static uint32_t counts_left(void) {
+    return period_counts - getCounterValue32(TIMER2);
+}
+
+static bool tick_pending(void) {
+    return checkTimerStatus(TIMER2, UIF);
+}
+
+/**
+ * @brief Restarts the count so the next interrupt comes after counts, the
+ * tick handler goes back to the normal period.
+ */
+static void set_next_tick(uint32_t counts) {
+    setCounterValue32(TIMER2, 0);
+    setAutoReload32(TIMER2, counts - 1);
+    period_counts = counts;
+}
+
+static void restore_period(void) {
+    setAutoReload32(TIMER2, tick_counts - 1);
+    period_counts = tick_counts;
+}
+
+static void start_tick_source(void) {
+    tick_counts = tim2.auto_reload_value + 1;
+    period_counts = tick_counts;
+    configure_interrupt(tim2_irq);
+    configureGeneralTimer(TIMER2, tim2);
+    enableTimer(TIMER2);
+}
+#else
+static uint32_t counts_left(void) {
+    return SysTick->VAL;
+}
+
+static bool tick_pending(void) {
+    return (SCB->ICSR & SCB_ICSR_PENDSTSET_Msk) != 0;
+}
+
+static void set_next_tick(uint32_t counts) {
+    SysTick->LOAD = counts - 1;
+    SysTick->VAL = 0;
+    period_counts = counts;
+}
+
+/* Writing VAL restarts the count, what ran since the wrap is lost */
+static void restore_period(void) {
+    set_next_tick(tick_counts);
+}
+
+static void start_tick_source(void) {
+    tick_counts = SystemCoreClock / SYSTEM_TICK_HZ;
+    set_next_tick(tick_counts);
+    NVIC_SetPriority(SysTick_IRQn, HEARTBEAT_PRIORITY);
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk |
+                    SysTick_CTRL_ENABLE_Msk;
+}
+#endif
+
+/**
+ * @brief Everything that runs on time: the HAL tick, the time base, the
+ * heartbeat event and the watchdog. ticks is more than one after a
+ * suppressed stretch.
+ */
+FASTCODE static void system_tick(uint32_t ticks) {
+    TRACE(TRACE_TICK, ticks);
+    sched_post(E_HEARTBEAT);
+    timems += ticks;
+    for (uint32_t i = 0; i < ticks; i++) {
+        HAL_IncTick();
     }
-    if (!watchdog_count) {
+
+    if (watchdog_count > ticks) {
+        watchdog_count -= ticks;
+        return;
+    }
+    watchdog_count = 0;
+    if (!watchdog_expired) {
+        /* watchdog_service() flushes and resets from the main loop */
+        watchdog_expired = true;
+    } else if (watchdog_grace <= ticks) {
+        /* The main loop is stuck, reset without saving */
         reset_system();
+    } else {
+        watchdog_grace -= ticks;
+    }
+}
+
+FASTCODE static void tick_interrupt(void) {
+    uint32_t ticks = next_ticks;
+
+    if (period_counts != tick_counts) {
+        restore_period();
+        next_ticks = 1;
+    }
+    system_tick(ticks);
+}
+
+#if SYSTEM_TICK_SOURCE == TICK_SOURCE_TIM2
+FASTCODE void TIM2_IRQHandler(void) {
+    ISR_PROFILE_ENTER();
+    if (checkTimerStatus(TIMER2, UIF)) {
+        tick_interrupt();
     }
 
     // Clear erroneous status
     clearTimerStatusRegister(TIMER2);
+    ISR_PROFILE_EXIT(PROFILE_TICK);
+}
+#else
+FASTCODE void SysTick_Handler(void) {
+    ISR_PROFILE_ENTER();
+    tick_interrupt();
+    ISR_PROFILE_EXIT(PROFILE_TICK);
+}
+#endif
+
+/**
+ * @brief The HAL would start SysTick from HAL_Init() and again on every clock
+ * change. Its tick comes from system_tick() instead, so leave it alone.
+ */
+HAL_StatusTypeDef HAL_InitTick(uint32_t TickPriority) {
+    (void)TickPriority;
+    return HAL_OK;
 }
 
-void init_heartbeat(void) {
-    // Configure Heart beat
+/**
+ * @brief Starts the system tick. SysTick runs from HCLK, so this comes after
+ * finish_system_clock().
+ */
+void init_system_tick(void) {
     timems = 0;
-    configure_interrupt(tim2_irq);
-    configureGeneralTimer(TIMER2, tim2);
-    enableTimer(TIMER2);
+    next_ticks = 1;
+    start_tick_source();
 }
 
 void kick_the_watchdog(void) {
@@ -80,8 +235,115 @@ void kick_the_watchdog(void) {
     enable_global_irq();
 }
 
+/**
+ * @brief Resets once the watchdog expired. Flash writes cannot run from the
+ * tick interrupt, so this is in the background slot of the main loop.
+ */
+void watchdog_service(void) {
+    if (watchdog_expired) {
+        /* Keep the scores the reset would otherwise lose */
+        storage_flush();
+        reset_system();
+    }
+}
+
+/**
+ * @brief Most ticks idle may merge into one interrupt, 1 keeps every tick.
+ * Whoever owns the heartbeat decides, it sees fewer of them while suppressed.
+ */
+void set_tickless_limit(uint32_t ticks) {
+    if (!SYSTEM_TICKLESS || !ticks) {
+        ticks = 1;
+    }
+    tickless_limit = ticks;
+}
+
+/**
+ * @brief Called by idle with interrupts masked. Pushes the next tick out by
+ * up to the tickless limit and returns the CPU cycles until it.
+ */
+uint32_t suppress_ticks(void) {
+    uint32_t left = counts_left();
+    uint32_t extra;
+
+    if (tickless_limit > 1 && next_ticks == 1 && !tick_pending()) {
+        extra = (tickless_limit - 1) * tick_counts;
+        if (left + extra <= TICK_MAX_COUNTS && left >= TICK_MIN_COUNTS) {
+            left += extra;
+            next_ticks = tickless_limit;
+            set_next_tick(left);
+        }
+    }
+    return left * TICK_CYCLES_PER_COUNT;
+}
+
+/**
+ * @brief Called by idle with interrupts masked after waking up. An interrupt
+ * other than the tick may have ended a suppressed stretch early, the ticks
+ * that passed are accounted for now and the normal period resumes in phase.
+ */
+void resume_ticks(void) {
+    uint32_t left, outstanding;
+
+    if (next_ticks == 1 || tick_pending()) {
+        /* The tick interrupt accounts for the whole stretch */
+        return;
+    }
+
+    left = counts_left();
+    outstanding = (left + tick_counts - 1) / tick_counts;
+    left -= (outstanding - 1) * tick_counts;
+    if (left < TICK_MIN_COUNTS) {
+        left = TICK_MIN_COUNTS;
+    }
+    if (next_ticks > outstanding) {
+        system_tick(next_ticks - outstanding);
+    }
+    next_ticks = 1;
+    set_next_tick(left);
+}
+
+/**
+ * @brief Moves the tick forward by time it spent stopped (STOP mode), without
+ * skipping the next tick interrupt.
+ */
+void advance_ticks(uint32_t cycles) {
+    uint32_t left = counts_left();
+    uint32_t counts = cycles / TICK_CYCLES_PER_COUNT;
+
+    if (counts + TICK_MIN_COUNTS >= left) {
+        counts = (left > TICK_MIN_COUNTS) ? left - TICK_MIN_COUNTS : 0;
+    }
+    if (counts) {
+        set_next_tick(left - counts);
+    }
+}
+
+/**
+ * @brief CPU cycles into the current tick period, one period more if it
+ * already ended and the tick interrupt is held off by masked interrupts.
+ * Times sleeps, the cycle counter stops during WFI.
+ */
+uint32_t read_tick_cycles(void) {
+    uint32_t counts;
+    bool pending;
+
+    do {
+        pending = tick_pending();
+        counts = period_counts - counts_left();
+    } while (pending != tick_pending());
+
+    if (pending) {
+        counts += period_counts;
+    }
+    return counts * TICK_CYCLES_PER_COUNT;
+}
+
+/**
+ * @brief Counts into the current tick period.
+ */
 uint32_t read_heartbeat(void) {
-    return (uint32_t)getCounterValue(TIMER2);
+    return period_counts - counts_left();
 }
 
 void start_measurement(void) {
@@ -91,7 +353,7 @@ void start_measurement(void) {
     enable_global_irq();
 }
 
-void stop_measurement(void) {
+FASTCODE void stop_measurement(void) {
     disable_global_irq();
     measurement = timems - measurement;
     measure = false;
@@ -108,8 +370,12 @@ uint32_t current_ts(void) {
 
 void init_motor_timer(void) {
     configureGeneralTimer(TIMER3, tim3);
+    enableCaptureCompareChannel(TIMER3, 3);
+    enableTimer(TIMER3);
 }
 
 void init_pid_timer(void) {
+    configure_interrupt(tim4_irq);
     configureGeneralTimer(TIMER4, tim4);
+    enableTimer(TIMER4);
 }
@@ -0,0 +1,156 @@
+/*
+ * trace.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Circular trace of 8 byte records. Each record stores the cycle counter
+ * delta to the previous one, so consecutive records must be less than
+ * 2^32 cycles (~25 s) apart; the 1 ms heartbeat guarantees that.
+ *
+ * trace_dump() freezes the buffer and trace_service() prints it a few lines
+ * per main loop pass, oldest first, to the console or the USB CDC port:
+ *
+ *   # trace <cpu hz> <records>
+ *   # <id> <name>            (once per id)
+ *   <delta> <id> <payload>   (one per record)
+ *
+ * which tools/trace2chrome.py accumulates into absolute times for a Chrome
+ * trace.
+ */
+
+#include "trace.h"
+#include "core_m4.h"
+#include "productDef.h"
+#include "stdio.h"
+#include "usb_cdc.h"
+#include <stdbool.h>
+#include <stdint.h>
+
+#if TRACE_ENABLE
+
+#define TRACE_MASK       (TRACE_BUFFER_SIZE - 1)
+
+/* Lines printed per trace_service() call */
+#define TRACE_DUMP_BATCH 8
+/* Ahead of the records, "# trace" and one per id */
+#define TRACE_HEADER_LINES (1 + NUM_TRACE_IDS)
+
+static const char *const trace_names[NUM_TRACE_IDS] = {
+    "tick", "EXTI9_5", "EXTI15_10", "dispatch_begin", "dispatch_end", "state"};
+
+static trace_record_t records[TRACE_BUFFER_SIZE];
+static uint32_t head = 0;
+static uint32_t count = 0;
+static uint32_t last_cycles = 0;
+static volatile bool frozen = false;
+
+static bool dumping = false;
+static bool dump_usb = false;
+static uint32_t dump_index = 0;
+
+FASTCODE void trace_record(trace_id_t id, uint16_t payload) {
+    uint32_t primask = __get_PRIMASK();
+    uint32_t now;
+    trace_record_t *record;
+
+    if (frozen) {
+        return;
+    }
+
+    __disable_irq();
+    now = CYCLE_COUNTER;
+    record = &records[head];
+    record->delta = now - last_cycles;
+    record->id = (uint16_t)id;
+    record->payload = payload;
+    last_cycles = now;
+    head = (head + 1) & TRACE_MASK;
+    if (count < TRACE_BUFFER_SIZE) {
+        count++;
+    }
+    __set_PRIMASK(primask);
+}
+
+void trace_clear(void) {
+    disable_global_irq();
+    head = 0;
+    count = 0;
+    last_cycles = CYCLE_COUNTER;
+    enable_global_irq();
+}
+
+/**
+ * @brief Freezes the buffer and starts printing it from trace_service(), to
+ * the USB CDC port if usb is set. Recording resumes once the dump is done.
+ */
+void trace_dump(bool usb) {
+    if (dumping) {
+        return;
+    }
+    if (usb && !usb_cdc_connected()) {
+        printf("USB port not open\r\n");
+        return;
+    }
+    frozen = true;
+    dumping = true;
+    dump_usb = usb;
+    dump_index = 0;
+}
+
+static void format_line(uint32_t index, char *text, uint32_t size) {
+    uint32_t first = (head - count) & TRACE_MASK;
+    const trace_record_t *record;
+
+    if (!index) {
+        snprintf(text, size, "# trace %lu %lu\r\n", SystemCoreClock, count);
+    } else if (index < TRACE_HEADER_LINES) {
+        snprintf(text, size, "# %lu %s\r\n", index - 1,
+                 trace_names[index - 1]);
+    } else {
+        record = &records[(first + index - TRACE_HEADER_LINES) & TRACE_MASK];
+        snprintf(text, size, "%lu %u %u\r\n", record->delta, record->id,
+                 record->payload);
+    }
+}
+
+/**
+ * @brief Returns false if the USB port has no room for the line yet.
+ */
+static bool emit_line(const char *text) {
+    if (dump_usb) {
+        return usb_cdc_printf("%s", text);
+    }
+    printf("%s", text);
+    return true;
+}
+
+void trace_service(void) {
+    uint32_t lines = TRACE_HEADER_LINES + count;
+    char text[USB_CDC_LINE_SIZE];
+
+    if (!dumping) {
+        return;
+    }
+    if (dump_usb && !usb_cdc_connected()) {
+        /* Unplugged, the rest is lost */
+        dump_index = lines;
+    }
+
+    for (uint32_t n = 0; n < TRACE_DUMP_BATCH && dump_index < lines; n++) {
+        format_line(dump_index, text, sizeof(text));
+        if (!emit_line(text)) {
+            break;
+        }
+        dump_index++;
+    }
+
+    if (dump_index >= lines) {
+        dumping = false;
+        /* The gap while frozen would be a bogus delta */
+        trace_clear();
+        frozen = false;
+    }
+}
+
+#endif /* TRACE_ENABLE */
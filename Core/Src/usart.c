@@ -0,0 +1,206 @@
+/*
+ * usart.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Register level USART driver. Only what the console needs is touched: 8 data
+ * bits (plus the parity bit if enabled), 16x oversampling, no flow control.
+ * The baud rate divider comes from the bus clock as it is configured when the
+ * port is set up.
+ */
+
+#include "usart.h"
+#include "clock_gate.h"
+#include "core_m4.h"
+#include "productDef.h"
+#include "stm_rcc.h"
+#include "stm_utils.h"
+#include <assert.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define USART_BASE(port, reg)                                                  \
+    *(((volatile uint32_t *)0x40000000) + (uint32_t)(port) + (reg))
+
+/* USART Offsets */
+#define USART_SR          0x0
+#define USART_DR          0x1
+#define USART_BRR         0x2
+#define USART_CR1         0x3
+#define USART_CR2         0x4
+#define USART_CR3         0x5
+
+// CR1
+#define USART_RE          BIT2
+#define USART_TE          BIT3
+#define USART_PARITY_SHIFT 9
+/* 9 bit frames, so parity comes on top of 8 data bits */
+#define USART_M           BITC
+#define USART_UE          BITD
+
+// CR2
+#define USART_STOP_SHIFT  12
+
+#define USART_PORTS       6
+
+static usart_errors_t errors[USART_PORTS];
+
+static uint32_t port_index(usart_port_t port) {
+    switch (port) {
+    case usart_1:
+        return 0;
+    case usart_2:
+        return 1;
+    case usart_3:
+        return 2;
+    case uart_4:
+        return 3;
+    case uart_5:
+        return 4;
+    case usart_6:
+        return 5;
+    default:
+        assert(0);
+        return 0;
+    }
+}
+
+static void enable_clock(usart_port_t port) {
+    switch (port) {
+    case usart_1:
+        acquire_clock(UART1_EN);
+        break;
+    case usart_2:
+        acquire_clock(UART2_EN);
+        break;
+    case usart_3:
+        acquire_clock(UART3_EN);
+        break;
+    case uart_4:
+        acquire_clock(UART4_EN);
+        break;
+    case uart_5:
+        acquire_clock(UART5_EN);
+        break;
+    case usart_6:
+        acquire_clock(UART6_EN);
+        break;
+    default:
+        assert(0);
+    }
+}
+
+/**
+ * @brief Sets up the port with the receiver and transmitter on and every
+ * interrupt off. The pins are the caller's job.
+ */
+void init_usart(usart_config_t config) {
+    uint32_t frame = ((uint32_t)config.parity & 0x3) << USART_PARITY_SHIFT;
+
+    enable_clock(config.port);
+    if (config.parity != no_parity) {
+        frame |= USART_M;
+    }
+
+    USART_BASE(config.port, USART_CR1) = 0;
+    USART_BASE(config.port, USART_CR2) =
+        ((uint32_t)config.stop_bits & 0x3) << USART_STOP_SHIFT;
+    USART_BASE(config.port, USART_CR3) = 0;
+    update_baud_rate(config.port, config.baud_rate);
+    clear_usart_errors(config.port);
+    USART_BASE(config.port, USART_CR1) = USART_UE | USART_TE | USART_RE | frame;
+}
+
+/**
+ * @brief Recomputes the divider from the live bus clock, rounded to the
+ * nearest 1/16. Call again after changing the bus prescalers.
+ */
+void update_baud_rate(usart_port_t port, uint32_t baud_rate) {
+    uint32_t bus = (uint32_t)port >= usart_1 ? RESET_APB2 : RESET_APB1;
+    uint32_t pclk = read_bus_frequency(bus);
+
+    assert(baud_rate && pclk >= 16 * baud_rate);
+    USART_BASE(port, USART_BRR) = (pclk + baud_rate / 2) / baud_rate;
+}
+
+void enable_usart_interrupts(usart_port_t port, uint32_t mask) {
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    USART_BASE(port, USART_CR1) |= mask & USART_INTERRUPTS;
+    __set_PRIMASK(primask);
+}
+
+void disable_usart_interrupts(usart_port_t port, uint32_t mask) {
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    USART_BASE(port, USART_CR1) &= ~(mask & USART_INTERRUPTS);
+    __set_PRIMASK(primask);
+}
+
+bool usart_interrupt_enabled(usart_port_t port, uint32_t mask) {
+    return (USART_BASE(port, USART_CR1) & mask & USART_INTERRUPTS) != 0;
+}
+
+uint32_t read_usart_status(usart_port_t port) {
+    return USART_BASE(port, USART_SR);
+}
+
+void usart_write_byte(usart_port_t port, uint8_t byte) {
+    while (!(USART_BASE(port, USART_SR) & USART_TXE)) {
+    }
+    USART_BASE(port, USART_DR) = byte;
+}
+
+void usart_write(usart_port_t port, const uint8_t *data, uint32_t length) {
+    for (uint32_t i = 0; i < length; i++) {
+        usart_write_byte(port, data[i]);
+    }
+}
+
+/**
+ * @brief Waits until the last byte has left the shift register.
+ */
+void usart_flush(usart_port_t port) {
+    while (!(USART_BASE(port, USART_SR) & USART_TC)) {
+    }
+}
+
+/**
+ * @brief Takes a received byte if there is one. Reading SR then DR also
+ * clears the error flags, which are counted here. A byte that arrived with a
+ * parity, framing or noise error is still returned.
+ */
+bool usart_read_byte(usart_port_t port, uint8_t *byte) {
+    uint32_t status = USART_BASE(port, USART_SR);
+    usart_errors_t *count;
+    uint8_t data;
+
+    if (!(status & (USART_RXNE | USART_ERRORS))) {
+        return false;
+    }
+    data = (uint8_t)USART_BASE(port, USART_DR);
+
+    if (status & USART_ERRORS) {
+        count = &errors[port_index(port)];
+        count->parity += (status & USART_PE) ? 1 : 0;
+        count->framing += (status & USART_FE) ? 1 : 0;
+        count->noise += (status & USART_NF) ? 1 : 0;
+        count->overrun += (status & USART_ORE) ? 1 : 0;
+    }
+    if (!(status & USART_RXNE)) {
+        return false;
+    }
+    *byte = data;
+    return true;
+}
+
+void read_usart_errors(usart_port_t port, usart_errors_t *out) {
+    *out = errors[port_index(port)];
+}
+
+void clear_usart_errors(usart_port_t port) {
+    errors[port_index(port)] = (usart_errors_t){0};
+}
@@ -0,0 +1,570 @@
+/*
+ * usb_cdc.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Minimal CDC-ACM (virtual COM port) device on USB OTG FS, built straight on
+ * the HAL PCD driver. Only the requests a host needs to enumerate and open the
+ * port are handled, everything else is stalled.
+ *
+ * Bulk IN is double buffered: usb_cdc_write() fills one buffer while the
+ * other one is on the wire as a single multi packet transfer, and the buffers
+ * are swapped from the transfer complete interrupt. A transfer that ends on a
+ * full packet is only closed with a ZLP when nothing follows it, so a steady
+ * stream does not spend a packet on every buffer. TX FIFO 1 holds 8
+ * packets, so the core keeps answering IN tokens without waiting on the CPU
+ * and a busy bulk endpoint can run close to the ~1 MB/s full speed limit.
+ * Bulk OUT is only re-armed while the receive ring has room for a full
+ * packet, so the host is NAKed instead of losing data.
+ */
+
+#include "usb_cdc.h"
+#include "core_m4.h"
+#include "idle.h"
+#include "productDef.h"
+#include "stm_utils.h"
+#include <assert.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define EP0_SIZE               64
+#define CDC_DATA_SIZE          64
+#define CDC_NOTIFY_SIZE        8
+
+#define CDC_OUT_EP             0x01
+#define CDC_IN_EP              0x81
+#define CDC_NOTIFY_EP          0x82
+
+/* FIFO sizes in words, 320 in total on OTG FS */
+#define RX_FIFO_WORDS          128
+#define TX0_FIFO_WORDS         (EP0_SIZE / 4)
+#define TX1_FIFO_WORDS         (8 * CDC_DATA_SIZE / 4)
+#define TX2_FIFO_WORDS         16
+
+#define REQ_TYPE_MASK          0x60
+#define REQ_TYPE_STANDARD      0x00
+#define REQ_TYPE_CLASS         0x20
+#define REQ_RECIPIENT_MASK     0x1F
+#define REQ_RECIPIENT_ENDPOINT 0x02
+#define REQ_DIR_IN             0x80
+
+#define REQ_GET_STATUS         0x00
+#define REQ_CLEAR_FEATURE      0x01
+#define REQ_SET_FEATURE        0x03
+#define REQ_SET_ADDRESS        0x05
+#define REQ_GET_DESCRIPTOR     0x06
+#define REQ_GET_CONFIGURATION  0x08
+#define REQ_SET_CONFIGURATION  0x09
+#define REQ_GET_INTERFACE      0x0A
+#define REQ_SET_INTERFACE      0x0B
+
+#define CDC_SET_LINE_CODING    0x20
+#define CDC_GET_LINE_CODING    0x21
+#define CDC_SET_CONTROL_LINE   0x22
+#define CDC_SEND_BREAK         0x23
+#define CDC_LINE_CODING_SIZE   7
+#define CDC_DTR                BIT0
+
+#define DESC_DEVICE            0x01
+#define DESC_CONFIGURATION     0x02
+#define DESC_STRING            0x03
+
+#define STR_LANGUAGE           0
+#define STR_MANUFACTURER       1
+#define STR_PRODUCT            2
+#define STR_SERIAL             3
+
+#define CONFIG_VALUE           1
+#define CONFIG_DESC_SIZE       67
+
+#define RX_MASK                (USB_CDC_RX_BUFFER_SIZE - 1)
+
+#define LO(x)                  ((x) & 0xFF)
+#define HI(x)                  (((x) >> 8) & 0xFF)
+
+typedef enum {
+    EP0_IDLE,
+    EP0_DATA_IN,
+    EP0_DATA_OUT,
+    EP0_STATUS_IN,
+    EP0_STATUS_OUT
+} ep0_state_t;
+
+typedef struct {
+    uint8_t bmRequestType;
+    uint8_t bRequest;
+    uint16_t wValue;
+    uint16_t wIndex;
+    uint16_t wLength;
+} setup_packet_t;
+
+static const uint8_t device_desc[] = {
+    18, DESC_DEVICE, LO(0x0200), HI(0x0200), /* USB 2.0 */
+    0x02, 0x00, 0x00,                        /* CDC class */
+    EP0_SIZE, LO(0x0483), HI(0x0483),        /* ST vendor id */
+    LO(0x5740), HI(0x5740),                  /* Virtual COM port */
+    LO(0x0200), HI(0x0200), STR_MANUFACTURER, STR_PRODUCT, STR_SERIAL,
+    1};
+
+static const uint8_t config_desc[CONFIG_DESC_SIZE] = {
+    9, DESC_CONFIGURATION, LO(CONFIG_DESC_SIZE), HI(CONFIG_DESC_SIZE), 2,
+    CONFIG_VALUE, 0, 0x80, 50, /* bus powered, 100 mA */
+
+    /* Communication interface */
+    9, 0x04, 0, 0, 1, 0x02, 0x02, 0x01, 0,
+    5, 0x24, 0x00, LO(0x0110), HI(0x0110), /* Header */
+    5, 0x24, 0x01, 0x00, 1,                /* Call management */
+    4, 0x24, 0x02, 0x02,                   /* ACM, line coding */
+    5, 0x24, 0x06, 0, 1,                   /* Union */
+    7, 0x05, CDC_NOTIFY_EP, 0x03, CDC_NOTIFY_SIZE, 0, 16,
+
+    /* Data interface */
+    9, 0x04, 1, 0, 2, 0x0A, 0x00, 0x00, 0,
+    7, 0x05, CDC_OUT_EP, 0x02, CDC_DATA_SIZE, 0, 0,
+    7, 0x05, CDC_IN_EP, 0x02, CDC_DATA_SIZE, 0, 0};
+
+static const uint8_t language_desc[] = {4, DESC_STRING, LO(0x0409),
+                                        HI(0x0409)};
+
+static const char *const strings[] = {NULL, "Advanced Mechatronics",
+                                      "Slapper Telemetry"};
+
+static const irq_info_t usb_irq = {INT_NUM_OTG_FS, USB_PRIORITY};
+
+static PCD_HandleTypeDef *usb = NULL;
+static volatile bool configured = false;
+static volatile bool host_open = false;
+
+static ep0_state_t ep0_state = EP0_IDLE;
+static const uint8_t *ep0_data;
+static uint32_t ep0_remaining;
+static bool ep0_zlp;
+static uint8_t ep0_buffer[128];
+static uint8_t line_coding[CDC_LINE_CODING_SIZE] = {
+    LO(115200), HI(115200), 0x01, 0x00, 0, 0, 8};
+
+static uint8_t tx_buffer[2][USB_CDC_TX_BUFFER_SIZE];
+static uint32_t tx_fill = 0;
+static uint32_t tx_fill_len = 0;
+static uint32_t tx_sent_len = 0;
+static volatile bool tx_busy = false;
+
+static uint8_t rx_packet[CDC_DATA_SIZE];
+static uint8_t rx_ring[USB_CDC_RX_BUFFER_SIZE];
+static volatile uint32_t rx_head = 0;
+static volatile uint32_t rx_tail = 0;
+static volatile bool rx_armed = false;
+
+static uint32_t string_desc(uint8_t index) {
+    const char *str = strings[index];
+    uint32_t n = 2;
+
+    while (*str && n < sizeof(ep0_buffer)) {
+        ep0_buffer[n++] = (uint8_t)*str++;
+        ep0_buffer[n++] = 0;
+    }
+    ep0_buffer[0] = (uint8_t)n;
+    ep0_buffer[1] = DESC_STRING;
+    return n;
+}
+
+static uint32_t serial_desc(void) {
+    const uint32_t *uid = (const uint32_t *)UID_BASE;
+    uint32_t n = 2;
+
+    for (uint32_t word = 0; word < 3; word++) {
+        for (int32_t shift = 28; shift >= 0; shift -= 4) {
+            uint8_t nibble = (uid[word] >> shift) & 0xF;
+            ep0_buffer[n++] = nibble + ((nibble < 10) ? '0' : 'A' - 10);
+            ep0_buffer[n++] = 0;
+        }
+    }
+    ep0_buffer[0] = (uint8_t)n;
+    ep0_buffer[1] = DESC_STRING;
+    return n;
+}
+
+static void ep0_stall(void) {
+    HAL_PCD_EP_SetStall(usb, 0x80);
+    HAL_PCD_EP_SetStall(usb, 0x00);
+    ep0_state = EP0_IDLE;
+}
+
+static void ep0_send_status(void) {
+    ep0_state = EP0_STATUS_IN;
+    HAL_PCD_EP_Transmit(usb, 0x80, NULL, 0);
+}
+
+static void ep0_send_chunk(void) {
+    uint32_t len = (ep0_remaining > EP0_SIZE) ? EP0_SIZE : ep0_remaining;
+
+    HAL_PCD_EP_Transmit(usb, 0x80, (uint8_t *)ep0_data, len);
+    ep0_data += len;
+    ep0_remaining -= len;
+}
+
+/**
+ * @brief Starts an IN data stage. HAL sends at most one packet per call on
+ * EP0, so the rest goes out from the data in callback.
+ */
+static void ep0_send(const uint8_t *data, uint32_t len, uint16_t max) {
+    if (len > max) {
+        len = max;
+    }
+    ep0_data = data;
+    ep0_remaining = len;
+    ep0_zlp = len && (len < max) && !(len % EP0_SIZE);
+    ep0_state = EP0_DATA_IN;
+    ep0_send_chunk();
+}
+
+static void ep0_receive(uint16_t len) {
+    ep0_state = EP0_DATA_OUT;
+    HAL_PCD_EP_Receive(usb, 0x00, ep0_buffer, len);
+}
+
+static void arm_rx(void) {
+    rx_armed = true;
+    HAL_PCD_EP_Receive(usb, CDC_OUT_EP, rx_packet, CDC_DATA_SIZE);
+}
+
+static uint32_t rx_free(void) {
+    return USB_CDC_RX_BUFFER_SIZE - 1 - ((rx_head - rx_tail) & RX_MASK);
+}
+
+/**
+ * @brief Hands the filled buffer to the endpoint. Runs from the USB interrupt
+ * or with it masked.
+ */
+static void start_tx(void) {
+    uint8_t *buffer = tx_buffer[tx_fill];
+
+    if (!tx_fill_len) {
+        return;
+    }
+    tx_busy = true;
+    tx_sent_len = tx_fill_len;
+    tx_fill ^= 1;
+    tx_fill_len = 0;
+    HAL_PCD_EP_Transmit(usb, CDC_IN_EP, buffer, tx_sent_len);
+}
+
+static void set_configuration(uint16_t value) {
+    if (value == CONFIG_VALUE) {
+        HAL_PCD_EP_Open(usb, CDC_NOTIFY_EP, CDC_NOTIFY_SIZE, EP_TYPE_INTR);
+        HAL_PCD_EP_Open(usb, CDC_OUT_EP, CDC_DATA_SIZE, EP_TYPE_BULK);
+        HAL_PCD_EP_Open(usb, CDC_IN_EP, CDC_DATA_SIZE, EP_TYPE_BULK);
+        tx_busy = false;
+        tx_fill_len = 0;
+        rx_head = rx_tail = 0;
+        arm_rx();
+        configured = true;
+        idle_block_stop(IDLE_BLOCK_USB);
+    } else if (configured) {
+        configured = false;
+        host_open = false;
+        idle_allow_stop(IDLE_BLOCK_USB);
+        HAL_PCD_EP_Close(usb, CDC_NOTIFY_EP);
+        HAL_PCD_EP_Close(usb, CDC_OUT_EP);
+        HAL_PCD_EP_Close(usb, CDC_IN_EP);
+    }
+}
+
+static void get_descriptor(const setup_packet_t *req) {
+    uint8_t type = req->wValue >> 8, index = req->wValue & 0xFF;
+
+    if (type == DESC_DEVICE) {
+        ep0_send(device_desc, sizeof(device_desc), req->wLength);
+    } else if (type == DESC_CONFIGURATION) {
+        ep0_send(config_desc, sizeof(config_desc), req->wLength);
+    } else if (type == DESC_STRING && index == STR_LANGUAGE) {
+        ep0_send(language_desc, sizeof(language_desc), req->wLength);
+    } else if (type == DESC_STRING && index == STR_SERIAL) {
+        ep0_send(ep0_buffer, serial_desc(), req->wLength);
+    } else if (type == DESC_STRING && index < STR_SERIAL) {
+        ep0_send(ep0_buffer, string_desc(index), req->wLength);
+    } else {
+        /* No device qualifier, full speed only */
+        ep0_stall();
+    }
+}
+
+static void standard_request(const setup_packet_t *req) {
+    bool endpoint = (req->bmRequestType & REQ_RECIPIENT_MASK) ==
+                    REQ_RECIPIENT_ENDPOINT;
+
+    switch (req->bRequest) {
+    case REQ_GET_STATUS:
+        memset(ep0_buffer, 0, 2);
+        ep0_send(ep0_buffer, 2, req->wLength);
+        break;
+    case REQ_SET_ADDRESS:
+        HAL_PCD_SetAddress(usb, req->wValue & 0x7F);
+        ep0_send_status();
+        break;
+    case REQ_GET_DESCRIPTOR:
+        get_descriptor(req);
+        break;
+    case REQ_GET_CONFIGURATION:
+        ep0_buffer[0] = configured ? CONFIG_VALUE : 0;
+        ep0_send(ep0_buffer, 1, req->wLength);
+        break;
+    case REQ_SET_CONFIGURATION:
+        set_configuration(req->wValue);
+        ep0_send_status();
+        break;
+    case REQ_GET_INTERFACE:
+        ep0_buffer[0] = 0;
+        ep0_send(ep0_buffer, 1, req->wLength);
+        break;
+    case REQ_SET_INTERFACE:
+        ep0_send_status();
+        break;
+    case REQ_CLEAR_FEATURE:
+    case REQ_SET_FEATURE:
+        if (!endpoint || (req->wIndex & 0x7F) == 0) {
+            ep0_stall();
+            break;
+        }
+        if (req->bRequest == REQ_SET_FEATURE) {
+            HAL_PCD_EP_SetStall(usb, req->wIndex & 0xFF);
+        } else {
+            HAL_PCD_EP_ClrStall(usb, req->wIndex & 0xFF);
+        }
+        ep0_send_status();
+        break;
+    default:
+        ep0_stall();
+        break;
+    }
+}
+
+static void class_request(const setup_packet_t *req) {
+    switch (req->bRequest) {
+    case CDC_SET_LINE_CODING:
+        /* Only informational, there is no UART behind the port */
+        ep0_receive(CDC_LINE_CODING_SIZE);
+        break;
+    case CDC_GET_LINE_CODING:
+        ep0_send(line_coding, sizeof(line_coding), req->wLength);
+        break;
+    case CDC_SET_CONTROL_LINE:
+        host_open = req->wValue & CDC_DTR;
+        ep0_send_status();
+        break;
+    case CDC_SEND_BREAK:
+        ep0_send_status();
+        break;
+    default:
+        ep0_stall();
+        break;
+    }
+}
+
+void HAL_PCD_SetupStageCallback(PCD_HandleTypeDef *hpcd) {
+    const uint8_t *raw = (const uint8_t *)hpcd->Setup;
+    setup_packet_t req = {raw[0], raw[1], raw[2] | (raw[3] << 8),
+                          raw[4] | (raw[5] << 8), raw[6] | (raw[7] << 8)};
+
+    if ((req.bmRequestType & REQ_TYPE_MASK) == REQ_TYPE_STANDARD) {
+        standard_request(&req);
+    } else if ((req.bmRequestType & REQ_TYPE_MASK) == REQ_TYPE_CLASS) {
+        if (!(req.bmRequestType & REQ_DIR_IN) && req.wLength &&
+            req.bRequest != CDC_SET_LINE_CODING) {
+            ep0_stall();
+            return;
+        }
+        class_request(&req);
+    } else {
+        ep0_stall();
+    }
+}
+
+void HAL_PCD_DataInStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum) {
+    if (epnum == 0) {
+        if (ep0_state == EP0_DATA_IN) {
+            if (ep0_remaining) {
+                ep0_send_chunk();
+            } else if (ep0_zlp) {
+                ep0_zlp = false;
+                HAL_PCD_EP_Transmit(hpcd, 0x80, NULL, 0);
+            } else {
+                ep0_state = EP0_STATUS_OUT;
+                HAL_PCD_EP_Receive(hpcd, 0x00, NULL, 0);
+            }
+        } else {
+            ep0_state = EP0_IDLE;
+        }
+        return;
+    }
+
+    if (epnum == (CDC_IN_EP & 0x7F)) {
+        /* A full last packet needs a ZLP for the host to see the end of
+         * the transfer, unless more data follows right away */
+        if (tx_sent_len && !(tx_sent_len % CDC_DATA_SIZE) && !tx_fill_len) {
+            tx_sent_len = 0;
+            HAL_PCD_EP_Transmit(hpcd, CDC_IN_EP, NULL, 0);
+            return;
+        }
+        tx_busy = false;
+        start_tx();
+    }
+}
+
+void HAL_PCD_DataOutStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum) {
+    if (epnum == 0) {
+        if (ep0_state == EP0_DATA_OUT) {
+            memcpy(line_coding, ep0_buffer, sizeof(line_coding));
+            ep0_send_status();
+        } else {
+            ep0_state = EP0_IDLE;
+        }
+        return;
+    }
+
+    if (epnum == CDC_OUT_EP) {
+        uint32_t count = HAL_PCD_EP_GetRxCount(hpcd, CDC_OUT_EP);
+        uint32_t head = rx_head;
+
+        for (uint32_t i = 0; i < count; i++) {
+            rx_ring[head] = rx_packet[i];
+            head = (head + 1) & RX_MASK;
+        }
+        rx_head = head;
+
+        if (rx_free() >= CDC_DATA_SIZE) {
+            arm_rx();
+        } else {
+            rx_armed = false;
+        }
+    }
+}
+
+void HAL_PCD_ResetCallback(PCD_HandleTypeDef *hpcd) {
+    idle_allow_stop(IDLE_BLOCK_USB);
+    configured = false;
+    host_open = false;
+    tx_busy = false;
+    rx_armed = false;
+    ep0_state = EP0_IDLE;
+    HAL_PCD_EP_Open(hpcd, 0x00, EP0_SIZE, EP_TYPE_CTRL);
+    HAL_PCD_EP_Open(hpcd, 0x80, EP0_SIZE, EP_TYPE_CTRL);
+}
+
+void HAL_PCD_DisconnectCallback(PCD_HandleTypeDef *hpcd) {
+    (void)hpcd;
+    idle_allow_stop(IDLE_BLOCK_USB);
+    configured = false;
+    host_open = false;
+}
+
+void OTG_FS_IRQHandler(void) {
+    HAL_PCD_IRQHandler(usb);
+}
+
+/**
+ * @brief Sets up the FIFOs and connects to the bus. Expects HAL_PCD_Init() to
+ * have been called on hpcd.
+ */
+void init_usb_cdc(PCD_HandleTypeDef *hpcd) {
+    assert(hpcd);
+    usb = hpcd;
+
+    HAL_PCDEx_SetRxFiFo(usb, RX_FIFO_WORDS);
+    HAL_PCDEx_SetTxFiFo(usb, 0, TX0_FIFO_WORDS);
+    HAL_PCDEx_SetTxFiFo(usb, 1, TX1_FIFO_WORDS);
+    HAL_PCDEx_SetTxFiFo(usb, 2, TX2_FIFO_WORDS);
+
+    configure_interrupt(usb_irq);
+    HAL_PCD_Start(usb);
+}
+
+/**
+ * @brief True once the host has configured the device and opened the port.
+ */
+bool usb_cdc_connected(void) {
+    return configured && host_open;
+}
+
+/**
+ * @brief Queues up to len bytes for the host and returns how many were taken.
+ * Never blocks, bytes that do not fit are left to the caller.
+ */
+uint32_t usb_cdc_write(const void *data, uint32_t len) {
+    uint32_t n;
+
+    if (!configured) {
+        return 0;
+    }
+
+    disable_irq(usb_irq);
+    n = USB_CDC_TX_BUFFER_SIZE - tx_fill_len;
+    if (len < n) {
+        n = len;
+    }
+    memcpy(&tx_buffer[tx_fill][tx_fill_len], data, n);
+    tx_fill_len += n;
+    if (!tx_busy) {
+        start_tx();
+    }
+    enable_irq(usb_irq);
+    return n;
+}
+
+/**
+ * @brief Bytes usb_cdc_write() would take right now. Only grows until the
+ * next write.
+ */
+uint32_t usb_cdc_tx_free(void) {
+    return USB_CDC_TX_BUFFER_SIZE - tx_fill_len;
+}
+
+/**
+ * @brief Formats a line and queues it whole or not at all, so text streams
+ * never carry half lines. Returns false if the port is closed or full, the
+ * caller retries later. Longer lines are cut at USB_CDC_LINE_SIZE - 1.
+ */
+bool usb_cdc_printf(const char *fmt, ...) {
+    char text[USB_CDC_LINE_SIZE];
+    va_list args;
+    int len;
+
+    if (!usb_cdc_connected()) {
+        return false;
+    }
+    va_start(args, fmt);
+    len = vsnprintf(text, sizeof(text), fmt, args);
+    va_end(args);
+    if (len < 0) {
+        return false;
+    }
+    if ((uint32_t)len >= sizeof(text)) {
+        len = sizeof(text) - 1;
+    }
+    if (usb_cdc_tx_free() < (uint32_t)len) {
+        return false;
+    }
+    usb_cdc_write(text, len);
+    return true;
+}
+
+uint32_t usb_cdc_read(void *data, uint32_t max) {
+    uint8_t *out = data;
+    uint32_t n = 0;
+
+    while (n < max && rx_tail != rx_head) {
+        out[n++] = rx_ring[rx_tail];
+        rx_tail = (rx_tail + 1) & RX_MASK;
+    }
+
+    disable_irq(usb_irq);
+    if (configured && !rx_armed && rx_free() >= CDC_DATA_SIZE) {
+        arm_rx();
+    }
+    enable_irq(usb_irq);
+    return n;
+}
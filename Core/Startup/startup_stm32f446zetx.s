@@ -32,6 +32,42 @@
 .global  g_pfnVectors
 .global  Default_Handler
 
+/* Set STARTUP_FAST_INIT to 0 to fall back to the one word per iteration
+loops, e.g. to compare the cycle counts reported in the boot log. */
+.equ  STARTUP_FAST_INIT, 1
+/* .bss regions at least this many bytes are zeroed by DMA2 */
+.equ  STARTUP_USE_DMA, 1
+.equ  STARTUP_DMA_THRESHOLD, 2048
+
+/* Must match boot.c */
+.equ  STARTUP_FLAG_FAST, 0x1
+.equ  STARTUP_FLAG_DMA, 0x2
+
+.equ  CORE_DEMCR, 0xE000EDFC
+.equ  DEMCR_TRCENA, 0x01000000
+.equ  DWT_CTRL, 0xE0001000
+.equ  DWT_CYCCNT, 0xE0001004
+.equ  DWT_CYCCNTENA, 0x1
+
+.equ  RCC_AHB1ENR, 0x40023830
+.equ  RCC_DMA2EN, 0x00400000
+
+.equ  DMA2_LISR, 0x40026400
+.equ  DMA_LIFCR, 0x08
+.equ  DMA2_S0CR, 0x40026410
+.equ  DMA_SxNDTR, 0x04
+.equ  DMA_SxPAR, 0x08
+.equ  DMA_SxM0AR, 0x0C
+.equ  DMA_SxFCR, 0x14
+.equ  DMA_SxCR_EN, 0x1
+/* Memory to memory, word sizes, memory increment, very high priority */
+.equ  DMA_ZERO_CONFIG, 0x00035480
+/* FIFO mode, full threshold */
+.equ  DMA_FIFO_FULL, 0x7
+.equ  DMA_TEIF0, 0x08
+.equ  DMA_TCIF0, 0x20
+.equ  DMA_S0_FLAGS, 0x3D
+
 /* start address for the initialization values of the .data section. 
 defined in linker script */
 .word  _sidata
@@ -43,6 +79,13 @@ defined in linker script */
 .word  _sbss
 /* end address for the .bss section. defined in linker script */
 .word  _ebss
+/* start address for the initialization values of the .fastcode section.
+defined in linker script */
+.word  _sifastcode
+/* start address for the .fastcode section. defined in linker script */
+.word  _sfastcode
+/* end address for the .fastcode section. defined in linker script */
+.word  _efastcode
 /* stack used for SystemInit_ExtMemCtl; always internal RAM used */
 
 /**
@@ -60,6 +103,96 @@ defined in linker script */
 Reset_Handler:  
   ldr   sp, =_estack      /* set stack pointer */
 
+/* Start the DWT cycle counter so the RAM initialization can be timed */
+  ldr r0, =CORE_DEMCR
+  ldr r1, [r0]
+  orr r1, r1, #DEMCR_TRCENA
+  str r1, [r0]
+  ldr r0, =DWT_CYCCNT
+  movs r1, #0
+  str r1, [r0]
+  ldr r0, =DWT_CTRL
+  ldr r1, [r0]
+  orr r1, r1, #DWT_CYCCNTENA
+  str r1, [r0]
+  mov r11, #0
+
+.if STARTUP_FAST_INIT
+.if STARTUP_USE_DMA
+/* Large .bss regions are zeroed by DMA2 while the CPU copies .data */
+  ldr r0, =_sbss
+  ldr r1, =_ebss
+  subs r2, r1, r0
+  cmp r2, #STARTUP_DMA_THRESHOLD
+  blo StartCopy
+
+  ldr r3, =RCC_AHB1ENR
+  ldr r4, [r3]
+  orr r4, r4, #RCC_DMA2EN
+  str r4, [r3]
+  ldr r4, [r3]            /* read back so the clock is up before DMA2 */
+  ldr r3, =DMA2_S0CR
+  ldr r4, =StartupZeroWord
+  str r4, [r3, #DMA_SxPAR]
+  str r0, [r3, #DMA_SxM0AR]
+  lsrs r2, r2, #2
+  str r2, [r3, #DMA_SxNDTR]
+  movs r4, #DMA_FIFO_FULL
+  str r4, [r3, #DMA_SxFCR]
+  ldr r4, =DMA_ZERO_CONFIG
+  str r4, [r3]
+  orr r4, r4, #DMA_SxCR_EN
+  str r4, [r3]
+  mov r11, #STARTUP_FLAG_DMA
+.endif
+
+StartCopy:
+/* Copy the data segment initializers from flash to SRAM */
+  ldr r0, =_sdata
+  ldr r1, =_edata
+  ldr r2, =_sidata
+  bl FastCopy
+
+/* Copy the code that runs from SRAM out of flash */
+  ldr r0, =_sfastcode
+  ldr r1, =_efastcode
+  ldr r2, =_sifastcode
+  bl FastCopy
+  ldr r0, =DWT_CYCCNT
+  ldr r0, [r0]
+  ldr r1, =startup_copy_cycles
+  str r0, [r1]
+
+/* Zero fill the bss segment. */
+  tst r11, #STARTUP_FLAG_DMA
+  beq CpuZerobss
+
+  ldr r3, =DMA2_LISR
+WaitDmaZerobss:
+  ldr r5, [r3]
+  tst r5, #(DMA_TCIF0 | DMA_TEIF0)
+  beq WaitDmaZerobss
+  movs r4, #DMA_S0_FLAGS
+  str r4, [r3, #DMA_LIFCR]
+  ldr r3, =DMA2_S0CR
+  movs r4, #0
+  str r4, [r3]
+  ldr r3, =RCC_AHB1ENR
+  ldr r4, [r3]
+  bic r4, r4, #RCC_DMA2EN
+  str r4, [r3]
+  tst r5, #DMA_TEIF0
+  beq ZerobssDone
+  bic r11, r11, #STARTUP_FLAG_DMA
+
+CpuZerobss:
+  ldr r0, =_sbss
+  ldr r1, =_ebss
+  bl FastZero
+
+ZerobssDone:
+  orr r11, r11, #STARTUP_FLAG_FAST
+.else
 /* Copy the data segment initializers from flash to SRAM */  
   ldr r0, =_sdata
   ldr r1, =_edata
@@ -76,6 +209,27 @@ LoopCopyDataInit:
   adds r4, r0, r3
   cmp r4, r1
   bcc CopyDataInit
+
+/* Copy the code that runs from SRAM out of flash */
+  ldr r0, =_sfastcode
+  ldr r1, =_efastcode
+  ldr r2, =_sifastcode
+  movs r3, #0
+  b LoopCopyFastCode
+
+CopyFastCode:
+  ldr r4, [r2, r3]
+  str r4, [r0, r3]
+  adds r3, r3, #4
+
+LoopCopyFastCode:
+  adds r4, r0, r3
+  cmp r4, r1
+  bcc CopyFastCode
+  ldr r0, =DWT_CYCCNT
+  ldr r0, [r0]
+  ldr r1, =startup_copy_cycles
+  str r0, [r1]
   
 /* Zero fill the bss segment. */
   ldr r2, =_sbss
@@ -90,6 +244,15 @@ FillZerobss:
 LoopFillZerobss:
   cmp r2, r4
   bcc FillZerobss
+.endif
+
+/* Report the RAM initialization cost. .noinit is not touched above. */
+  ldr r0, =DWT_CYCCNT
+  ldr r0, [r0]
+  ldr r1, =startup_init_cycles
+  str r0, [r1]
+  ldr r1, =startup_init_flags
+  str r11, [r1]
 
 /* Call the clock system initialization function.*/
   bl  SystemInit   
@@ -100,6 +263,78 @@ LoopFillZerobss:
   bx  lr    
 .size  Reset_Handler, .-Reset_Handler
 
+.if STARTUP_FAST_INIT
+/**
+ * @brief  Copies words from r2 to [r0, r1) in 32 byte LDM/STM blocks.
+ *         Clobbers r0-r10 and r12.
+*/
+  .type  FastCopy, %function
+FastCopy:
+  subs r12, r1, r0
+  subs r12, r12, #32
+  blo FastCopyTail
+
+FastCopyBlock:
+  ldmia r2!, {r3-r10}
+  stmia r0!, {r3-r10}
+  subs r12, r12, #32
+  bhs FastCopyBlock
+
+FastCopyTail:
+  adds r12, r12, #32
+  beq FastCopyDone
+
+FastCopyWord:
+  ldr r3, [r2], #4
+  str r3, [r0], #4
+  subs r12, r12, #4
+  bne FastCopyWord
+
+FastCopyDone:
+  bx lr
+.size  FastCopy, .-FastCopy
+
+/**
+ * @brief  Zeroes [r0, r1) in 32 byte STM blocks.
+ *         Clobbers r0 and r3-r10, r12.
+*/
+  .type  FastZero, %function
+FastZero:
+  movs r3, #0
+  movs r4, #0
+  movs r5, #0
+  movs r6, #0
+  movs r7, #0
+  mov r8, #0
+  mov r9, #0
+  mov r10, #0
+  subs r12, r1, r0
+  subs r12, r12, #32
+  blo FastZeroTail
+
+FastZeroBlock:
+  stmia r0!, {r3-r10}
+  subs r12, r12, #32
+  bhs FastZeroBlock
+
+FastZeroTail:
+  adds r12, r12, #32
+  beq FastZeroDone
+
+FastZeroWord:
+  str r3, [r0], #4
+  subs r12, r12, #4
+  bne FastZeroWord
+
+FastZeroDone:
+  bx lr
+.size  FastZero, .-FastZero
+
+  .align 2
+StartupZeroWord:
+  .word 0
+.endif
+
 /**
  * @brief  This is the code that gets called when the processor receives an 
  *         unexpected interrupt.  This simply enters an infinite loop, preserving
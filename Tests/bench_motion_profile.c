@@ -0,0 +1,130 @@
+/*
+ * bench_motion_profile.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Host cost of motion_profile.c: building a table, done at startup and by
+ * configure_motor_move(), and sample_motion_profile(), done every control
+ * tick. The host is much faster than the part, so compare the builds with
+ * each other and read the per-tick figure against the TIM4 ISR profile from
+ * the board.
+ *
+ * With a file name it also writes every tick of the motor_control.c moves as
+ * CSV, for tools/plot_motion_profile.py:
+ *
+ *   ./build/bench_motion_profile profiles.csv
+ *   python3 ../tools/plot_motion_profile.py profiles.csv
+ */
+
+#include "motion_profile.h"
+#include "motor_control.h"
+#include "test.h"
+#include <time.h>
+
+#define BUILDS 1000
+#define PASSES 1000
+
+typedef struct {
+    const char *name;
+    motion_limits_t limits;
+} move_t;
+
+/* The limits motor_control.c starts with */
+static const move_t moves[] = {
+    {"slap", {MOTION_S_CURVE, 40.0f, 2000.0f, 200000.0f}},
+    {"reset", {MOTION_TRAPEZOID, 10.0f, 400.0f}},
+};
+
+#define NUM_MOVES (sizeof(moves) / sizeof(moves[0]))
+
+static motion_profile_t profiles[NUM_MOVES];
+
+/* Keeps the samples from being optimised away */
+volatile q31_t sink;
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/**
+ * @brief One row per tick of each move: position in travel, velocity in
+ * travel per second. A comment line ahead of each move has its limits. The
+ * rows run on to the table entry where the move is at rest on target; the
+ * control loop already holds the target from profile->ticks, a few
+ * millionths of the travel short of it.
+ */
+static bool write_csv(const char *path) {
+    const double travel = (SLAP_POSITION - RESET_POSITION) / 32768.0;
+    FILE *out = fopen(path, "w");
+
+    if (!out) {
+        perror(path);
+        return false;
+    }
+    fprintf(out, "move,tick,seconds,position,velocity\n");
+    for (uint32_t m = 0; m < NUM_MOVES; m++) {
+        const motion_limits_t *l = &moves[m].limits;
+
+        fprintf(out, "# %s %s %g %g %g\n", moves[m].name,
+                l->shape == MOTION_S_CURVE ? "s-curve" : "trapezoid",
+                l->max_velocity, l->max_acceleration,
+                l->shape == MOTION_S_CURVE ? l->max_jerk : 0.0f);
+        for (uint32_t tick = 0;; tick++) {
+            q31_t position, velocity;
+
+            sample_motion_profile(&profiles[m], tick, &position, &velocity);
+            fprintf(out, "%s,%u,%.6f,%.6f,%.4f\n", moves[m].name, tick,
+                    (double)tick / MOTOR_CONTROL_HZ,
+                    travel * position / 2147483648.0,
+                    travel * velocity / 2147483648.0 * MOTOR_CONTROL_HZ);
+            if (tick >= profiles[m].ticks && position == INT32_MAX &&
+                !velocity) {
+                break;
+            }
+        }
+    }
+    fclose(out);
+    printf("  wrote %s\n", path);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    printf("motion_profile, %u Hz control ticks\n", MOTOR_CONTROL_HZ);
+    for (uint32_t m = 0; m < NUM_MOVES; m++) {
+        double start = now(), build_us, tick_ns;
+        uint32_t ticks = 0;
+
+        for (uint32_t i = 0; i < BUILDS; i++) {
+            build_motion_profile(&profiles[m], moves[m].limits,
+                                 SLAP_POSITION - RESET_POSITION,
+                                 MOTOR_CONTROL_HZ);
+        }
+        build_us = (now() - start) * 1e6 / BUILDS;
+
+        start = now();
+        for (uint32_t pass = 0; pass < PASSES; pass++) {
+            for (uint32_t tick = 0; tick <= profiles[m].ticks; tick++) {
+                q31_t position, velocity;
+
+                sample_motion_profile(&profiles[m], tick, &position,
+                                      &velocity);
+                sink = position + velocity;
+                ticks++;
+            }
+        }
+        tick_ns = (now() - start) * 1e9 / ticks;
+
+        printf("  %s: %u ticks, build %.1f us, %.1f ns per tick\n",
+               moves[m].name, profiles[m].ticks, build_us, tick_ns);
+        CHECK(profiles[m].ticks > 0);
+    }
+
+    if (argc > 1) {
+        CHECK(write_csv(argv[1]));
+    }
+    TEST_EXIT();
+}
@@ -0,0 +1,91 @@
+/*
+ * bench_reaction_stats.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Inserts millions of samples into reaction_stats.c and reports the host time
+ * per insert, round by round, and how far the running statistics have drifted
+ * from exact ones. An insert is O(1), so the time per round should stay flat.
+ */
+
+#include "reaction_stats.h"
+#include "test.h"
+#include <math.h>
+#include <time.h>
+
+#define ROUNDS         5
+#define ROUND_SAMPLES  2000000UL
+#define SAMPLES        (ROUNDS * ROUND_SAMPLES)
+#define MAX_MS         1024
+
+static uint32_t histogram[MAX_MS];
+
+static double now(void) {
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static double quantile(double p, uint64_t n) {
+    uint64_t rank = (uint64_t)ceil(p * n), seen = 0;
+
+    for (uint32_t ms = 0; ms < MAX_MS; ms++) {
+        seen += histogram[ms];
+        if (seen >= rank) {
+            return ms;
+        }
+    }
+    return MAX_MS - 1;
+}
+
+int main(void) {
+    static uint32_t samples[ROUND_SAMPLES];
+    uint32_t rng = 0x12345678;
+    double sum = 0, sum_sq = 0, mean, stddev;
+    reaction_summary_t s;
+
+    clear_reaction_stats();
+    printf("reaction_stats, %lu samples\n", SAMPLES);
+    for (uint32_t round = 0; round < ROUNDS; round++) {
+        double start, ns;
+
+        /* Drawn up front so only record_reaction() is timed: 150-600 ms
+         * with a long tail */
+        for (uint32_t i = 0; i < ROUND_SAMPLES; i++) {
+            uint32_t ms;
+
+            rng ^= rng << 13;
+            rng ^= rng >> 17;
+            rng ^= rng << 5;
+            ms = 150 + (rng & 0xFF) + ((rng >> 8) & 0xFF) * ((rng >> 16) & 1);
+            samples[i] = ms;
+            histogram[ms]++;
+            sum += ms;
+            sum_sq += (double)ms * ms;
+        }
+
+        start = now();
+        for (uint32_t i = 0; i < ROUND_SAMPLES; i++) {
+            record_reaction(samples[i], i);
+        }
+        ns = (now() - start) * 1e9 / ROUND_SAMPLES;
+        printf("  %lu samples: %.1f ns per insert\n",
+               (round + 1) * ROUND_SAMPLES, ns);
+    }
+
+    get_reaction_summary(&s);
+    mean = sum / SAMPLES;
+    stddev = sqrt((sum_sq - SAMPLES * mean * mean) / (SAMPLES - 1));
+    printf("  mean %.3f (exact %.3f), stddev %.3f (%.3f)\n", s.mean, mean,
+           s.stddev, stddev);
+    printf("  P50 %.1f (exact %.0f), P90 %.1f (%.0f)\n", s.p50,
+           quantile(0.5, SAMPLES), s.p90, quantile(0.9, SAMPLES));
+
+    CHECK_EQ(s.count, SAMPLES);
+    CHECK(fabs(s.mean - mean) <= 1e-3 * mean);
+    CHECK(fabs(s.stddev - stddev) <= 1e-3 * stddev);
+    CHECK(fabs(s.p90 - quantile(0.9, SAMPLES)) <= 5);
+    TEST_EXIT();
+}
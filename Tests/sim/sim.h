@@ -0,0 +1,99 @@
+/*
+ * sim.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Simulated STM32F446 for the host tests. Flash, SRAM, the peripheral blocks
+ * and the core peripherals are mapped at their real addresses, so the drivers
+ * run unchanged against plain memory. A watch turns writes to a register
+ * range into calls of a hook, which is where a peripheral model reacts (the
+ * page is write protected and the store is single stepped, x86-64 only).
+ *
+ * Hooks run in a signal handler. They may only touch the simulated memory
+ * through sim_read()/sim_write() and call sim_irq_raise(), never run driver
+ * code. Interrupts are delivered later, when PRIMASK is cleared or from
+ * sim_irq_poll(). Anything a hook changes must be volatile, the compiler does
+ * not see the call.
+ */
+
+#ifndef SIM_H_
+#define SIM_H_
+
+#include <setjmp.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#define SIM_FLASH_BASE  0x08000000UL
+#define SIM_FLASH_SIZE  0x80000UL
+#define SIM_SRAM_BASE   0x20000000UL
+#define SIM_SRAM_SIZE   0x20000UL
+
+#define SIM_RCC_BASE    0x40023800UL
+#define SIM_DMA1_BASE   0x40026000UL
+#define SIM_DMA2_BASE   0x40026400UL
+
+#define SIM_IRQS        97
+
+/* Address of a SIM_SRAM_BASE relative buffer, for anything handed to DMA */
+#define SIM_SRAM(offset) ((void *)(uintptr_t)(SIM_SRAM_BASE + (offset)))
+
+typedef void (*sim_write_hook_t)(uint32_t address, uint32_t old,
+                                 uint32_t value);
+typedef void (*sim_irq_handler_t)(void);
+
+/* sim_bus.c */
+void sim_bus_reset(void);
+uint32_t sim_read(uint32_t address);
+void sim_write(uint32_t address, uint32_t value);
+void *sim_alias(uint32_t address, uint32_t length);
+void sim_watch(uint32_t address, uint32_t size, sim_write_hook_t hook);
+void *sim_bus_save(void);
+void sim_bus_restore(void *saved);
+
+/* sim_core.c */
+void sim_core_reset(void);
+void sim_irq_attach(uint32_t irq, sim_irq_handler_t handler);
+void sim_irq_raise(uint32_t irq);
+void sim_irq_poll(void);
+bool sim_irq_enabled(uint32_t irq);
+uint8_t sim_irq_priority(uint32_t irq);
+void sim_cycles_add(uint32_t cycles);
+
+/* sim_dma.c */
+typedef struct {
+    uint32_t register_write; /* Per firmware store to a DMA register */
+    uint32_t item;           /* Per item moved */
+} sim_dma_costs_t;
+
+void sim_dma_reset(void);
+void sim_dma_set_costs(sim_dma_costs_t costs);
+uint32_t sim_dma_request(uint32_t stream, uint32_t items);
+uint32_t sim_dma_violations(void);
+
+/* sim_flash.c, the HAL side is declared in stm32f4xx_hal.h */
+void sim_flash_reset(void);
+void sim_flash_power_cut(uint32_t count, jmp_buf *target);
+uint32_t sim_flash_erases(uint32_t sector);
+uint32_t sim_flash_programs(void);
+uint32_t sim_flash_violations(void);
+
+/* sim_usb.c, the HAL side is declared in stm32f4xx_hal.h */
+#define SIM_USB_NAK   (-1)
+#define SIM_USB_STALL (-2)
+
+void sim_usb_reset(void);
+void sim_usb_bus_reset(void);
+void sim_usb_disconnect(void);
+void sim_usb_setup(const uint8_t setup[8]);
+int32_t sim_usb_in(uint8_t ep, uint8_t *data, uint32_t max);
+int32_t sim_usb_out(uint8_t ep, const uint8_t *data, uint32_t len);
+int32_t sim_usb_control(uint8_t type, uint8_t request, uint16_t value,
+                        uint16_t index, uint16_t length, uint8_t *data);
+uint8_t sim_usb_address(void);
+bool sim_usb_ep_open(uint8_t ep_addr);
+bool sim_usb_ep_busy(uint8_t ep_addr);
+uint32_t sim_usb_in_packets(uint8_t ep);
+uint32_t sim_usb_violations(void);
+
+#endif /* SIM_H_ */
@@ -0,0 +1,271 @@
+/*
+ * sim_bus.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Memory map of the simulated part. Every region is a memfd mapped twice: at
+ * the address the firmware uses, and at an alias the models use. Watched
+ * pages are made read only at the firmware address. A store to one faults,
+ * the page is opened, the store is single stepped with the trap flag and the
+ * hook sees the word before and after. The alias is never protected, so the
+ * models can update registers without faulting.
+ *
+ * The firmware's own statics live in SRAM on the part, so a bus master may
+ * also reach the test program's data and bss, which sit below 4 GB in the
+ * non-PIE build.
+ */
+
+#define _GNU_SOURCE
+#include "sim.h"
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <ucontext.h>
+#include <unistd.h>
+
+#if !defined(__x86_64__)
+#error "The register watch single steps with the x86-64 trap flag"
+#endif
+
+#define PAGE_SIZE   0x1000UL
+#define PAGE_MASK   (~(PAGE_SIZE - 1))
+#define TRAP_FLAG   0x100
+#define MAX_WATCHES 8
+
+typedef struct {
+    uint32_t base;
+    uint32_t size;
+    uint8_t *alias;
+} region_t;
+
+typedef struct {
+    uint32_t address;
+    uint32_t size;
+    sim_write_hook_t hook;
+} watch_t;
+
+static region_t regions[] = {
+    {SIM_FLASH_BASE, SIM_FLASH_SIZE, NULL},
+    {SIM_SRAM_BASE, SIM_SRAM_SIZE, NULL},
+    {0x1FFF0000UL, 0x10000UL, NULL}, /* System memory, OTP, UID */
+    {0x40000000UL, 0x80000UL, NULL}, /* APB1, APB2, AHB1 */
+    {0x50000000UL, 0x40000UL, NULL}, /* AHB2, USB OTG FS */
+    {0xE0000000UL, 0x100000UL, NULL} /* DWT, NVIC, SCB */
+};
+
+#define NUM_REGIONS (sizeof(regions) / sizeof(regions[0]))
+
+/* Data and bss of the test program, from the linker */
+extern uint8_t __data_start[], _end[];
+
+static watch_t watches[MAX_WATCHES];
+static uint32_t num_watches = 0;
+
+/* The store being single stepped */
+static struct {
+    bool active;
+    uint32_t address;
+    uint32_t old;
+} step;
+
+static region_t *find_region(uintptr_t address) {
+    for (uint32_t i = 0; i < NUM_REGIONS; i++) {
+        if (address >= regions[i].base &&
+            address - regions[i].base < regions[i].size) {
+            return &regions[i];
+        }
+    }
+    return NULL;
+}
+
+static volatile uint32_t *alias(uint32_t address) {
+    region_t *region = find_region(address);
+
+    if (!region) {
+        fprintf(stderr, "sim: 0x%08x is not mapped\n", address);
+        abort();
+    }
+    return (volatile uint32_t *)(region->alias + (address - region->base));
+}
+
+static bool page_watched(uintptr_t address) {
+    for (uint32_t i = 0; i < num_watches; i++) {
+        uintptr_t first = watches[i].address & PAGE_MASK;
+        uintptr_t last = (watches[i].address + watches[i].size - 1) & PAGE_MASK;
+
+        if ((address & PAGE_MASK) >= first && (address & PAGE_MASK) <= last) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static void protect(uintptr_t address, int prot) {
+    if (mprotect((void *)(address & PAGE_MASK), PAGE_SIZE, prot)) {
+        abort();
+    }
+}
+
+static void on_segv(int sig, siginfo_t *info, void *context) {
+    ucontext_t *uc = context;
+    uintptr_t address = (uintptr_t)info->si_addr;
+
+    if (step.active || !find_region(address) || !page_watched(address)) {
+        /* A real crash, let it happen again without the handler */
+        signal(SIGSEGV, SIG_DFL);
+        return;
+    }
+    step.active = true;
+    step.address = (uint32_t)address & ~0x3UL;
+    step.old = *alias(step.address);
+    protect(address, PROT_READ | PROT_WRITE);
+    uc->uc_mcontext.gregs[REG_EFL] |= TRAP_FLAG;
+}
+
+static void on_trap(int sig, siginfo_t *info, void *context) {
+    ucontext_t *uc = context;
+    uint32_t value;
+
+    uc->uc_mcontext.gregs[REG_EFL] &= ~TRAP_FLAG;
+    if (!step.active) {
+        return;
+    }
+    step.active = false;
+    value = *alias(step.address);
+    for (uint32_t i = 0; i < num_watches; i++) {
+        if (step.address >= watches[i].address &&
+            step.address - watches[i].address < watches[i].size) {
+            watches[i].hook(step.address, step.old, value);
+        }
+    }
+    protect(step.address, PROT_READ);
+}
+
+__attribute__((constructor)) static void map_regions(void) {
+    struct sigaction action = {0};
+
+    for (uint32_t i = 0; i < NUM_REGIONS; i++) {
+        int fd = memfd_create("sim", 0);
+        void *device;
+
+        if (fd < 0 || ftruncate(fd, regions[i].size)) {
+            perror("sim: memfd");
+            exit(2);
+        }
+        device = mmap((void *)(uintptr_t)regions[i].base, regions[i].size,
+                      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED_NOREPLACE,
+                      fd, 0);
+        regions[i].alias = mmap(NULL, regions[i].size, PROT_READ | PROT_WRITE,
+                                MAP_SHARED, fd, 0);
+        if (device != (void *)(uintptr_t)regions[i].base ||
+            regions[i].alias == MAP_FAILED) {
+            fprintf(stderr, "sim: cannot map 0x%08x\n", regions[i].base);
+            exit(2);
+        }
+        close(fd);
+    }
+
+    action.sa_flags = SA_SIGINFO;
+    action.sa_sigaction = on_segv;
+    sigaction(SIGSEGV, &action, NULL);
+    action.sa_sigaction = on_trap;
+    sigaction(SIGTRAP, &action, NULL);
+
+    sim_bus_reset();
+}
+
+/**
+ * @brief Drops every watch and clears the whole map. Flash reads back erased
+ * (0xFF), everything else as zero.
+ */
+void sim_bus_reset(void) {
+    for (uint32_t i = 0; i < num_watches; i++) {
+        uintptr_t page = watches[i].address & PAGE_MASK;
+
+        for (; page < watches[i].address + watches[i].size; page += PAGE_SIZE) {
+            protect(page, PROT_READ | PROT_WRITE);
+        }
+    }
+    num_watches = 0;
+
+    for (uint32_t i = 0; i < NUM_REGIONS; i++) {
+        memset(regions[i].alias, regions[i].base == SIM_FLASH_BASE ? 0xFF : 0,
+               regions[i].size);
+    }
+}
+
+uint32_t sim_read(uint32_t address) {
+    return *alias(address);
+}
+
+void sim_write(uint32_t address, uint32_t value) {
+    *alias(address) = value;
+}
+
+/**
+ * @brief Host pointer to [address, address + length) through the alias, NULL
+ * if any of it is unmapped. What a bus master model uses to move data.
+ */
+void *sim_alias(uint32_t address, uint32_t length) {
+    region_t *region = find_region(address);
+
+    if (!region && length && address >= (uintptr_t)__data_start &&
+        address + (uint64_t)length <= (uintptr_t)_end) {
+        return (void *)(uintptr_t)address;
+    }
+    if (!region || !length ||
+        address - region->base + (uint64_t)length > region->size) {
+        return NULL;
+    }
+    return region->alias + (address - region->base);
+}
+
+/**
+ * @brief Calls hook for every firmware store to [address, address + size).
+ * Other registers on the same pages are still written, just not reported.
+ */
+void sim_watch(uint32_t address, uint32_t size, sim_write_hook_t hook) {
+    if (num_watches == MAX_WATCHES || !find_region(address)) {
+        abort();
+    }
+    watches[num_watches++] = (watch_t){address, size, hook};
+    for (uintptr_t page = address & PAGE_MASK; page < address + size;
+         page += PAGE_SIZE) {
+        protect(page, PROT_READ);
+    }
+}
+
+/**
+ * @brief Copies the whole map, e.g. around a forked child that shares it.
+ */
+void *sim_bus_save(void) {
+    size_t total = 0;
+    uint8_t *saved, *next;
+
+    for (uint32_t i = 0; i < NUM_REGIONS; i++) {
+        total += regions[i].size;
+    }
+    saved = malloc(total);
+    if (!saved) {
+        abort();
+    }
+    next = saved;
+    for (uint32_t i = 0; i < NUM_REGIONS; i++) {
+        memcpy(next, regions[i].alias, regions[i].size);
+        next += regions[i].size;
+    }
+    return saved;
+}
+
+void sim_bus_restore(void *saved) {
+    uint8_t *next = saved;
+
+    for (uint32_t i = 0; i < NUM_REGIONS; i++) {
+        memcpy(regions[i].alias, next, regions[i].size);
+        next += regions[i].size;
+    }
+    free(saved);
+}
@@ -0,0 +1,229 @@
+/*
+ * sim_core.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Host versions of the Cortex-M4 pieces: PRIMASK, an NVIC that runs attached
+ * handlers in priority order, and the core_m4.h API that the tested drivers
+ * call. A raised interrupt runs once PRIMASK is clear and its priority beats
+ * the handler that is running, like on the part, but only at the points where
+ * the simulation gets control: clearing PRIMASK, enabling or pending an IRQ,
+ * and sim_irq_poll().
+ */
+
+#include "core_m4.h"
+#include "sim.h"
+#include "stm32f4xx_hal.h"
+#include <assert.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define NO_PRIORITY 0x100
+
+uint32_t SystemCoreClock = 168000000;
+
+static uint32_t primask = 0;
+static bool enabled[SIM_IRQS];
+static uint8_t priorities[SIM_IRQS];
+static volatile sig_atomic_t pending[SIM_IRQS];
+static bool active[SIM_IRQS];
+static sim_irq_handler_t handlers[SIM_IRQS];
+static uint32_t running_priority = NO_PRIORITY;
+
+static isr_profile_t isr_profiles[NUM_ISR_PROFILES];
+
+void sim_core_reset(void) {
+    primask = 0;
+    running_priority = NO_PRIORITY;
+    for (uint32_t i = 0; i < SIM_IRQS; i++) {
+        enabled[i] = false;
+        priorities[i] = 0;
+        pending[i] = 0;
+        active[i] = false;
+        handlers[i] = NULL;
+    }
+    clear_isr_profiles();
+}
+
+void sim_irq_attach(uint32_t irq, sim_irq_handler_t handler) {
+    assert(irq < SIM_IRQS);
+    handlers[irq] = handler;
+}
+
+/**
+ * @brief Pends an interrupt. Safe from a write hook, it is only delivered
+ * later.
+ */
+void sim_irq_raise(uint32_t irq) {
+    assert(irq < SIM_IRQS);
+    pending[irq] = 1;
+}
+
+static int32_t next_irq(void) {
+    int32_t best = -1;
+
+    for (uint32_t i = 0; i < SIM_IRQS; i++) {
+        if (pending[i] && enabled[i] && handlers[i] &&
+            priorities[i] < running_priority &&
+            (best < 0 || priorities[i] < priorities[best])) {
+            best = (int32_t)i;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief Runs every deliverable interrupt, including the ones the handlers
+ * raise on the way.
+ */
+void sim_irq_poll(void) {
+    int32_t irq;
+
+    while (!primask && (irq = next_irq()) >= 0) {
+        uint32_t preempted = running_priority;
+
+        pending[irq] = 0;
+        active[irq] = true;
+        running_priority = priorities[irq];
+        handlers[irq]();
+        running_priority = preempted;
+        active[irq] = false;
+        /* Exception return leaves PRIMASK as the handler left it */
+    }
+}
+
+bool sim_irq_enabled(uint32_t irq) {
+    assert(irq < SIM_IRQS);
+    return enabled[irq];
+}
+
+uint8_t sim_irq_priority(uint32_t irq) {
+    assert(irq < SIM_IRQS);
+    return priorities[irq];
+}
+
+void sim_cycles_add(uint32_t cycles) {
+    CYCLE_COUNTER += cycles;
+}
+
+/* CMSIS intrinsics */
+uint32_t __get_PRIMASK(void) {
+    return primask;
+}
+
+void __set_PRIMASK(uint32_t value) {
+    primask = value & 0x1;
+    sim_irq_poll();
+}
+
+void __disable_irq(void) {
+    primask = 1;
+}
+
+void __enable_irq(void) {
+    __set_PRIMASK(0);
+}
+
+void __DSB(void) {
+}
+
+void __ISB(void) {
+}
+
+void __DMB(void) {
+}
+
+void __WFI(void) {
+    sim_irq_poll();
+}
+
+void __NOP(void) {
+}
+
+/* core_m4.h */
+void disable_global_irq(void) {
+    __disable_irq();
+}
+
+void enable_global_irq(void) {
+    __enable_irq();
+}
+
+void configure_interrupt(irq_info_t config) {
+    assert(config.interrupt_id < SIM_IRQS && config.priority < 16);
+    enabled[config.interrupt_id] = false;
+    pending[config.interrupt_id] = 0;
+    priorities[config.interrupt_id] = config.priority;
+    enable_irq(config);
+}
+
+void configure_interrupts(irq_info_t config[], uint8_t n) {
+    for (uint8_t i = 0; i < n; i++) {
+        configure_interrupt(config[i]);
+    }
+}
+
+void enable_irq(irq_info_t irq) {
+    enabled[irq.interrupt_id] = true;
+    sim_irq_poll();
+}
+
+void disable_irq(irq_info_t irq) {
+    enabled[irq.interrupt_id] = false;
+}
+
+void set_pending_irq(irq_info_t irq) {
+    pending[irq.interrupt_id] = 1;
+    sim_irq_poll();
+}
+
+void clear_pending_irq(irq_info_t irq) {
+    pending[irq.interrupt_id] = 0;
+}
+
+bool check_irq_active(irq_info_t irq) {
+    return active[irq.interrupt_id];
+}
+
+void send_software_irq(irq_info_t irq) {
+    set_pending_irq(irq);
+}
+
+void reset_system(void) {
+    fprintf(stderr, "sim: reset_system()\n");
+    abort();
+}
+
+void relocate_vector_table(void) {
+}
+
+void enable_cycle_counter(void) {
+}
+
+void update_isr_profile(isr_profile_id_t id, uint32_t cycles) {
+    isr_profile_t *profile = &isr_profiles[id];
+
+    profile->count++;
+    profile->total += cycles;
+    if (cycles > profile->max) {
+        profile->max = cycles;
+    }
+}
+
+void get_isr_profile(isr_profile_id_t id, isr_profile_t *profile) {
+    assert(id < NUM_ISR_PROFILES);
+    *profile = isr_profiles[id];
+}
+
+void clear_isr_profiles(void) {
+    for (uint32_t i = 0; i < NUM_ISR_PROFILES; i++) {
+        isr_profiles[i] = (isr_profile_t){0};
+    }
+}
+
+void Error_Handler(void) {
+    fprintf(stderr, "sim: Error_Handler()\n");
+    abort();
+}
@@ -0,0 +1,271 @@
+/*
+ * sim_dma.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Model of the two DMA controllers, driven by a watch on their registers.
+ *
+ * Memory to memory streams run to completion as soon as they are enabled,
+ * like a very fast DMA2. Peripheral streams move one item per request, which
+ * the test issues with sim_dma_request() in place of the peripheral. Either
+ * way the model keeps NDTR, the half/complete flags, circular reload and the
+ * double buffer target up to date, and raises the stream interrupt for every
+ * enabled flag. An address outside the map, a write to flash or a memory to
+ * memory stream on DMA1 stops the stream with a transfer error.
+ *
+ * Writes the real controller ignores are counted as violations and undone:
+ * anything but EN, or the idle double buffer address, while the stream is
+ * enabled, and writes to the read only status registers. FIFO and direct
+ * mode errors and bursts are not modelled.
+ */
+
+#include "sim.h"
+#include "core_m4.h"
+#include <string.h>
+
+#define DMA_BASE(controller) (SIM_DMA1_BASE + 0x400 * (controller))
+#define DMA_SIZE             0x800
+#define STREAMS              16
+
+/* Registers of a stream, in words */
+#define CR                   0
+#define NDTR                 1
+#define PAR                  2
+#define M0AR                 3
+#define M1AR                 4
+#define FCR                  5
+
+#define CR_EN                (1UL << 0)
+#define CR_DMEIE             (1UL << 1)
+#define CR_TEIE              (1UL << 2)
+#define CR_HTIE              (1UL << 3)
+#define CR_TCIE              (1UL << 4)
+#define CR_CIRC              (1UL << 8)
+#define CR_PINC              (1UL << 9)
+#define CR_MINC              (1UL << 10)
+#define CR_DBM               (1UL << 18)
+#define CR_CT                (1UL << 19)
+#define FCR_FEIE             (1UL << 7)
+
+#define FLAG_FE              (1UL << 0)
+#define FLAG_DME             (1UL << 2)
+#define FLAG_TE              (1UL << 3)
+#define FLAG_HT              (1UL << 4)
+#define FLAG_TC              (1UL << 5)
+
+#define DIR_M2P              1
+#define DIR_M2M              2
+
+static const uint8_t flag_shifts[4] = {0, 6, 16, 22};
+
+static const uint8_t stream_irqs[STREAMS] = {
+    INT_NUM_DMA1_STREAM0, INT_NUM_DMA1_STREAM1, INT_NUM_DMA1_STREAM2,
+    INT_NUM_DMA1_STREAM3, INT_NUM_DMA1_STREAM4, INT_NUM_DMA1_STREAM5,
+    INT_NUM_DMA1_STREAM6, INT_NUM_DMA1_STREAM7, INT_NUM_DMA2_STREAM0,
+    INT_NUM_DMA2_STREAM1, INT_NUM_DMA2_STREAM2, INT_NUM_DMA2_STREAM3,
+    INT_NUM_DMA2_STREAM4, INT_NUM_DMA2_STREAM5, INT_NUM_DMA2_STREAM6,
+    INT_NUM_DMA2_STREAM7};
+
+/* NDTR as enabled and bytes moved since the last reload */
+static uint32_t reloads[STREAMS];
+static uint32_t positions[STREAMS];
+static sim_dma_costs_t costs;
+static volatile uint32_t violations = 0;
+
+static uint32_t reg_address(uint32_t stream, uint32_t reg) {
+    return DMA_BASE(stream >> 3) + 0x10 + 0x18 * (stream & 0x7) + 4 * reg;
+}
+
+static uint32_t read_reg(uint32_t stream, uint32_t reg) {
+    return sim_read(reg_address(stream, reg));
+}
+
+static void write_reg(uint32_t stream, uint32_t reg, uint32_t value) {
+    sim_write(reg_address(stream, reg), value);
+}
+
+static void set_flags(uint32_t stream, uint32_t flags) {
+    uint32_t isr = DMA_BASE(stream >> 3) + 4 * ((stream & 0x7) >> 2);
+    uint32_t cr = read_reg(stream, CR);
+    uint32_t enabled = 0;
+
+    sim_write(isr, sim_read(isr) | flags << flag_shifts[stream & 0x3]);
+
+    enabled |= (cr & CR_TCIE) ? FLAG_TC : 0;
+    enabled |= (cr & CR_HTIE) ? FLAG_HT : 0;
+    enabled |= (cr & CR_TEIE) ? FLAG_TE : 0;
+    enabled |= (cr & CR_DMEIE) ? FLAG_DME : 0;
+    enabled |= (read_reg(stream, FCR) & FCR_FEIE) ? FLAG_FE : 0;
+    if (flags & enabled) {
+        sim_irq_raise(stream_irqs[stream]);
+    }
+}
+
+static bool writable(uint32_t address, uint32_t size) {
+    return address >= SIM_FLASH_BASE + SIM_FLASH_SIZE ||
+           address + size <= SIM_FLASH_BASE;
+}
+
+/**
+ * @brief Moves one item, false on a bus error.
+ */
+static bool move_item(uint32_t stream) {
+    uint32_t cr = read_reg(stream, CR);
+    uint32_t direction = (cr >> 6) & 0x3;
+    uint32_t size = 1UL << ((cr >> 11) & 0x3);
+    uint32_t memory = read_reg(stream, (cr & CR_CT) ? M1AR : M0AR);
+    uint32_t peripheral = read_reg(stream, PAR);
+    uint32_t source, destination;
+    void *from, *to;
+
+    if (cr & CR_MINC) {
+        memory += positions[stream];
+    }
+    if (cr & CR_PINC) {
+        peripheral += positions[stream];
+    }
+    /* Memory to memory reads through the peripheral port */
+    source = direction == DIR_M2P ? memory : peripheral;
+    destination = direction == DIR_M2P ? peripheral : memory;
+
+    from = sim_alias(source, size);
+    to = sim_alias(destination, size);
+    if (!from || !to || !writable(destination, size) ||
+        (direction == DIR_M2M && stream < 8)) {
+        return false;
+    }
+    memmove(to, from, size);
+    positions[stream] += size;
+    write_reg(stream, NDTR, read_reg(stream, NDTR) - 1);
+    sim_write(0xE0001004, sim_read(0xE0001004) + costs.item);
+    return true;
+}
+
+static uint32_t run(uint32_t stream, uint32_t items) {
+    uint32_t done = 0;
+
+    while (done < items && (read_reg(stream, CR) & CR_EN)) {
+        uint32_t left;
+
+        if (!move_item(stream)) {
+            write_reg(stream, CR, read_reg(stream, CR) & ~CR_EN);
+            set_flags(stream, FLAG_TE);
+            break;
+        }
+        done++;
+        left = read_reg(stream, NDTR);
+        if (reloads[stream] > 1 &&
+            reloads[stream] - left == reloads[stream] / 2) {
+            set_flags(stream, FLAG_HT);
+        }
+        if (left) {
+            continue;
+        }
+        set_flags(stream, FLAG_TC);
+        if (read_reg(stream, CR) & CR_CIRC) {
+            write_reg(stream, NDTR, reloads[stream]);
+            positions[stream] = 0;
+            if (read_reg(stream, CR) & CR_DBM) {
+                write_reg(stream, CR, read_reg(stream, CR) ^ CR_CT);
+            }
+        } else {
+            write_reg(stream, CR, read_reg(stream, CR) & ~CR_EN);
+        }
+    }
+    return done;
+}
+
+static void start(uint32_t stream) {
+    uint32_t cr = read_reg(stream, CR);
+
+    reloads[stream] = read_reg(stream, NDTR) & 0xFFFF;
+    positions[stream] = 0;
+    if (!reloads[stream]) {
+        violations++;
+        write_reg(stream, CR, cr & ~CR_EN);
+        return;
+    }
+    if (((cr >> 6) & 0x3) == DIR_M2M) {
+        run(stream, reloads[stream]);
+    }
+}
+
+static void on_write(uint32_t address, uint32_t old, uint32_t value) {
+    uint32_t controller = (address - SIM_DMA1_BASE) / 0x400;
+    uint32_t offset = address - DMA_BASE(controller);
+    uint32_t stream, reg, cr;
+
+    sim_write(0xE0001004, sim_read(0xE0001004) + costs.register_write);
+
+    if (offset < 0x10) {
+        if (offset >= 0x08) {
+            /* LIFCR/HIFCR clear LISR/HISR and read as zero */
+            uint32_t isr = address - 0x08;
+            sim_write(isr, sim_read(isr) & ~value);
+            sim_write(address, 0);
+        } else {
+            violations++;
+            sim_write(address, old);
+        }
+        return;
+    }
+
+    stream = controller * 8 + (offset - 0x10) / 0x18;
+    reg = ((offset - 0x10) % 0x18) / 4;
+    cr = reg == CR ? old : read_reg(stream, CR);
+
+    if (cr & CR_EN) {
+        if (reg == CR && !(value & CR_EN)) {
+            /* Stopping early still flags the end of the transfer */
+            if (read_reg(stream, NDTR)) {
+                set_flags(stream, FLAG_TC);
+            }
+            return;
+        }
+        if ((cr & CR_DBM) && reg == ((cr & CR_CT) ? M0AR : M1AR)) {
+            return;
+        }
+        violations++;
+        sim_write(address, old);
+        return;
+    }
+
+    if (reg == CR && (value & CR_EN)) {
+        start(stream);
+    }
+}
+
+/**
+ * @brief Clears both controllers and watches them again. Call after
+ * sim_bus_reset(), which drops the watch.
+ */
+void sim_dma_reset(void) {
+    for (uint32_t controller = 0; controller < 2; controller++) {
+        memset(sim_alias(DMA_BASE(controller), 0x400), 0, 0x400);
+    }
+    memset(reloads, 0, sizeof(reloads));
+    memset(positions, 0, sizeof(positions));
+    costs = (sim_dma_costs_t){0};
+    violations = 0;
+    sim_watch(SIM_DMA1_BASE, DMA_SIZE, on_write);
+}
+
+void sim_dma_set_costs(sim_dma_costs_t new_costs) {
+    costs = new_costs;
+}
+
+/**
+ * @brief The peripheral asks for items transfers. Returns how many happened,
+ * fewer if the stream stopped, and runs the interrupts they raised.
+ */
+uint32_t sim_dma_request(uint32_t stream, uint32_t items) {
+    uint32_t done = run(stream, items);
+
+    sim_irq_poll();
+    return done;
+}
+
+uint32_t sim_dma_violations(void) {
+    return violations;
+}
@@ -0,0 +1,180 @@
+/*
+ * sim_flash.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * The HAL flash calls storage.c makes, on the simulated flash. Programming can
+ * only clear bits, like the part, and an erase sets the whole sector back to
+ * 0xFF and is counted per sector. An erase keeps BSY set for a few polls.
+ *
+ * Programming bits back to 1, programming while locked or busy, and a
+ * misaligned address are counted as violations; the first two also fail like
+ * on the part.
+ *
+ * sim_flash_power_cut() loses power in the middle of a later operation. A
+ * torn word only gets half of its bits programmed, and a torn erase only
+ * clears the front half of the sector (the real contents are undefined).
+ * The model then resets and longjmp()s to the test, which reboots the
+ * firmware.
+ */
+
+#include "sim.h"
+#include "stm32f4xx_hal.h"
+#include <stdlib.h>
+#include <string.h>
+
+#define SECTORS     8
+#define ERASE_POLLS 4
+
+static const uint32_t sector_offsets[SECTORS + 1] = {
+    0x00000, 0x04000, 0x08000, 0x0C000, 0x10000,
+    0x20000, 0x40000, 0x60000, 0x80000};
+
+static bool locked;
+static uint32_t busy_polls;
+static uint32_t errors;
+static uint32_t erases[SECTORS];
+static uint32_t programs;
+static uint32_t violations;
+
+static uint32_t operations;
+static uint32_t cut_at;
+static jmp_buf *cut_target;
+
+static void reset_controller(void) {
+    locked = true;
+    busy_polls = 0;
+    errors = 0;
+    sim_write((uint32_t)&FLASH->CR, 0);
+}
+
+/**
+ * @brief True if power goes in this operation: the caller tears it and
+ * calls lose_power().
+ */
+static bool power_lost(void) {
+    return cut_target && operations++ == cut_at;
+}
+
+static void lose_power(void) {
+    jmp_buf *target = cut_target;
+
+    cut_target = NULL;
+    reset_controller();
+    longjmp(*target, 1);
+}
+
+/**
+ * @brief Clears the counters and the controller, not the flash contents
+ * (sim_bus_reset() erases those).
+ */
+void sim_flash_reset(void) {
+    reset_controller();
+    memset(erases, 0, sizeof(erases));
+    programs = 0;
+    violations = 0;
+    cut_target = NULL;
+}
+
+/**
+ * @brief Power goes in the middle of the program or erase after the next
+ * count ones, and the firmware continues at target.
+ */
+void sim_flash_power_cut(uint32_t count, jmp_buf *target) {
+    operations = 0;
+    cut_at = count;
+    cut_target = target;
+}
+
+uint32_t sim_flash_erases(uint32_t sector) {
+    return sector < SECTORS ? erases[sector] : 0;
+}
+
+uint32_t sim_flash_programs(void) {
+    return programs;
+}
+
+uint32_t sim_flash_violations(void) {
+    return violations;
+}
+
+uint32_t sim_flash_get_flag(uint32_t flag) {
+    uint32_t sr = errors;
+
+    if (busy_polls) {
+        busy_polls--;
+        sr |= FLASH_FLAG_BSY;
+    }
+    return sr & flag;
+}
+
+void sim_flash_clear_flag(uint32_t flag) {
+    errors &= ~flag;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void) {
+    locked = false;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Lock(void) {
+    locked = true;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address,
+                                    uint64_t Data) {
+    uint32_t size = 1UL << TypeProgram;
+    uint8_t *cell = sim_alias(Address, size);
+    uint8_t *data = (uint8_t *)&Data;
+
+    if (TypeProgram > FLASH_TYPEPROGRAM_WORD || !cell ||
+        Address < SIM_FLASH_BASE || Address % size) {
+        violations++;
+        errors |= FLASH_FLAG_PGAERR;
+        return HAL_ERROR;
+    }
+    if (locked || busy_polls) {
+        violations++;
+        errors |= FLASH_FLAG_PGSERR;
+        return HAL_ERROR;
+    }
+    if (power_lost()) {
+        for (uint32_t i = 0; i < size; i++) {
+            cell[i] &= data[i] | (i < size / 2 ? 0x00 : 0xFF);
+        }
+        lose_power();
+    }
+
+    programs++;
+    for (uint32_t i = 0; i < size; i++) {
+        if (data[i] & ~cell[i]) {
+            violations++;
+        }
+        cell[i] &= data[i];
+    }
+    return HAL_OK;
+}
+
+void FLASH_Erase_Sector(uint32_t Sector, uint8_t VoltageRange) {
+    uint32_t base = SIM_FLASH_BASE + sector_offsets[Sector % SECTORS];
+    uint32_t size = sector_offsets[Sector % SECTORS + 1] -
+                    sector_offsets[Sector % SECTORS];
+
+    if (Sector >= SECTORS || locked || busy_polls) {
+        violations++;
+        errors |= FLASH_FLAG_PGSERR;
+        return;
+    }
+    if (power_lost()) {
+        memset(sim_alias(base, size / 2), 0xFF, size / 2);
+        lose_power();
+    }
+
+    sim_write((uint32_t)&FLASH->CR,
+              FLASH_CR_SER | (Sector << 3) | FLASH_CR_STRT);
+    memset(sim_alias(base, size), 0xFF, size);
+    erases[Sector]++;
+    busy_polls = ERASE_POLLS;
+}
@@ -0,0 +1,416 @@
+/*
+ * sim_usb.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Software model of the OTG FS device endpoints behind the HAL PCD calls
+ * usb_cdc.c makes, with the host side driven by the test one packet at a
+ * time. An IN transfer goes out in max packet sized pieces and ends with the
+ * piece that completes its length (a zero length transfer is one ZLP), an OUT
+ * transfer ends on a short packet or when its buffer is full, like the HAL
+ * does it. EP0 sends one packet per call. Completed transfers, SETUP packets
+ * and bus resets are queued and handed to the HAL callbacks from
+ * HAL_PCD_IRQHandler(), through the simulated OTG_FS interrupt, so masking it
+ * holds them back like on the part.
+ *
+ * Calls the HAL would get wrong or reject are counted as violations: a
+ * transfer on a closed endpoint or one that is still busy, an EP0 transfer
+ * over a packet, a host packet larger than the buffer, and FIFOs that do not
+ * fit the 320 words of OTG FS or an IN endpoint's packets.
+ */
+
+#include "sim.h"
+#include "core_m4.h"
+#include "stm32f4xx_hal.h"
+#include <assert.h>
+#include <string.h>
+
+#define ENDPOINTS   4
+#define FIFO_WORDS  320
+#define EVENT_QUEUE 16
+
+typedef enum {
+    EVENT_SETUP,
+    EVENT_DATA_IN,
+    EVENT_DATA_OUT,
+    EVENT_RESET,
+    EVENT_DISCONNECT
+} kind_t;
+
+typedef struct {
+    kind_t kind;
+    uint8_t ep;
+} event_t;
+
+typedef struct {
+    bool open;
+    bool stalled;
+    bool busy;
+    uint16_t mps;
+    uint8_t *buffer;
+    uint32_t length;
+    uint32_t done;
+} endpoint_t;
+
+static PCD_HandleTypeDef *pcd;
+static bool started;
+static uint8_t address;
+static endpoint_t in_eps[ENDPOINTS];
+static endpoint_t out_eps[ENDPOINTS];
+static uint16_t rx_fifo;
+static uint16_t tx_fifos[ENDPOINTS];
+static uint32_t in_packets[ENDPOINTS];
+static uint32_t violations;
+
+static event_t events[EVENT_QUEUE];
+static uint32_t event_head;
+static uint32_t event_tail;
+
+static endpoint_t *endpoint(uint8_t ep_addr) {
+    assert((ep_addr & 0x7F) < ENDPOINTS);
+    return (ep_addr & 0x80) ? &in_eps[ep_addr & 0x7F] : &out_eps[ep_addr];
+}
+
+/**
+ * @brief Queues an event and takes the interrupt, unless it is masked.
+ */
+static void post(kind_t kind, uint8_t ep) {
+    assert(event_head - event_tail < EVENT_QUEUE);
+    events[event_head++ % EVENT_QUEUE] = (event_t){kind, ep};
+    sim_irq_raise(INT_NUM_OTG_FS);
+    sim_irq_poll();
+}
+
+static void cancel(endpoint_t *ep) {
+    ep->busy = false;
+    ep->buffer = NULL;
+    ep->length = 0;
+    ep->done = 0;
+}
+
+void sim_usb_reset(void) {
+    pcd = NULL;
+    started = false;
+    address = 0;
+    memset(in_eps, 0, sizeof(in_eps));
+    memset(out_eps, 0, sizeof(out_eps));
+    rx_fifo = 0;
+    memset(tx_fifos, 0, sizeof(tx_fifos));
+    memset(in_packets, 0, sizeof(in_packets));
+    violations = 0;
+    event_head = 0;
+    event_tail = 0;
+}
+
+/**
+ * @brief USB reset from the host: every endpoint closes and the address
+ * goes back to 0.
+ */
+void sim_usb_bus_reset(void) {
+    address = 0;
+    memset(in_eps, 0, sizeof(in_eps));
+    memset(out_eps, 0, sizeof(out_eps));
+    post(EVENT_RESET, 0);
+}
+
+/**
+ * @brief The cable is pulled: nothing is open any more.
+ */
+void sim_usb_disconnect(void) {
+    address = 0;
+    memset(in_eps, 0, sizeof(in_eps));
+    memset(out_eps, 0, sizeof(out_eps));
+    post(EVENT_DISCONNECT, 0);
+}
+
+/**
+ * @brief A SETUP packet, which the core always takes on EP0. It ends
+ * whatever EP0 was doing, stall included.
+ */
+void sim_usb_setup(const uint8_t setup[8]) {
+    assert(pcd && started);
+    cancel(&in_eps[0]);
+    cancel(&out_eps[0]);
+    in_eps[0].stalled = false;
+    out_eps[0].stalled = false;
+    memcpy(pcd->Setup, setup, 8);
+    post(EVENT_SETUP, 0);
+}
+
+/**
+ * @brief An IN token: copies the next packet of the transfer on ep into data
+ * and returns its length, SIM_USB_NAK or SIM_USB_STALL.
+ */
+int32_t sim_usb_in(uint8_t ep, uint8_t *data, uint32_t max) {
+    endpoint_t *in = endpoint(ep | 0x80);
+    uint32_t n;
+
+    if (!started || !in->open) {
+        return SIM_USB_NAK;
+    }
+    if (in->stalled) {
+        return SIM_USB_STALL;
+    }
+    if (!in->busy) {
+        return SIM_USB_NAK;
+    }
+
+    n = in->length - in->done;
+    if (n > in->mps) {
+        n = in->mps;
+    }
+    assert(n <= max);
+    memcpy(data, in->buffer + in->done, n);
+    in->done += n;
+    in_packets[ep & 0x7F]++;
+    if (in->done == in->length) {
+        in->busy = false;
+        post(EVENT_DATA_IN, ep & 0x7F);
+    }
+    return (int32_t)n;
+}
+
+/**
+ * @brief An OUT packet of len bytes: returns len once the endpoint took it,
+ * SIM_USB_NAK or SIM_USB_STALL.
+ */
+int32_t sim_usb_out(uint8_t ep, const uint8_t *data, uint32_t len) {
+    endpoint_t *out = endpoint(ep & 0x7F);
+
+    if (!started || !out->open) {
+        return SIM_USB_NAK;
+    }
+    assert(len <= out->mps);
+    if (out->stalled) {
+        return SIM_USB_STALL;
+    }
+    if (!out->busy) {
+        return SIM_USB_NAK;
+    }
+
+    if (len > out->length - out->done) {
+        violations++;
+        len = out->length - out->done;
+    }
+    if (len) {
+        memcpy(out->buffer + out->done, data, len);
+    }
+    out->done += len;
+    if (len < out->mps || out->done == out->length) {
+        out->busy = false;
+        post(EVENT_DATA_OUT, ep & 0x7F);
+    }
+    return (int32_t)len;
+}
+
+/**
+ * @brief A whole control transfer on EP0: SETUP, the data stage into or out
+ * of data, and the status stage. Returns the length of the data stage or
+ * SIM_USB_STALL / SIM_USB_NAK if the device did not answer.
+ */
+int32_t sim_usb_control(uint8_t type, uint8_t request, uint16_t value,
+                        uint16_t index, uint16_t length, uint8_t *data) {
+    const uint8_t setup[8] = {type,         request,     value & 0xFF,
+                              value >> 8,   index & 0xFF, index >> 8,
+                              length & 0xFF, length >> 8};
+    uint8_t packet[64];
+    uint32_t done = 0;
+    int32_t n;
+
+    sim_usb_setup(setup);
+    if (length && (type & 0x80)) {
+        do {
+            n = sim_usb_in(0, packet, sizeof(packet));
+            if (n < 0) {
+                return n;
+            }
+            memcpy(data + done, packet, n);
+            done += n;
+        } while (n == in_eps[0].mps && done < length);
+        n = sim_usb_out(0, NULL, 0);
+    } else {
+        while (done < length) {
+            uint32_t chunk = length - done;
+
+            if (chunk > out_eps[0].mps) {
+                chunk = out_eps[0].mps;
+            }
+            n = sim_usb_out(0, data + done, chunk);
+            if (n < 0) {
+                return n;
+            }
+            done += n;
+        }
+        n = sim_usb_in(0, packet, sizeof(packet));
+        /* The status stage is a ZLP */
+        if (n > 0) {
+            violations++;
+        }
+    }
+    return n < 0 ? n : (int32_t)done;
+}
+
+uint8_t sim_usb_address(void) {
+    return address;
+}
+
+bool sim_usb_ep_open(uint8_t ep_addr) {
+    return endpoint(ep_addr)->open;
+}
+
+bool sim_usb_ep_busy(uint8_t ep_addr) {
+    return endpoint(ep_addr)->busy;
+}
+
+/**
+ * @brief IN packets sent on ep, ZLPs included.
+ */
+uint32_t sim_usb_in_packets(uint8_t ep) {
+    return in_packets[ep & 0x7F];
+}
+
+uint32_t sim_usb_violations(void) {
+    return violations;
+}
+
+/* Weak like the HAL's own, for the tests that do not link a class driver */
+__attribute__((weak)) void HAL_PCD_SetupStageCallback(PCD_HandleTypeDef *hpcd) {
+}
+
+__attribute__((weak)) void HAL_PCD_DataInStageCallback(PCD_HandleTypeDef *hpcd,
+                                                       uint8_t epnum) {
+}
+
+__attribute__((weak)) void HAL_PCD_DataOutStageCallback(PCD_HandleTypeDef *hpcd,
+                                                        uint8_t epnum) {
+}
+
+__attribute__((weak)) void HAL_PCD_ResetCallback(PCD_HandleTypeDef *hpcd) {
+}
+
+__attribute__((weak)) void HAL_PCD_DisconnectCallback(PCD_HandleTypeDef *hpcd) {
+}
+
+/* HAL PCD */
+HAL_StatusTypeDef HAL_PCD_Start(PCD_HandleTypeDef *hpcd) {
+    uint32_t words = rx_fifo;
+
+    for (uint32_t i = 0; i < ENDPOINTS; i++) {
+        words += tx_fifos[i];
+    }
+    if (words > FIFO_WORDS) {
+        violations++;
+    }
+    pcd = hpcd;
+    started = true;
+    return HAL_OK;
+}
+
+void HAL_PCD_IRQHandler(PCD_HandleTypeDef *hpcd) {
+    while (event_tail != event_head) {
+        event_t event = events[event_tail++ % EVENT_QUEUE];
+
+        switch (event.kind) {
+        case EVENT_SETUP:
+            HAL_PCD_SetupStageCallback(hpcd);
+            break;
+        case EVENT_DATA_IN:
+            HAL_PCD_DataInStageCallback(hpcd, event.ep);
+            break;
+        case EVENT_DATA_OUT:
+            HAL_PCD_DataOutStageCallback(hpcd, event.ep);
+            break;
+        case EVENT_RESET:
+            HAL_PCD_ResetCallback(hpcd);
+            break;
+        case EVENT_DISCONNECT:
+            HAL_PCD_DisconnectCallback(hpcd);
+            break;
+        }
+    }
+}
+
+HAL_StatusTypeDef HAL_PCD_SetAddress(PCD_HandleTypeDef *hpcd,
+                                     uint8_t new_address) {
+    address = new_address;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PCD_EP_Open(PCD_HandleTypeDef *hpcd, uint8_t ep_addr,
+                                  uint16_t ep_mps, uint8_t ep_type) {
+    endpoint_t *ep = endpoint(ep_addr);
+
+    if ((ep_addr & 0x80) && tx_fifos[ep_addr & 0x7F] * 4 < ep_mps) {
+        violations++;
+    }
+    cancel(ep);
+    ep->open = true;
+    ep->stalled = false;
+    ep->mps = ep_mps;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PCD_EP_Close(PCD_HandleTypeDef *hpcd, uint8_t ep_addr) {
+    endpoint_t *ep = endpoint(ep_addr);
+
+    cancel(ep);
+    ep->open = false;
+    ep->stalled = false;
+    return HAL_OK;
+}
+
+static HAL_StatusTypeDef start(uint8_t ep_addr, uint8_t *buffer,
+                               uint32_t len) {
+    endpoint_t *ep = endpoint(ep_addr);
+
+    if (!ep->open || ep->busy || ((ep_addr & 0x7F) == 0 && len > ep->mps) ||
+        (len && !buffer)) {
+        violations++;
+        return HAL_ERROR;
+    }
+    ep->busy = true;
+    ep->buffer = buffer;
+    ep->length = len;
+    ep->done = 0;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PCD_EP_Receive(PCD_HandleTypeDef *hpcd, uint8_t ep_addr,
+                                     uint8_t *pBuf, uint32_t len) {
+    return start(ep_addr & 0x7F, pBuf, len);
+}
+
+HAL_StatusTypeDef HAL_PCD_EP_Transmit(PCD_HandleTypeDef *hpcd,
+                                      uint8_t ep_addr, uint8_t *pBuf,
+                                      uint32_t len) {
+    return start(ep_addr | 0x80, pBuf, len);
+}
+
+uint32_t HAL_PCD_EP_GetRxCount(PCD_HandleTypeDef *hpcd, uint8_t ep_addr) {
+    return endpoint(ep_addr & 0x7F)->done;
+}
+
+HAL_StatusTypeDef HAL_PCD_EP_SetStall(PCD_HandleTypeDef *hpcd,
+                                      uint8_t ep_addr) {
+    endpoint(ep_addr)->stalled = true;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PCD_EP_ClrStall(PCD_HandleTypeDef *hpcd,
+                                      uint8_t ep_addr) {
+    endpoint(ep_addr)->stalled = false;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PCDEx_SetRxFiFo(PCD_HandleTypeDef *hpcd, uint16_t size) {
+    rx_fifo = size;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_PCDEx_SetTxFiFo(PCD_HandleTypeDef *hpcd, uint8_t fifo,
+                                      uint16_t size) {
+    assert(fifo < ENDPOINTS);
+    tx_fifos[fifo] = size;
+    return HAL_OK;
+}
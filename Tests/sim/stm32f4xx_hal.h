@@ -0,0 +1,146 @@
+/*
+ * stm32f4xx_hal.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Host stand-in for the HAL and CMSIS headers. The firmware sources include
+ * "stm32f4xx_hal.h" through productDef.h and find this one first, so only the
+ * few CMSIS intrinsics and HAL pieces the tested modules use are declared.
+ * The intrinsics work on the simulated PRIMASK in sim_core.c, the flash API
+ * on the simulated flash in sim_flash.c and the PCD API on the USB endpoint
+ * model in sim_usb.c.
+ */
+
+#ifndef __STM32F4xx_HAL_H
+#define __STM32F4xx_HAL_H
+
+#include <stdint.h>
+
+typedef enum {
+    HAL_OK = 0x00U,
+    HAL_ERROR = 0x01U,
+    HAL_BUSY = 0x02U,
+    HAL_TIMEOUT = 0x03U
+} HAL_StatusTypeDef;
+
+/* Unique device ID, in the simulated system memory */
+#define UID_BASE 0x1FFF7A10UL
+
+extern uint32_t SystemCoreClock;
+
+/* stm_utils.h has its own, bit number based SET_BIT/CLEAR_BIT */
+#ifndef SET_BIT
+#define SET_BIT(reg, bit)   ((reg) |= (bit))
+#define CLEAR_BIT(reg, bit) ((reg) &= ~(bit))
+#endif
+
+/* Flash interface, sim_flash.c */
+typedef struct {
+    volatile uint32_t ACR;
+    volatile uint32_t KEYR;
+    volatile uint32_t OPTKEYR;
+    volatile uint32_t SR;
+    volatile uint32_t CR;
+    volatile uint32_t OPTCR;
+} FLASH_TypeDef;
+
+#define FLASH                      ((FLASH_TypeDef *)0x40023C00UL)
+
+#define FLASH_ACR_DCEN             (1UL << 10)
+#define FLASH_ACR_DCRST            (1UL << 12)
+#define FLASH_CR_PG                (1UL << 0)
+#define FLASH_CR_SER               (1UL << 1)
+#define FLASH_CR_SNB               (0x1FUL << 3)
+#define FLASH_CR_STRT              (1UL << 16)
+
+#define FLASH_FLAG_EOP             (1UL << 0)
+#define FLASH_FLAG_OPERR           (1UL << 1)
+#define FLASH_FLAG_WRPERR          (1UL << 4)
+#define FLASH_FLAG_PGAERR          (1UL << 5)
+#define FLASH_FLAG_PGPERR          (1UL << 6)
+#define FLASH_FLAG_PGSERR          (1UL << 7)
+#define FLASH_FLAG_BSY             (1UL << 16)
+
+#define FLASH_TYPEPROGRAM_BYTE     0x0U
+#define FLASH_TYPEPROGRAM_HALFWORD 0x1U
+#define FLASH_TYPEPROGRAM_WORD     0x2U
+#define FLASH_VOLTAGE_RANGE_3      0x2U
+
+#define FLASH_SECTOR_0             0U
+#define FLASH_SECTOR_1             1U
+#define FLASH_SECTOR_2             2U
+#define FLASH_SECTOR_3             3U
+#define FLASH_SECTOR_4             4U
+#define FLASH_SECTOR_5             5U
+#define FLASH_SECTOR_6             6U
+#define FLASH_SECTOR_7             7U
+
+uint32_t sim_flash_get_flag(uint32_t flag);
+void sim_flash_clear_flag(uint32_t flag);
+
+#define __HAL_FLASH_GET_FLAG(flag)       (sim_flash_get_flag(flag) != 0)
+#define __HAL_FLASH_CLEAR_FLAG(flag)     sim_flash_clear_flag(flag)
+#define __HAL_FLASH_DATA_CACHE_DISABLE() (FLASH->ACR &= ~FLASH_ACR_DCEN)
+#define __HAL_FLASH_DATA_CACHE_ENABLE()  (FLASH->ACR |= FLASH_ACR_DCEN)
+#define __HAL_FLASH_DATA_CACHE_RESET()                                         \
+    do {                                                                       \
+        FLASH->ACR |= FLASH_ACR_DCRST;                                         \
+        FLASH->ACR &= ~FLASH_ACR_DCRST;                                        \
+    } while (0)
+
+HAL_StatusTypeDef HAL_FLASH_Unlock(void);
+HAL_StatusTypeDef HAL_FLASH_Lock(void);
+HAL_StatusTypeDef HAL_FLASH_Program(uint32_t TypeProgram, uint32_t Address,
+                                    uint64_t Data);
+void FLASH_Erase_Sector(uint32_t Sector, uint8_t VoltageRange);
+
+/* USB device (PCD), sim_usb.c */
+typedef struct {
+    uint32_t Setup[12];
+} PCD_HandleTypeDef;
+
+#define EP_TYPE_CTRL 0U
+#define EP_TYPE_ISOC 1U
+#define EP_TYPE_BULK 2U
+#define EP_TYPE_INTR 3U
+
+HAL_StatusTypeDef HAL_PCD_Start(PCD_HandleTypeDef *hpcd);
+void HAL_PCD_IRQHandler(PCD_HandleTypeDef *hpcd);
+HAL_StatusTypeDef HAL_PCD_SetAddress(PCD_HandleTypeDef *hpcd,
+                                     uint8_t address);
+HAL_StatusTypeDef HAL_PCD_EP_Open(PCD_HandleTypeDef *hpcd, uint8_t ep_addr,
+                                  uint16_t ep_mps, uint8_t ep_type);
+HAL_StatusTypeDef HAL_PCD_EP_Close(PCD_HandleTypeDef *hpcd, uint8_t ep_addr);
+HAL_StatusTypeDef HAL_PCD_EP_Receive(PCD_HandleTypeDef *hpcd, uint8_t ep_addr,
+                                     uint8_t *pBuf, uint32_t len);
+HAL_StatusTypeDef HAL_PCD_EP_Transmit(PCD_HandleTypeDef *hpcd,
+                                      uint8_t ep_addr, uint8_t *pBuf,
+                                      uint32_t len);
+uint32_t HAL_PCD_EP_GetRxCount(PCD_HandleTypeDef *hpcd, uint8_t ep_addr);
+HAL_StatusTypeDef HAL_PCD_EP_SetStall(PCD_HandleTypeDef *hpcd,
+                                      uint8_t ep_addr);
+HAL_StatusTypeDef HAL_PCD_EP_ClrStall(PCD_HandleTypeDef *hpcd,
+                                      uint8_t ep_addr);
+HAL_StatusTypeDef HAL_PCDEx_SetRxFiFo(PCD_HandleTypeDef *hpcd, uint16_t size);
+HAL_StatusTypeDef HAL_PCDEx_SetTxFiFo(PCD_HandleTypeDef *hpcd, uint8_t fifo,
+                                      uint16_t size);
+
+/* Callbacks the class driver implements */
+void HAL_PCD_SetupStageCallback(PCD_HandleTypeDef *hpcd);
+void HAL_PCD_DataInStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum);
+void HAL_PCD_DataOutStageCallback(PCD_HandleTypeDef *hpcd, uint8_t epnum);
+void HAL_PCD_ResetCallback(PCD_HandleTypeDef *hpcd);
+void HAL_PCD_DisconnectCallback(PCD_HandleTypeDef *hpcd);
+
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t primask);
+void __disable_irq(void);
+void __enable_irq(void);
+void __DSB(void);
+void __ISB(void);
+void __DMB(void);
+void __WFI(void);
+void __NOP(void);
+
+#endif /* __STM32F4xx_HAL_H */
@@ -0,0 +1,80 @@
+/*
+ * test.h
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Minimal checks for the host tests. A failed CHECK prints where it failed
+ * and the test carries on; TEST_EXIT() turns the failure count into the exit
+ * status make looks at.
+ */
+
+#ifndef TEST_H_
+#define TEST_H_
+
+#include "sim.h"
+#include "stm32f4xx_hal.h"
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static int test_failures = 0;
+
+#define CHECK(cond)                                                            \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #cond);    \
+            test_failures++;                                                   \
+        }                                                                      \
+    } while (0)
+
+#define CHECK_EQ(actual, expected)                                             \
+    do {                                                                       \
+        unsigned long long actual_ = (unsigned long long)(actual);             \
+        unsigned long long expected_ = (unsigned long long)(expected);         \
+        if (actual_ != expected_) {                                            \
+            printf("%s:%d: %s is 0x%llx, expected 0x%llx\n", __FILE__,         \
+                   __LINE__, #actual, actual_, expected_);                     \
+            test_failures++;                                                   \
+        }                                                                      \
+    } while (0)
+
+#define RUN_TEST(test)                                                         \
+    do {                                                                       \
+        printf("  %s\n", #test);                                               \
+        test();                                                                \
+    } while (0)
+
+#define TEST_EXIT()                                                            \
+    do {                                                                       \
+        printf("%s: %s\n", __FILE__, test_failures ? "FAILED" : "ok");         \
+        return test_failures ? 1 : 0;                                          \
+    } while (0)
+
+/**
+ * @brief Runs fn in a child and returns true if it hit an assert. The child
+ * shares the simulated memory, so it is put back afterwards.
+ */
+static inline bool expect_abort(void (*fn)(void)) {
+    void *saved = sim_bus_save();
+    int status = 0;
+    pid_t pid;
+
+    fflush(stdout);
+    pid = fork();
+    if (!pid) {
+        /* The assert message is expected, keep the output clean */
+        freopen("/dev/null", "w", stderr);
+        fn();
+        _exit(0);
+    }
+    waitpid(pid, &status, 0);
+    sim_bus_restore(saved);
+    return WIFSIGNALED(status) && WTERMSIG(status) == SIGABRT;
+}
+
+#endif /* TEST_H_ */
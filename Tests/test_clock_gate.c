@@ -0,0 +1,172 @@
+/*
+ * test_clock_gate.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Reference counting in clock_gate.c against the simulated RCC. Every test
+ * ends with all references released and flushed, and check_balanced()
+ * asserts that nothing was left on.
+ */
+
+#include "clock_gate.h"
+#include "stm_rcc.h"
+#include "test.h"
+
+/* AHB1ENR, AHB2ENR, AHB3ENR, APB1ENR, APB2ENR */
+static const uint32_t enr_offsets[5] = {0x30, 0x34, 0x38, 0x40, 0x44};
+
+#define RCC_ENR(reg) (SIM_RCC_BASE + enr_offsets[reg])
+
+static volatile uint32_t enr_writes[5];
+
+static void count_enr_writes(uint32_t address, uint32_t old, uint32_t value) {
+    for (uint32_t reg = 0; reg < 5; reg++) {
+        if (address == RCC_ENR(reg)) {
+            enr_writes[reg]++;
+        }
+    }
+}
+
+static void setup(void) {
+    sim_bus_reset();
+    sim_core_reset();
+    for (uint32_t reg = 0; reg < 5; reg++) {
+        enr_writes[reg] = 0;
+    }
+    sim_watch(SIM_RCC_BASE, 0x90, count_enr_writes);
+}
+
+/**
+ * @brief Every reference is gone and every enable bit is off again.
+ */
+static void check_balanced(void) {
+    flush_clock_releases();
+    for (uint32_t reg = 0; reg < 5; reg++) {
+        for (uint32_t bit = 0; bit < 32; bit++) {
+            CHECK_EQ(clock_refcount(reg, 1UL << bit), 0);
+        }
+        CHECK_EQ(sim_read(RCC_ENR(reg)), 0);
+    }
+}
+
+static void test_acquire_enables(void) {
+    setup();
+    acquire_clock(TIM2_EN);
+    CHECK_EQ(sim_read(RCC_ENR(3)), BIT0);
+    CHECK_EQ(clock_refcount(TIM2_EN), 1);
+    CHECK_EQ(enr_writes[3], 1);
+
+    /* A second user does not touch the register */
+    acquire_clock(TIM2_EN);
+    CHECK_EQ(clock_refcount(TIM2_EN), 2);
+    CHECK_EQ(enr_writes[3], 1);
+
+    release_clock(TIM2_EN);
+    release_clock(TIM2_EN);
+    check_balanced();
+}
+
+static void test_release_waits_for_flush(void) {
+    setup();
+    acquire_clock(DMA2_EN);
+    release_clock(DMA2_EN);
+    CHECK_EQ(clock_refcount(DMA2_EN), 0);
+    /* Queued, still on */
+    CHECK_EQ(sim_read(RCC_ENR(0)), UPPER16BITS(BIT6));
+    flush_clock_releases();
+    CHECK_EQ(sim_read(RCC_ENR(0)), 0);
+    CHECK_EQ(enr_writes[0], 2);
+    check_balanced();
+}
+
+static void test_reacquire_before_flush(void) {
+    setup();
+    acquire_clock(ADC3_EN);
+    release_clock(ADC3_EN);
+    acquire_clock(ADC3_EN);
+    flush_clock_releases();
+    /* Never switched off in between */
+    CHECK_EQ(sim_read(RCC_ENR(4)), BITA);
+    CHECK_EQ(enr_writes[4], 1);
+    release_clock(ADC3_EN);
+    check_balanced();
+}
+
+static void test_flush_coalesces(void) {
+    setup();
+    acquire_clock(TIM3_EN);
+    acquire_clock(TIM4_EN);
+    acquire_clock(UART3_EN);
+    CHECK_EQ(enr_writes[3], 3);
+
+    release_clock(TIM3_EN);
+    release_clock(TIM4_EN);
+    release_clock(UART3_EN);
+    flush_clock_releases();
+    /* One write gates all three */
+    CHECK_EQ(enr_writes[3], 4);
+    check_balanced();
+}
+
+static void test_multi_bit_masks(void) {
+    setup();
+    acquire_clock(3, BIT1 | BIT2);
+    acquire_clock(TIM2_EN);
+    CHECK_EQ(sim_read(RCC_ENR(3)), BIT0 | BIT1 | BIT2);
+    release_clock(TIM2_EN);
+    release_clock(3, BIT1 | BIT2);
+    check_balanced();
+}
+
+static void test_gpio_clocks(void) {
+    setup();
+    acquire_gpio_clock(bank_a);
+    acquire_gpio_clock(bank_g);
+    CHECK_EQ(sim_read(RCC_ENR(0)), BIT0 | BIT6);
+    release_gpio_clock(bank_g);
+    release_gpio_clock(bank_a);
+    check_balanced();
+}
+
+static void over_release(void) {
+    acquire_clock(TIM5_EN);
+    release_clock(TIM5_EN);
+    release_clock(TIM5_EN);
+}
+
+static void refcount_of_mask(void) {
+    (void)clock_refcount(3, BIT0 | BIT1);
+}
+
+static void test_unbalanced_asserts(void) {
+    setup();
+    CHECK(expect_abort(over_release));
+    CHECK(expect_abort(refcount_of_mask));
+    check_balanced();
+}
+
+static void test_nested_in_interrupt_context(void) {
+    setup();
+    /* Masked callers keep their PRIMASK */
+    __disable_irq();
+    acquire_clock(SPI1_EN);
+    CHECK_EQ(__get_PRIMASK(), 1);
+    release_clock(SPI1_EN);
+    flush_clock_releases();
+    CHECK_EQ(__get_PRIMASK(), 1);
+    __enable_irq();
+    check_balanced();
+}
+
+int main(void) {
+    RUN_TEST(test_acquire_enables);
+    RUN_TEST(test_release_waits_for_flush);
+    RUN_TEST(test_reacquire_before_flush);
+    RUN_TEST(test_flush_coalesces);
+    RUN_TEST(test_multi_bit_masks);
+    RUN_TEST(test_gpio_clocks);
+    RUN_TEST(test_unbalanced_asserts);
+    RUN_TEST(test_nested_in_interrupt_context);
+    TEST_EXIT();
+}
@@ -0,0 +1,379 @@
+/*
+ * test_dma.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * dma.c against the simulated DMA controllers (sim/sim_dma.c), with the
+ * stream interrupts wired to the driver's handlers.
+ */
+
+#include "clock_gate.h"
+#include "core_m4.h"
+#include "dma.h"
+#include "stm_rcc.h"
+#include "test.h"
+#include <string.h>
+
+/* ADC3 data register, the peripheral side of the P2M tests */
+#define ADC3_DR  0x4001224CUL
+
+#define SxCR(stream)                                                           \
+    (SIM_DMA1_BASE + 0x400 * ((stream) >> 3) + 0x10 + 0x18 * ((stream) & 7))
+
+void DMA1_Stream0_IRQHandler(void);
+void DMA1_Stream1_IRQHandler(void);
+void DMA1_Stream2_IRQHandler(void);
+void DMA1_Stream3_IRQHandler(void);
+void DMA1_Stream4_IRQHandler(void);
+void DMA1_Stream5_IRQHandler(void);
+void DMA1_Stream6_IRQHandler(void);
+void DMA1_Stream7_IRQHandler(void);
+void DMA2_Stream0_IRQHandler(void);
+void DMA2_Stream1_IRQHandler(void);
+void DMA2_Stream2_IRQHandler(void);
+void DMA2_Stream3_IRQHandler(void);
+void DMA2_Stream4_IRQHandler(void);
+void DMA2_Stream5_IRQHandler(void);
+void DMA2_Stream6_IRQHandler(void);
+void DMA2_Stream7_IRQHandler(void);
+
+static const struct {
+    uint8_t irq;
+    sim_irq_handler_t handler;
+} vectors[DMA_STREAMS] = {
+    {INT_NUM_DMA1_STREAM0, DMA1_Stream0_IRQHandler},
+    {INT_NUM_DMA1_STREAM1, DMA1_Stream1_IRQHandler},
+    {INT_NUM_DMA1_STREAM2, DMA1_Stream2_IRQHandler},
+    {INT_NUM_DMA1_STREAM3, DMA1_Stream3_IRQHandler},
+    {INT_NUM_DMA1_STREAM4, DMA1_Stream4_IRQHandler},
+    {INT_NUM_DMA1_STREAM5, DMA1_Stream5_IRQHandler},
+    {INT_NUM_DMA1_STREAM6, DMA1_Stream6_IRQHandler},
+    {INT_NUM_DMA1_STREAM7, DMA1_Stream7_IRQHandler},
+    {INT_NUM_DMA2_STREAM0, DMA2_Stream0_IRQHandler},
+    {INT_NUM_DMA2_STREAM1, DMA2_Stream1_IRQHandler},
+    {INT_NUM_DMA2_STREAM2, DMA2_Stream2_IRQHandler},
+    {INT_NUM_DMA2_STREAM3, DMA2_Stream3_IRQHandler},
+    {INT_NUM_DMA2_STREAM4, DMA2_Stream4_IRQHandler},
+    {INT_NUM_DMA2_STREAM5, DMA2_Stream5_IRQHandler},
+    {INT_NUM_DMA2_STREAM6, DMA2_Stream6_IRQHandler},
+    {INT_NUM_DMA2_STREAM7, DMA2_Stream7_IRQHandler}};
+
+static struct {
+    uint32_t calls;
+    dma_stream_t stream;
+    uint32_t events;
+} last;
+
+static void record(dma_stream_t stream, uint32_t events) {
+    last.calls++;
+    last.stream = stream;
+    last.events |= events;
+}
+
+static void setup(void) {
+    sim_bus_reset();
+    sim_core_reset();
+    sim_dma_reset();
+    for (uint32_t i = 0; i < DMA_STREAMS; i++) {
+        sim_irq_attach(vectors[i].irq, vectors[i].handler);
+    }
+    memset(&last, 0, sizeof(last));
+}
+
+static void teardown(void) {
+    flush_clock_releases();
+    CHECK_EQ(clock_refcount(DMA1_EN), 0);
+    CHECK_EQ(clock_refcount(DMA2_EN), 0);
+    CHECK_EQ(sim_dma_violations(), 0);
+}
+
+static dma_config_t adc_config(void) {
+    dma_config_t config = {.channel = 2,
+                           .direction = DMA_PERIPH_TO_MEM,
+                           .peripheral = ADC3_DR,
+                           .peripheral_size = DMA_SIZE_HALF_WORD,
+                           .memory_size = DMA_SIZE_HALF_WORD,
+                           .memory_increment = true,
+                           .priority = DMA_PRIO_HIGH,
+                           .events = DMA_EVENT_TRANSFER_DONE |
+                                     DMA_EVENT_TRANSFER_ERROR,
+                           .callback = record,
+                           .irq_priority = 10};
+    return config;
+}
+
+static void test_claim_and_release(void) {
+    setup();
+    CHECK(dma_claim(DMA2_STREAM0, "adc"));
+    CHECK(!dma_claim(DMA2_STREAM0, "other"));
+    CHECK(dma_claim(DMA2_STREAM3, "other"));
+    CHECK(dma_claim(DMA1_STREAM5, "uart"));
+    CHECK_EQ(clock_refcount(DMA2_EN), 2);
+    CHECK_EQ(clock_refcount(DMA1_EN), 1);
+
+    dma_release(DMA2_STREAM3);
+    dma_release(DMA2_STREAM0);
+    dma_release(DMA1_STREAM5);
+    teardown();
+
+    /* Free again once released */
+    CHECK(dma_claim(DMA2_STREAM0, "adc"));
+    dma_release(DMA2_STREAM0);
+    teardown();
+}
+
+static void test_configure_registers(void) {
+    dma_config_t config = adc_config();
+    uint32_t cr;
+
+    setup();
+    dma_claim(DMA2_STREAM0, "adc");
+    config.channel = 5;
+    config.memory_size = DMA_SIZE_WORD;
+    config.fifo = true;
+    config.fifo_threshold = DMA_FIFO_FULL;
+    config.memory_burst = DMA_BURST_INCR4;
+    dma_configure(DMA2_STREAM0, &config);
+
+    cr = sim_read(SxCR(DMA2_STREAM0));
+    CHECK_EQ((cr >> 25) & 0x7, 5);
+    /* DMA_PRIO_HIGH is PL = 2, not the HAL's DMA_PRIORITY_HIGH */
+    CHECK_EQ(cr & (0x3UL << 16), 2UL << 16);
+    CHECK_EQ((cr >> 23) & 0x3, DMA_BURST_INCR4);
+    CHECK_EQ((cr >> 13) & 0x3, DMA_SIZE_WORD);
+    CHECK_EQ((cr >> 11) & 0x3, DMA_SIZE_HALF_WORD);
+    CHECK_EQ((cr >> 6) & 0x3, DMA_PERIPH_TO_MEM);
+    CHECK_EQ(cr & (BIT0 | BIT1 | BIT3 | BIT8 | BIT9), 0);
+    CHECK_EQ(cr & (BIT2 | BIT4 | BITA), BIT2 | BIT4 | BITA);
+    CHECK_EQ(sim_read(SxCR(DMA2_STREAM0) + 8), ADC3_DR);
+    CHECK_EQ(sim_read(SxCR(DMA2_STREAM0) + 20), BIT2 | DMA_FIFO_FULL);
+
+    CHECK(sim_irq_enabled(INT_NUM_DMA2_STREAM0));
+    CHECK_EQ(sim_irq_priority(INT_NUM_DMA2_STREAM0), 10);
+
+    /* Direct mode, no callback */
+    config = adc_config();
+    config.priority = DMA_PRIO_VERY_HIGH;
+    config.callback = NULL;
+    dma_configure(DMA2_STREAM0, &config);
+    CHECK_EQ(sim_read(SxCR(DMA2_STREAM0) + 20), 0);
+    CHECK_EQ(sim_read(SxCR(DMA2_STREAM0)) & (0x3UL << 16), 3UL << 16);
+    CHECK(!sim_irq_enabled(INT_NUM_DMA2_STREAM0));
+
+    dma_release(DMA2_STREAM0);
+    teardown();
+}
+
+static void test_memory_to_memory(void) {
+    dma_config_t config = {.direction = DMA_MEM_TO_MEM,
+                           .peripheral_size = DMA_SIZE_WORD,
+                           .peripheral_increment = true,
+                           .memory_size = DMA_SIZE_WORD,
+                           .memory_increment = true,
+                           .fifo = true,
+                           .events = DMA_EVENT_TRANSFER_DONE,
+                           .callback = record,
+                           .irq_priority = 13};
+    uint32_t *src = SIM_SRAM(0), *dst = SIM_SRAM(0x1000);
+
+    setup();
+    for (uint32_t i = 0; i < 64; i++) {
+        src[i] = 0xA5000000 | i;
+    }
+    dma_claim(DMA2_STREAM1, "copy");
+    config.peripheral = (uint32_t)src;
+    dma_configure(DMA2_STREAM1, &config);
+
+    __disable_irq();
+    dma_start(DMA2_STREAM1, (uint32_t)dst, 0, 64);
+    /* Done, but the interrupt waits for PRIMASK */
+    CHECK(!memcmp(src, dst, 64 * 4));
+    CHECK_EQ(last.calls, 0);
+    __enable_irq();
+
+    CHECK_EQ(last.calls, 1);
+    CHECK_EQ(last.stream, DMA2_STREAM1);
+    CHECK(last.events & DMA_EVENT_TRANSFER_DONE);
+    CHECK(!dma_busy(DMA2_STREAM1));
+    CHECK_EQ(dma_remaining(DMA2_STREAM1), 0);
+    /* The handler cleared what it reported */
+    CHECK_EQ(dma_read_events(DMA2_STREAM1), 0);
+
+    dma_release(DMA2_STREAM1);
+    teardown();
+}
+
+static void copy_on_dma1(void) {
+    dma_config_t config = {.direction = DMA_MEM_TO_MEM};
+
+    dma_claim(DMA1_STREAM0, "copy");
+    dma_configure(DMA1_STREAM0, &config);
+}
+
+static void circular_copy(void) {
+    dma_config_t config = {.direction = DMA_MEM_TO_MEM, .circular = true};
+
+    dma_claim(DMA2_STREAM1, "copy");
+    dma_configure(DMA2_STREAM1, &config);
+}
+
+static void start_unclaimed(void) {
+    dma_start(DMA2_STREAM4, 0x20000000, 0, 1);
+}
+
+static void test_invalid_use_asserts(void) {
+    setup();
+    CHECK(expect_abort(copy_on_dma1));
+    CHECK(expect_abort(circular_copy));
+    CHECK(expect_abort(start_unclaimed));
+    teardown();
+}
+
+static void test_double_buffer(void) {
+    dma_config_t config = adc_config();
+    uint16_t *ping = SIM_SRAM(0x100), *pong = SIM_SRAM(0x200);
+
+    setup();
+    dma_claim(DMA2_STREAM0, "adc");
+    config.double_buffer = true;
+    config.events |= DMA_EVENT_HALF_TRANSFER;
+    dma_configure(DMA2_STREAM0, &config);
+    dma_start(DMA2_STREAM0, (uint32_t)ping, (uint32_t)pong, 8);
+    CHECK(dma_busy(DMA2_STREAM0));
+    CHECK_EQ(dma_current_target(DMA2_STREAM0), 0);
+
+    /* Half of the first buffer */
+    for (uint16_t i = 0; i < 4; i++) {
+        sim_write(ADC3_DR, 100 + i);
+        sim_dma_request(DMA2_STREAM0, 1);
+    }
+    CHECK_EQ(last.calls, 1);
+    CHECK_EQ(last.events, DMA_EVENT_HALF_TRANSFER);
+    CHECK_EQ(dma_remaining(DMA2_STREAM0), 4);
+
+    for (uint16_t i = 4; i < 8; i++) {
+        sim_write(ADC3_DR, 100 + i);
+        sim_dma_request(DMA2_STREAM0, 1);
+    }
+    CHECK_EQ(last.calls, 2);
+    CHECK(last.events & DMA_EVENT_TRANSFER_DONE);
+    for (uint16_t i = 0; i < 8; i++) {
+        CHECK_EQ(ping[i], 100 + i);
+    }
+    /* Reloaded and swapped, still running */
+    CHECK(dma_busy(DMA2_STREAM0));
+    CHECK_EQ(dma_current_target(DMA2_STREAM0), 1);
+    CHECK_EQ(dma_remaining(DMA2_STREAM0), 8);
+
+    /* The idle buffer may move while the stream runs */
+    dma_set_memory(DMA2_STREAM0, 0, (uint32_t)SIM_SRAM(0x300));
+    sim_write(ADC3_DR, 0x777);
+    CHECK_EQ(sim_dma_request(DMA2_STREAM0, 8), 8);
+    CHECK_EQ(pong[0], 0x777);
+    CHECK_EQ(dma_current_target(DMA2_STREAM0), 0);
+    sim_dma_request(DMA2_STREAM0, 1);
+    CHECK_EQ(*(uint16_t *)SIM_SRAM(0x300), 0x777);
+
+    dma_release(DMA2_STREAM0);
+    CHECK(!dma_busy(DMA2_STREAM0));
+    teardown();
+}
+
+static void move_active_buffer(void) {
+    dma_set_memory(DMA2_STREAM0, dma_current_target(DMA2_STREAM0),
+                   0x20000400);
+}
+
+static void test_active_buffer_asserts(void) {
+    dma_config_t config = adc_config();
+
+    setup();
+    dma_claim(DMA2_STREAM0, "adc");
+    config.double_buffer = true;
+    dma_configure(DMA2_STREAM0, &config);
+    dma_start(DMA2_STREAM0, 0x20000100, 0x20000200, 8);
+    CHECK(expect_abort(move_active_buffer));
+    dma_release(DMA2_STREAM0);
+    teardown();
+}
+
+static void test_transfer_error(void) {
+    dma_config_t config = adc_config();
+
+    setup();
+    dma_claim(DMA2_STREAM0, "adc");
+    dma_configure(DMA2_STREAM0, &config);
+    /* The DMA cannot write flash */
+    dma_start(DMA2_STREAM0, SIM_FLASH_BASE, 0, 4);
+    CHECK_EQ(sim_dma_request(DMA2_STREAM0, 4), 0);
+    CHECK_EQ(last.calls, 1);
+    CHECK_EQ(last.events, DMA_EVENT_TRANSFER_ERROR);
+    CHECK(!dma_busy(DMA2_STREAM0));
+    dma_release(DMA2_STREAM0);
+    teardown();
+}
+
+static void test_stop_drops_events(void) {
+    dma_config_t config = adc_config();
+
+    setup();
+    dma_claim(DMA2_STREAM0, "adc");
+    config.callback = NULL;
+    dma_configure(DMA2_STREAM0, &config);
+    dma_start(DMA2_STREAM0, (uint32_t)SIM_SRAM(0), 0, 4);
+    sim_dma_request(DMA2_STREAM0, 2);
+    dma_stop(DMA2_STREAM0);
+    CHECK(!dma_busy(DMA2_STREAM0));
+    CHECK_EQ(dma_read_events(DMA2_STREAM0), 0);
+    CHECK_EQ(dma_remaining(DMA2_STREAM0), 2);
+    dma_release(DMA2_STREAM0);
+    teardown();
+}
+
+static void test_every_stream_flags(void) {
+    dma_config_t config = {.direction = DMA_MEM_TO_PERIPH,
+                           .peripheral = ADC3_DR,
+                           .memory_increment = true,
+                           .events = DMA_EVENT_TRANSFER_DONE |
+                                     DMA_EVENT_HALF_TRANSFER,
+                           .callback = record,
+                           .irq_priority = 5};
+    uint8_t *data = SIM_SRAM(0);
+
+    setup();
+    data[0] = 0x11;
+    data[1] = 0x22;
+    for (uint32_t i = 0; i < DMA_STREAMS; i++) {
+        dma_stream_t stream = (dma_stream_t)i;
+
+        memset(&last, 0, sizeof(last));
+        CHECK(dma_claim(stream, "test"));
+        dma_configure(stream, &config);
+        dma_start(stream, (uint32_t)data, 0, 2);
+        CHECK_EQ(sim_dma_request(stream, 2), 2);
+        /* The stream's own handler, with its own flags */
+        CHECK_EQ(last.stream, stream);
+        CHECK_EQ(last.events,
+                 DMA_EVENT_TRANSFER_DONE | DMA_EVENT_HALF_TRANSFER);
+        CHECK_EQ(sim_read(ADC3_DR) & 0xFF, 0x22);
+        CHECK_EQ(sim_read(SIM_DMA1_BASE) | sim_read(SIM_DMA1_BASE + 4) |
+                     sim_read(SIM_DMA2_BASE) | sim_read(SIM_DMA2_BASE + 4),
+                 0);
+        dma_release(stream);
+    }
+    teardown();
+}
+
+int main(void) {
+    RUN_TEST(test_claim_and_release);
+    RUN_TEST(test_configure_registers);
+    RUN_TEST(test_memory_to_memory);
+    RUN_TEST(test_invalid_use_asserts);
+    RUN_TEST(test_double_buffer);
+    RUN_TEST(test_active_buffer_asserts);
+    RUN_TEST(test_transfer_error);
+    RUN_TEST(test_stop_drops_events);
+    RUN_TEST(test_every_stream_flags);
+    TEST_EXIT();
+}
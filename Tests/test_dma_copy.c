@@ -0,0 +1,261 @@
+/*
+ * test_dma_copy.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * dma_copy.c on the simulated DMA2. dma_copy.c is included to check which
+ * engine did the work. The simulated stream finishes a memory to memory
+ * transfer as soon as it is enabled, so masking interrupts is what holds
+ * requests in the queue.
+ */
+
+#include "../Core/Src/dma_copy.c"
+#include "clock_gate.h"
+#include "stm_rcc.h"
+#include "test.h"
+
+#define QUEUE_DEPTH (DMA_COPY_QUEUE + 1)
+
+void DMA2_Stream1_IRQHandler(void);
+
+static struct {
+    uint32_t calls;
+    uintptr_t order[2 * QUEUE_DEPTH];
+} done;
+
+static void record(void *context) {
+    if (done.calls < 2 * QUEUE_DEPTH) {
+        done.order[done.calls] = (uintptr_t)context;
+    }
+    done.calls++;
+}
+
+static void setup(void) {
+    sim_bus_reset();
+    sim_core_reset();
+    sim_dma_reset();
+    sim_irq_attach(INT_NUM_DMA2_STREAM1, DMA2_Stream1_IRQHandler);
+    memset(&done, 0, sizeof(done));
+    dma_copies = 0;
+    cpu_copies = 0;
+    dma_errors = 0;
+    init_dma_copy();
+}
+
+static void teardown(void) {
+    CHECK(!dma_copy_busy());
+    ready = false;
+    dma_release(COPY_STREAM);
+    flush_clock_releases();
+    CHECK_EQ(clock_refcount(DMA2_EN), 0);
+    CHECK_EQ(sim_dma_violations(), 0);
+}
+
+static void fill_pattern(uint8_t *buffer, uint32_t length, uint8_t seed) {
+    for (uint32_t i = 0; i < length; i++) {
+        buffer[i] = (uint8_t)(seed + i * 7 + (i >> 8));
+    }
+}
+
+static void test_small_on_cpu(void) {
+    uint8_t *src = SIM_SRAM(0), *dst = SIM_SRAM(0x1000);
+
+    setup();
+    fill_pattern(src, DMA_COPY_THRESHOLD - 1, 1);
+    dma_memcpy(dst, src, DMA_COPY_THRESHOLD - 1, record, (void *)1);
+    /* Done before the call returns, the stream never started */
+    CHECK_EQ(done.calls, 1);
+    CHECK(!memcmp(dst, src, DMA_COPY_THRESHOLD - 1));
+    CHECK_EQ(cpu_copies, 1);
+    CHECK_EQ(dma_copies, 0);
+    CHECK_EQ(sim_read(SIM_DMA2_BASE + 0x10 + 0x18 + 4), 0);
+    teardown();
+}
+
+static void test_word_copy(void) {
+    uint8_t *src = SIM_SRAM(0), *dst = SIM_SRAM(0x4000);
+    uint32_t length = 0x2000;
+
+    setup();
+    fill_pattern(src, length, 2);
+    __disable_irq();
+    dma_memcpy(dst, src, length, record, (void *)1);
+    /* The data is there, the callback waits for the interrupt */
+    CHECK(!memcmp(dst, src, length));
+    CHECK_EQ(done.calls, 0);
+    CHECK(dma_copy_busy());
+    CHECK_EQ((sim_read(SIM_DMA2_BASE + 0x28) >> 13) & 0x3, DMA_SIZE_WORD);
+    __enable_irq();
+
+    CHECK_EQ(done.calls, 1);
+    CHECK(!dma_copy_busy());
+    CHECK_EQ(dma_copies, 1);
+    CHECK_EQ(cpu_copies, 0);
+    teardown();
+}
+
+static void test_unaligned_copy(void) {
+    uint8_t *src = SIM_SRAM(0x1), *dst = SIM_SRAM(0x4002);
+    uint8_t *guard = SIM_SRAM(0x4002 + 1000);
+
+    setup();
+    fill_pattern(src, 1000, 3);
+    *guard = 0x5A;
+    dma_memcpy(dst, src, 1000, record, NULL);
+    CHECK(!memcmp(dst, src, 1000));
+    CHECK_EQ(*guard, 0x5A);
+    CHECK_EQ(*(dst - 1), 0);
+    CHECK_EQ((sim_read(SIM_DMA2_BASE + 0x28) >> 13) & 0x3, DMA_SIZE_BYTE);
+    CHECK_EQ(done.calls, 1);
+    teardown();
+}
+
+static void test_fill(void) {
+    uint8_t *dst = SIM_SRAM(0x100);
+
+    setup();
+    memset(SIM_SRAM(0), 0x11, 0x800);
+    dma_memset(dst, 0xC3, 0x400, record, NULL);
+    for (uint32_t i = 0; i < 0x400; i++) {
+        CHECK_EQ(dst[i], 0xC3);
+    }
+    /* Nothing on either side */
+    CHECK_EQ(*(dst - 1), 0x11);
+    CHECK_EQ(dst[0x400], 0x11);
+    CHECK_EQ(done.calls, 1);
+
+    /* Odd start and length, byte items */
+    dma_memset(dst + 3, 0x00, 0x201, record, NULL);
+    CHECK_EQ(dst[2], 0xC3);
+    CHECK_EQ(dst[3], 0x00);
+    CHECK_EQ(dst[0x203], 0x00);
+    CHECK_EQ(dst[0x204], 0xC3);
+    CHECK_EQ(dma_copies, 2);
+    teardown();
+}
+
+static void test_chunks(void) {
+    static uint32_t words[COPY_MAX_ITEMS + 3];
+    /* More bytes than one NDTR load, read from flash */
+    const uint8_t *src = (const uint8_t *)(SIM_FLASH_BASE + 0x10001);
+    uint8_t *dst = SIM_SRAM(0x3);
+    uint32_t length = COPY_MAX_ITEMS + 5000;
+
+    setup();
+    fill_pattern(sim_alias((uint32_t)src, length), length, 4);
+    dma_memcpy(dst, src, length, record, NULL);
+    CHECK(!memcmp(dst, src, length));
+    CHECK_EQ(done.calls, 1);
+    CHECK_EQ(dma_copies, 1);
+    CHECK_EQ(dma_errors, 0);
+
+    /* Words, 0xFFFF of them and then the rest. Too big for SRAM, so a
+     * static as the firmware would have */
+    memset(words, 0, sizeof(words));
+    dma_memset(words, 0xEE, 4 * COPY_MAX_ITEMS + 8, record, NULL);
+    CHECK_EQ(words[COPY_MAX_ITEMS - 1], 0xEEEEEEEE);
+    CHECK_EQ(words[COPY_MAX_ITEMS + 1], 0xEEEEEEEE);
+    CHECK_EQ(words[COPY_MAX_ITEMS + 2], 0);
+    CHECK_EQ(done.calls, 2);
+    teardown();
+}
+
+static void test_queue(void) {
+    uint32_t *dst = SIM_SRAM(0);
+
+    setup();
+    __disable_irq();
+    for (uintptr_t i = 0; i < QUEUE_DEPTH; i++) {
+        dma_memset(dst + i * 64, (uint8_t)(i + 1), 256, record,
+                   (void *)(i + 1));
+    }
+    CHECK_EQ(done.calls, 0);
+    /* Only the first one has run so far */
+    CHECK_EQ(dst[0], 0x01010101);
+    CHECK_EQ(dst[64], 0);
+
+    /* The queue is full, the CPU takes this one straight away */
+    dma_memset(dst + QUEUE_DEPTH * 64, 0x77, 256, record, (void *)99);
+    CHECK_EQ(done.calls, 1);
+    CHECK_EQ(done.order[0], 99);
+    CHECK_EQ(cpu_copies, 1);
+    __enable_irq();
+
+    /* The rest in order, each started by the interrupt of the one before */
+    CHECK_EQ(done.calls, QUEUE_DEPTH + 1);
+    for (uintptr_t i = 0; i < QUEUE_DEPTH; i++) {
+        CHECK_EQ(done.order[i + 1], i + 1);
+        CHECK_EQ(dst[i * 64 + 63], (i + 1) * 0x01010101);
+    }
+    CHECK_EQ(dma_copies, QUEUE_DEPTH);
+    teardown();
+}
+
+static void chain(void *context) {
+    uintptr_t left = (uintptr_t)context;
+
+    record(context);
+    if (left) {
+        dma_memset(SIM_SRAM(left * 0x100), (uint8_t)left, 0x100, chain,
+                   (void *)(left - 1));
+    }
+}
+
+static void test_callback_queues_next(void) {
+    setup();
+    chain((void *)3);
+    CHECK_EQ(done.calls, 4);
+    CHECK_EQ(*(uint8_t *)SIM_SRAM(0x1FF), 1);
+    CHECK_EQ(*(uint8_t *)SIM_SRAM(0x300), 3);
+    CHECK_EQ(dma_copies, 3);
+    teardown();
+}
+
+static void test_error_falls_back(void) {
+    /* The DMA cannot write flash, the CPU finishes the request */
+    uint8_t *dst = (uint8_t *)(SIM_FLASH_BASE + 0x20000);
+
+    setup();
+    dma_memset(dst, 0x42, 0x200, record, NULL);
+    CHECK_EQ(dma_errors, 1);
+    CHECK_EQ(done.calls, 1);
+    CHECK_EQ(dst[0x1FF], 0x42);
+    teardown();
+}
+
+static void test_before_init(void) {
+    uint8_t *dst = SIM_SRAM(0);
+
+    setup();
+    ready = false;
+    dma_memset(dst, 0x99, 0x400, record, NULL);
+    CHECK_EQ(done.calls, 1);
+    CHECK_EQ(dst[0x3FF], 0x99);
+    CHECK_EQ(cpu_copies, 1);
+    teardown();
+}
+
+static void copy_to_null(void) {
+    dma_memcpy(NULL, SIM_SRAM(0), 4, NULL, NULL);
+}
+
+static void test_null_asserts(void) {
+    setup();
+    CHECK(expect_abort(copy_to_null));
+    teardown();
+}
+
+int main(void) {
+    RUN_TEST(test_small_on_cpu);
+    RUN_TEST(test_word_copy);
+    RUN_TEST(test_unaligned_copy);
+    RUN_TEST(test_fill);
+    RUN_TEST(test_chunks);
+    RUN_TEST(test_queue);
+    RUN_TEST(test_callback_queues_next);
+    RUN_TEST(test_error_falls_back);
+    RUN_TEST(test_before_init);
+    RUN_TEST(test_null_asserts);
+    TEST_EXIT();
+}
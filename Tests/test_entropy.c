@@ -0,0 +1,303 @@
+/*
+ * test_entropy.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Statistical checks of the entropy.c output. The generator is checked
+ * against the published xoshiro128++ sequence first, then a few million
+ * draws go through frequency, chi-square and correlation tests, and the
+ * bounded API through bias tests that a plain modulo would fail. The seed is
+ * fixed, so the results are repeatable; the limits sit around p = 1e-5.
+ */
+
+#include "../Core/Src/entropy.c"
+#include "test.h"
+#include <math.h>
+#include <string.h>
+
+#define DRAWS     (1UL << 21)
+#define Z_LIMIT   4.42
+
+/* Slapper wait time, see slapper.c */
+#define WAIT_MIN  1700
+#define WAIT_MAX  3281
+
+static uint32_t stored_seed;
+static uint32_t seed_writes;
+static uint16_t adc_value;
+
+uint16_t adc_sampler_latest(uint8_t index) {
+    return adc_value;
+}
+
+uint32_t storage_get_or(storage_key_t key, uint32_t fallback) {
+    return key == KEY_RANDOM_SEED && seed_writes ? stored_seed : fallback;
+}
+
+void storage_set(storage_key_t key, uint32_t value) {
+    CHECK_EQ(key, KEY_RANDOM_SEED);
+    stored_seed = value;
+    seed_writes++;
+}
+
+/**
+ * @brief Chi-square limit for df degrees of freedom (Wilson-Hilferty) at z
+ * standard deviations, negative z for the lower one.
+ */
+static double chi_square_limit(double df, double z) {
+    double a = 2.0 / (9.0 * df);
+
+    return df * pow(1.0 - a + z * sqrt(a), 3);
+}
+
+static double chi_square(const uint64_t *bins, uint32_t n, uint64_t draws) {
+    double expected = (double)draws / n;
+    double sum = 0;
+
+    for (uint32_t i = 0; i < n; i++) {
+        double d = (double)bins[i] - expected;
+        sum += d * d / expected;
+    }
+    return sum;
+}
+
+static void check_chi_square(const char *name, const uint64_t *bins,
+                             uint32_t n, uint64_t draws) {
+    double x = chi_square(bins, n, draws);
+    double low = chi_square_limit(n - 1, -Z_LIMIT);
+    double high = chi_square_limit(n - 1, Z_LIMIT);
+
+    printf("    %s: chi2 %.1f, df %u, limits %.1f-%.1f\n", name, x, n - 1, low,
+           high);
+    CHECK(x > low && x < high);
+}
+
+static void seed(uint32_t uid0) {
+    sim_bus_reset();
+    sim_core_reset();
+    sim_write(UID_BASE, uid0);
+    sim_write(UID_BASE + 4, 0x00470038);
+    sim_write(UID_BASE + 8, 0x32385108);
+    CYCLE_COUNTER = 0x12345;
+    memset(state, 0, sizeof(state));
+    memset(pool, 0, sizeof(pool));
+    pool_index = 0;
+    pool_bits = 0;
+    seed_saved = false;
+    seed_writes = 0;
+    init_entropy();
+}
+
+static void test_reference_sequence(void) {
+    static const uint32_t expected[] = {641,        1573767,    3222811527,
+                                        3517856514, 836907274,  4247214768,
+                                        3867114732, 1355841295};
+
+    state[0] = 1;
+    state[1] = 2;
+    state[2] = 3;
+    state[3] = 4;
+    for (uint32_t i = 0; i < sizeof(expected) / sizeof(expected[0]); i++) {
+        CHECK_EQ(random_u32(), expected[i]);
+    }
+}
+
+static void test_bit_frequencies(void) {
+    static uint64_t bit_ones[32];
+    uint64_t ones = 0;
+    double n = (double)DRAWS;
+
+    seed(0x001F0041);
+    memset(bit_ones, 0, sizeof(bit_ones));
+    for (uint32_t i = 0; i < DRAWS; i++) {
+        uint32_t x = random_u32();
+
+        ones += __builtin_popcount(x);
+        for (uint32_t bit = 0; bit < 32; bit++) {
+            bit_ones[bit] += (x >> bit) & 1;
+        }
+    }
+
+    /* Monobit over every bit, then each position on its own */
+    CHECK(fabs((ones - 16 * n) / sqrt(8 * n)) < Z_LIMIT);
+    for (uint32_t bit = 0; bit < 32; bit++) {
+        double z = (bit_ones[bit] - n / 2) / sqrt(n / 4);
+        if (fabs(z) >= Z_LIMIT) {
+            printf("    bit %u: z %.2f\n", bit, z);
+        }
+        CHECK(fabs(z) < Z_LIMIT);
+    }
+}
+
+static void test_byte_distribution(void) {
+    static uint64_t bytes[256], pairs[256];
+    uint32_t previous = 0;
+
+    seed(0x001F0042);
+    memset(bytes, 0, sizeof(bytes));
+    memset(pairs, 0, sizeof(pairs));
+    for (uint32_t i = 0; i < DRAWS; i++) {
+        uint32_t x = random_u32();
+
+        for (uint32_t k = 0; k < 4; k++) {
+            bytes[(x >> (8 * k)) & 0xFF]++;
+        }
+        /* Top nibbles of consecutive draws */
+        pairs[((previous >> 28) << 4) | (x >> 28)]++;
+        previous = x;
+    }
+    check_chi_square("bytes", bytes, 256, 4 * (uint64_t)DRAWS);
+    check_chi_square("serial pairs", pairs, 256, DRAWS);
+}
+
+static void test_serial_correlation(void) {
+    double sum = 0, sum_sq = 0, sum_lag = 0, previous;
+    double n = (double)DRAWS, mean, r;
+
+    seed(0x001F0043);
+    previous = random_u32() / 4294967296.0;
+    for (uint32_t i = 0; i < DRAWS; i++) {
+        double x = random_u32() / 4294967296.0;
+
+        sum += x;
+        sum_sq += x * x;
+        sum_lag += x * previous;
+        previous = x;
+    }
+    mean = sum / n;
+    r = (sum_lag / n - mean * mean) / (sum_sq / n - mean * mean);
+    printf("    lag 1 correlation %.6f\n", r);
+    CHECK(fabs(r) * sqrt(n) < Z_LIMIT);
+}
+
+static void test_below_small_bounds(void) {
+    static uint64_t bins[10];
+    static uint64_t waits[WAIT_MAX - WAIT_MIN + 1];
+    uint32_t span = WAIT_MAX - WAIT_MIN + 1;
+
+    seed(0x001F0044);
+    memset(bins, 0, sizeof(bins));
+    for (uint32_t i = 0; i < DRAWS; i++) {
+        uint32_t x = random_below(10);
+        CHECK(x < 10);
+        bins[x < 10 ? x : 0]++;
+    }
+    check_chi_square("random_below(10)", bins, 10, DRAWS);
+
+    memset(waits, 0, sizeof(waits));
+    for (uint32_t i = 0; i < DRAWS; i++) {
+        uint32_t x = random_range(WAIT_MIN, WAIT_MAX);
+
+        if (x < WAIT_MIN || x > WAIT_MAX) {
+            CHECK(false);
+            continue;
+        }
+        waits[x - WAIT_MIN]++;
+    }
+    check_chi_square("slapper waits", waits, span, DRAWS);
+    CHECK(waits[0] && waits[span - 1]);
+}
+
+static void test_below_without_bias(void) {
+    /* A plain random_u32() % bound puts half the draws below 2^30 */
+    uint32_t bound = 0xC0000000UL;
+    uint64_t low = 0;
+    double n = (double)DRAWS, z;
+
+    seed(0x001F0045);
+    for (uint32_t i = 0; i < DRAWS; i++) {
+        uint32_t x = random_below(bound);
+        CHECK(x < bound);
+        low += x < 0x40000000UL;
+    }
+    z = (low - n / 3) / sqrt(n * (1.0 / 3) * (2.0 / 3));
+    printf("    below 2^30: %.4f (1/3 expected)\n", low / n);
+    CHECK(fabs(z) < Z_LIMIT);
+}
+
+static void test_range_edges(void) {
+    seed(0x001F0046);
+    for (uint32_t i = 0; i < 1000; i++) {
+        CHECK_EQ(random_range(7, 7), 7);
+        CHECK(random_below(1) == 0);
+    }
+    /* The full span wraps to 0 and falls through to random_u32() */
+    (void)random_range(0, UINT32_MAX);
+}
+
+static void below_zero(void) {
+    (void)random_below(0);
+}
+
+static void inverted_range(void) {
+    (void)random_range(5, 4);
+}
+
+static void test_bad_arguments_assert(void) {
+    CHECK(expect_abort(below_zero));
+    CHECK(expect_abort(inverted_range));
+}
+
+static void test_seeding(void) {
+    uint32_t first, other;
+
+    seed(0x001F0047);
+    first = random_u32();
+    seed(0x001F0048);
+    other = random_u32();
+    /* Another board (UID) gives another sequence */
+    CHECK(first != other);
+
+    seed(0x001F0047);
+    CHECK_EQ(random_u32(), first);
+}
+
+static void test_reseed(void) {
+    uint32_t before[4];
+
+    seed(0x001F0049);
+    for (uint32_t i = 0; i < ENTROPY_RESEED_BITS / ENTROPY_EVENT_BITS - 1;
+         i++) {
+        entropy_add(i * 0x1337, ENTROPY_EVENT_BITS);
+    }
+    memcpy(before, state, sizeof(before));
+    entropy_service();
+    /* Not enough bits yet */
+    CHECK(!memcmp(before, state, sizeof(before)));
+    CHECK_EQ(seed_writes, 0);
+
+    adc_value = 0x5A5;
+    harvest_entropy();
+    entropy_add(0xBEEF, ENTROPY_EVENT_BITS);
+    entropy_service();
+    CHECK(memcmp(before, state, sizeof(before)) != 0);
+    CHECK_EQ(pool_bits, 0);
+    /* The seed for the next boot is saved once */
+    CHECK_EQ(seed_writes, 1);
+    pool_bits = ENTROPY_RESEED_BITS;
+    entropy_service();
+    CHECK_EQ(seed_writes, 1);
+}
+
+static void test_never_all_zero(void) {
+    memset(state, 0, sizeof(state));
+    memset(pool, 0, sizeof(pool));
+    reseed();
+    CHECK(state[0] | state[1] | state[2] | state[3]);
+}
+
+int main(void) {
+    RUN_TEST(test_reference_sequence);
+    RUN_TEST(test_bit_frequencies);
+    RUN_TEST(test_byte_distribution);
+    RUN_TEST(test_serial_correlation);
+    RUN_TEST(test_below_small_bounds);
+    RUN_TEST(test_below_without_bias);
+    RUN_TEST(test_range_edges);
+    RUN_TEST(test_bad_arguments_assert);
+    RUN_TEST(test_seeding);
+    RUN_TEST(test_reseed);
+    RUN_TEST(test_never_all_zero);
+    TEST_EXIT();
+}
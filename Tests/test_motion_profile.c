@@ -0,0 +1,182 @@
+/*
+ * test_motion_profile.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * motion_profile.c against its limits. The control loop sees the tables
+ * through sample_motion_profile(), so the velocity, acceleration and jerk are
+ * taken from the table entries: linear interpolation between them cannot go
+ * past the entries, and their differences bound the average acceleration and
+ * jerk over 2^MOTION_TABLE_SHIFT ticks. Moves that reach their limits must
+ * also take the textbook time, so the limits are used and not just obeyed.
+ */
+
+#include "motion_profile.h"
+#include "motor_control.h"
+#include "test.h"
+#include <math.h>
+
+#define TABLE_TICKS (1 << MOTION_TABLE_SHIFT)
+#define FULL_MOVE   (SLAP_POSITION - RESET_POSITION)
+
+/* Relative, for the float integration and the scaling to the target */
+#define LIMIT_TOLERANCE 0.01
+
+typedef struct {
+    const char *name;
+    motion_limits_t limits;
+    q15_t distance;
+    /* Expected duration in seconds, 0 if the move is too short for it */
+    double seconds;
+} profile_case_t;
+
+static motion_profile_t profile;
+
+static double q31(q31_t value) {
+    return value / 2147483648.0;
+}
+
+/**
+ * @brief Builds a profile and checks it: from rest to exactly the target,
+ * monotonic, and within the limits. Returns the worst ratio of a derivative
+ * to its limit.
+ */
+static double check_profile(const profile_case_t *c) {
+    const motion_limits_t *l = &c->limits;
+    double travel = c->distance / 32768.0, scale = travel * MOTOR_CONTROL_HZ;
+    double peak_v = 0, peak_a = 0, peak_j = 0, prev_a = 0;
+    q31_t position, velocity, last = 0;
+
+    build_motion_profile(&profile, *l, c->distance, MOTOR_CONTROL_HZ);
+
+    sample_motion_profile(&profile, 0, &position, &velocity);
+    CHECK_EQ(position, 0);
+    CHECK_EQ(velocity, 0);
+    for (uint32_t tick = 0; tick <= MOTION_MAX_TICKS + TABLE_TICKS; tick++) {
+        sample_motion_profile(&profile, tick, &position, &velocity);
+        CHECK(position >= last);
+        CHECK(velocity >= 0);
+        last = position;
+    }
+    /* Done at profile->ticks and at rest after */
+    sample_motion_profile(&profile, profile.ticks + TABLE_TICKS, &position,
+                          &velocity);
+    CHECK_EQ(position, INT32_MAX);
+    CHECK_EQ(velocity, 0);
+
+    /* Velocity in travel per second, the differences over the table spacing
+     * in travel per second^2 and ^3 */
+    for (uint32_t i = 0; i < MOTION_TABLE_SIZE; i++) {
+        double v = q31(profile.velocity[i]) * scale, a = 0;
+
+        peak_v = fmax(peak_v, v / l->max_velocity);
+        if (i > 0) {
+            a = (v - q31(profile.velocity[i - 1]) * scale) * MOTOR_CONTROL_HZ /
+                TABLE_TICKS;
+            peak_a = fmax(peak_a, fabs(a) / l->max_acceleration);
+        }
+        if (i > 1 && l->shape == MOTION_S_CURVE) {
+            peak_j = fmax(peak_j, fabs(a - prev_a) * MOTOR_CONTROL_HZ /
+                                      TABLE_TICKS / l->max_jerk);
+        }
+        prev_a = a;
+    }
+
+    printf("    %s: %u ticks, peak velocity %.1f%%, acceleration %.1f%%, "
+           "jerk %.1f%% of the limits\n",
+           c->name, profile.ticks, 100 * peak_v, 100 * peak_a, 100 * peak_j);
+    CHECK(peak_v <= 1 + LIMIT_TOLERANCE);
+    CHECK(peak_a <= 1 + LIMIT_TOLERANCE);
+    CHECK(peak_j <= 1 + LIMIT_TOLERANCE);
+    if (c->seconds > 0) {
+        CHECK(fabs(profile.ticks - c->seconds * MOTOR_CONTROL_HZ) <= 1);
+    }
+    return fmax(peak_v, fmax(peak_a, peak_j));
+}
+
+static void test_motor_moves(void) {
+    /* The limits motor_control.c starts with, over the full travel. The slap
+     * is too short for 40/s: v^2 / a + v a / j = d gives 33.6/s, and the
+     * move takes d / v + v / a + a / j */
+    static const profile_case_t moves[] = {
+        {"slap",
+         {MOTION_S_CURVE, 40.0f, 2000.0f, 200000.0f},
+         FULL_MOVE,
+         0.053589},
+        {"reset", {MOTION_TRAPEZOID, 10.0f, 400.0f}, FULL_MOVE,
+         0.9 / 10 + 10.0 / 400},
+    };
+
+    for (uint32_t i = 0; i < 2; i++) {
+        /* Each reaches at least one of its limits */
+        CHECK(check_profile(&moves[i]) >= 1 - LIMIT_TOLERANCE);
+    }
+}
+
+static void test_full_s_curve(void) {
+    /* Reaches all three limits, d / v + v / a + a / j */
+    static const profile_case_t full = {
+        "full S-curve",
+        {MOTION_S_CURVE, 10.0f, 400.0f, 40000.0f},
+        FULL_MOVE,
+        0.9 / 10 + 10.0 / 400 + 400.0 / 40000};
+
+    CHECK(check_profile(&full) >= 1 - LIMIT_TOLERANCE);
+}
+
+static void test_short_moves(void) {
+    /* Too short to reach the velocity, then the acceleration as well */
+    static const profile_case_t moves[] = {
+        {"short trapezoid", {MOTION_TRAPEZOID, 10.0f, 400.0f}, Q15(0.1f), 0},
+        {"short S-curve",
+         {MOTION_S_CURVE, 40.0f, 2000.0f, 200000.0f},
+         Q15(0.2f),
+         0},
+        {"tiny S-curve",
+         {MOTION_S_CURVE, 40.0f, 2000.0f, 200000.0f},
+         Q15(0.002f),
+         0},
+    };
+    const double triangle = 2 * sqrt(0.1 / 400.0);
+
+    for (uint32_t i = 0; i < 3; i++) {
+        check_profile(&moves[i]);
+    }
+    /* The short trapezoid is a triangle, 2 sqrt(d / a) */
+    build_motion_profile(&profile, moves[0].limits, moves[0].distance,
+                         MOTOR_CONTROL_HZ);
+    CHECK(fabs(profile.ticks - triangle * MOTOR_CONTROL_HZ) <= 1);
+}
+
+static void test_soft_jerk(void) {
+    /* The jerk limit keeps the acceleration from ever reaching its limit,
+     * the ramps take 2 sqrt(v / j) */
+    static const profile_case_t soft = {
+        "soft S-curve",
+        {MOTION_S_CURVE, 10.0f, 2000.0f, 20000.0f},
+        FULL_MOVE,
+        0.9 / 10 + 2 * sqrt(10.0 / 20000)};
+
+    check_profile(&soft);
+}
+
+static void build_too_long(void) {
+    motion_limits_t slow = {MOTION_TRAPEZOID, 1.0f, 400.0f};
+
+    build_motion_profile(&profile, slow, FULL_MOVE, MOTOR_CONTROL_HZ);
+}
+
+static void test_too_long(void) {
+    /* More than MOTION_MAX_TICKS does not fit the table */
+    CHECK(expect_abort(build_too_long));
+}
+
+int main(void) {
+    RUN_TEST(test_motor_moves);
+    RUN_TEST(test_full_s_curve);
+    RUN_TEST(test_short_moves);
+    RUN_TEST(test_soft_jerk);
+    RUN_TEST(test_too_long);
+    TEST_EXIT();
+}
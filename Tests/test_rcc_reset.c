@@ -0,0 +1,201 @@
+/*
+ * test_rcc_reset.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * Reset engine of stm_rcc.c against a simulated RCC that logs every write to
+ * the reset registers. stm_rcc.c is included so the bus divider behind the
+ * hold time can be checked directly.
+ */
+
+#include "../Core/Src/stm_rcc.c"
+#include "test.h"
+
+#define RCC_CFGR_ADDR   (SIM_RCC_BASE + 0x08)
+#define RCC_PLLCFG_ADDR (SIM_RCC_BASE + 0x04)
+#define RCC_BDCR_ADDR   (SIM_RCC_BASE + 0x70)
+
+/* 16 MHz HSI / 8 * 168 / 2, AHB /1, APB1 /4, APB2 /2 */
+#define PLLCFGR_168MHZ  (8 | (168 << 6))
+#define CFGR_168MHZ     (0x8 | (5 << 10) | (4 << 13))
+
+#define MAX_LOG         16
+
+typedef struct {
+    uint32_t address;
+    uint32_t old;
+    uint32_t value;
+} rcc_write_t;
+
+static const uint32_t rstr_addresses[RESET_REGISTERS] = {
+    SIM_RCC_BASE + 0x10, SIM_RCC_BASE + 0x14, SIM_RCC_BASE + 0x18,
+    SIM_RCC_BASE + 0x20, SIM_RCC_BASE + 0x24};
+
+static volatile rcc_write_t log_entries[MAX_LOG];
+static volatile uint32_t log_length;
+
+static void log_write(uint32_t address, uint32_t old, uint32_t value) {
+    if (address == RCC_CFGR_ADDR || address == RCC_PLLCFG_ADDR) {
+        return;
+    }
+    if (log_length < MAX_LOG) {
+        log_entries[log_length] = (rcc_write_t){address, old, value};
+    }
+    log_length++;
+}
+
+static void setup(void) {
+    sim_bus_reset();
+    sim_core_reset();
+    sim_write(RCC_PLLCFG_ADDR, PLLCFGR_168MHZ);
+    sim_write(RCC_CFGR_ADDR, CFGR_168MHZ);
+    log_length = 0;
+    sim_watch(SIM_RCC_BASE, 0x90, log_write);
+}
+
+static void check_write(uint32_t n, uint32_t address, uint32_t old,
+                        uint32_t value) {
+    CHECK(n < log_length);
+    if (n >= log_length) {
+        return;
+    }
+    CHECK_EQ(log_entries[n].address, address);
+    CHECK_EQ(log_entries[n].old, old);
+    CHECK_EQ(log_entries[n].value, value);
+}
+
+static void test_one_write_per_register(void) {
+    static const peripheral_reset_t group[] = {
+        RESET_TIM2, RESET_TIM1, RESET_TIM3, RESET_ADC, RESET_UART3};
+    uint32_t apb1 = BIT0 | BIT1 | UPPER16BITS(BIT2);
+    uint32_t apb2 = BIT0 | BIT8;
+
+    setup();
+    reset_peripherals(group, 5, false);
+
+    /* Both asserted before either is released */
+    CHECK_EQ(log_length, 4);
+    check_write(0, rstr_addresses[RESET_APB1], 0, apb1);
+    check_write(1, rstr_addresses[RESET_APB2], 0, apb2);
+    check_write(2, rstr_addresses[RESET_APB1], apb1, 0);
+    check_write(3, rstr_addresses[RESET_APB2], apb2, 0);
+}
+
+static void test_hold_reset(void) {
+    static const peripheral_reset_t group[] = {RESET_SPI2, RESET_SPI3};
+    uint32_t bits = BITE | BITF;
+
+    setup();
+    /* Someone else's reset is already held and must stay */
+    sim_write(rstr_addresses[RESET_APB1], BIT3);
+
+    reset_peripherals(group, 2, true);
+    CHECK_EQ(log_length, 1);
+    check_write(0, rstr_addresses[RESET_APB1], BIT3, BIT3 | bits);
+
+    release_peripheral_resets(group, 2);
+    CHECK_EQ(log_length, 2);
+    check_write(1, rstr_addresses[RESET_APB1], BIT3 | bits, BIT3);
+}
+
+static void test_single_reset(void) {
+    setup();
+    /* reset_timer11() used to never assert anything */
+    reset_peripheral(RESET_TIM11, false);
+    CHECK_EQ(log_length, 2);
+    check_write(0, rstr_addresses[RESET_APB2], 0, UPPER16BITS(BIT2));
+    check_write(1, rstr_addresses[RESET_APB2], UPPER16BITS(BIT2), 0);
+
+    reset_peripheral(RESET_USB_OTG_FS, true);
+    check_write(2, rstr_addresses[RESET_AHB2], 0, BIT7);
+    release_peripheral_reset(RESET_USB_OTG_FS);
+    check_write(3, rstr_addresses[RESET_AHB2], BIT7, 0);
+}
+
+static void test_every_valid_bit(void) {
+    setup();
+    for (uint32_t reg = 0; reg < RESET_REGISTERS; reg++) {
+        for (uint32_t bit = 0; bit < 32; bit++) {
+            uint32_t mask = 1UL << bit;
+
+            if (!(valid_reset_masks[reg] & mask)) {
+                continue;
+            }
+            log_length = 0;
+            reset_peripheral((peripheral_reset_t)RESET_ID(reg, bit), false);
+            CHECK_EQ(log_length, 2);
+            check_write(0, rstr_addresses[reg], 0, mask);
+            check_write(1, rstr_addresses[reg], mask, 0);
+        }
+    }
+}
+
+static void reset_reserved_bit(void) {
+    /* Bit 9 of APB1RSTR is reserved */
+    reset_peripheral((peripheral_reset_t)RESET_ID(RESET_APB1, 9), false);
+}
+
+static void reset_bad_register(void) {
+    reset_peripheral((peripheral_reset_t)RESET_ID(RESET_REGISTERS, 0), false);
+}
+
+static void test_invalid_ids_assert(void) {
+    setup();
+    CHECK(expect_abort(reset_reserved_bit));
+    CHECK(expect_abort(reset_bad_register));
+    CHECK_EQ(log_length, 0);
+}
+
+static void test_hold_divider(void) {
+    setup();
+    CHECK_EQ(bus_clock_divider(RESET_AHB1), 1);
+    CHECK_EQ(bus_clock_divider(RESET_APB1), 4);
+    CHECK_EQ(bus_clock_divider(RESET_APB2), 2);
+
+    /* AHB /8 on top of APB1 /16 */
+    sim_write(RCC_CFGR_ADDR, (0xA << 4) | (7 << 10));
+    CHECK_EQ(bus_clock_divider(RESET_AHB2), 8);
+    CHECK_EQ(bus_clock_divider(RESET_APB1), 128);
+    CHECK_EQ(bus_clock_divider(RESET_APB2), 8);
+
+    /* AHB /512, the largest */
+    sim_write(RCC_CFGR_ADDR, 0xF << 4);
+    CHECK_EQ(bus_clock_divider(RESET_AHB3), 512);
+}
+
+static void test_bus_frequencies(void) {
+    setup();
+    CHECK_EQ(read_sysclk_frequency(), 168000000);
+    CHECK_EQ(read_bus_frequency(RESET_AHB1), 168000000);
+    CHECK_EQ(read_bus_frequency(RESET_APB1), 42000000);
+    CHECK_EQ(read_bus_frequency(RESET_APB2), 84000000);
+
+    /* Straight from the HSI after reset */
+    sim_write(RCC_CFGR_ADDR, 0);
+    CHECK_EQ(read_bus_frequency(RESET_APB1), 16000000);
+}
+
+static void test_backup_domain(void) {
+    setup();
+    reset_backup_domain(false);
+    CHECK_EQ(log_length, 2);
+    check_write(0, RCC_BDCR_ADDR, 0, UPPER16BITS(BIT0));
+    check_write(1, RCC_BDCR_ADDR, UPPER16BITS(BIT0), 0);
+
+    reset_backup_domain(true);
+    CHECK_EQ(log_length, 3);
+    CHECK_EQ(sim_read(RCC_BDCR_ADDR), UPPER16BITS(BIT0));
+}
+
+int main(void) {
+    RUN_TEST(test_one_write_per_register);
+    RUN_TEST(test_hold_reset);
+    RUN_TEST(test_single_reset);
+    RUN_TEST(test_every_valid_bit);
+    RUN_TEST(test_invalid_ids_assert);
+    RUN_TEST(test_hold_divider);
+    RUN_TEST(test_bus_frequencies);
+    RUN_TEST(test_backup_domain);
+    TEST_EXIT();
+}
@@ -0,0 +1,241 @@
+/*
+ * test_reaction_stats.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * reaction_stats.c against exact statistics computed on the side: the
+ * history ring, Welford's mean and deviation against plain sums, and the
+ * P-square percentiles against the exact ones from a full histogram of
+ * the (whole millisecond) samples.
+ */
+
+#include "reaction_stats.h"
+#include "test.h"
+#include <math.h>
+#include <string.h>
+
+#define MAX_MS 2000
+
+typedef struct {
+    uint64_t n;
+    double sum;
+    double sum_sq;
+    uint32_t min;
+    uint32_t max;
+    uint32_t histogram[MAX_MS + 1];
+} exact_t;
+
+static exact_t exact;
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static double uniform(void) {
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 7;
+    rng_state ^= rng_state << 17;
+    return ((rng_state >> 11) + 0.5) / 9007199254740992.0;
+}
+
+/**
+ * @brief Ex-Gaussian reaction time, the usual model: a normal part (mu,
+ * sigma) plus an exponential tail (tau), in whole ms.
+ */
+static uint32_t reaction_time(double mu, double sigma, double tau) {
+    double normal = sqrt(-2.0 * log(uniform())) * cos(2.0 * M_PI * uniform());
+    double x = mu + sigma * normal - tau * log(uniform());
+
+    if (x < 100) {
+        x = 100;
+    }
+    return x > MAX_MS ? MAX_MS : (uint32_t)x;
+}
+
+static void start(void) {
+    clear_reaction_stats();
+    memset(&exact, 0, sizeof(exact));
+    exact.min = UINT32_MAX;
+}
+
+static void add(uint32_t ms, uint32_t timestamp) {
+    record_reaction(ms, timestamp);
+    exact.n++;
+    exact.sum += ms;
+    exact.sum_sq += (double)ms * ms;
+    exact.min = ms < exact.min ? ms : exact.min;
+    exact.max = ms > exact.max ? ms : exact.max;
+    exact.histogram[ms]++;
+}
+
+/**
+ * @brief Smallest sample with at least p of the samples at or below it.
+ */
+static double exact_quantile(double p) {
+    uint64_t rank = (uint64_t)ceil(p * exact.n), seen = 0;
+
+    for (uint32_t ms = 0; ms <= MAX_MS; ms++) {
+        seen += exact.histogram[ms];
+        if (seen >= rank && seen) {
+            return ms;
+        }
+    }
+    return MAX_MS;
+}
+
+/**
+ * @brief Checks the summary against the exact values. The summary hands out
+ * floats, so the mean and deviation get 0.1%. Percentiles are allowed
+ * quantile_tolerance ms, the P-square markers only estimate them.
+ */
+static void check_summary(const char *name, double quantile_tolerance) {
+    reaction_summary_t s;
+    double n = (double)exact.n;
+    double mean = exact.sum / n;
+    double stddev = sqrt((exact.sum_sq - n * mean * mean) / (n - 1));
+    double p50 = exact_quantile(0.5), p90 = exact_quantile(0.9);
+
+    get_reaction_summary(&s);
+    printf("    %s, %llu samples: mean %.3f/%.3f, stddev %.3f/%.3f, "
+           "P50 %.1f/%.0f, P90 %.1f/%.0f\n",
+           name, (unsigned long long)exact.n, s.mean, mean, s.stddev, stddev,
+           s.p50, p50, s.p90, p90);
+    CHECK_EQ(s.count, exact.n);
+    CHECK_EQ(s.min, exact.min);
+    CHECK_EQ(s.max, exact.max);
+    CHECK(fabs(s.mean - mean) <= 1e-3 * mean);
+    CHECK(fabs(s.stddev - stddev) <= 1e-3 * stddev);
+    CHECK(fabs(s.p50 - p50) <= quantile_tolerance);
+    CHECK(fabs(s.p90 - p90) <= quantile_tolerance);
+}
+
+static void test_empty(void) {
+    reaction_summary_t s;
+    reaction_sample_t sample;
+
+    start();
+    get_reaction_summary(&s);
+    CHECK_EQ(s.count, 0);
+    CHECK_EQ(s.min, 0);
+    CHECK_EQ(s.max, 0);
+    CHECK(s.mean == 0.0f && s.stddev == 0.0f);
+    CHECK(s.p50 == 0.0f && s.p90 == 0.0f);
+    CHECK_EQ(get_reaction_history(&sample, 1), 0);
+    CHECK_EQ(get_reaction_history(NULL, 0), 0);
+}
+
+static void test_few_samples_exact(void) {
+    static const uint32_t ms[] = {300, 200, 500, 400};
+    reaction_summary_t s;
+
+    start();
+    add(250, 1);
+    get_reaction_summary(&s);
+    CHECK(s.mean == 250.0f && s.stddev == 0.0f);
+    CHECK(s.p50 == 250.0f && s.p90 == 250.0f);
+
+    start();
+    for (uint32_t i = 0; i < 4; i++) {
+        add(ms[i], i);
+    }
+    get_reaction_summary(&s);
+    /* Below 5 samples the percentiles come from the sorted samples */
+    CHECK(s.p50 == 300.0f || s.p50 == 400.0f);
+    CHECK(s.p90 == 500.0f);
+    CHECK(s.mean == 350.0f);
+    CHECK(fabsf(s.stddev - 129.0994f) < 1e-3f);
+    CHECK_EQ(s.min, 200);
+    CHECK_EQ(s.max, 500);
+}
+
+static void test_history_ring(void) {
+    reaction_sample_t samples[REACTION_HISTORY_SIZE + 1];
+    uint32_t total = REACTION_HISTORY_SIZE + 10;
+
+    start();
+    for (uint32_t i = 0; i < 3; i++) {
+        add(200 + i, 1000 * i);
+    }
+    CHECK_EQ(get_reaction_history(samples, 2), 2);
+    CHECK_EQ(samples[0].reaction_ms, 202);
+    CHECK_EQ(samples[0].timestamp, 2000);
+    CHECK_EQ(samples[1].reaction_ms, 201);
+    CHECK_EQ(get_reaction_history(samples, 10), 3);
+
+    /* Wraps and keeps only the newest */
+    start();
+    for (uint32_t i = 0; i < total; i++) {
+        add(200 + i, i);
+    }
+    CHECK_EQ(get_reaction_history(samples, REACTION_HISTORY_SIZE + 1),
+             REACTION_HISTORY_SIZE);
+    for (uint32_t i = 0; i < REACTION_HISTORY_SIZE; i++) {
+        CHECK_EQ(samples[i].reaction_ms, 200 + total - 1 - i);
+        CHECK_EQ(samples[i].timestamp, total - 1 - i);
+    }
+}
+
+static void test_clear(void) {
+    reaction_summary_t s;
+    reaction_sample_t sample;
+
+    start();
+    for (uint32_t i = 0; i < 100; i++) {
+        add(300 + i, i);
+    }
+    start();
+    add(150, 7);
+    get_reaction_summary(&s);
+    CHECK_EQ(s.count, 1);
+    CHECK_EQ(s.min, 150);
+    CHECK_EQ(s.max, 150);
+    CHECK(s.p90 == 150.0f);
+    CHECK_EQ(get_reaction_history(&sample, 1), 1);
+    CHECK_EQ(sample.timestamp, 7);
+}
+
+static void test_game_sized(void) {
+    /* A session: a few hundred reactions */
+    start();
+    for (uint32_t i = 0; i < 300; i++) {
+        add(reaction_time(250, 30, 80), i);
+    }
+    check_summary("session", 15);
+}
+
+static void test_long_run(void) {
+    start();
+    for (uint32_t i = 0; i < 1000000; i++) {
+        add(reaction_time(250, 30, 80), i);
+    }
+    check_summary("ex-Gaussian", 3);
+}
+
+static void test_sorted_input(void) {
+    /* Sorted input keeps moving the markers, the hard case for P-square */
+    start();
+    for (uint32_t i = 0; i < 100000; i++) {
+        add(100 + i * 1000 / 100000, i);
+    }
+    check_summary("ascending", 5);
+}
+
+static void test_two_groups(void) {
+    /* A fast and a slow player taking turns */
+    start();
+    for (uint32_t i = 0; i < 200000; i++) {
+        add(i & 1 ? reaction_time(200, 20, 30) : reaction_time(450, 40, 100),
+            i);
+    }
+    check_summary("two players", 5);
+}
+
+int main(void) {
+    RUN_TEST(test_empty);
+    RUN_TEST(test_few_samples_exact);
+    RUN_TEST(test_history_ring);
+    RUN_TEST(test_clear);
+    RUN_TEST(test_game_sized);
+    RUN_TEST(test_long_run);
+    RUN_TEST(test_sorted_input);
+    RUN_TEST(test_two_groups);
+    TEST_EXIT();
+}
@@ -0,0 +1,297 @@
+/*
+ * test_storage.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * storage.c on the simulated flash (sim/sim_flash.c). storage.c is included
+ * so a reboot can clear its state the way a reset would while the flash keeps
+ * its contents. Besides the basics this wears the two sectors through many
+ * compactions, and cuts the power at every flash operation around one.
+ */
+
+#include "../Core/Src/storage.c"
+#include "test.h"
+#include <string.h>
+
+#define RECORDS_PER_SECTOR ((KV_SECTOR_SIZE - KV_HEADER_SIZE) / KV_RECORD_SIZE)
+#define KV_AREA_SIZE       (KV_NUM_SECTORS * KV_SECTOR_SIZE)
+
+/* Guaranteed erase cycles per sector, F446 datasheet */
+#define FLASH_ENDURANCE    10000
+#define ENDURANCE_UPDATES  200000
+/* Updates the power cut window spans, enough for one compaction */
+#define CUT_UPDATES        40
+#define SETTLE_LIMIT       100000
+
+static jmp_buf power_fail;
+
+static void reboot(void) {
+    memset(values, 0, sizeof(values));
+    valid_keys = 0;
+    dirty_keys = 0;
+    active = 0;
+    generation = 0;
+    write_addr = 0;
+    erase_pending = KV_NO_SECTOR;
+    erasing = false;
+    erase_allowed = false;
+    formatted = false;
+    init_storage();
+}
+
+static void power_on(void) {
+    sim_bus_reset();
+    sim_core_reset();
+    sim_flash_reset();
+    reboot();
+}
+
+static bool idle(void) {
+    return formatted && !dirty_keys && !erasing &&
+           erase_pending == KV_NO_SECTOR;
+}
+
+/**
+ * @brief Runs storage_service() until everything is written and erased, as
+ * the main loop would with erases allowed.
+ */
+static void settle(void) {
+    storage_allow_erase(true);
+    for (uint32_t i = 0; i < SETTLE_LIMIT && !idle(); i++) {
+        storage_service();
+    }
+    CHECK(idle());
+}
+
+static void test_blank_start(void) {
+    uint32_t value = 0;
+
+    power_on();
+    CHECK(!storage_get(KEY_USER_SCORE, &value));
+    CHECK_EQ(storage_get_or(KEY_CPU_SCORE, 7), 7);
+
+    storage_set(KEY_USER_SCORE, 5);
+    CHECK_EQ(storage_get_or(KEY_USER_SCORE, 0), 5);
+    settle();
+    CHECK_EQ(sim_read(KV_SECTOR_ADDR(0)), 1);
+    CHECK_EQ(sim_read(KV_SECTOR_ADDR(0) + 4), KV_MAGIC);
+    /* A blank part needs no erase */
+    CHECK_EQ(sim_flash_erases(FLASH_SECTOR_2), 0);
+
+    reboot();
+    CHECK(storage_get(KEY_USER_SCORE, &value));
+    CHECK_EQ(value, 5);
+    CHECK(!storage_get(KEY_CPU_SCORE, &value));
+    CHECK_EQ(sim_flash_violations(), 0);
+}
+
+static void test_only_changes_written(void) {
+    uint32_t programs;
+
+    power_on();
+    storage_set(KEY_DIFFICULTY, 3);
+    settle();
+    programs = sim_flash_programs();
+    storage_set(KEY_DIFFICULTY, 3);
+    settle();
+    CHECK_EQ(sim_flash_programs(), programs);
+
+    /* Two changes before the service runs make one record */
+    storage_set(KEY_DIFFICULTY, 4);
+    storage_set(KEY_DIFFICULTY, 5);
+    settle();
+    CHECK_EQ(sim_flash_programs(), programs + 2);
+    reboot();
+    CHECK_EQ(storage_get_or(KEY_DIFFICULTY, 0), 5);
+}
+
+static void test_newest_record_wins(void) {
+    power_on();
+    for (uint32_t i = 1; i <= 20; i++) {
+        storage_set(KEY_USER_SCORE, i);
+        storage_set(KEY_CPU_SCORE, 100 + i);
+        settle();
+    }
+    reboot();
+    CHECK_EQ(storage_get_or(KEY_USER_SCORE, 0), 20);
+    CHECK_EQ(storage_get_or(KEY_CPU_SCORE, 0), 120);
+}
+
+static void test_erase_waits_for_permission(void) {
+    uint32_t user = 0;
+
+    power_on();
+    /* Fill sector 2, compact into sector 3 and stop before the erase */
+    while (active == 0 || dirty_keys) {
+        storage_set(KEY_USER_SCORE, ++user);
+        storage_allow_erase(false);
+        storage_service();
+    }
+    CHECK_EQ(active, 1);
+    CHECK_EQ(erase_pending, 0);
+    for (uint32_t i = 0; i < 100; i++) {
+        storage_service();
+    }
+    CHECK_EQ(sim_flash_erases(FLASH_SECTOR_2), 0);
+    CHECK(!erasing);
+
+    storage_allow_erase(true);
+    storage_service();
+    CHECK(erasing);
+    CHECK_EQ(sim_flash_erases(FLASH_SECTOR_2), 1);
+    /* Busy for a few polls, then the controller and cache are put back */
+    settle();
+    CHECK_EQ(sim_read((uint32_t)&FLASH->CR) & (FLASH_CR_SER | FLASH_CR_SNB),
+             0);
+    CHECK(sim_read((uint32_t)&FLASH->ACR) & FLASH_ACR_DCEN);
+
+    reboot();
+    CHECK_EQ(storage_get_or(KEY_USER_SCORE, 0), user);
+    CHECK_EQ(sim_flash_violations(), 0);
+}
+
+static void test_flush(void) {
+    power_on();
+    storage_set(KEY_USER_SCORE, 1);
+    settle();
+
+    /* Start the erase behind a compaction, then flush in the middle of it */
+    while (active == 0 || dirty_keys) {
+        storage_set(KEY_USER_SCORE, storage_get_or(KEY_USER_SCORE, 0) + 1);
+        storage_service();
+    }
+    storage_allow_erase(true);
+    storage_service();
+    CHECK(erasing);
+    storage_set(KEY_CPU_SCORE, 42);
+    storage_flush();
+    CHECK(!erasing);
+    CHECK_EQ(dirty_keys, 0);
+
+    reboot();
+    CHECK_EQ(storage_get_or(KEY_CPU_SCORE, 0), 42);
+    CHECK_EQ(sim_flash_violations(), 0);
+}
+
+static void test_endurance(void) {
+    uint32_t e2, e3, per_erase;
+
+    power_on();
+    storage_set(KEY_FSR_THRESHOLD, 1234);
+    storage_set(KEY_DIFFICULTY, 3);
+    for (uint32_t i = 1; i <= ENDURANCE_UPDATES; i++) {
+        storage_set(i & 1 ? KEY_USER_SCORE : KEY_CPU_SCORE, i);
+        settle();
+    }
+    e2 = sim_flash_erases(FLASH_SECTOR_2);
+    e3 = sim_flash_erases(FLASH_SECTOR_3);
+    per_erase = ENDURANCE_UPDATES / (e2 + e3);
+    printf("    %u updates: sector 2 erased %u times, sector 3 %u, "
+           "%u updates per erase\n",
+           ENDURANCE_UPDATES, e2, e3, per_erase);
+    printf("    %u cycles per sector last about %u million updates\n",
+           FLASH_ENDURANCE, 2 * FLASH_ENDURANCE * per_erase / 1000000);
+
+    /* The sectors take turns, and each compaction only carries the 4 live
+     * keys over */
+    CHECK(e2 <= e3 + 1 && e3 <= e2 + 1);
+    CHECK(per_erase >= RECORDS_PER_SECTOR - 4 - 1);
+    CHECK_EQ(sim_flash_violations(), 0);
+
+    reboot();
+    CHECK_EQ(storage_get_or(KEY_USER_SCORE, 0), ENDURANCE_UPDATES - 1);
+    CHECK_EQ(storage_get_or(KEY_CPU_SCORE, 0), ENDURANCE_UPDATES);
+    CHECK_EQ(storage_get_or(KEY_FSR_THRESHOLD, 0), 1234);
+    CHECK_EQ(storage_get_or(KEY_DIFFICULTY, 0), 3);
+}
+
+/* Changed on the way to a longjmp(), so kept in memory */
+static volatile uint32_t score;
+static volatile uint32_t committed;
+
+static void play(uint32_t updates) {
+    for (uint32_t i = 0; i < updates; i++) {
+        score++;
+        storage_set(KEY_USER_SCORE, score);
+        storage_set(KEY_CPU_SCORE, 3 * score);
+        settle();
+        committed = score;
+    }
+}
+
+/**
+ * @brief Cuts the power at each flash operation of CUT_UPDATES updates that
+ * start with prefill records in the active sector. After the reboot the
+ * scores must be the last committed ones or newer, never garbage, and the
+ * store must keep working.
+ */
+static uint32_t power_cut_sweep(uint32_t prefill) {
+    static uint8_t image[KV_AREA_SIZE];
+    uint32_t base, cuts = 0;
+
+    power_on();
+    score = 0;
+    play(prefill);
+    base = score;
+    memcpy(image, sim_alias(KV_SECTOR_ADDR(0), KV_AREA_SIZE), KV_AREA_SIZE);
+
+    for (uint32_t cut = 0;; cut++) {
+        uint32_t user, cpu;
+
+        memcpy(sim_alias(KV_SECTOR_ADDR(0), KV_AREA_SIZE), image,
+               KV_AREA_SIZE);
+        sim_flash_reset();
+        reboot();
+        score = base;
+        committed = base;
+
+        sim_flash_power_cut(cut, &power_fail);
+        if (!setjmp(power_fail)) {
+            play(CUT_UPDATES);
+            /* Every operation of the window has had its cut */
+            sim_flash_reset();
+            return cuts;
+        }
+        cuts++;
+
+        reboot();
+        user = storage_get_or(KEY_USER_SCORE, 0);
+        cpu = storage_get_or(KEY_CPU_SCORE, 0);
+        if (user < committed || user > score || cpu < 3 * committed ||
+            cpu > 3 * score || cpu % 3) {
+            printf("    cut %u: user %u cpu %u, committed %u, last %u\n", cut,
+                   user, cpu, committed, score);
+            CHECK(false);
+        }
+
+        /* Carries on from there */
+        score = user > cpu / 3 ? user : cpu / 3;
+        play(3);
+        reboot();
+        CHECK_EQ(storage_get_or(KEY_USER_SCORE, 0), score);
+        CHECK_EQ(storage_get_or(KEY_CPU_SCORE, 0), 3 * score);
+        CHECK_EQ(sim_flash_violations(), 0);
+    }
+}
+
+static void test_power_loss(void) {
+    /* From a blank part, then across a compaction and the erase after it */
+    uint32_t first = power_cut_sweep(0);
+    uint32_t full = power_cut_sweep(RECORDS_PER_SECTOR / 2 - CUT_UPDATES / 2);
+
+    printf("    %u and %u power cuts recovered\n", first, full);
+    CHECK(first >= 2 * CUT_UPDATES);
+    CHECK(full >= 2 * CUT_UPDATES);
+}
+
+int main(void) {
+    RUN_TEST(test_blank_start);
+    RUN_TEST(test_only_changes_written);
+    RUN_TEST(test_newest_record_wins);
+    RUN_TEST(test_erase_waits_for_permission);
+    RUN_TEST(test_flush);
+    RUN_TEST(test_endurance);
+    RUN_TEST(test_power_loss);
+    TEST_EXIT();
+}
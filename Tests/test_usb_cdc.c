@@ -0,0 +1,344 @@
+/*
+ * test_usb_cdc.c
+ *
+ *  Created on: Oct 19, 2026
+ *      Author: Tom
+ *
+ * usb_cdc.c on the USB endpoint model (sim/sim_usb.c), with the test as the
+ * host: enumeration and the CDC requests on EP0, then the data interface.
+ * Bulk IN is checked for its double buffering and ZLPs and streamed at the
+ * full speed limit of 19 bulk packets per 1 ms frame, with every byte
+ * checked. Bulk OUT must NAK rather than drop data once the ring is full.
+ */
+
+#include "usb_cdc.h"
+#include "core_m4.h"
+#include "idle.h"
+#include "test.h"
+#include <string.h>
+
+#define GET_STATUS          0x00
+#define SET_ADDRESS         0x05
+#define GET_DESCRIPTOR      0x06
+#define GET_CONFIGURATION   0x08
+#define SET_CONFIGURATION   0x09
+#define SET_LINE_CODING     0x20
+#define GET_LINE_CODING     0x21
+#define SET_CONTROL_LINE    0x22
+
+#define TO_DEVICE           0x00
+#define TO_HOST             0x80
+#define CLASS               0x21
+#define CLASS_IN            0xA1
+
+#define DATA_OUT            0x01
+#define DATA_IN             0x81
+#define PACKET              64
+
+/* Full speed bulk, with nothing else on the bus */
+#define PACKETS_PER_FRAME   19
+#define STREAM_FRAMES       2000
+#define STREAM_MIN_KB_PER_S 1000
+
+static PCD_HandleTypeDef hpcd;
+static uint32_t stop_blocks;
+
+void idle_block_stop(uint32_t source) {
+    stop_blocks |= source;
+}
+
+void idle_allow_stop(uint32_t source) {
+    stop_blocks &= ~source;
+}
+
+void OTG_FS_IRQHandler(void);
+
+static int32_t control(uint8_t type, uint8_t request, uint16_t value,
+                       uint16_t length, uint8_t *data) {
+    return sim_usb_control(type, request, value, 0, length, data);
+}
+
+/**
+ * @brief Enumerates and opens the port like a host would.
+ */
+static void connect(void) {
+    uint8_t data[256];
+
+    sim_bus_reset();
+    sim_core_reset();
+    sim_usb_reset();
+    sim_irq_attach(INT_NUM_OTG_FS, OTG_FS_IRQHandler);
+    stop_blocks = 0;
+    init_usb_cdc(&hpcd);
+
+    sim_usb_bus_reset();
+    CHECK_EQ(control(TO_HOST, GET_DESCRIPTOR, 0x0100, 64, data), 18);
+    CHECK_EQ(control(TO_DEVICE, SET_ADDRESS, 5, 0, NULL), 0);
+    CHECK_EQ(control(TO_HOST, GET_DESCRIPTOR, 0x0200, 255, data), 67);
+    CHECK_EQ(control(TO_DEVICE, SET_CONFIGURATION, 1, 0, NULL), 0);
+    CHECK_EQ(control(CLASS, SET_CONTROL_LINE, 0x0001, 0, NULL), 0);
+    CHECK(usb_cdc_connected());
+}
+
+/**
+ * @brief Reads IN packets until the endpoint NAKs or max packets came,
+ * and returns the bytes. A ZLP counts as a packet.
+ */
+static uint32_t host_read(uint8_t *data, uint32_t max_packets) {
+    uint32_t n = 0;
+
+    for (uint32_t i = 0; i < max_packets; i++) {
+        int32_t len = sim_usb_in(DATA_IN, data + n, PACKET);
+
+        if (len < 0) {
+            break;
+        }
+        n += len;
+    }
+    return n;
+}
+
+/* Byte at offset i of a stream, not periodic in a packet or a buffer */
+static uint8_t pattern(uint32_t i) {
+    return (uint8_t)(i * 7 + (i >> 8));
+}
+
+static void fill(uint8_t *data, uint32_t len, uint32_t start) {
+    for (uint32_t i = 0; i < len; i++) {
+        data[i] = pattern(start + i);
+    }
+}
+
+static void test_enumeration(void) {
+    static const uint32_t uid[3] = {0x00400041, 0x3235510D, 0x37383931};
+    uint8_t data[256];
+    int32_t n;
+
+    connect();
+    for (uint32_t i = 0; i < 3; i++) {
+        sim_write(UID_BASE + 4 * i, uid[i]);
+    }
+    CHECK_EQ(sim_usb_address(), 5);
+    CHECK(sim_usb_ep_open(DATA_IN) && sim_usb_ep_open(DATA_OUT) &&
+          sim_usb_ep_open(0x82));
+    CHECK(stop_blocks & IDLE_BLOCK_USB);
+
+    /* The configuration is 67 bytes, so two packets, and a short wLength
+     * cuts it */
+    CHECK_EQ(control(TO_HOST, GET_DESCRIPTOR, 0x0200, 9, data), 9);
+    CHECK_EQ(data[2], 67);
+    CHECK_EQ(control(TO_HOST, GET_CONFIGURATION, 0, 1, data), 1);
+    CHECK_EQ(data[0], 1);
+    CHECK_EQ(control(TO_HOST, GET_STATUS, 0, 2, data), 2);
+
+    /* The serial number is the UID in hex, in UTF-16 */
+    n = control(TO_HOST, GET_DESCRIPTOR, 0x0303, 255, data);
+    CHECK_EQ(n, 2 + 2 * 24);
+    CHECK_EQ(data[2], '0');
+    CHECK_EQ(data[2 + 2 * 7], '1');
+    CHECK_EQ(data[2 + 2 * 8], '3');
+    CHECK_EQ(data[2 + 2 * 15], 'D');
+
+    /* No device qualifier, full speed only */
+    CHECK_EQ(control(TO_HOST, GET_DESCRIPTOR, 0x0600, 10, data),
+             SIM_USB_STALL);
+    /* EP0 takes the next SETUP after a stall */
+    CHECK_EQ(control(TO_HOST, GET_DESCRIPTOR, 0x0100, 18, data), 18);
+    CHECK_EQ(sim_usb_violations(), 0);
+}
+
+static void test_line_coding(void) {
+    uint8_t coding[7] = {0x00, 0x10, 0x0E, 0x00, 0, 0, 8};
+    uint8_t data[7];
+
+    connect();
+    CHECK_EQ(control(CLASS, SET_LINE_CODING, 0, 7, coding), 7);
+    CHECK_EQ(control(CLASS_IN, GET_LINE_CODING, 0, 7, data), 7);
+    CHECK(!memcmp(data, coding, 7));
+
+    /* Dropping DTR closes the port, the configuration stays */
+    CHECK_EQ(control(CLASS, SET_CONTROL_LINE, 0, 0, NULL), 0);
+    CHECK(!usb_cdc_connected());
+    CHECK_EQ(sim_usb_violations(), 0);
+}
+
+static void test_double_buffering(void) {
+    uint8_t out[3 * USB_CDC_TX_BUFFER_SIZE], in[3 * USB_CDC_TX_BUFFER_SIZE];
+    uint32_t taken, n;
+
+    connect();
+    fill(out, sizeof(out), 0);
+
+    /* The first write goes on the wire at once, the next ones fill the other
+     * buffer until the first transfer is done */
+    CHECK_EQ(usb_cdc_write(out, 100), 100);
+    CHECK(sim_usb_ep_busy(DATA_IN));
+    CHECK_EQ(usb_cdc_tx_free(), USB_CDC_TX_BUFFER_SIZE);
+    taken = usb_cdc_write(out + 100, sizeof(out) - 100);
+    CHECK_EQ(taken, USB_CDC_TX_BUFFER_SIZE);
+    CHECK_EQ(usb_cdc_tx_free(), 0);
+    CHECK_EQ(usb_cdc_write(out, 1), 0);
+
+    /* 100 bytes as 64 + 36, then the second buffer */
+    CHECK_EQ(sim_usb_in(DATA_IN, in, PACKET), 64);
+    CHECK_EQ(sim_usb_in(DATA_IN, in + 64, PACKET), 36);
+    CHECK_EQ(usb_cdc_tx_free(), USB_CDC_TX_BUFFER_SIZE);
+    n = 100 + host_read(in + 100, 1000);
+    CHECK_EQ(n, 100 + taken);
+    CHECK(!memcmp(in, out, n));
+    CHECK_EQ(sim_usb_violations(), 0);
+}
+
+static void test_zlp(void) {
+    uint8_t out[2 * PACKET], in[2 * PACKET];
+
+    connect();
+    fill(out, sizeof(out), 0);
+
+    /* A transfer of whole packets with nothing after it ends with a ZLP */
+    CHECK_EQ(usb_cdc_write(out, sizeof(out)), sizeof(out));
+    CHECK_EQ(sim_usb_in(DATA_IN, in, PACKET), PACKET);
+    CHECK_EQ(sim_usb_in(DATA_IN, in + PACKET, PACKET), PACKET);
+    CHECK_EQ(sim_usb_in(DATA_IN, in, PACKET), 0);
+    CHECK_EQ(sim_usb_in(DATA_IN, in, PACKET), SIM_USB_NAK);
+    CHECK(!sim_usb_ep_busy(DATA_IN));
+
+    /* The port keeps going after it */
+    CHECK_EQ(usb_cdc_write(out, 10), 10);
+    CHECK_EQ(sim_usb_in(DATA_IN, in, PACKET), 10);
+
+    /* With the next buffer waiting, the stream just carries on */
+    CHECK_EQ(usb_cdc_write(out, sizeof(out)), sizeof(out));
+    CHECK_EQ(usb_cdc_write(out, 10), 10);
+    CHECK_EQ(sim_usb_in(DATA_IN, in, PACKET), PACKET);
+    CHECK_EQ(sim_usb_in(DATA_IN, in, PACKET), PACKET);
+    CHECK_EQ(sim_usb_in(DATA_IN, in, PACKET), 10);
+    CHECK_EQ(sim_usb_in(DATA_IN, in, PACKET), SIM_USB_NAK);
+    CHECK_EQ(sim_usb_violations(), 0);
+}
+
+static void test_receive(void) {
+    uint8_t packet[PACKET], data[USB_CDC_RX_BUFFER_SIZE];
+    uint32_t sent = 0, n;
+
+    connect();
+
+    /* The ring takes packets until it cannot hold a whole one, then the
+     * endpoint NAKs until the firmware reads */
+    for (uint32_t i = 0; i <= USB_CDC_RX_BUFFER_SIZE / PACKET; i++) {
+        fill(packet, PACKET, sent);
+        if (sim_usb_out(DATA_OUT, packet, PACKET) == SIM_USB_NAK) {
+            break;
+        }
+        sent += PACKET;
+    }
+    CHECK_EQ(sent, (USB_CDC_RX_BUFFER_SIZE / PACKET - 1) * PACKET);
+
+    n = usb_cdc_read(data, 100);
+    CHECK_EQ(n, 100);
+    CHECK_EQ(sim_usb_out(DATA_OUT, packet, 10), 10);
+    sent += 10;
+    n += usb_cdc_read(data + n, sizeof(data) - n);
+    CHECK_EQ(n, sent);
+    for (uint32_t i = 0; i < n; i++) {
+        if (data[i] != pattern(i)) {
+            CHECK_EQ(i, n);
+            break;
+        }
+    }
+    CHECK_EQ(sim_usb_violations(), 0);
+}
+
+static void test_stream(void) {
+    static uint8_t block[USB_CDC_TX_BUFFER_SIZE], in[PACKETS_PER_FRAME * 64];
+    uint32_t written = 0, received = 0, errors = 0;
+
+    connect();
+
+    /* The main loop keeps the buffers full between frames, the host takes
+     * whatever the endpoint has in each frame */
+    for (uint32_t frame = 0; frame < STREAM_FRAMES; frame++) {
+        uint32_t free = usb_cdc_tx_free(), n;
+
+        fill(block, free, written);
+        written += usb_cdc_write(block, free);
+
+        n = host_read(in, PACKETS_PER_FRAME);
+        for (uint32_t i = 0; i < n; i++) {
+            errors += in[i] != pattern(received + i);
+        }
+        received += n;
+    }
+
+    printf("    %u bytes in %u frames, %u KB/s, %u IN packets\n", received,
+           STREAM_FRAMES, received / STREAM_FRAMES,
+           sim_usb_in_packets(DATA_IN));
+    CHECK_EQ(errors, 0);
+    CHECK(received / STREAM_FRAMES >= STREAM_MIN_KB_PER_S);
+    CHECK_EQ(sim_usb_violations(), 0);
+}
+
+static void test_printf(void) {
+    static uint8_t block[USB_CDC_TX_BUFFER_SIZE];
+    uint8_t in[PACKET];
+    char longer[USB_CDC_LINE_SIZE + 10];
+
+    connect();
+    CHECK(usb_cdc_printf("%u %s\r\n", 42, "ok"));
+    CHECK_EQ(sim_usb_in(DATA_IN, in, PACKET), 7);
+    CHECK(!memcmp(in, "42 ok\r\n", 7));
+
+    /* Cut to the line buffer */
+    memset(longer, 'x', sizeof(longer) - 1);
+    longer[sizeof(longer) - 1] = '\0';
+    CHECK(usb_cdc_printf("%s", longer));
+    CHECK_EQ(host_read(block, 4), USB_CDC_LINE_SIZE - 1);
+
+    /* Whole lines only: a full buffer takes nothing */
+    fill(block, sizeof(block), 0);
+    usb_cdc_write(block, sizeof(block));
+    usb_cdc_write(block, usb_cdc_tx_free() - 3);
+    CHECK(!usb_cdc_printf("four"));
+    CHECK_EQ(usb_cdc_tx_free(), 3);
+    CHECK(usb_cdc_printf("two"));
+    CHECK_EQ(usb_cdc_tx_free(), 0);
+    CHECK_EQ(sim_usb_violations(), 0);
+
+    sim_usb_disconnect();
+    CHECK(!usb_cdc_printf("closed"));
+}
+
+static void test_reset_while_busy(void) {
+    uint8_t out[500], in[PACKET];
+
+    connect();
+    fill(out, sizeof(out), 0);
+    usb_cdc_write(out, sizeof(out));
+    CHECK_EQ(sim_usb_in(DATA_IN, in, PACKET), PACKET);
+
+    /* Unplugged mid transfer, then back */
+    sim_usb_disconnect();
+    CHECK(!usb_cdc_connected());
+    CHECK(!(stop_blocks & IDLE_BLOCK_USB));
+    CHECK_EQ(usb_cdc_write(out, 10), 0);
+
+    sim_usb_bus_reset();
+    CHECK_EQ(control(TO_DEVICE, SET_ADDRESS, 7, 0, NULL), 0);
+    CHECK_EQ(control(TO_DEVICE, SET_CONFIGURATION, 1, 0, NULL), 0);
+    CHECK_EQ(control(CLASS, SET_CONTROL_LINE, 0x0001, 0, NULL), 0);
+    CHECK_EQ(usb_cdc_write(out, 10), 10);
+    CHECK_EQ(sim_usb_in(DATA_IN, in, PACKET), 10);
+    CHECK_EQ(sim_usb_violations(), 0);
+}
+
+int main(void) {
+    RUN_TEST(test_enumeration);
+    RUN_TEST(test_line_coding);
+    RUN_TEST(test_double_buffering);
+    RUN_TEST(test_zlp);
+    RUN_TEST(test_receive);
+    RUN_TEST(test_stream);
+    RUN_TEST(test_printf);
+    RUN_TEST(test_reset_while_busy);
+    TEST_EXIT();
+}
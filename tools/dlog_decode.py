@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+"""Decode the raw deferred log stream ('log raw') from the USB CDC port.
+
+Every entry is a dlog_entry_t in little endian:
+
+    uint32_t header;     0xA5 << 24 | nargs << 16 | id
+    uint32_t timestamp;  ms since boot
+    uint32_t args[4];
+
+The id is the offset of the format string in the .dlog_fmt section, so the
+strings come from the ELF that is running on the board. They are pulled out
+with
+
+    arm-none-eabi-objcopy -O binary -j .dlog_fmt firmware.elf fmt.bin
+
+which this script runs itself unless --fmt-bin gives an extracted copy.
+
+    python3 tools/dlog_decode.py --elf Debug/Adv-Mech-Project-2.elf capture.bin
+    python3 tools/dlog_decode.py --elf firmware.elf /dev/ttyACM0
+"""
+
+import argparse
+import os
+import re
+import struct
+import subprocess
+import sys
+import tempfile
+
+ENTRY = struct.Struct("<6I")
+MAGIC = 0xA5000000
+MAGIC_MASK = 0xFF000000
+MAX_ARGS = 4
+
+CONVERSION = re.compile(
+    r"%([-+ 0#]*)(\d*)(?:\.(\d+))?(?:hh|h|ll|l|z|j|t)?([diuoxXc%])")
+
+
+def read_formats(args):
+    """Returns the .dlog_fmt section as bytes."""
+    if args.fmt_bin:
+        with open(args.fmt_bin, "rb") as f:
+            return f.read()
+
+    fd, path = tempfile.mkstemp(suffix=".bin")
+    os.close(fd)
+    try:
+        subprocess.run([args.objcopy, "-O", "binary", "-j", ".dlog_fmt",
+                        args.elf, path], check=True)
+        with open(path, "rb") as f:
+            return f.read()
+    finally:
+        os.remove(path)
+
+
+def format_string(section, offset):
+    end = section.find(b"\0", offset)
+    if offset >= len(section) or end < 0:
+        return None
+    return section[offset:end].decode("ascii", errors="replace")
+
+
+def c_format(fmt, values):
+    """printf() with 32 bit arguments, integer conversions only."""
+    values = list(values)
+
+    def convert(match):
+        flags, width, precision, kind = match.groups()
+        if kind == "%":
+            return "%"
+        value = values.pop(0) if values else 0
+        if kind in "di":
+            value = value - (1 << 32) if value & 0x80000000 else value
+            kind = "d"
+        elif kind == "u":
+            kind = "d"
+        elif kind == "c":
+            value = chr(value & 0xFF)
+        spec = "%" + flags + width
+        if precision is not None and kind != "c":
+            spec += "." + precision
+        return (spec + kind) % value
+
+    return CONVERSION.sub(convert, fmt)
+
+
+def decode(stream, section, out):
+    """Writes one line per entry. Bytes that do not start an entry are
+    skipped until the stream lines up with the magic again."""
+    buffer = b""
+    skipped = 0
+
+    while True:
+        chunk = stream.read(4096)
+        if not chunk:
+            break
+        buffer += chunk
+        while len(buffer) >= ENTRY.size:
+            header, timestamp, *values = ENTRY.unpack_from(buffer)
+            nargs = (header >> 16) & 0xFF
+            fmt = format_string(section, header & 0xFFFF)
+            if (header & MAGIC_MASK) != MAGIC or nargs > MAX_ARGS or \
+                    fmt is None:
+                buffer = buffer[1:]
+                skipped += 1
+                continue
+            if skipped:
+                print("dlog_decode: skipped %d bytes" % skipped,
+                      file=sys.stderr)
+                skipped = 0
+            out.write("[%u] %s\n" % (timestamp, c_format(fmt,
+                                                          values[:nargs])))
+            out.flush()
+            buffer = buffer[ENTRY.size:]
+
+    if buffer or skipped:
+        print("dlog_decode: %d trailing bytes" % (len(buffer) + skipped),
+              file=sys.stderr)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--elf", help="firmware the log came from")
+    source.add_argument("--fmt-bin",
+                        help=".dlog_fmt already extracted with objcopy")
+    parser.add_argument("--objcopy", default="arm-none-eabi-objcopy")
+    parser.add_argument("input", nargs="?", default="-",
+                        help="captured stream or serial device, '-' for "
+                             "stdin")
+    args = parser.parse_args()
+
+    try:
+        section = read_formats(args)
+    except (OSError, subprocess.CalledProcessError) as error:
+        sys.exit("dlog_decode: cannot read .dlog_fmt: %s" % error)
+
+    if args.input == "-":
+        decode(sys.stdin.buffer, section, sys.stdout)
+    else:
+        with open(args.input, "rb", buffering=0) as stream:
+            decode(stream, section, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
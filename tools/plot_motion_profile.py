@@ -0,0 +1,150 @@
+#!/usr/bin/env python3
+"""Plot and check the motion profiles written by Tests/bench_motion_profile.
+
+The CSV has one row per control tick of each move
+
+    move,tick,seconds,position,velocity
+
+with the position in travel and the velocity in travel per second, and a line
+
+    # <move> <shape> <max velocity> <max acceleration> <max jerk>
+
+ahead of each move. The acceleration is taken from the velocity of
+consecutive ticks. Every move is checked to start and end at rest, to never
+go backwards and to stay within its velocity and acceleration limits; the
+jerk shows up in the tick to tick acceleration only in steps, so
+test_motion_profile checks that one on the tables.
+
+The plot needs matplotlib; without it, or with --check, only the check runs.
+
+    python3 tools/plot_motion_profile.py profiles.csv
+    python3 tools/plot_motion_profile.py profiles.csv -o profiles.png
+"""
+
+import argparse
+import csv
+import sys
+
+# Relative, the same slack as test_motion_profile
+TOLERANCE = 0.01
+
+
+def parse(lines):
+    """Returns {move: (limits, [(seconds, position, velocity)])}."""
+    moves = {}
+
+    for row in csv.reader(lines):
+        if not row or row[0] == "move":
+            continue
+        if row[0].startswith("#"):
+            name, shape, velocity, accel, jerk = row[0][1:].split()
+            moves[name] = ({"shape": shape, "velocity": float(velocity),
+                            "acceleration": float(accel),
+                            "jerk": float(jerk)}, [])
+            continue
+        if row[0] not in moves:
+            raise ValueError("samples of '%s' before its limits" % row[0])
+        moves[row[0]][1].append(tuple(float(x) for x in row[2:5]))
+
+    if not moves:
+        raise ValueError("no moves found")
+    return moves
+
+
+def acceleration(samples):
+    """Acceleration between consecutive ticks, at the later one."""
+    return [0.0] + [(v1 - v0) / (t1 - t0) for (t0, _, v0), (t1, _, v1)
+                    in zip(samples, samples[1:])]
+
+
+def check(name, limits, samples):
+    """Prints the peaks against the limits, returns False on a violation."""
+    velocities = [v for _, _, v in samples]
+    peak_v = max(abs(v) for v in velocities)
+    peak_a = max(abs(a) for a in acceleration(samples))
+    problems = []
+
+    if velocities[0] != 0 or velocities[-1] != 0:
+        problems.append("not at rest at both ends")
+    if any(p1 < p0 for (_, p0, _), (_, p1, _) in zip(samples, samples[1:])):
+        problems.append("goes backwards")
+    if peak_v > limits["velocity"] * (1 + TOLERANCE):
+        problems.append("velocity over the limit")
+    if peak_a > limits["acceleration"] * (1 + TOLERANCE):
+        problems.append("acceleration over the limit")
+
+    print("%s (%s): %.1f ms, travel %.4f, peak velocity %.1f of %g, "
+          "acceleration %.0f of %g%s" %
+          (name, limits["shape"], 1e3 * samples[-1][0], samples[-1][1],
+           peak_v, limits["velocity"], peak_a, limits["acceleration"],
+           "".join(", " + p for p in problems)))
+    return not problems
+
+
+def plot(moves, output):
+    import matplotlib
+    if output:
+        matplotlib.use("Agg")
+    import matplotlib.pyplot as plt
+
+    fig, axes = plt.subplots(3, len(moves), sharex="col", squeeze=False,
+                             figsize=(5 * len(moves), 8))
+    for column, (name, (limits, samples)) in enumerate(moves.items()):
+        ms = [1e3 * t for t, _, _ in samples]
+        position, velocity, accel = axes[0][column], axes[1][column], \
+            axes[2][column]
+
+        position.set_title("%s (%s)" % (name, limits["shape"]))
+        position.plot(ms, [p for _, p, _ in samples])
+        position.set_ylabel("position (travel)")
+        velocity.plot(ms, [v for _, _, v in samples])
+        velocity.axhline(limits["velocity"], color="r", linestyle="--")
+        velocity.set_ylabel("velocity (travel/s)")
+        accel.plot(ms, acceleration(samples))
+        for sign in (1, -1):
+            accel.axhline(sign * limits["acceleration"], color="r",
+                          linestyle="--")
+        accel.set_ylabel("acceleration (travel/s^2)")
+        accel.set_xlabel("ms")
+
+    fig.tight_layout()
+    if output:
+        fig.savefig(output)
+    else:
+        plt.show()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", nargs="?", default="-",
+                        help="CSV from bench_motion_profile, '-' for stdin")
+    parser.add_argument("-o", "--output",
+                        help="image to write instead of showing the plot")
+    parser.add_argument("--check", action="store_true",
+                        help="only check the limits, do not plot")
+    args = parser.parse_args()
+
+    if args.input == "-":
+        lines = sys.stdin.readlines()
+    else:
+        with open(args.input) as f:
+            lines = f.readlines()
+
+    try:
+        moves = parse(lines)
+    except ValueError as error:
+        sys.exit("plot_motion_profile: %s" % error)
+
+    ok = all([check(name, limits, samples)
+              for name, (limits, samples) in moves.items()])
+
+    if not args.check:
+        try:
+            plot(moves, args.output)
+        except ImportError:
+            print("matplotlib not found, not plotting", file=sys.stderr)
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,127 @@
+#!/usr/bin/env python3
+"""Convert a 'trace' dump from the console into a Chrome trace.
+
+trace_dump() prints
+
+    # trace <cpu hz> <records>
+    # <id> <name>
+    <delta> <id> <payload>
+
+where each delta is the CPU cycles since the previous record. The deltas are
+summed into absolute times and written as Chrome trace events, which
+chrome://tracing or https://ui.perfetto.dev can open. dispatch_begin and
+dispatch_end become duration slices, every other id is an instant event.
+Lines that do not belong to the dump (shell output, log lines) are skipped.
+
+    python3 tools/trace2chrome.py console.txt -o trace.json
+"""
+
+import argparse
+import json
+import re
+import sys
+
+HEADER = re.compile(r"^# trace (\d+) (\d+)$")
+NAME = re.compile(r"^# (\d+) (\S+)$")
+RECORD = re.compile(r"^(\d+) (\d+) (\d+)$")
+
+BEGIN = "dispatch_begin"
+END = "dispatch_end"
+
+
+def parse(lines):
+    """Returns (hz, names, records) for the last dump in lines."""
+    hz = None
+    names = {}
+    records = []
+    expected = 0
+
+    for line in lines:
+        line = line.strip()
+        match = HEADER.match(line)
+        if match:
+            hz = int(match.group(1))
+            expected = int(match.group(2))
+            names = {}
+            records = []
+            continue
+        if hz is None:
+            continue
+        match = NAME.match(line)
+        if match:
+            names[int(match.group(1))] = match.group(2)
+            continue
+        match = RECORD.match(line)
+        if match and len(records) < expected:
+            records.append(tuple(int(g) for g in match.groups()))
+
+    if hz is None:
+        raise ValueError("no '# trace' header found")
+    if len(records) != expected:
+        print("warning: %d of %d records found" % (len(records), expected),
+              file=sys.stderr)
+    return hz, names, records
+
+
+def to_events(hz, names, records):
+    """Sums the deltas and builds the Chrome trace event list."""
+    events = []
+    cycles = 0
+    open_slices = 0
+
+    for delta, ident, payload in records:
+        cycles += delta
+        ts = cycles * 1e6 / hz
+        name = names.get(ident, "id%d" % ident)
+        event = {"name": name, "pid": 0, "tid": 0, "ts": ts,
+                 "args": {"payload": payload, "cycles": cycles}}
+        if name == BEGIN:
+            event.update(name="dispatch 0x%x" % payload, ph="B")
+            open_slices += 1
+        elif name == END:
+            if not open_slices:
+                # The begin record was overwritten by the ring buffer
+                continue
+            event.update(name="dispatch 0x%x" % payload, ph="E")
+            open_slices -= 1
+        else:
+            event.update(ph="i", s="t", tid=1)
+        events.append(event)
+
+    return events
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", nargs="?", default="-",
+                        help="captured console output, '-' for stdin")
+    parser.add_argument("-o", "--output", default="-",
+                        help="JSON file to write, '-' for stdout")
+    args = parser.parse_args()
+
+    if args.input == "-":
+        lines = sys.stdin.readlines()
+    else:
+        with open(args.input, encoding="ascii", errors="replace") as f:
+            lines = f.readlines()
+
+    try:
+        hz, names, records = parse(lines)
+    except ValueError as error:
+        sys.exit("trace2chrome: %s" % error)
+
+    trace = {
+        "traceEvents": to_events(hz, names, records),
+        "displayTimeUnit": "ns",
+        "otherData": {"cpu_hz": hz, "records": len(records)},
+    }
+    if args.output == "-":
+        json.dump(trace, sys.stdout, indent=1)
+        sys.stdout.write("\n")
+    else:
+        with open(args.output, "w") as f:
+            json.dump(trace, f, indent=1)
+
+
+if __name__ == "__main__":
+    main()